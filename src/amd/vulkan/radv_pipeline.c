@@ -2925,6 +2925,10 @@ void radv_create_shaders(struct radv_pipeline *pipeline,
 			nir_shader_gather_info(nir[i], nir_shader_get_entrypoint(nir[i]));
 
 			if (device->physical_device->use_aco) {
+				/* LLVM does its own LICM, ACO relies on NIR for it. */
+				if (!(flags & VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT))
+					NIR_PASS_V(nir[i], nir_opt_licm, 32);
+
 				NIR_PASS_V(nir[i], nir_lower_non_uniform_access,
 				           nir_lower_non_uniform_ubo_access |
 				           nir_lower_non_uniform_ssbo_access |
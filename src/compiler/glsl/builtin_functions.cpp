@@ -39,7 +39,9 @@
  *
  *    The builtin_builder::create_builtins() function contains lists of all
  *    built-in function signatures, where they're available, what types they
- *    take, and so on.
+ *    take, and so on.  Functions are only created the first time they are
+ *    looked up, so that compiling a shader doesn't build the IR of every
+ *    built-in.
  *
  * 4. Implementations of built-in function signatures
  *
@@ -83,6 +85,7 @@
 #include <math.h>
 #include "builtin_functions.h"
 #include "util/hash_table.h"
+#include "util/set.h"
 
 #define M_PIf   ((float) M_PI)
 #define M_PI_2f ((float) M_PI_2)
@@ -873,18 +876,46 @@ public:
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, exec_list *actual_parameters);
 
+   /** Get a built-in function or intrinsic, creating it if needed. */
+   ir_function *get_function(const char *name);
+
    /**
-    * A shader to hold all the built-in signatures; created by this module.
+    * A shader to hold the built-in signatures; created by this module.
     *
-    * This includes signatures for every built-in, regardless of version or
-    * enabled extensions.  The availability predicate associated with each
-    * signature allows matching_signature() to filter out the irrelevant ones.
+    * This includes signatures for every built-in looked up so far,
+    * regardless of version or enabled extensions.  The availability
+    * predicate associated with each signature allows matching_signature()
+    * to filter out the irrelevant ones.
     */
    gl_shader *shader;
 
 private:
    void *mem_ctx;
 
+   /**
+    * Names of all the built-ins and intrinsics, so that looking up other
+    * names doesn't go through the lists.
+    */
+   struct set *names;
+
+   /**
+    * The function being created.  create_intrinsics() and create_builtins()
+    * skip all the others, without calling their signature generators.
+    *
+    * While NULL, they only fill in names.
+    */
+   const char *wanted_name;
+
+   bool wants(const char *name)
+   {
+      if (wanted_name == NULL) {
+         _mesa_set_add(names, name);
+         return false;
+      }
+
+      return strcmp(name, wanted_name) == 0;
+   }
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
@@ -1256,7 +1287,7 @@ enum image_function_flags {
  *  @{
  */
 builtin_builder::builtin_builder()
-   : shader(NULL)
+   : shader(NULL), names(NULL), wanted_name(NULL)
 {
    mem_ctx = NULL;
 }
@@ -1279,7 +1310,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = shader->symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1291,6 +1322,23 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   ir_function *f = shader->symbols->get_function(name);
+   if (f != NULL || !_mesa_set_search(names, name))
+      return f;
+
+   /* Built-ins may need intrinsics while they are being created. */
+   const char *outer_name = wanted_name;
+   wanted_name = name;
+   create_intrinsics();
+   create_builtins();
+   wanted_name = outer_name;
+
+   return shader->symbols->get_function(name);
+}
+
 void
 builtin_builder::initialize()
 {
@@ -1301,7 +1349,11 @@ builtin_builder::initialize()
    glsl_type_singleton_init_or_ref();
 
    mem_ctx = ralloc_context(NULL);
+   names = _mesa_set_create(mem_ctx, _mesa_hash_string,
+                            _mesa_key_string_equal);
    create_shader();
+
+   /* The names are all string literals, so the set can point at them. */
    create_intrinsics();
    create_builtins();
 }
@@ -1311,6 +1363,7 @@ builtin_builder::release()
 {
    ralloc_free(mem_ctx);
    mem_ctx = NULL;
+   names = NULL;
 
    ralloc_free(shader);
    shader = NULL;
@@ -1331,6 +1384,15 @@ builtin_builder::create_shader()
 
 /** @} */
 
+/* Only create the function being looked up.  The other signature generators
+ * aren't even called.
+ */
+#define add_function(NAME, ...)                      \
+   do {                                              \
+      if (wants(NAME))                               \
+         this->add_function(NAME, __VA_ARGS__);      \
+   } while (0)
+
 /**
  * Create ir_function and ir_function_signature objects for each
  * intrinsic.
@@ -4540,6 +4602,8 @@ builtin_builder::create_builtins()
 #undef FIU2_MIXED
 }
 
+#undef add_function
+
 void
 builtin_builder::add_function(const char *name, ...)
 {
@@ -4610,6 +4674,9 @@ builtin_builder::add_image_function(const char *name,
       glsl_type::uimage2DMSArray_type
    };
 
+   if (!wants(name))
+      return;
+
    ir_function *f = new(mem_ctx) ir_function(name);
 
    for (unsigned i = 0; i < ARRAY_SIZE(types); ++i) {
@@ -7110,7 +7177,7 @@ builtin_builder::_atomic_counter_op(const char *intrinsic,
    MAKE_SIG(glsl_type::uint_type, avail, 1, counter);
 
    ir_variable *retval = body.make_temp(glsl_type::uint_type, "atomic_retval");
-   body.emit(call(shader->symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7141,7 +7208,7 @@ builtin_builder::_atomic_counter_op1(const char *intrinsic,
       parameters.push_tail(new(mem_ctx) ir_dereference_variable(neg_data));
 
       ir_function *const func =
-         shader->symbols->get_function("__intrinsic_atomic_add");
+         get_function("__intrinsic_atomic_add");
       ir_instruction *const c = call(func, retval, parameters);
 
       assert(c != NULL);
@@ -7149,7 +7216,7 @@ builtin_builder::_atomic_counter_op1(const char *intrinsic,
 
       body.emit(c);
    } else {
-      body.emit(call(shader->symbols->get_function(intrinsic), retval,
+      body.emit(call(get_function(intrinsic), retval,
                      sig->parameters));
    }
 
@@ -7167,7 +7234,7 @@ builtin_builder::_atomic_counter_op2(const char *intrinsic,
    MAKE_SIG(glsl_type::uint_type, avail, 3, counter, compare, data);
 
    ir_variable *retval = body.make_temp(glsl_type::uint_type, "atomic_retval");
-   body.emit(call(shader->symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7183,7 +7250,7 @@ builtin_builder::_atomic_op2(const char *intrinsic,
    MAKE_SIG(type, avail, 2, atomic, data);
 
    ir_variable *retval = body.make_temp(type, "atomic_retval");
-   body.emit(call(shader->symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7200,7 +7267,7 @@ builtin_builder::_atomic_op3(const char *intrinsic,
    MAKE_SIG(type, avail, 3, atomic, data1, data2);
 
    ir_variable *retval = body.make_temp(type, "atomic_retval");
-   body.emit(call(shader->symbols->get_function(intrinsic), retval,
+   body.emit(call(get_function(intrinsic), retval,
                   sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7397,7 +7464,7 @@ builtin_builder::_image(image_prototype_ctr prototype,
 
    if (flags & IMAGE_FUNCTION_EMIT_STUB) {
       ir_factory body(&sig->body, mem_ctx);
-      ir_function *f = shader->symbols->get_function(intrinsic_name);
+      ir_function *f = get_function(intrinsic_name);
 
       if (flags & IMAGE_FUNCTION_RETURNS_VOID) {
          body.emit(call(f, NULL, sig->parameters));
@@ -7430,7 +7497,7 @@ builtin_builder::_memory_barrier(const char *intrinsic_name,
                                  builtin_available_predicate avail)
 {
    MAKE_SIG(glsl_type::void_type, avail, 0);
-   body.emit(call(shader->symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   NULL, sig->parameters));
    return sig;
 }
@@ -7452,7 +7519,7 @@ builtin_builder::_ballot()
    MAKE_SIG(glsl_type::uint64_t_type, shader_ballot, 1, value);
    ir_variable *retval = body.make_temp(glsl_type::uint64_t_type, "retval");
 
-   body.emit(call(shader->symbols->get_function("__intrinsic_ballot"),
+   body.emit(call(get_function("__intrinsic_ballot"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7475,7 +7542,7 @@ builtin_builder::_read_first_invocation(const glsl_type *type)
    MAKE_SIG(type, shader_ballot, 1, value);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(shader->symbols->get_function("__intrinsic_read_first_invocation"),
+   body.emit(call(get_function("__intrinsic_read_first_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7500,7 +7567,7 @@ builtin_builder::_read_invocation(const glsl_type *type)
    MAKE_SIG(type, shader_ballot, 2, value, invocation);
    ir_variable *retval = body.make_temp(type, "retval");
 
-   body.emit(call(shader->symbols->get_function("__intrinsic_read_invocation"),
+   body.emit(call(get_function("__intrinsic_read_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7519,7 +7586,7 @@ builtin_builder::_invocation_interlock(const char *intrinsic_name,
                                        builtin_available_predicate avail)
 {
    MAKE_SIG(glsl_type::void_type, avail, 0);
-   body.emit(call(shader->symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   NULL, sig->parameters));
    return sig;
 }
@@ -7540,7 +7607,7 @@ builtin_builder::_shader_clock(builtin_available_predicate avail,
 
    ir_variable *retval = body.make_temp(glsl_type::uvec2_type, "clock_retval");
 
-   body.emit(call(shader->symbols->get_function("__intrinsic_shader_clock"),
+   body.emit(call(get_function("__intrinsic_shader_clock"),
                   retval, sig->parameters));
 
    if (type == glsl_type::uint64_t_type) {
@@ -7571,7 +7638,7 @@ builtin_builder::_vote(const char *intrinsic_name,
 
    ir_variable *retval = body.make_temp(glsl_type::bool_type, "retval");
 
-   body.emit(call(shader->symbols->get_function(intrinsic_name),
+   body.emit(call(get_function(intrinsic_name),
                   retval, sig->parameters));
    body.emit(ret(retval));
    return sig;
@@ -7592,7 +7659,7 @@ builtin_builder::_helper_invocation()
 
    ir_variable *retval = body.make_temp(glsl_type::bool_type, "retval");
 
-   body.emit(call(shader->symbols->get_function("__intrinsic_helper_invocation"),
+   body.emit(call(get_function("__intrinsic_helper_invocation"),
                   retval, sig->parameters));
    body.emit(ret(retval));
 
@@ -7649,7 +7716,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    mtx_lock(&builtins_lock);
-   f = builtins.shader->symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -7663,10 +7730,15 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
-gl_shader *
-_mesa_glsl_get_builtin_function_shader()
+ir_function *
+_mesa_glsl_get_builtin_function(const char *name)
 {
-   return builtins.shader;
+   ir_function *f;
+   mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   mtx_unlock(&builtins_lock);
+
+   return f;
 }
 
 
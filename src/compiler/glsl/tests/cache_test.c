@@ -35,6 +35,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "util/macros.h"
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
 
@@ -423,6 +424,345 @@ test_put_and_get(void)
    disk_cache_destroy(cache);
 }
 
+static void
+test_put_and_get_packed(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   char string[] = "While this string has thirty-four";
+   uint8_t string_key[20];
+   uint8_t *big[3];
+   uint8_t big_key[3][20];
+   const size_t big_size = 400 * 1024;
+   char *result;
+   size_t size;
+
+   setenv("MESA_GLSL_CACHE_PACKED", "true", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+   expect_non_null(cache, "disk_cache_create with MESA_GLSL_CACHE_PACKED");
+
+   /* Simple test of put and get. */
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_compute_key(cache, string, sizeof(string), string_key);
+
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   disk_cache_put(cache, string_key, string, sizeof(string), NULL);
+
+   /* disk_cache_put() hands things off to a thread so wait for it. */
+   disk_cache_wait_for_idle(cache);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "packed disk_cache_get of existing item (pointer)");
+   expect_equal(size, sizeof(blob), "packed disk_cache_get of existing item (size)");
+   free(result);
+
+   result = disk_cache_get(cache, string_key, &size);
+   expect_equal_str(string, result, "2nd packed disk_cache_get of existing item (pointer)");
+   expect_equal(size, sizeof(string), "2nd packed disk_cache_get of existing item (size)");
+   free(result);
+
+   disk_cache_remove(cache, string_key);
+   expect_true(!does_cache_contain(cache, string_key),
+               "packed disk_cache_get of removed item");
+
+   /* Entries survive destroying and recreating the cache. */
+   disk_cache_destroy(cache);
+   cache = disk_cache_create("test", "make_check", 0);
+   expect_true(does_cache_contain(cache, blob_key),
+               "packed disk_cache_get after recreating the cache");
+
+   /* Incompressible data, so that three of these overflow the 1M cache. */
+   for (unsigned i = 0; i < 3; i++) {
+      big[i] = malloc(big_size);
+      for (unsigned j = 0; j < big_size; j++)
+         big[i][j] = rand();
+      disk_cache_compute_key(cache, big[i], big_size, big_key[i]);
+   }
+
+   disk_cache_put(cache, big_key[0], big[0], big_size, NULL);
+   disk_cache_wait_for_idle(cache);
+   disk_cache_put(cache, big_key[1], big[1], big_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   /* Touch the first one so that the second is the least recently used. */
+   expect_true(does_cache_contain(cache, big_key[0]),
+               "packed disk_cache_get before overflow");
+
+   disk_cache_put(cache, big_key[2], big[2], big_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_true(!does_cache_contain(cache, big_key[1]),
+               "packed eviction of the least recently used item");
+   expect_true(!does_cache_contain(cache, blob_key),
+               "packed eviction of an older item");
+
+   result = disk_cache_get(cache, big_key[0], &size);
+   expect_true(result && size == big_size && memcmp(result, big[0], size) == 0,
+               "packed disk_cache_get of recently used item after eviction");
+   free(result);
+
+   result = disk_cache_get(cache, big_key[2], &size);
+   expect_true(result && size == big_size && memcmp(result, big[2], size) == 0,
+               "packed disk_cache_get of last item after eviction");
+   free(result);
+
+   for (unsigned i = 0; i < 3; i++)
+      free(big[i]);
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_GLSL_CACHE_PACKED");
+}
+
+static void
+test_mem_cache_and_batch(void)
+{
+   struct disk_cache *cache;
+   char blobs[4][40];
+   uint8_t keys[4][20];
+   uint8_t batch_keys[4][20];
+   void *data[4];
+   size_t sizes[4];
+   char *result;
+   size_t size;
+   unsigned found;
+   int err;
+
+   unsetenv("MESA_GLSL_CACHE_MEM_SIZE");
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (unsigned i = 0; i < 4; i++) {
+      snprintf(blobs[i], sizeof(blobs[i]), "This is blob number %u", i);
+      disk_cache_compute_key(cache, blobs[i], strlen(blobs[i]) + 1, keys[i]);
+      disk_cache_put(cache, keys[i], blobs[i], strlen(blobs[i]) + 1, NULL);
+   }
+
+   /* disk_cache_put() hands things off to a thread so wait for it. */
+   disk_cache_wait_for_idle(cache);
+
+   /* Fetch the first three items plus one that was never stored. */
+   memcpy(batch_keys, keys, 3 * sizeof(keys[0]));
+   disk_cache_compute_key(cache, "missing", sizeof("missing"), batch_keys[3]);
+
+   found = disk_cache_get_batch(cache, (const cache_key *) batch_keys, 4,
+                                data, sizes);
+   expect_equal(found, 3, "disk_cache_get_batch number of items found");
+   for (unsigned i = 0; i < 3; i++) {
+      expect_equal_str(blobs[i], data[i], "disk_cache_get_batch (pointer)");
+      expect_equal(sizes[i], strlen(blobs[i]) + 1,
+                   "disk_cache_get_batch (size)");
+      free(data[i]);
+   }
+   expect_null(data[3], "disk_cache_get_batch of non-existing item");
+
+   disk_cache_prefetch(cache, (const cache_key *) &keys[3], 1);
+   disk_cache_wait_for_idle(cache);
+
+   /* Items that were read or prefetched are now served from memory, even
+    * with the files gone.
+    */
+   err = rmrf_local(CACHE_TEST_TMP "/mesa-glsl-cache-dir");
+   expect_equal(err, 0, "Removing " CACHE_TEST_TMP "/mesa-glsl-cache-dir");
+
+   result = disk_cache_get(cache, keys[0], &size);
+   expect_equal_str(blobs[0], result, "disk_cache_get from memory (pointer)");
+   expect_equal(size, strlen(blobs[0]) + 1, "disk_cache_get from memory (size)");
+   free(result);
+
+   result = disk_cache_get(cache, keys[3], &size);
+   expect_equal_str(blobs[3], result, "disk_cache_get of prefetched item");
+   free(result);
+
+   disk_cache_remove(cache, keys[0]);
+   expect_true(!does_cache_contain(cache, keys[0]),
+               "disk_cache_get of removed item in memory");
+
+   disk_cache_destroy(cache);
+
+   /* The other tests check what is on disk. */
+   setenv("MESA_GLSL_CACHE_MEM_SIZE", "0", 1);
+}
+
+static void
+test_compression(void)
+{
+   struct disk_cache *cache;
+   struct disk_cache_stats stats;
+   char blobs[300][128];
+   uint8_t keys[300][20];
+   char *result;
+   size_t size;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blobs); i++) {
+      snprintf(blobs[i], sizeof(blobs[i]),
+               "shader %u: vec4 main() { return texture(sampler%u, "
+               "vec2(%u.0, %u.0)) * uniform%u; }", i, i % 7, i, i * 3, i % 5);
+      memset(keys[i], 0, sizeof(keys[i]));
+      memcpy(keys[i], &i, sizeof(i));
+   }
+
+   /* Each entry takes at least a block on disk, don't evict any. */
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "16M", 1);
+   setenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL", "1", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_put(cache, keys[0], blobs[0], sizeof(blobs[0]), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   result = disk_cache_get(cache, keys[0], &size);
+   expect_equal_str(blobs[0], result, "disk_cache_get at level 1");
+   free(result);
+
+   disk_cache_get_stats(cache, &stats);
+   expect_equal(stats.compressed_entries, 1, "stats compressed entries");
+   expect_equal(stats.dict_entries, 0, "stats dictionary entries");
+   expect_equal(stats.uncompressed_size, sizeof(blobs[0]),
+                "stats uncompressed size");
+   expect_true(stats.compressed_size < stats.uncompressed_size,
+               "stats compressed size");
+   expect_equal(stats.decompressed_entries, 1, "stats decompressed entries");
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL");
+
+#ifdef HAVE_ZSTD
+   /* Enough entries to train the dictionary, then some using it. */
+   setenv("MESA_GLSL_CACHE_DICT", "true", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (unsigned i = 1; i < ARRAY_SIZE(blobs); i++) {
+      disk_cache_put(cache, keys[i], blobs[i], sizeof(blobs[i]), NULL);
+      /* Keep the order, so that the last entries come after training. */
+      disk_cache_wait_for_idle(cache);
+   }
+
+   disk_cache_get_stats(cache, &stats);
+   expect_true(stats.dict_entries > 0, "entries compressed with a dictionary");
+
+   disk_cache_destroy(cache);
+
+   /* A new cache loads the dictionary stored by the first one. */
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blobs); i++) {
+      result = disk_cache_get(cache, keys[i], &size);
+      expect_equal_str(blobs[i], result, "disk_cache_get with a dictionary");
+      free(result);
+   }
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_GLSL_CACHE_DICT");
+#endif
+}
+
+static void
+test_lru_journal(void)
+{
+   struct disk_cache *cache;
+   uint8_t *blobs[8];
+   uint8_t keys[8][20];
+   const size_t blob_size = 6 * 1024;
+   uint32_t seed = 1;
+   char *result;
+   size_t size;
+
+   /* Not compressible, so that each entry takes about 8K on disk. */
+   for (unsigned i = 0; i < ARRAY_SIZE(blobs); i++) {
+      blobs[i] = malloc(blob_size);
+      for (unsigned j = 0; j < blob_size; j++) {
+         seed = seed * 1103515245 + 12345;
+         blobs[i][j] = seed >> 16;
+      }
+      memset(keys[i], 0, sizeof(keys[i]));
+      keys[i][0] = 0x40 + i;
+   }
+
+   /* Start from an empty cache, so that only these entries are evicted. */
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/lru-journal", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "60K,30K", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blobs) - 1; i++) {
+      disk_cache_put(cache, keys[i], blobs[i], blob_size, NULL);
+      disk_cache_wait_for_idle(cache);
+   }
+
+   /* Reading the first entry makes it the most recently used one. */
+   result = disk_cache_get(cache, keys[0], &size);
+   expect_non_null(result, "disk_cache_get before eviction");
+   free(result);
+
+   /* Going over the high watermark evicts down to the low one. */
+   disk_cache_put(cache, keys[7], blobs[7], blob_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_true(does_cache_contain(cache, keys[0]),
+               "recently read entry survives eviction");
+   expect_true(!does_cache_contain(cache, keys[1]),
+               "least recently used entry is evicted");
+   expect_true(!does_cache_contain(cache, keys[2]),
+               "eviction frees space down to the low watermark");
+   expect_true(does_cache_contain(cache, keys[7]),
+               "new entry is stored after eviction");
+
+   disk_cache_destroy(cache);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blobs); i++)
+      free(blobs[i]);
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/mesa-glsl-cache-dir", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+}
+
+static void
+test_journal_reads_only(void)
+{
+   struct disk_cache *cache;
+   uint8_t keys[4][20];
+   char data[] = "some test data";
+   const unsigned num_gets = 20000;
+   char *journal_path;
+   struct stat sb;
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/journal-reads", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      memset(keys[i], 0, sizeof(keys[i]));
+      keys[i][0] = 0x60 + i;
+      disk_cache_put(cache, keys[i], data, sizeof(data), NULL);
+   }
+   disk_cache_wait_for_idle(cache);
+
+   /* Every hit appends an access record to the journal, which has to be
+    * compacted even though nothing is stored any more.
+    */
+   for (unsigned i = 0; i < num_gets; i++) {
+      expect_true(does_cache_contain(cache, keys[i % ARRAY_SIZE(keys)]),
+                  "disk_cache_get of a stored entry");
+   }
+
+   disk_cache_destroy(cache);
+
+   journal_path = NULL;
+   if (asprintf(&journal_path, "%s/mesa_shader_cache/journal",
+                CACHE_TEST_TMP "/journal-reads") == -1)
+      journal_path = NULL;
+   expect_non_null(journal_path, "asprintf of the journal path");
+
+   if (journal_path) {
+      expect_equal(stat(journal_path, &sb), 0, "stat of the journal");
+      /* The records are 48 bytes, allow for half of the accesses. */
+      expect_true(sb.st_size < (num_gets / 2) * 48,
+                  "journal stays short without puts");
+      free(journal_path);
+   }
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/mesa-glsl-cache-dir", 1);
+}
+
 static void
 test_put_key_and_get_key(void)
 {
@@ -482,10 +822,25 @@ main(void)
 #ifdef ENABLE_SHADER_CACHE
    int err;
 
+   /* Most tests check what ends up on disk, keep the in-memory cache out of
+    * the way.
+    */
+   setenv("MESA_GLSL_CACHE_MEM_SIZE", "0", 1);
+
    test_disk_cache_create();
 
    test_put_and_get();
 
+   test_put_and_get_packed();
+
+   test_mem_cache_and_batch();
+
+   test_compression();
+
+   test_lru_journal();
+
+   test_journal_reads_only();
+
    test_put_key_and_get_key();
 
    err = rmrf_local(CACHE_TEST_TMP);
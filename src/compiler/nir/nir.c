@@ -289,6 +289,7 @@ nir_function_impl_create_bare(nir_shader *shader)
    exec_list_make_empty(&impl->locals);
    impl->reg_alloc = 0;
    impl->ssa_alloc = 0;
+   impl->cf_dirty_index = 0;
    impl->valid_metadata = nir_metadata_none;
 
    /* create start & end blocks */
@@ -325,6 +326,10 @@ nir_block_create(nir_shader *shader)
 
    cf_init(&block->cf_node, nir_cf_node_block);
 
+   /* New blocks come after any unchanged block until they're indexed, see
+    * nir_function_impl::cf_dirty_index.
+    */
+   block->index = UINT_MAX;
    block->successors[0] = block->successors[1] = NULL;
    block->predecessors = _mesa_pointer_set_create(block);
    block->imm_dom = NULL;
@@ -1739,6 +1744,10 @@ nir_index_blocks(nir_function_impl *impl)
    if (impl->valid_metadata & nir_metadata_block_index)
       return;
 
+   /* The indices are still valid if the control flow didn't change. */
+   if (impl->cf_dirty_index == UINT_MAX)
+      return;
+
    nir_foreach_block(block, impl) {
       block->index = index++;
    }
@@ -2624,6 +2624,8 @@ typedef enum {
     * every block index is in the range [0, nir_function_impl::num_blocks].
     *
     * A pass can preserve this metadata type if it doesn't touch the CFG.
+    * Otherwise, only the blocks after the first change are renumbered, see
+    * nir_function_impl::cf_dirty_index.
     */
    nir_metadata_block_index = 0x1,
 
@@ -2638,6 +2640,9 @@ typedef enum {
     *   - nir_block::dom_post_index
     *
     * A pass can preserve this metadata type if it doesn't touch the CFG.
+    * Otherwise, the control flow modification functions keep track of the
+    * first changed block, and the dominance of the blocks before it isn't
+    * recomputed.
     */
    nir_metadata_dominance = 0x2,
 
@@ -2699,6 +2704,14 @@ typedef struct {
    /* total number of basic blocks, only valid when block_index_dirty = false */
    unsigned num_blocks;
 
+   /**
+    * Blocks with an index lower than this one haven't been touched by
+    * control flow changes since the block indices and dominance were last
+    * computed, so they only have to be recomputed from this block on.
+    * UINT_MAX if the control flow hasn't changed at all.
+    */
+   unsigned cf_dirty_index;
+
    nir_metadata valid_metadata;
 } nir_function_impl;
 
@@ -3764,6 +3777,109 @@ static inline bool should_print_nir(void) { return false; }
 
 #define NIR_SKIP(name) should_skip_nir(#name)
 
+/** The parts of a shader a pass looks at, for nir_pass_manager. */
+typedef enum {
+   nir_pass_dep_alu           = (1 << nir_instr_type_alu),
+   nir_pass_dep_deref         = (1 << nir_instr_type_deref),
+   nir_pass_dep_call          = (1 << nir_instr_type_call),
+   nir_pass_dep_tex           = (1 << nir_instr_type_tex),
+   nir_pass_dep_intrinsic     = (1 << nir_instr_type_intrinsic),
+   nir_pass_dep_load_const    = (1 << nir_instr_type_load_const),
+   nir_pass_dep_jump          = (1 << nir_instr_type_jump),
+   nir_pass_dep_ssa_undef     = (1 << nir_instr_type_ssa_undef),
+   nir_pass_dep_phi           = (1 << nir_instr_type_phi),
+   nir_pass_dep_parallel_copy = (1 << nir_instr_type_parallel_copy),
+
+   /** Blocks, ifs and loops */
+   nir_pass_dep_cf            = (1 << 10),
+
+   /** Variable declarations */
+   nir_pass_dep_vars          = (1 << 11),
+
+   nir_pass_dep_all           = (1 << 12) - 1,
+
+   /** What the passes working on variables through derefs look at */
+   nir_pass_dep_var_access    = nir_pass_dep_deref |
+                                nir_pass_dep_call |
+                                nir_pass_dep_intrinsic |
+                                nir_pass_dep_jump |
+                                nir_pass_dep_cf |
+                                nir_pass_dep_vars,
+} nir_pass_deps;
+
+#define NIR_PASS_DEP_COUNT 12
+
+/** A pass run through a nir_pass_manager, one per call site */
+typedef struct nir_pass_info {
+   const char *name;
+   unsigned deps; /**< nir_pass_deps */
+
+   /* Statistics, only gathered when NIR_PASS_STATS is set. */
+   struct nir_pass_info *next;
+   bool registered;
+   uint64_t runs;
+   uint64_t skips;
+   uint64_t progress;
+   uint64_t time_ns;
+} nir_pass_info;
+
+#define NIR_PASS_MANAGER_MAX_PASSES 64
+
+/**
+ * Skips the passes of an optimization loop which can't make progress
+ *
+ * A pass which didn't make progress the last time it ran is only run again
+ * once something it depends on changed.  To find out what a pass changed,
+ * the manager keeps a hash of each kind of instruction, of the control flow
+ * and of the variables, and updates it after every pass making progress.
+ *
+ * All the passes changing the shader inside of the loop must go through
+ * NIR_LOOP_PASS or NIR_LOOP_PASS_V, otherwise their changes go unnoticed.
+ */
+typedef struct nir_pass_manager {
+   nir_shader *shader;
+
+   /** Incremented every time a pass changes the shader */
+   unsigned generation;
+
+   /** The generation each dependency last changed in */
+   unsigned changed[NIR_PASS_DEP_COUNT];
+   uint32_t hash[NIR_PASS_DEP_COUNT];
+
+   unsigned num_passes;
+   struct {
+      const nir_pass_info *info;
+      unsigned generation;
+      bool progress;
+   } passes[NIR_PASS_MANAGER_MAX_PASSES];
+} nir_pass_manager;
+
+void nir_pass_manager_init(nir_pass_manager *pm, nir_shader *shader);
+bool nir_pass_manager_should_run(nir_pass_manager *pm, nir_pass_info *info);
+int64_t nir_pass_manager_begin(void);
+void nir_pass_manager_end(nir_pass_manager *pm, nir_pass_info *info,
+                          int64_t start, bool progress);
+
+#define NIR_LOOP_PASS(progress, pm, deps, pass, ...) do {            \
+   static nir_pass_info _pass_info = { #pass, deps };                \
+   if (nir_pass_manager_should_run(pm, &_pass_info)) {               \
+      int64_t _pass_start = nir_pass_manager_begin();               \
+      bool _pass_progress = false;                                   \
+      NIR_PASS(_pass_progress, (pm)->shader, pass, ##__VA_ARGS__);   \
+      nir_pass_manager_end(pm, &_pass_info, _pass_start,             \
+                           _pass_progress);                          \
+      if (_pass_progress)                                            \
+         progress = true;                                            \
+   }                                                                 \
+} while (0)
+
+/* For passes whose progress doesn't keep the loop going. */
+#define NIR_LOOP_PASS_V(pm, deps, pass, ...) do {                    \
+   bool _pass_progress_v = false;                                    \
+   NIR_LOOP_PASS(_pass_progress_v, pm, deps, pass, ##__VA_ARGS__);   \
+   (void)_pass_progress_v;                                           \
+} while (0)
+
 /** An instruction filtering callback
  *
  * Returns true if the instruction should be processed and false otherwise.
@@ -3848,6 +3964,12 @@ void nir_inline_function_impl(struct nir_builder *b,
                               nir_ssa_def **params);
 bool nir_inline_functions(nir_shader *shader);
 
+unsigned nir_find_inlinable_uniforms(nir_shader *shader, uint32_t *dw_offsets,
+                                     unsigned max_offsets);
+bool nir_inline_uniforms(nir_shader *shader, unsigned num_uniforms,
+                         const uint32_t *uniform_values,
+                         const uint32_t *uniform_dw_offsets);
+
 bool nir_propagate_invariant(nir_shader *shader);
 
 void nir_lower_var_copy_instr(nir_intrinsic_instr *copy, nir_shader *shader);
@@ -4490,6 +4612,8 @@ bool nir_opt_large_constants(nir_shader *shader,
                              glsl_type_size_align_func size_align,
                              unsigned threshold);
 
+bool nir_opt_licm(nir_shader *shader, unsigned max_live_components);
+
 bool nir_opt_loop_unroll(nir_shader *shader, nir_variable_mode indirect_mask);
 
 typedef enum {
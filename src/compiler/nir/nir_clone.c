@@ -62,7 +62,9 @@ init_clone_state(clone_state *state, struct hash_table *remap_table,
    if (remap_table) {
       state->remap_table = remap_table;
    } else {
-      state->remap_table = _mesa_pointer_hash_table_create(NULL);
+      state->remap_table =
+         _mesa_hash_table_create_grouped(NULL, _mesa_hash_pointer,
+                                         _mesa_key_pointer_equal);
    }
 
    list_inithead(&state->phi_srcs);
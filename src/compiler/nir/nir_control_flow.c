@@ -45,6 +45,16 @@
  */
 /*@{*/
 
+/* Records that the control flow changed at the given block, so that the
+ * block indices and dominance only have to be recomputed from there on.
+ */
+static void
+block_mark_cf_dirty(nir_block *block)
+{
+   nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
+   impl->cf_dirty_index = MIN2(impl->cf_dirty_index, block->index);
+}
+
 static inline void
 block_add_pred(nir_block *block, nir_block *pred)
 {
@@ -470,6 +480,7 @@ nir_handle_add_jump(nir_block *block)
 
    nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
    nir_metadata_preserve(impl, nir_metadata_none);
+   block_mark_cf_dirty(block);
 
    if (jump_instr->type == nir_jump_break ||
        jump_instr->type == nir_jump_continue) {
@@ -513,6 +524,7 @@ nir_handle_remove_jump(nir_block *block, nir_jump_type type)
 
    nir_function_impl *impl = nir_cf_node_get_function(&block->cf_node);
    nir_metadata_preserve(impl, nir_metadata_none);
+   block_mark_cf_dirty(block);
 }
 
 static void
@@ -573,6 +585,7 @@ nir_cf_node_insert(nir_cursor cursor, nir_cf_node *node)
 {
    nir_block *before, *after;
 
+   block_mark_cf_dirty(nir_cursor_current_block(cursor));
    split_block_cursor(cursor, &before, &after);
 
    if (node->type == nir_cf_node_block) {
@@ -673,6 +686,7 @@ nir_cf_extract(nir_cf_list *extracted, nir_cursor begin, nir_cursor end)
     * would be pointing to the same place that begin used to point to, which
     * is obviously not what we want.
     */
+   block_mark_cf_dirty(nir_cursor_current_block(begin));
    split_block_cursor(begin, &block_before, &block_begin);
    split_block_cursor(end, &block_end, &block_after);
 
@@ -708,6 +722,7 @@ nir_cf_reinsert(nir_cf_list *cf_list, nir_cursor cursor)
    if (exec_list_is_empty(&cf_list->list))
       return;
 
+   block_mark_cf_dirty(nir_cursor_current_block(cursor));
    split_block_cursor(cursor, &before, &after);
 
    foreach_list_typed_safe(nir_cf_node, node, node, &cf_list->list) {
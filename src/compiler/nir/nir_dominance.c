@@ -161,6 +161,145 @@ calc_dfs_indicies(nir_block *block, unsigned *index)
    block->dom_post_index = (*index)++;
 }
 
+/*
+ * Blocks are indexed in program order, so every predecessor of a block has
+ * a lower index, except for the back-edges to loop headers.  Loop headers
+ * are always immediately dominated by the block before the loop, so the
+ * back-edges can be ignored, and the immediate dominator of a block only
+ * depends on the blocks before it.  This means that after control flow
+ * changes, the immediate dominators of the untouched blocks before the first
+ * changed one are still valid, and those of the following blocks can be
+ * computed in a single walk.
+ *
+ * The dominance frontiers and children of the untouched blocks may still
+ * refer to changed blocks, so those entries are recomputed as well.  Loop
+ * headers in the untouched part may have gained or lost back-edges, so their
+ * frontier entries are recomputed if their loop contains changed blocks.
+ */
+static void
+calc_dominance_forward(nir_block *block)
+{
+   nir_block *new_idom = NULL;
+   set_foreach(block->predecessors, entry) {
+      nir_block *pred = (nir_block *) entry->key;
+
+      if (pred->index < block->index && pred->imm_dom) {
+         if (new_idom)
+            new_idom = intersect(pred, new_idom);
+         else
+            new_idom = pred;
+      }
+   }
+
+   block->imm_dom = new_idom;
+}
+
+static void
+update_dom_children(nir_function_impl *impl, unsigned first)
+{
+   void *mem_ctx = ralloc_parent(impl);
+   unsigned *num_new_children =
+      rzalloc_array(NULL, unsigned, impl->num_blocks);
+
+   nir_foreach_block(block, impl) {
+      if (block->index < first) {
+         /* The children from before the first changed block keep their
+          * immediate dominator.
+          */
+         unsigned num_children = 0;
+         for (unsigned i = 0; i < block->num_dom_children; i++) {
+            if (block->dom_children[i]->index < first)
+               block->dom_children[num_children++] = block->dom_children[i];
+         }
+         block->num_dom_children = num_children;
+      } else if (block->imm_dom) {
+         num_new_children[block->imm_dom->index]++;
+      }
+   }
+
+   nir_foreach_block(block, impl) {
+      unsigned num = num_new_children[block->index];
+      if (block->index >= first) {
+         block->dom_children = ralloc_array(mem_ctx, nir_block *, num);
+      } else if (num > 0) {
+         block->dom_children = reralloc(mem_ctx, block->dom_children,
+                                        nir_block *,
+                                        block->num_dom_children + num);
+      }
+   }
+
+   nir_foreach_block(block, impl) {
+      if (block->index >= first && block->imm_dom) {
+         block->imm_dom->dom_children[block->imm_dom->num_dom_children++]
+            = block;
+      }
+   }
+
+   ralloc_free(num_new_children);
+}
+
+static void
+update_dominance(nir_function_impl *impl, unsigned first)
+{
+   nir_block *first_block = NULL;
+
+   nir_foreach_block(block, impl) {
+      if (block->index < first) {
+         set_foreach(block->dom_frontier, entry) {
+            if (((nir_block *) entry->key)->index >= first)
+               _mesa_set_remove(block->dom_frontier, entry);
+         }
+      } else {
+         if (!first_block)
+            first_block = block;
+         init_block(block, impl);
+      }
+   }
+
+   for (nir_cf_node *node = first_block->cf_node.parent;
+        node->type != nir_cf_node_function; node = node->parent) {
+      if (node->type != nir_cf_node_loop)
+         continue;
+
+      nir_block *header = nir_loop_first_block(nir_cf_node_as_loop(node));
+      for (nir_block *block = header; block->index < first;
+           block = nir_block_cf_tree_next(block)) {
+         struct set_entry *entry =
+            _mesa_set_search(block->dom_frontier, header);
+         if (entry)
+            _mesa_set_remove(block->dom_frontier, entry);
+      }
+   }
+
+   nir_block *start_block = nir_start_block(impl);
+   start_block->imm_dom = start_block;
+
+   for (nir_block *block = first_block; block;
+        block = nir_block_cf_tree_next(block))
+      calc_dominance_forward(block);
+
+   for (nir_block *block = first_block; block;
+        block = nir_block_cf_tree_next(block))
+      calc_dom_frontier(block);
+
+   for (nir_cf_node *node = first_block->cf_node.parent;
+        node->type != nir_cf_node_function; node = node->parent) {
+      if (node->type != nir_cf_node_loop)
+         continue;
+
+      nir_block *header = nir_loop_first_block(nir_cf_node_as_loop(node));
+      if (header->index < first)
+         calc_dom_frontier(header);
+   }
+
+   start_block->imm_dom = NULL;
+
+   update_dom_children(impl, first);
+
+   unsigned dfs_index = 0;
+   calc_dfs_indicies(start_block, &dfs_index);
+}
+
 void
 nir_calc_dominance_impl(nir_function_impl *impl)
 {
@@ -169,6 +308,15 @@ nir_calc_dominance_impl(nir_function_impl *impl)
 
    nir_metadata_require(impl, nir_metadata_block_index);
 
+   /* Only recompute what changed since the last time, if anything. */
+   if (impl->cf_dirty_index == UINT_MAX)
+      return;
+
+   if (impl->cf_dirty_index > 0 && impl->cf_dirty_index < impl->num_blocks) {
+      update_dominance(impl, impl->cf_dirty_index);
+      impl->cf_dirty_index = UINT_MAX;
+      return;
+   }
 
    nir_foreach_block(block, impl) {
       init_block(block, impl);
@@ -194,6 +342,8 @@ nir_calc_dominance_impl(nir_function_impl *impl)
 
    unsigned dfs_index = 0;
    calc_dfs_indicies(start_block, &dfs_index);
+
+   impl->cf_dirty_index = UINT_MAX;
 }
 
 void
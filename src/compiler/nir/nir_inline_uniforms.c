@@ -0,0 +1,308 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/set.h"
+
+/*
+ * Uniform inlining.
+ *
+ * Uber-shaders often select features with uniforms which rarely change,
+ * like material flags or light counts.  nir_find_inlinable_uniforms()
+ * finds the uniforms which control if conditions and loop bounds, so that
+ * the driver can compile a variant of the shader for the current values of
+ * those uniforms.  nir_inline_uniforms() replaces the loads of those
+ * uniforms with constants, after which constant folding, nir_opt_dead_cf
+ * and loop unrolling remove the control flow depending on them.
+ *
+ * Uniforms are expected to be lowered to constant-offset loads from UBO 0
+ * (see nir_lower_uniforms_to_ubo), and are identified by their dword
+ * offset into that buffer.  Only 32-bit loads are handled.
+ */
+
+static bool
+get_uniform_dw_offset(nir_intrinsic_instr *intr, unsigned *dw_offset)
+{
+   if (intr->intrinsic != nir_intrinsic_load_ubo ||
+       intr->dest.ssa.bit_size != 32 ||
+       !nir_src_is_const(intr->src[0]) ||
+       nir_src_as_uint(intr->src[0]) != 0 ||
+       !nir_src_is_const(intr->src[1]))
+      return false;
+
+   uint64_t offset = nir_src_as_uint(intr->src[1]);
+   if (offset % 4)
+      return false;
+
+   *dw_offset = offset / 4;
+   return true;
+}
+
+static bool
+add_dw_offset(uint32_t *dw_offsets, unsigned *num_offsets,
+              unsigned max_offsets, unsigned dw_offset)
+{
+   for (unsigned i = 0; i < *num_offsets; i++) {
+      if (dw_offsets[i] == dw_offset)
+         return true;
+   }
+
+   if (*num_offsets == max_offsets)
+      return false;
+
+   dw_offsets[(*num_offsets)++] = dw_offset;
+   return true;
+}
+
+/* Returns true if src is computed only from constants and uniforms, adding
+ * the uniforms to dw_offsets.
+ *
+ * visited holds the defs already walked for the current source.  The walk
+ * stops at the first def which doesn't qualify, so any def seen before has
+ * already had its uniforms added, and shared subexpressions are only
+ * walked once.
+ */
+static bool
+src_only_uses_uniforms(nir_src *src, struct set *visited,
+                       uint32_t *dw_offsets, unsigned *num_offsets,
+                       unsigned max_offsets)
+{
+   if (!src->is_ssa)
+      return false;
+
+   bool found = false;
+   _mesa_set_search_and_add(visited, src->ssa, &found);
+   if (found)
+      return true;
+
+   nir_instr *instr = src->ssa->parent_instr;
+
+   switch (instr->type) {
+   case nir_instr_type_load_const:
+      return true;
+
+   case nir_instr_type_alu: {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+         if (!src_only_uses_uniforms(&alu->src[i].src, visited, dw_offsets,
+                                     num_offsets, max_offsets))
+            return false;
+      }
+      return true;
+   }
+
+   case nir_instr_type_intrinsic: {
+      nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+      unsigned dw_offset;
+
+      if (!get_uniform_dw_offset(intr, &dw_offset))
+         return false;
+
+      for (unsigned i = 0; i < intr->dest.ssa.num_components; i++) {
+         if (!add_dw_offset(dw_offsets, num_offsets, max_offsets,
+                            dw_offset + i))
+            return false;
+      }
+      return true;
+   }
+
+   default:
+      return false;
+   }
+}
+
+/* Adds the uniforms src depends on to the list, only if src depends on
+ * nothing else and all of them fit.
+ */
+static void
+try_add_src(nir_src *src, struct set *visited, uint32_t *dw_offsets,
+            unsigned *num_offsets, unsigned max_offsets)
+{
+   unsigned num = *num_offsets;
+
+   _mesa_set_clear(visited, NULL);
+   if (!src_only_uses_uniforms(src, visited, dw_offsets, &num, max_offsets))
+      return;
+
+   *num_offsets = num;
+}
+
+static bool
+block_ends_in_break(nir_block *block)
+{
+   nir_instr *last = nir_block_last_instr(block);
+
+   return last && last->type == nir_instr_type_jump &&
+          nir_instr_as_jump(last)->type == nir_jump_break;
+}
+
+static void
+find_in_cf_list(struct exec_list *cf_list, bool in_loop_body,
+                struct set *visited, uint32_t *dw_offsets,
+                unsigned *num_offsets, unsigned max_offsets)
+{
+   foreach_list_typed(nir_cf_node, node, node, cf_list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         break;
+
+      case nir_cf_node_if: {
+         nir_if *nif = nir_cf_node_as_if(node);
+
+         try_add_src(&nif->condition, visited, dw_offsets, num_offsets,
+                     max_offsets);
+
+         /* For a loop terminator like "if (i >= n) break;", the uniform
+          * operand is enough to give the loop a constant trip count.
+          */
+         if (in_loop_body &&
+             (block_ends_in_break(nir_if_last_then_block(nif)) ||
+              block_ends_in_break(nir_if_last_else_block(nif))) &&
+             nif->condition.is_ssa &&
+             nif->condition.ssa->parent_instr->type == nir_instr_type_alu) {
+            nir_alu_instr *cond =
+               nir_instr_as_alu(nif->condition.ssa->parent_instr);
+
+            if (nir_alu_instr_is_comparison(cond) &&
+                nir_op_infos[cond->op].num_inputs == 2) {
+               for (unsigned i = 0; i < 2; i++) {
+                  try_add_src(&cond->src[i].src, visited, dw_offsets,
+                              num_offsets, max_offsets);
+               }
+            }
+         }
+
+         find_in_cf_list(&nif->then_list, false, visited, dw_offsets,
+                         num_offsets, max_offsets);
+         find_in_cf_list(&nif->else_list, false, visited, dw_offsets,
+                         num_offsets, max_offsets);
+         break;
+      }
+
+      case nir_cf_node_loop: {
+         nir_loop *loop = nir_cf_node_as_loop(node);
+         find_in_cf_list(&loop->body, true, visited, dw_offsets,
+                         num_offsets, max_offsets);
+         break;
+      }
+
+      default:
+         unreachable("Invalid CF node type");
+      }
+   }
+}
+
+/**
+ * Finds up to max_offsets uniform dwords controlling if conditions and loop
+ * bounds in the entrypoint, and returns their number.
+ */
+unsigned
+nir_find_inlinable_uniforms(nir_shader *shader, uint32_t *dw_offsets,
+                            unsigned max_offsets)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   unsigned num_offsets = 0;
+
+   if (impl) {
+      struct set *visited = _mesa_pointer_set_create(NULL);
+
+      find_in_cf_list(&impl->body, false, visited, dw_offsets, &num_offsets,
+                      max_offsets);
+
+      _mesa_set_destroy(visited, NULL);
+   }
+
+   return num_offsets;
+}
+
+/**
+ * Replaces the loads of the given uniform dwords with their values.  A load
+ * is only replaced if all its components are in the list.
+ */
+bool
+nir_inline_uniforms(nir_shader *shader, unsigned num_uniforms,
+                    const uint32_t *uniform_values,
+                    const uint32_t *uniform_dw_offsets)
+{
+   bool progress = false;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_builder b;
+      nir_builder_init(&b, function->impl);
+      bool impl_progress = false;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr_safe(instr, block) {
+            if (instr->type != nir_instr_type_intrinsic)
+               continue;
+
+            nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+            unsigned dw_offset;
+
+            if (!get_uniform_dw_offset(intr, &dw_offset))
+               continue;
+
+            nir_const_value values[NIR_MAX_VEC_COMPONENTS];
+            unsigned num_components = intr->dest.ssa.num_components;
+            unsigned c;
+
+            for (c = 0; c < num_components; c++) {
+               unsigned i;
+               for (i = 0; i < num_uniforms; i++) {
+                  if (uniform_dw_offsets[i] == dw_offset + c)
+                     break;
+               }
+               if (i == num_uniforms)
+                  break;
+
+               values[c] = nir_const_value_for_uint(uniform_values[i], 32);
+            }
+
+            if (c < num_components)
+               continue;
+
+            b.cursor = nir_before_instr(instr);
+            nir_ssa_def *imm = nir_build_imm(&b, num_components, 32, values);
+            nir_ssa_def_rewrite_uses(&intr->dest.ssa, nir_src_for_ssa(imm));
+            nir_instr_remove(instr);
+            impl_progress = true;
+         }
+      }
+
+      if (impl_progress) {
+         nir_metadata_preserve(function->impl, nir_metadata_block_index |
+                                               nir_metadata_dominance);
+         progress = true;
+      } else {
+#ifndef NDEBUG
+         function->impl->valid_metadata &= ~nir_metadata_not_properly_reset;
+#endif
+      }
+   }
+
+   return progress;
+}
@@ -786,7 +786,10 @@ cmp_func(const void *data1, const void *data2)
 struct set *
 nir_instr_set_create(void *mem_ctx)
 {
-   return _mesa_set_create(mem_ctx, hash_instr, cmp_func);
+   /* CSE does a search for every instruction of the shader, most of which
+    * fail, so use the grouped mode where failed searches are cheap.
+    */
+   return _mesa_set_create_grouped(mem_ctx, hash_instr, cmp_func);
 }
 
 void
@@ -714,7 +714,9 @@ nir_lower_vars_to_ssa_impl(nir_function_impl *impl)
    state.dead_ctx = ralloc_context(state.shader);
    state.impl = impl;
 
-   state.deref_var_nodes = _mesa_pointer_hash_table_create(state.dead_ctx);
+   state.deref_var_nodes =
+      _mesa_hash_table_create_grouped(state.dead_ctx, _mesa_hash_pointer,
+                                      _mesa_key_pointer_equal);
    exec_list_make_empty(&state.direct_deref_nodes);
 
    /* Build the initial deref structures and direct_deref_nodes table */
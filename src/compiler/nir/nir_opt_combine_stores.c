@@ -408,7 +408,7 @@ combine_stores_impl(struct combine_stores_state *state, nir_function_impl *impl)
 bool
 nir_opt_combine_stores(nir_shader *shader, nir_variable_mode modes)
 {
-   void *mem_ctx = ralloc_context(NULL);
+   void *mem_ctx = ralloc_arena_context(NULL);
    struct combine_stores_state state = {
       .modes   = modes,
       .lin_ctx = linear_zalloc_parent(mem_ctx, 0),
@@ -0,0 +1,406 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "util/set.h"
+
+/*
+ * Implements loop-invariant code motion.
+ *
+ * Instructions inside a loop whose sources are all defined before the loop
+ * are moved to the block preceding it (the preheader).  Loops are handled
+ * innermost first, so that an instruction can move out of a whole loop
+ * nest one level at a time.
+ *
+ * Every hoisted value stays live across the whole loop, so hoisting can
+ * increase register pressure and cause spilling in the loop, which is
+ * worse than recomputing the value.  To keep that in check, the pass keeps
+ * an estimate of the number of 32-bit components live across the loop:
+ * the values defined before the loop and used inside it, plus everything
+ * hoisted so far.  An instruction is only hoisted if it keeps the estimate
+ * under the given limit, or if it doesn't increase it because the sources
+ * it consumes become dead inside the loop.
+ *
+ * ALU instructions are hoisted from anywhere in the loop, as executing
+ * them speculatively is harmless.  Texture instructions and reorderable
+ * intrinsics may access memory, and are only hoisted from blocks which are
+ * executed on every iteration.
+ */
+
+struct licm_state {
+   nir_loop *loop;
+   nir_block *preheader;
+
+   /* Range of block indices of the loop, including nested loops. */
+   unsigned first_index;
+   unsigned last_index;
+
+   /* Blocks with an index below this one which are directly in the loop
+    * body are executed on every iteration.
+    */
+   unsigned guaranteed_end;
+
+   /* Estimated number of components live across the loop. */
+   unsigned pressure;
+   unsigned max_pressure;
+
+   nir_instr *instr;
+   unsigned freed;
+   struct set *freed_defs;
+};
+
+static bool
+def_is_remat(nir_ssa_def *def)
+{
+   return def->parent_instr->type == nir_instr_type_load_const ||
+          def->parent_instr->type == nir_instr_type_ssa_undef;
+}
+
+static bool
+block_in_loop(struct licm_state *state, nir_block *block)
+{
+   return block->index >= state->first_index &&
+          block->index <= state->last_index;
+}
+
+static unsigned
+def_cost(nir_ssa_def *def)
+{
+   return def->num_components * DIV_ROUND_UP(def->bit_size, 32);
+}
+
+static bool
+node_has_jump(nir_cf_node *node)
+{
+   nir_foreach_block_in_cf_node(block, node) {
+      if (nir_block_ends_in_jump(block))
+         return true;
+   }
+   return false;
+}
+
+static void
+compute_guaranteed_end(struct licm_state *state)
+{
+   state->guaranteed_end = state->last_index + 1;
+
+   foreach_list_typed(nir_cf_node, node, node, &state->loop->body) {
+      if (node->type == nir_cf_node_block) {
+         nir_block *block = nir_cf_node_as_block(node);
+         if (nir_block_ends_in_jump(block)) {
+            state->guaranteed_end = block->index + 1;
+            return;
+         }
+      } else if (node_has_jump(node)) {
+         nir_block *next = nir_cf_node_as_block(nir_cf_node_next(node));
+         state->guaranteed_end = next->index;
+         return;
+      }
+   }
+}
+
+static bool
+block_is_guaranteed(struct licm_state *state, nir_block *block)
+{
+   return block->cf_node.parent == &state->loop->cf_node &&
+          block->index < state->guaranteed_end;
+}
+
+static bool
+add_live_in(nir_src *src, void *void_state)
+{
+   struct licm_state *state = void_state;
+
+   if (src->is_ssa && !def_is_remat(src->ssa) &&
+       !block_in_loop(state, src->ssa->parent_instr->block))
+      _mesa_set_add(state->freed_defs, src->ssa);
+
+   return true;
+}
+
+/* Counts the non-rematerializable values defined before the loop and used
+ * inside it.  These are live across the whole loop.
+ */
+static void
+compute_base_pressure(struct licm_state *state)
+{
+   nir_foreach_block_in_cf_node(block, &state->loop->cf_node) {
+      nir_foreach_instr(instr, block)
+         nir_foreach_src(instr, add_live_in, state);
+
+      nir_if *nif = nir_block_get_following_if(block);
+      if (nif)
+         add_live_in(&nif->condition, state);
+   }
+
+   state->pressure = 0;
+   set_foreach(state->freed_defs, entry)
+      state->pressure += def_cost((nir_ssa_def *)entry->key);
+
+   _mesa_set_clear(state->freed_defs, NULL);
+}
+
+static bool
+src_is_invariant(nir_src *src, void *void_state)
+{
+   struct licm_state *state = void_state;
+
+   if (!src->is_ssa)
+      return false;
+
+   return def_is_remat(src->ssa) ||
+          !block_in_loop(state, src->ssa->parent_instr->block);
+}
+
+static bool
+dest_is_ssa(nir_dest *dest, void *state)
+{
+   return dest->is_ssa;
+}
+
+static bool
+def_dies_at_instr(nir_ssa_def *def, struct licm_state *state)
+{
+   nir_foreach_use(use, def) {
+      if (use->parent_instr != state->instr &&
+          use->parent_instr->block->index >= state->first_index)
+         return false;
+   }
+
+   nir_foreach_if_use(use, def) {
+      nir_cf_node *prev = nir_cf_node_prev(&use->parent_if->cf_node);
+      if (nir_cf_node_as_block(prev)->index >= state->first_index)
+         return false;
+   }
+
+   return true;
+}
+
+/* Sums up the cost of the sources which are no longer live across the loop
+ * once state->instr is hoisted.
+ */
+static bool
+add_freed_src(nir_src *src, void *void_state)
+{
+   struct licm_state *state = void_state;
+   nir_ssa_def *def = src->ssa;
+
+   if (def_is_remat(def) || _mesa_set_search(state->freed_defs, def))
+      return true;
+
+   if (def_dies_at_instr(def, state)) {
+      _mesa_set_add(state->freed_defs, def);
+      state->freed += def_cost(def);
+   }
+
+   return true;
+}
+
+static bool
+hoist_remat_src(nir_src *src, void *void_state)
+{
+   struct licm_state *state = void_state;
+   nir_instr *parent = src->ssa->parent_instr;
+
+   if (def_is_remat(src->ssa) && block_in_loop(state, parent->block)) {
+      nir_instr_remove(parent);
+      nir_instr_insert(nir_after_block_before_jump(state->preheader), parent);
+   }
+
+   return true;
+}
+
+static bool
+instr_can_hoist(nir_instr *instr, struct licm_state *state)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      break;
+
+   case nir_instr_type_tex:
+      if (!block_is_guaranteed(state, instr->block))
+         return false;
+      break;
+
+   case nir_instr_type_intrinsic:
+      if (!nir_intrinsic_can_reorder(nir_instr_as_intrinsic(instr)) ||
+          !nir_intrinsic_infos[nir_instr_as_intrinsic(instr)->intrinsic].has_dest ||
+          !block_is_guaranteed(state, instr->block))
+         return false;
+      break;
+
+   default:
+      /* Constants and undefs are only moved along with their users, derefs
+       * have to stay next to their users, and phis and jumps are pinned.
+       */
+      return false;
+   }
+
+   return nir_foreach_dest(instr, dest_is_ssa, NULL) &&
+          nir_foreach_src(instr, src_is_invariant, state);
+}
+
+static nir_ssa_def *
+instr_def(nir_instr *instr)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      return &nir_instr_as_alu(instr)->dest.dest.ssa;
+   case nir_instr_type_tex:
+      return &nir_instr_as_tex(instr)->dest.ssa;
+   case nir_instr_type_intrinsic:
+      return &nir_instr_as_intrinsic(instr)->dest.ssa;
+   default:
+      unreachable("Invalid instruction type for LICM");
+   }
+}
+
+static bool
+try_hoist_instr(nir_instr *instr, struct licm_state *state)
+{
+   if (!instr_can_hoist(instr, state))
+      return false;
+
+   nir_ssa_def *def = instr_def(instr);
+
+   /* Leave dead instructions to DCE. */
+   if (list_is_empty(&def->uses) && list_is_empty(&def->if_uses))
+      return false;
+
+   state->instr = instr;
+   state->freed = 0;
+   _mesa_set_clear(state->freed_defs, NULL);
+   nir_foreach_src(instr, add_freed_src, state);
+
+   unsigned cost = def_cost(def);
+   if (cost > state->freed &&
+       state->pressure + cost - state->freed > state->max_pressure)
+      return false;
+
+   state->pressure = state->pressure + cost - state->freed;
+
+   nir_foreach_src(instr, hoist_remat_src, state);
+   nir_instr_remove(instr);
+   nir_instr_insert(nir_after_block_before_jump(state->preheader), instr);
+
+   return true;
+}
+
+static bool
+opt_licm_loop(nir_loop *loop, struct licm_state *state)
+{
+   state->loop = loop;
+   state->preheader = nir_cf_node_as_block(nir_cf_node_prev(&loop->cf_node));
+   state->first_index = nir_loop_first_block(loop)->index;
+   state->last_index = nir_loop_last_block(loop)->index;
+
+   compute_guaranteed_end(state);
+   compute_base_pressure(state);
+
+   /* Blocks are visited in order so that hoisting an instruction can make
+    * its users invariant as well.
+    */
+   bool progress = false;
+   nir_foreach_block_in_cf_node(block, &loop->cf_node) {
+      nir_foreach_instr_safe(instr, block)
+         progress |= try_hoist_instr(instr, state);
+   }
+
+   return progress;
+}
+
+static bool
+opt_licm_cf_list(struct exec_list *cf_list, struct licm_state *state)
+{
+   bool progress = false;
+
+   foreach_list_typed(nir_cf_node, node, node, cf_list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         break;
+
+      case nir_cf_node_if: {
+         nir_if *nif = nir_cf_node_as_if(node);
+         progress |= opt_licm_cf_list(&nif->then_list, state);
+         progress |= opt_licm_cf_list(&nif->else_list, state);
+         break;
+      }
+
+      case nir_cf_node_loop: {
+         nir_loop *loop = nir_cf_node_as_loop(node);
+         progress |= opt_licm_cf_list(&loop->body, state);
+         progress |= opt_licm_loop(loop, state);
+         break;
+      }
+
+      default:
+         unreachable("Invalid CF node type");
+      }
+   }
+
+   return progress;
+}
+
+static bool
+opt_licm_impl(nir_function_impl *impl, unsigned max_live_components)
+{
+   nir_metadata_require(impl, nir_metadata_block_index);
+
+   struct licm_state state = {
+      .max_pressure = max_live_components,
+      .freed_defs = _mesa_pointer_set_create(NULL),
+   };
+
+   bool progress = opt_licm_cf_list(&impl->body, &state);
+
+   _mesa_set_destroy(state.freed_defs, NULL);
+
+   if (progress) {
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+   } else {
+#ifndef NDEBUG
+      impl->valid_metadata &= ~nir_metadata_not_properly_reset;
+#endif
+   }
+
+   return progress;
+}
+
+/**
+ * Moves loop-invariant instructions out of loops, as long as the estimated
+ * number of components live across each loop stays below
+ * max_live_components.
+ */
+bool
+nir_opt_licm(nir_shader *shader, unsigned max_live_components)
+{
+   bool progress = false;
+
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= opt_licm_impl(function->impl, max_live_components);
+   }
+
+   return progress;
+}
@@ -0,0 +1,512 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "util/debug.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Pass manager for the optimization loops
+ *
+ * The drivers run their optimization passes in a loop until none of them
+ * makes progress.  Most of the passes only make progress in the first few
+ * iterations though, and then keep running for nothing until the last pass
+ * making progress is done.
+ *
+ * The manager finds out which parts of the shader a pass changed by hashing
+ * them: one hash for each type of instruction, one for the control flow and
+ * one for the variables.  A pass which didn't make progress is then skipped
+ * until one of the parts it depends on changes.
+ *
+ * With NIR_PASS_STATS set, the time spent in each pass, the number of times
+ * it ran or was skipped and how often it made progress are printed to stderr
+ * at exit.  NIR_PASS_RUN_ALL disables the skipping, to check it doesn't
+ * change the results.
+ */
+
+#define NIR_PASS_DEP_CF_INDEX   10
+#define NIR_PASS_DEP_VARS_INDEX 11
+
+static bool
+nir_pass_stats_enabled(void)
+{
+   static int enabled = -1;
+   if (enabled < 0)
+      enabled = env_var_as_boolean("NIR_PASS_STATS", false);
+
+   return enabled;
+}
+
+static bool
+nir_pass_run_all(void)
+{
+   static int run_all = -1;
+   if (run_all < 0)
+      run_all = env_var_as_boolean("NIR_PASS_RUN_ALL", false);
+
+   return run_all;
+}
+
+/*
+ * Statistics
+ */
+
+static simple_mtx_t stats_mutex = _SIMPLE_MTX_INITIALIZER_NP;
+static nir_pass_info *stats_list;
+
+/* The time spent hashing the shaders, reported as a pass. */
+static nir_pass_info hash_info = { "(nir_pass_manager hashing)" };
+
+struct pass_stats {
+   const char *name;
+   uint64_t runs;
+   uint64_t skips;
+   uint64_t progress;
+   uint64_t time_ns;
+};
+
+static int
+compare_pass_stats_time(const void *_a, const void *_b)
+{
+   const struct pass_stats *a = _a, *b = _b;
+
+   if (a->time_ns != b->time_ns)
+      return a->time_ns < b->time_ns ? 1 : -1;
+
+   return strcmp(a->name, b->name);
+}
+
+static void
+nir_pass_stats_print(void)
+{
+   unsigned count = 0, num_stats = 0;
+
+   for (nir_pass_info *info = stats_list; info; info = info->next)
+      count++;
+
+   struct pass_stats *stats = calloc(count, sizeof(*stats));
+   if (!stats)
+      return;
+
+   /* The same pass is usually called from several places. */
+   for (nir_pass_info *info = stats_list; info; info = info->next) {
+      unsigned i;
+      for (i = 0; i < num_stats; i++) {
+         if (strcmp(stats[i].name, info->name) == 0)
+            break;
+      }
+
+      if (i == num_stats)
+         stats[num_stats++].name = info->name;
+
+      stats[i].runs += info->runs;
+      stats[i].skips += info->skips;
+      stats[i].progress += info->progress;
+      stats[i].time_ns += info->time_ns;
+   }
+
+   qsort(stats, num_stats, sizeof(*stats), compare_pass_stats_time);
+
+   fprintf(stderr, "%-36s %10s %10s %9s %12s %10s\n",
+           "NIR pass", "runs", "skipped", "progress", "total ms", "avg us");
+
+   for (unsigned i = 0; i < num_stats; i++) {
+      fprintf(stderr, "%-36s %10"PRIu64" %10"PRIu64" %8.1f%% %12.3f %10.3f\n",
+              stats[i].name, stats[i].runs, stats[i].skips,
+              stats[i].runs ? 100.0 * stats[i].progress / stats[i].runs : 0.0,
+              stats[i].time_ns / 1000000.0,
+              stats[i].runs ? stats[i].time_ns / 1000.0 / stats[i].runs : 0.0);
+   }
+
+   free(stats);
+}
+
+static void
+nir_pass_stats_register(nir_pass_info *info)
+{
+   simple_mtx_lock(&stats_mutex);
+
+   if (!info->registered) {
+      if (!stats_list)
+         atexit(nir_pass_stats_print);
+
+      info->next = stats_list;
+      stats_list = info;
+      info->registered = true;
+   }
+
+   simple_mtx_unlock(&stats_mutex);
+}
+
+static void
+nir_pass_stats_add(nir_pass_info *info, int64_t start, bool progress)
+{
+   if (!p_atomic_read(&info->registered))
+      nir_pass_stats_register(info);
+
+   p_atomic_inc(&info->runs);
+   if (progress)
+      p_atomic_inc(&info->progress);
+   p_atomic_add(&info->time_ns, os_time_get_nano() - start);
+}
+
+/*
+ * Hashing
+ */
+
+static inline uint32_t
+hash_u32(uint32_t hash, uint32_t value)
+{
+   /* FNV-1a, a word at a time */
+   return (hash ^ value) * 0x01000193;
+}
+
+static inline uint32_t
+hash_ptr(uint32_t hash, const void *ptr)
+{
+   uint64_t value = (uintptr_t)ptr;
+   return hash_u32(hash_u32(hash, value), value >> 32);
+}
+
+static inline uint32_t
+hash_data(uint32_t hash, const void *data, size_t size)
+{
+   return hash_u32(hash, _mesa_hash_data(data, size));
+}
+
+static bool
+hash_src(nir_src *src, void *state)
+{
+   uint32_t *hash = state;
+
+   *hash = hash_ptr(*hash, src->is_ssa ? (void *)src->ssa : (void *)src->reg.reg);
+   if (!src->is_ssa)
+      *hash = hash_u32(*hash, src->reg.base_offset);
+
+   return true;
+}
+
+static bool
+hash_dest(nir_dest *dest, void *state)
+{
+   uint32_t *hash = state;
+
+   if (!dest->is_ssa) {
+      *hash = hash_ptr(*hash, dest->reg.reg);
+      *hash = hash_u32(*hash, dest->reg.base_offset);
+   }
+
+   return true;
+}
+
+static uint32_t
+hash_instr(nir_instr *instr)
+{
+   uint32_t hash = hash_ptr(0x811c9dc5, instr);
+
+   hash = hash_ptr(hash, instr->block);
+
+   switch (instr->type) {
+   case nir_instr_type_alu: {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+
+      hash = hash_u32(hash, alu->op);
+      hash = hash_u32(hash, alu->dest.write_mask |
+                            alu->dest.saturate << 16 |
+                            alu->exact << 17);
+      for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+         hash = hash_data(hash, alu->src[i].swizzle,
+                          sizeof(alu->src[i].swizzle));
+         hash = hash_u32(hash, alu->src[i].negate | alu->src[i].abs << 1);
+      }
+      break;
+   }
+
+   case nir_instr_type_deref: {
+      nir_deref_instr *deref = nir_instr_as_deref(instr);
+
+      hash = hash_u32(hash, deref->deref_type);
+      hash = hash_u32(hash, deref->mode);
+      hash = hash_ptr(hash, deref->type);
+      if (deref->deref_type == nir_deref_type_var)
+         hash = hash_ptr(hash, deref->var);
+      else if (deref->deref_type == nir_deref_type_struct)
+         hash = hash_u32(hash, deref->strct.index);
+      break;
+   }
+
+   case nir_instr_type_call:
+      hash = hash_ptr(hash, nir_instr_as_call(instr)->callee);
+      break;
+
+   case nir_instr_type_tex: {
+      nir_tex_instr *tex = nir_instr_as_tex(instr);
+
+      hash = hash_u32(hash, tex->op);
+      hash = hash_u32(hash, tex->texture_index);
+      hash = hash_u32(hash, tex->sampler_index);
+      hash = hash_u32(hash, tex->dest_type);
+      hash = hash_u32(hash, tex->sampler_dim);
+      hash = hash_u32(hash, tex->coord_components |
+                            tex->is_array << 8 |
+                            tex->is_shadow << 9 |
+                            tex->is_new_style_shadow << 10 |
+                            tex->component << 11);
+      for (unsigned i = 0; i < tex->num_srcs; i++)
+         hash = hash_u32(hash, tex->src[i].src_type);
+      break;
+   }
+
+   case nir_instr_type_intrinsic: {
+      nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+      const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin->intrinsic];
+
+      hash = hash_u32(hash, intrin->intrinsic);
+      hash = hash_u32(hash, intrin->num_components);
+      hash = hash_data(hash, intrin->const_index,
+                       info->num_indices * sizeof(intrin->const_index[0]));
+      break;
+   }
+
+   case nir_instr_type_load_const: {
+      nir_load_const_instr *load = nir_instr_as_load_const(instr);
+
+      hash = hash_u32(hash, load->def.bit_size);
+      hash = hash_data(hash, load->value,
+                       load->def.num_components * sizeof(load->value[0]));
+      break;
+   }
+
+   case nir_instr_type_jump:
+      hash = hash_u32(hash, nir_instr_as_jump(instr)->type);
+      break;
+
+   case nir_instr_type_phi:
+      nir_foreach_phi_src(src, nir_instr_as_phi(instr))
+         hash = hash_ptr(hash, src->pred);
+      break;
+
+   case nir_instr_type_ssa_undef:
+   case nir_instr_type_parallel_copy:
+      break;
+   }
+
+   nir_foreach_src(instr, hash_src, &hash);
+   nir_foreach_dest(instr, hash_dest, &hash);
+
+   return hash;
+}
+
+static void
+hash_cf_list(uint32_t *hashes, struct exec_list *list)
+{
+   uint32_t *cf_hash = &hashes[NIR_PASS_DEP_CF_INDEX];
+
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      *cf_hash = hash_ptr(*cf_hash, node);
+
+      switch (node->type) {
+      case nir_cf_node_block:
+         nir_foreach_instr(instr, nir_cf_node_as_block(node)) {
+            hashes[instr->type] = hash_u32(hashes[instr->type],
+                                           hash_instr(instr));
+         }
+         break;
+
+      case nir_cf_node_if: {
+         nir_if *nif = nir_cf_node_as_if(node);
+
+         hash_src(&nif->condition, cf_hash);
+         hash_cf_list(hashes, &nif->then_list);
+         *cf_hash = hash_u32(*cf_hash, nir_cf_node_if);
+         hash_cf_list(hashes, &nif->else_list);
+         break;
+      }
+
+      case nir_cf_node_loop:
+         hash_cf_list(hashes, &nir_cf_node_as_loop(node)->body);
+         break;
+
+      default:
+         unreachable("Invalid CF node type");
+      }
+
+      /* Marks the end of the node, for the nesting to count. */
+      *cf_hash = hash_u32(*cf_hash, node->type);
+   }
+}
+
+static uint32_t
+hash_var_list(uint32_t hash, struct exec_list *list)
+{
+   nir_foreach_variable(var, list) {
+      hash = hash_ptr(hash, var);
+      hash = hash_ptr(hash, var->type);
+      hash = hash_u32(hash, var->data.mode);
+      hash = hash_u32(hash, var->data.location);
+   }
+
+   return hash_u32(hash, 0);
+}
+
+static void
+hash_shader(nir_shader *shader, uint32_t *hashes)
+{
+   uint32_t *vars_hash = &hashes[NIR_PASS_DEP_VARS_INDEX];
+
+   for (unsigned i = 0; i < NIR_PASS_DEP_COUNT; i++)
+      hashes[i] = 0x811c9dc5;
+
+   *vars_hash = hash_var_list(*vars_hash, &shader->uniforms);
+   *vars_hash = hash_var_list(*vars_hash, &shader->inputs);
+   *vars_hash = hash_var_list(*vars_hash, &shader->outputs);
+   *vars_hash = hash_var_list(*vars_hash, &shader->shared);
+   *vars_hash = hash_var_list(*vars_hash, &shader->globals);
+   *vars_hash = hash_var_list(*vars_hash, &shader->system_values);
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      hashes[NIR_PASS_DEP_CF_INDEX] =
+         hash_ptr(hashes[NIR_PASS_DEP_CF_INDEX], function->impl);
+      *vars_hash = hash_var_list(*vars_hash, &function->impl->locals);
+      hash_cf_list(hashes, &function->impl->body);
+   }
+}
+
+/*
+ * Scheduling
+ */
+
+void
+nir_pass_manager_init(nir_pass_manager *pm, nir_shader *shader)
+{
+   memset(pm, 0, sizeof(*pm));
+   pm->shader = shader;
+   hash_shader(shader, pm->hash);
+}
+
+static void
+nir_pass_manager_update(nir_pass_manager *pm)
+{
+   int64_t start = nir_pass_manager_begin();
+   uint32_t hashes[NIR_PASS_DEP_COUNT];
+   bool changed = false;
+
+   hash_shader(pm->shader, hashes);
+
+   pm->generation++;
+   for (unsigned i = 0; i < NIR_PASS_DEP_COUNT; i++) {
+      if (hashes[i] != pm->hash[i]) {
+         pm->hash[i] = hashes[i];
+         pm->changed[i] = pm->generation;
+         changed = true;
+      }
+   }
+
+   /* The pass made progress in a way the hashes don't see, such as changing
+    * variable data.  Assume it may have changed anything.
+    */
+   if (!changed) {
+      for (unsigned i = 0; i < NIR_PASS_DEP_COUNT; i++)
+         pm->changed[i] = pm->generation;
+   }
+
+   if (nir_pass_stats_enabled())
+      nir_pass_stats_add(&hash_info, start, changed);
+}
+
+bool
+nir_pass_manager_should_run(nir_pass_manager *pm, nir_pass_info *info)
+{
+   unsigned i;
+
+   for (i = 0; i < pm->num_passes; i++) {
+      if (pm->passes[i].info == info)
+         break;
+   }
+
+   /* First run of the pass, or too many passes to keep track of. */
+   if (i == pm->num_passes)
+      return true;
+
+   /* A pass making progress may be able to make more. */
+   if (pm->passes[i].progress || nir_pass_run_all())
+      return true;
+
+   unsigned deps = info->deps;
+   while (deps) {
+      const int dep = u_bit_scan(&deps);
+      if (pm->changed[dep] > pm->passes[i].generation)
+         return true;
+   }
+
+   if (nir_pass_stats_enabled()) {
+      if (!p_atomic_read(&info->registered))
+         nir_pass_stats_register(info);
+      p_atomic_inc(&info->skips);
+   }
+
+   return false;
+}
+
+int64_t
+nir_pass_manager_begin(void)
+{
+   return nir_pass_stats_enabled() ? os_time_get_nano() : 0;
+}
+
+void
+nir_pass_manager_end(nir_pass_manager *pm, nir_pass_info *info,
+                     int64_t start, bool progress)
+{
+   unsigned i;
+
+   if (nir_pass_stats_enabled())
+      nir_pass_stats_add(info, start, progress);
+
+   for (i = 0; i < pm->num_passes; i++) {
+      if (pm->passes[i].info == info)
+         break;
+   }
+
+   if (i == pm->num_passes) {
+      if (i == NIR_PASS_MANAGER_MAX_PASSES)
+         return;
+      pm->passes[pm->num_passes++].info = info;
+   }
+
+   /* The changes made by this pass end up in the next generation. */
+   pm->passes[i].generation = pm->generation;
+   pm->passes[i].progress = progress;
+
+   if (progress)
+      nir_pass_manager_update(pm);
+}
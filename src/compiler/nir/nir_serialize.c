@@ -29,6 +29,16 @@
 #define NIR_SERIALIZE_FUNC_HAS_IMPL ((void *)(intptr_t)1)
 #define MAX_OBJECT_IDS (1 << 20)
 
+/* Bump this whenever the encoding changes. nir_deserialize() refuses blobs
+ * written with a different version.
+ *
+ * Version 2 moved all strings into an interned table at the end of the
+ * blob and made each function_impl independently decodable: it starts with
+ * the first object ID it assigns and its size, and it doesn't depend on the
+ * last type or variable data of what was written before it.
+ */
+#define NIR_SERIALIZE_VERSION 2
+
 typedef struct {
    size_t blob_offset;
    nir_ssa_def *src;
@@ -62,6 +72,12 @@ typedef struct {
 
    /* Don't write optional data such as variable names. */
    bool strip;
+
+   /* maps interned strings to their index + 1 */
+   struct hash_table *string_table;
+
+   /* Array of const char * in the order they were interned. */
+   struct util_dynarray strings;
 } write_ctx;
 
 typedef struct {
@@ -85,8 +101,25 @@ typedef struct {
    const struct glsl_type *last_type;
    const struct glsl_type *last_interface_type;
    struct nir_variable_data last_var_data;
+
+   /* The interned strings.  They point into the blob, so they must be
+    * copied by whoever keeps them.
+    */
+   uint32_t num_strings;
+   const char **strings;
+
+   /* Functions called by the function_impls read so far. */
+   struct util_dynarray callees;
 } read_ctx;
 
+/* A function_impl that was located in the blob, but not read yet. */
+typedef struct {
+   nir_function *fxn;
+   uint32_t first_idx;
+   const uint8_t *data;
+   bool read;
+} read_impl;
+
 static void
 write_add_object(write_ctx *ctx, const void *obj)
 {
@@ -123,6 +156,33 @@ read_object(read_ctx *ctx)
    return read_lookup_object(ctx, blob_read_uint32(ctx->blob));
 }
 
+static void
+write_string(write_ctx *ctx, const char *str)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->string_table, str);
+   if (entry) {
+      blob_write_uint32(ctx->blob, (uint32_t)(uintptr_t) entry->data - 1);
+      return;
+   }
+
+   uint32_t index = util_dynarray_num_elements(&ctx->strings, const char *);
+   util_dynarray_append(&ctx->strings, const char *, str);
+   _mesa_hash_table_insert(ctx->string_table, str,
+                           (void *)(uintptr_t)(index + 1));
+   blob_write_uint32(ctx->blob, index);
+}
+
+static const char *
+read_string(read_ctx *ctx)
+{
+   uint32_t index = blob_read_uint32(ctx->blob);
+   if (index >= ctx->num_strings) {
+      ctx->blob->overrun = true;
+      return NULL;
+   }
+   return ctx->strings[index];
+}
+
 static uint32_t
 encode_bit_size_3bits(uint8_t bit_size)
 {
@@ -295,7 +355,7 @@ write_variable(write_ctx *ctx, const nir_variable *var)
    }
 
    if (flags.u.has_name)
-      blob_write_string(ctx->blob, var->name);
+      write_string(ctx, var->name);
 
    if (flags.u.data_encoding == var_encode_full ||
        flags.u.data_encoding == var_encode_location_diff) {
@@ -358,7 +418,7 @@ read_variable(read_ctx *ctx)
    }
 
    if (flags.u.has_name) {
-      const char *name = blob_read_string(ctx->blob);
+      const char *name = read_string(ctx);
       var->name = ralloc_strdup(var, name);
    } else {
       var->name = NULL;
@@ -443,7 +503,7 @@ write_register(write_ctx *ctx, const nir_register *reg)
    blob_write_uint32(ctx->blob, reg->index);
    blob_write_uint32(ctx->blob, !ctx->strip && reg->name);
    if (!ctx->strip && reg->name)
-      blob_write_string(ctx->blob, reg->name);
+      write_string(ctx, reg->name);
 }
 
 static nir_register *
@@ -457,7 +517,7 @@ read_register(read_ctx *ctx)
    reg->index = blob_read_uint32(ctx->blob);
    bool has_name = blob_read_uint32(ctx->blob);
    if (has_name) {
-      const char *name = blob_read_string(ctx->blob);
+      const char *name = read_string(ctx);
       reg->name = ralloc_strdup(reg, name);
    } else {
       reg->name = NULL;
@@ -750,7 +810,7 @@ write_dest(write_ctx *ctx, const nir_dest *dst, union packed_instr header,
    if (dst->is_ssa) {
       write_add_object(ctx, &dst->ssa);
       if (dest.ssa.has_name)
-         blob_write_string(ctx->blob, dst->ssa.name);
+         write_string(ctx, dst->ssa.name);
    } else {
       blob_write_uint32(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
       blob_write_uint32(ctx->blob, dst->reg.base_offset);
@@ -773,7 +833,7 @@ read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr,
          num_components = blob_read_uint32(ctx->blob);
       else
          num_components = decode_num_components_in_3bits(dest.ssa.num_components);
-      char *name = dest.ssa.has_name ? blob_read_string(ctx->blob) : NULL;
+      const char *name = dest.ssa.has_name ? read_string(ctx) : NULL;
       nir_ssa_dest_init(instr, dst, num_components, bit_size, name);
       read_add_object(ctx, &dst->ssa);
    } else {
@@ -1663,6 +1723,7 @@ read_call(read_ctx *ctx)
 {
    nir_function *callee = read_object(ctx);
    nir_call_instr *call = nir_call_instr_create(ctx->nir, callee);
+   util_dynarray_append(&ctx->callees, nir_function *, callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       read_src(ctx, &call->params[i], call);
@@ -1901,6 +1962,13 @@ read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
 static void
 write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
+   /* Don't let the impl depend on what was written before it, so that it
+    * can be read on its own.
+    */
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
    write_var_list(ctx, &fi->locals);
    write_reg_list(ctx, &fi->registers);
    blob_write_uint32(ctx->blob, fi->reg_alloc);
@@ -1915,6 +1983,10 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
    nir_function_impl *fi = nir_function_impl_create_bare(ctx->nir);
    fi->function = fxn;
 
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
    read_var_list(ctx, &fi->locals);
    read_reg_list(ctx, &fi->registers);
    fi->reg_alloc = blob_read_uint32(ctx->blob);
@@ -1937,7 +2009,7 @@ write_function(write_ctx *ctx, const nir_function *fxn)
       flags |= 0x4;
    blob_write_uint32(ctx->blob, flags);
    if (fxn->name)
-      blob_write_string(ctx->blob, fxn->name);
+      write_string(ctx, fxn->name);
 
    write_add_object(ctx, fxn);
 
@@ -1961,7 +2033,7 @@ read_function(read_ctx *ctx)
 {
    uint32_t flags = blob_read_uint32(ctx->blob);
    bool has_name = flags & 0x2;
-   char *name = has_name ? blob_read_string(ctx->blob) : NULL;
+   const char *name = has_name ? read_string(ctx) : NULL;
 
    nir_function *fxn = nir_function_create(ctx->nir, name);
 
@@ -1992,12 +2064,22 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
 {
    write_ctx ctx = {0};
    ctx.remap_table = _mesa_pointer_hash_table_create(NULL);
+   ctx.string_table = _mesa_hash_table_create(NULL, _mesa_hash_string,
+                                              _mesa_key_string_equal);
    ctx.blob = blob;
    ctx.nir = nir;
    ctx.strip = strip;
    util_dynarray_init(&ctx.phi_fixups, NULL);
+   util_dynarray_init(&ctx.strings, NULL);
 
+   /* Offsets within the serialized shader are relative to its start, so
+    * that it can be embedded anywhere in a bigger blob.
+    */
+   size_t start = blob->size;
+
+   blob_write_uint32(blob, NIR_SERIALIZE_VERSION);
    size_t idx_size_offset = blob_reserve_uint32(blob);
+   size_t string_table_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -2007,9 +2089,9 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
       strings |= 0x2;
    blob_write_uint32(blob, strings);
    if (!strip && info.name)
-      blob_write_string(blob, info.name);
+      write_string(&ctx, info.name);
    if (!strip && info.label)
-      blob_write_string(blob, info.label);
+      write_string(&ctx, info.label);
    info.name = info.label = NULL;
    blob_write_bytes(blob, (uint8_t *) &info, sizeof(info));
 
@@ -2031,35 +2113,105 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
       write_function(&ctx, fxn);
    }
 
+   /* Each impl is prefixed with the first object ID it assigns and its
+    * size, so that the reader can skip it and come back to it later.
+    */
    nir_foreach_function(fxn, nir) {
-      if (fxn->impl)
-         write_function_impl(&ctx, fxn->impl);
+      if (!fxn->impl)
+         continue;
+
+      blob_write_uint32(blob, ctx.next_idx);
+      size_t impl_size_offset = blob_reserve_uint32(blob);
+      size_t impl_start = blob->size;
+
+      write_function_impl(&ctx, fxn->impl);
+
+      blob_overwrite_uint32(blob, impl_size_offset, blob->size - impl_start);
    }
 
    blob_write_uint32(blob, nir->constant_data_size);
    if (nir->constant_data_size > 0)
       blob_write_bytes(blob, nir->constant_data, nir->constant_data_size);
 
-   *(uint32_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   blob_overwrite_uint32(blob, string_table_offset, blob->size - start);
+   blob_write_uint32(blob, util_dynarray_num_elements(&ctx.strings,
+                                                      const char *));
+   util_dynarray_foreach(&ctx.strings, const char *, str)
+      blob_write_string(blob, *str);
+
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
+   _mesa_hash_table_destroy(ctx.string_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
+   util_dynarray_fini(&ctx.strings);
 }
 
-nir_shader *
-nir_deserialize(void *mem_ctx,
-                const struct nir_shader_compiler_options *options,
-                struct blob_reader *blob)
+static read_impl *
+find_read_impl(read_impl *impls, unsigned num_impls, nir_function *fxn)
+{
+   for (unsigned i = 0; i < num_impls; i++) {
+      if (impls[i].fxn == fxn)
+         return &impls[i];
+   }
+   return NULL;
+}
+
+static void
+read_impl_at(read_ctx *ctx, read_impl *impl)
+{
+   assert(!impl->read);
+   impl->read = true;
+
+   ctx->blob->current = impl->data;
+   ctx->next_idx = impl->first_idx;
+   impl->fxn->impl = read_function_impl(ctx, impl->fxn);
+}
+
+static nir_shader *
+deserialize(void *mem_ctx, const struct nir_shader_compiler_options *options,
+            struct blob_reader *blob, bool only_reachable)
 {
    read_ctx ctx = {0};
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
+   util_dynarray_init(&ctx.callees, NULL);
+
+   const uint8_t *start = blob->current;
+
+   if (blob_read_uint32(blob) != NIR_SERIALIZE_VERSION)
+      return NULL;
+
    ctx.idx_table_len = blob_read_uint32(blob);
+   uint32_t string_table_offset = blob_read_uint32(blob);
+   if (blob->overrun || string_table_offset > blob->end - start)
+      return NULL;
+
+   /* The string table is at the end.  Read it first, keeping pointers into
+    * the blob rather than copies.
+    */
+   const uint8_t *header_end = blob->current;
+   blob->current = start + string_table_offset;
+   ctx.num_strings = blob_read_uint32(blob);
+   if (blob->overrun || ctx.num_strings > blob->end - blob->current)
+      return NULL;
+   ctx.strings = malloc(ctx.num_strings * sizeof(*ctx.strings));
+   for (unsigned i = 0; i < ctx.num_strings; i++)
+      ctx.strings[i] = blob_read_string(blob);
+   const uint8_t *end = blob->current;
+   bool overrun = blob->overrun;
+   blob->current = header_end;
+
+   if (overrun) {
+      free(ctx.strings);
+      return NULL;
+   }
+
    ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
 
    uint32_t strings = blob_read_uint32(blob);
-   char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
-   char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
+   const char *name = (strings & 0x1) ? read_string(&ctx) : NULL;
+   const char *label = (strings & 0x2) ? read_string(&ctx) : NULL;
 
    struct shader_info info;
    blob_copy_bytes(blob, (uint8_t *) &info, sizeof(info));
@@ -2088,9 +2240,24 @@ nir_deserialize(void *mem_ctx,
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
+   /* Only locate the impls for now. */
+   unsigned num_impls = 0;
+   read_impl *impls = malloc(num_functions * sizeof(*impls));
+   nir_function *entrypoint = NULL;
    nir_foreach_function(fxn, ctx.nir) {
-      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
-         fxn->impl = read_function_impl(&ctx, fxn);
+      if (fxn->is_entrypoint)
+         entrypoint = fxn;
+      if (fxn->impl != NIR_SERIALIZE_FUNC_HAS_IMPL)
+         continue;
+
+      fxn->impl = NULL;
+      impls[num_impls].fxn = fxn;
+      impls[num_impls].first_idx = blob_read_uint32(blob);
+      uint32_t impl_size = blob_read_uint32(blob);
+      impls[num_impls].data = blob->current;
+      impls[num_impls].read = false;
+      blob_skip_bytes(blob, impl_size);
+      num_impls++;
    }
 
    ctx.nir->constant_data_size = blob_read_uint32(blob);
@@ -2101,11 +2268,69 @@ nir_deserialize(void *mem_ctx,
                       ctx.nir->constant_data_size);
    }
 
+   if (only_reachable && entrypoint) {
+      /* Read the entrypoint, then whatever it calls, transitively. */
+      read_impl *impl = find_read_impl(impls, num_impls, entrypoint);
+      if (impl && !blob->overrun)
+         read_impl_at(&ctx, impl);
+
+      while (!blob->overrun && ctx.callees.size) {
+         nir_function *callee = util_dynarray_pop(&ctx.callees, nir_function *);
+         impl = find_read_impl(impls, num_impls, callee);
+         if (impl && !impl->read)
+            read_impl_at(&ctx, impl);
+      }
+
+      /* Drop the functions nothing can reach. */
+      for (unsigned i = 0; i < num_impls; i++) {
+         if (!impls[i].read)
+            exec_node_remove(&impls[i].fxn->node);
+      }
+   } else {
+      for (unsigned i = 0; i < num_impls && !blob->overrun; i++)
+         read_impl_at(&ctx, &impls[i]);
+   }
+
+   if (!blob->overrun)
+      blob->current = end;
+
+   free(impls);
+   free(ctx.strings);
    free(ctx.idx_table);
+   util_dynarray_fini(&ctx.callees);
 
    return ctx.nir;
 }
 
+/**
+ * Deserialize NIR written by nir_serialize().
+ *
+ * Returns NULL if the blob was written by a different version of the
+ * serializer.  Other errors are reported through blob->overrun, like for
+ * the rest of the blob API.
+ */
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   return deserialize(mem_ctx, options, blob, false);
+}
+
+/**
+ * Like nir_deserialize(), but only reads the function_impls of the
+ * entrypoint and of the functions it calls, which is all most drivers
+ * compile.  The other functions are left out of the shader.  If there is
+ * no entrypoint, all functions are read.
+ */
+nir_shader *
+nir_deserialize_entrypoint(void *mem_ctx,
+                           const struct nir_shader_compiler_options *options,
+                           struct blob_reader *blob)
+{
+   return deserialize(mem_ctx, options, blob, true);
+}
+
 void
 nir_shader_serialize_deserialize(nir_shader *shader)
 {
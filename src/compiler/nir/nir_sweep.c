@@ -136,8 +136,11 @@ sweep_impl(nir_shader *nir, nir_function_impl *impl)
 
    sweep_block(nir, impl->end_block);
 
-   /* Wipe out all the metadata, if any. */
+   /* Wipe out all the metadata, if any.  The dominance tree children were
+    * allocated from the shader and have been freed.
+    */
    nir_metadata_preserve(impl, nir_metadata_none);
+   impl->cf_dirty_index = 0;
 }
 
 static void
@@ -21,6 +21,8 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <gtest/gtest.h>
+#include <set>
+#include <vector>
 #include "nir.h"
 #include "nir_builder.h"
 
@@ -149,3 +151,241 @@ TEST_F(nir_cf_test, delete_break_in_loop)
 
    nir_metadata_require(b.impl, nir_metadata_dominance);
 }
+
+class nir_cf_dominance_test : public nir_cf_test {
+protected:
+   struct block_dominance {
+      nir_block *block;
+      unsigned index;
+      nir_block *imm_dom;
+      std::vector<nir_block *> dom_children;
+      std::set<nir_block *> dom_frontier;
+      int16_t dom_pre_index, dom_post_index;
+   };
+
+   std::vector<block_dominance> get_dominance();
+   void check_dominance();
+
+   nir_ssa_def *cond;
+};
+
+std::vector<nir_cf_dominance_test::block_dominance>
+nir_cf_dominance_test::get_dominance()
+{
+   std::vector<block_dominance> result;
+
+   nir_foreach_block(block, b.impl) {
+      block_dominance dom;
+      dom.block = block;
+      dom.index = block->index;
+      dom.imm_dom = block->imm_dom;
+      dom.dom_children.assign(block->dom_children,
+                              block->dom_children + block->num_dom_children);
+      set_foreach(block->dom_frontier, entry)
+         dom.dom_frontier.insert((nir_block *)entry->key);
+      dom.dom_pre_index = block->dom_pre_index;
+      dom.dom_post_index = block->dom_post_index;
+      result.push_back(dom);
+   }
+
+   return result;
+}
+
+/* Checks that updating the dominance after control flow changes gives the
+ * same result as computing it from scratch.
+ */
+void
+nir_cf_dominance_test::check_dominance()
+{
+   nir_validate_shader(b.shader, NULL);
+
+   /* The changes must have been tracked, and not start at the first block. */
+   EXPECT_GT(b.impl->cf_dirty_index, 0u);
+   EXPECT_NE(b.impl->cf_dirty_index, UINT_MAX);
+
+   nir_metadata_preserve(b.impl, nir_metadata_none);
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   EXPECT_EQ(b.impl->cf_dirty_index, UINT_MAX);
+   std::vector<block_dominance> updated = get_dominance();
+
+   nir_metadata_preserve(b.impl, nir_metadata_none);
+   b.impl->cf_dirty_index = 0;
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   std::vector<block_dominance> computed = get_dominance();
+
+   ASSERT_EQ(updated.size(), computed.size());
+   for (unsigned i = 0; i < updated.size(); i++) {
+      EXPECT_EQ(updated[i].block, computed[i].block);
+      EXPECT_EQ(updated[i].index, computed[i].index);
+      EXPECT_EQ(updated[i].imm_dom, computed[i].imm_dom)
+         << "block " << computed[i].index;
+      EXPECT_EQ(updated[i].dom_children, computed[i].dom_children)
+         << "block " << computed[i].index;
+      EXPECT_EQ(updated[i].dom_frontier, computed[i].dom_frontier)
+         << "block " << computed[i].index;
+      EXPECT_EQ(updated[i].dom_pre_index, computed[i].dom_pre_index);
+      EXPECT_EQ(updated[i].dom_post_index, computed[i].dom_post_index);
+   }
+}
+
+TEST_F(nir_cf_dominance_test, unchanged)
+{
+   cond = nir_imm_true(&b);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+   nir_block *start_block = nir_start_block(b.impl);
+   nir_block **dom_children = start_block->dom_children;
+
+   /* Changing instructions doesn't require recomputing anything. */
+   nir_imm_int(&b, 1);
+   nir_metadata_preserve(b.impl, nir_metadata_none);
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   EXPECT_EQ(start_block->dom_children, dom_children);
+}
+
+TEST_F(nir_cf_dominance_test, insert_if)
+{
+   /* Create IR:
+    *
+    * if (cond) { } else { }
+    * loop {
+    *    if (cond) { break; }
+    * }
+    * if (cond) { }
+    */
+   cond = nir_imm_true(&b);
+   nir_if *first_if = nir_push_if(&b, cond);
+   nir_pop_if(&b, first_if);
+   nir_loop *loop = nir_push_loop(&b);
+   nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+   nir_pop_loop(&b, loop);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   /* Insert ifs at the start of the loop and after the first if. */
+   b.cursor = nir_before_cf_list(&loop->body);
+   nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_continue);
+   nir_pop_if(&b, NULL);
+
+   b.cursor = nir_after_cf_node(&first_if->cf_node);
+   nir_push_if(&b, cond);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+   nir_pop_if(&b, NULL);
+
+   check_dominance();
+}
+
+TEST_F(nir_cf_dominance_test, add_continue)
+{
+   /* Create IR:
+    *
+    * loop {
+    *    if (cond) {
+    *       block_b;
+    *       if (cond) { } else { }
+    *       block_b2;
+    *    } else {
+    *    }
+    *    if (cond) { break; }
+    * }
+    *
+    * and then add a continue to block_b2, which makes the loop header part
+    * of the dominance frontier of block_b.
+    */
+   cond = nir_imm_true(&b);
+   nir_loop *loop = nir_push_loop(&b);
+   nir_push_if(&b, cond);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+   nir_block *block_b2 = nir_cursor_current_block(b.cursor);
+   nir_pop_if(&b, NULL);
+   nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+   nir_pop_loop(&b, loop);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   b.cursor = nir_after_block(block_b2);
+   nir_jump(&b, nir_jump_continue);
+
+   check_dominance();
+}
+
+TEST_F(nir_cf_dominance_test, remove_break)
+{
+   /* Create IR:
+    *
+    * loop {
+    *    if (cond) { }
+    *    if (cond) { break; }
+    * }
+    *
+    * and remove the break, making the end of the program unreachable.
+    */
+   cond = nir_imm_true(&b);
+   nir_loop *loop = nir_push_loop(&b);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+   nir_push_if(&b, cond);
+   nir_jump_instr *jump = nir_jump_instr_create(b.shader, nir_jump_break);
+   nir_builder_instr_insert(&b, &jump->instr);
+   nir_pop_if(&b, NULL);
+   nir_pop_loop(&b, loop);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   nir_instr_remove(&jump->instr);
+
+   check_dominance();
+}
+
+TEST_F(nir_cf_dominance_test, move_and_delete)
+{
+   /* Create IR:
+    *
+    * if (cond) { if (cond) { } }
+    * loop {
+    *    if (cond) { }
+    *    if (cond) { break; }
+    * }
+    * if (cond) { }
+    *
+    * Move the inner if of the first one to the end of the program and
+    * delete the first if in the loop, like loop unrolling would.
+    */
+   cond = nir_imm_true(&b);
+   nir_push_if(&b, cond);
+   nir_if *inner_if = nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+   nir_pop_if(&b, NULL);
+   nir_loop *loop = nir_push_loop(&b);
+   nir_if *loop_if = nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+   nir_push_if(&b, cond);
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+   nir_pop_loop(&b, loop);
+   nir_push_if(&b, cond);
+   nir_pop_if(&b, NULL);
+
+   nir_metadata_require(b.impl, nir_metadata_dominance);
+
+   nir_cf_list list;
+   nir_cf_extract(&list, nir_before_cf_node(&inner_if->cf_node),
+                  nir_after_cf_node(&inner_if->cf_node));
+   nir_cf_reinsert(&list, nir_after_cf_list(&b.impl->body));
+
+   nir_cf_node_remove(&loop_if->cf_node);
+
+   check_dominance();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_inline_uniforms_test : public ::testing::Test {
+protected:
+   nir_inline_uniforms_test();
+   ~nir_inline_uniforms_test();
+
+   nir_ssa_def *load_ubo(unsigned block, unsigned offset,
+                         unsigned num_components);
+   unsigned find(unsigned max_offsets);
+
+   void *mem_ctx;
+   nir_builder *b;
+
+   nir_ssa_def *index;
+   uint32_t dw_offsets[4];
+};
+
+nir_inline_uniforms_test::nir_inline_uniforms_test()
+{
+   glsl_type_singleton_init_or_ref();
+
+   mem_ctx = ralloc_context(NULL);
+   static const nir_shader_compiler_options options = { };
+   b = rzalloc(mem_ctx, nir_builder);
+   nir_builder_init_simple_shader(b, mem_ctx, MESA_SHADER_COMPUTE, &options);
+
+   index = nir_load_local_invocation_index(b);
+}
+
+nir_inline_uniforms_test::~nir_inline_uniforms_test()
+{
+   if (HasFailure()) {
+      printf("\nShader from the failed test:\n\n");
+      nir_print_shader(b->shader, stdout);
+   }
+
+   ralloc_free(mem_ctx);
+
+   glsl_type_singleton_decref();
+}
+
+nir_ssa_def *
+nir_inline_uniforms_test::load_ubo(unsigned block, unsigned offset,
+                                   unsigned num_components)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_ubo);
+   load->num_components = num_components;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, block));
+   load->src[1] = nir_src_for_ssa(nir_imm_int(b, offset));
+   nir_intrinsic_set_align(load, 4, 0);
+   nir_ssa_dest_init(&load->instr, &load->dest, num_components, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+unsigned
+nir_inline_uniforms_test::find(unsigned max_offsets)
+{
+   return nir_find_inlinable_uniforms(b->shader, dw_offsets, max_offsets);
+}
+
+} // namespace
+
+TEST_F(nir_inline_uniforms_test, if_condition)
+{
+   nir_push_if(b, nir_ine(b, load_ubo(0, 8, 1), nir_imm_int(b, 0)));
+   nir_pop_if(b, NULL);
+
+   ASSERT_EQ(find(4), 1u);
+   EXPECT_EQ(dw_offsets[0], 2u);
+}
+
+TEST_F(nir_inline_uniforms_test, loop_bound)
+{
+   nir_variable *counter =
+      nir_local_variable_create(b->impl, glsl_int_type(), "counter");
+   nir_store_var(b, counter, nir_imm_int(b, 0), 1);
+
+   nir_loop *loop = nir_push_loop(b);
+   nir_ssa_def *iteration = nir_load_var(b, counter);
+   nir_push_if(b, nir_ige(b, iteration, load_ubo(0, 4, 1)));
+   nir_jump(b, nir_jump_break);
+   nir_pop_if(b, NULL);
+   nir_store_var(b, counter, nir_iadd(b, iteration, nir_imm_int(b, 1)), 1);
+   nir_pop_loop(b, loop);
+
+   ASSERT_EQ(find(4), 1u);
+   EXPECT_EQ(dw_offsets[0], 1u);
+}
+
+TEST_F(nir_inline_uniforms_test, not_uniform)
+{
+   nir_push_if(b, nir_ine(b, index, load_ubo(0, 0, 1)));
+   nir_pop_if(b, NULL);
+   nir_push_if(b, nir_ine(b, load_ubo(1, 0, 1), nir_imm_int(b, 0)));
+   nir_pop_if(b, NULL);
+
+   EXPECT_EQ(find(4), 0u);
+}
+
+TEST_F(nir_inline_uniforms_test, max_offsets)
+{
+   /* The vec4 doesn't fit, but the following scalar does. */
+   nir_ssa_def *vec = load_ubo(0, 16, 4);
+   nir_push_if(b, nir_ball_iequal4(b, vec, nir_imm_ivec4(b, 0, 1, 2, 3)));
+   nir_pop_if(b, NULL);
+   nir_push_if(b, nir_ine(b, load_ubo(0, 0, 1), nir_imm_int(b, 0)));
+   nir_pop_if(b, NULL);
+
+   ASSERT_EQ(find(2), 1u);
+   EXPECT_EQ(dw_offsets[0], 0u);
+}
+
+TEST_F(nir_inline_uniforms_test, shared_subexpressions)
+{
+   /* Each step uses the previous one twice, which takes 2^100 steps to
+    * walk as a tree.
+    */
+   nir_ssa_def *value = load_ubo(0, 12, 1);
+   for (unsigned i = 0; i < 100; i++)
+      value = nir_imul(b, value, value);
+
+   nir_push_if(b, nir_ine(b, value, nir_imm_int(b, 0)));
+   nir_pop_if(b, NULL);
+   nir_push_if(b, nir_ine(b, nir_iadd(b, value, index), nir_imm_int(b, 0)));
+   nir_pop_if(b, NULL);
+
+   ASSERT_EQ(find(4), 1u);
+   EXPECT_EQ(dw_offsets[0], 3u);
+}
+
+TEST_F(nir_inline_uniforms_test, inline_loads)
+{
+   nir_ssa_def *scalar = load_ubo(0, 4, 1);
+   nir_ssa_def *vec = load_ubo(0, 8, 2);
+   nir_ssa_def *other = load_ubo(1, 4, 1);
+   nir_ssa_def *sum = nir_iadd(b, nir_iadd(b, scalar, nir_channel(b, vec, 0)),
+                               other);
+   nir_store_var(b, nir_local_variable_create(b->impl, glsl_int_type(), "out"),
+                 sum, 1);
+
+   /* Only the first component of the vec2 is known. */
+   static const uint32_t offsets[] = { 1, 2 };
+   static const uint32_t values[] = { 7, 9 };
+   ASSERT_TRUE(nir_inline_uniforms(b->shader, 2, values, offsets));
+   nir_validate_shader(b->shader, NULL);
+
+   nir_alu_instr *add = nir_instr_as_alu(sum->parent_instr);
+   nir_alu_instr *inner = nir_instr_as_alu(add->src[0].src.ssa->parent_instr);
+   ASSERT_TRUE(nir_src_is_const(inner->src[0].src));
+   EXPECT_EQ(nir_src_as_uint(inner->src[0].src), 7u);
+   EXPECT_FALSE(nir_src_is_const(inner->src[1].src));
+   EXPECT_FALSE(nir_src_is_const(add->src[1].src));
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_licm_test : public ::testing::Test {
+protected:
+   nir_licm_test();
+   ~nir_licm_test();
+
+   /* Starts a loop reading the counter, breaking out after 16 iterations. */
+   nir_loop *push_loop();
+   void pop_loop(nir_loop *loop, nir_ssa_def *value);
+
+   nir_ssa_def *load_push_constant(unsigned offset);
+
+   bool in_loop(nir_loop *loop, nir_ssa_def *def);
+   bool before_loop(nir_loop *loop, nir_ssa_def *def);
+
+   void *mem_ctx;
+   nir_builder *b;
+
+   nir_variable *counter;
+   nir_ssa_def *index;
+   nir_ssa_def *iteration;
+};
+
+nir_licm_test::nir_licm_test()
+{
+   glsl_type_singleton_init_or_ref();
+
+   mem_ctx = ralloc_context(NULL);
+   static const nir_shader_compiler_options options = { };
+   b = rzalloc(mem_ctx, nir_builder);
+   nir_builder_init_simple_shader(b, mem_ctx, MESA_SHADER_COMPUTE, &options);
+
+   counter = nir_local_variable_create(b->impl, glsl_int_type(), "counter");
+   nir_store_var(b, counter, nir_imm_int(b, 0), 1);
+   index = nir_load_local_invocation_index(b);
+}
+
+nir_licm_test::~nir_licm_test()
+{
+   if (HasFailure()) {
+      printf("\nShader from the failed test:\n\n");
+      nir_print_shader(b->shader, stdout);
+   }
+
+   ralloc_free(mem_ctx);
+
+   glsl_type_singleton_decref();
+}
+
+nir_loop *
+nir_licm_test::push_loop()
+{
+   nir_loop *loop = nir_push_loop(b);
+
+   iteration = nir_load_var(b, counter);
+   nir_push_if(b, nir_ige(b, iteration, nir_imm_int(b, 16)));
+   nir_jump(b, nir_jump_break);
+   nir_pop_if(b, NULL);
+
+   return loop;
+}
+
+void
+nir_licm_test::pop_loop(nir_loop *loop, nir_ssa_def *value)
+{
+   nir_store_var(b, counter, nir_iadd(b, iteration, value), 1);
+   nir_pop_loop(b, loop);
+}
+
+nir_ssa_def *
+nir_licm_test::load_push_constant(unsigned offset)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_push_constant);
+   load->num_components = 1;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, offset));
+   nir_intrinsic_set_base(load, 0);
+   nir_intrinsic_set_range(load, 64);
+   nir_ssa_dest_init(&load->instr, &load->dest, 1, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+bool
+nir_licm_test::in_loop(nir_loop *loop, nir_ssa_def *def)
+{
+   nir_foreach_block_in_cf_node(block, &loop->cf_node) {
+      if (def->parent_instr->block == block)
+         return true;
+   }
+   return false;
+}
+
+bool
+nir_licm_test::before_loop(nir_loop *loop, nir_ssa_def *def)
+{
+   return def->parent_instr->block ==
+          nir_cf_node_as_block(nir_cf_node_prev(&loop->cf_node));
+}
+
+} // namespace
+
+TEST_F(nir_licm_test, hoist_alu)
+{
+   nir_loop *loop = push_loop();
+   nir_ssa_def *invariant = nir_iadd(b, index, nir_imm_int(b, 1));
+   nir_ssa_def *variant = nir_imul(b, iteration, invariant);
+   pop_loop(loop, variant);
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 32));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(before_loop(loop, invariant));
+   EXPECT_TRUE(in_loop(loop, variant));
+   EXPECT_TRUE(before_loop(loop,
+      nir_instr_as_alu(invariant->parent_instr)->src[1].src.ssa));
+}
+
+TEST_F(nir_licm_test, hoist_chain)
+{
+   nir_loop *loop = push_loop();
+   nir_ssa_def *a = nir_iadd(b, index, nir_imm_int(b, 1));
+   nir_ssa_def *c = nir_imul(b, a, a);
+   pop_loop(loop, c);
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 32));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(before_loop(loop, a));
+   EXPECT_TRUE(before_loop(loop, c));
+}
+
+TEST_F(nir_licm_test, pressure_limit)
+{
+   /* The invocation index is live across the loop, and stays live until
+    * both of its users are hoisted.
+    */
+   nir_loop *loop = push_loop();
+   nir_ssa_def *a = nir_iadd(b, index, nir_imm_int(b, 1));
+   nir_ssa_def *c = nir_imul(b, index, nir_imm_int(b, 3));
+   pop_loop(loop, nir_iadd(b, a, c));
+
+   EXPECT_FALSE(nir_opt_licm(b->shader, 1));
+
+   EXPECT_TRUE(in_loop(loop, a));
+   EXPECT_TRUE(in_loop(loop, c));
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 2));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(before_loop(loop, a));
+   EXPECT_TRUE(before_loop(loop, c));
+}
+
+TEST_F(nir_licm_test, pressure_neutral)
+{
+   /* Hoisting the only use of the invocation index doesn't increase the
+    * pressure, so happens even without any budget.
+    */
+   nir_loop *loop = push_loop();
+   nir_ssa_def *a = nir_iadd(b, index, nir_imm_int(b, 1));
+   pop_loop(loop, a);
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 0));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(before_loop(loop, a));
+}
+
+TEST_F(nir_licm_test, conditional_load)
+{
+   nir_loop *loop = nir_push_loop(b);
+   nir_ssa_def *first = load_push_constant(0);
+   iteration = nir_load_var(b, counter);
+   nir_push_if(b, nir_ige(b, iteration, nir_imm_int(b, 16)));
+   nir_jump(b, nir_jump_break);
+   nir_pop_if(b, NULL);
+   nir_ssa_def *second = load_push_constant(4);
+   pop_loop(loop, nir_iadd(b, first, second));
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 32));
+   nir_validate_shader(b->shader, NULL);
+
+   /* The second load only happens if the loop doesn't exit. */
+   EXPECT_TRUE(before_loop(loop, first));
+   EXPECT_TRUE(in_loop(loop, second));
+}
+
+TEST_F(nir_licm_test, nested_loops)
+{
+   nir_loop *outer = push_loop();
+   nir_ssa_def *outer_iteration = iteration;
+   nir_loop *inner = push_loop();
+   nir_ssa_def *a = nir_iadd(b, index, nir_imm_int(b, 1));
+   pop_loop(inner, a);
+   pop_loop(outer, outer_iteration);
+
+   ASSERT_TRUE(nir_opt_licm(b->shader, 32));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(before_loop(outer, a));
+}
+
+TEST_F(nir_licm_test, no_variant_hoist)
+{
+   nir_loop *loop = push_loop();
+   nir_ssa_def *variant = nir_iadd(b, iteration, nir_imm_int(b, 1));
+   pop_loop(loop, variant);
+
+   EXPECT_FALSE(nir_opt_licm(b->shader, 32));
+
+   EXPECT_TRUE(in_loop(loop, variant));
+}
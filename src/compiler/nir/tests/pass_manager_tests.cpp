@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_pass_manager_test : public ::testing::Test {
+protected:
+   nir_pass_manager_test();
+   ~nir_pass_manager_test();
+
+   void *mem_ctx;
+   nir_builder *b;
+};
+
+nir_pass_manager_test::nir_pass_manager_test()
+{
+   glsl_type_singleton_init_or_ref();
+
+   mem_ctx = ralloc_context(NULL);
+   static const nir_shader_compiler_options options = { };
+   b = rzalloc(mem_ctx, nir_builder);
+   nir_builder_init_simple_shader(b, mem_ctx, MESA_SHADER_COMPUTE, &options);
+}
+
+nir_pass_manager_test::~nir_pass_manager_test()
+{
+   if (HasFailure()) {
+      printf("\nShader from the failed test:\n\n");
+      nir_print_shader(b->shader, stdout);
+   }
+
+   ralloc_free(mem_ctx);
+
+   glsl_type_singleton_decref();
+}
+
+/* Passes counting how often they ran, and never making progress. */
+static bool
+count_runs(nir_shader *shader, unsigned *runs)
+{
+   (*runs)++;
+   return false;
+}
+
+static bool
+count_other_runs(nir_shader *shader, unsigned *runs)
+{
+   (*runs)++;
+   return false;
+}
+
+/* Passes adding an instruction, the given number of times. */
+static bool
+add_alu(nir_shader *shader, unsigned *remaining)
+{
+   if (*remaining == 0)
+      return false;
+
+   nir_builder b;
+   nir_builder_init(&b, nir_shader_get_entrypoint(shader));
+   b.cursor = nir_after_cf_list(&b.impl->body);
+   nir_fadd(&b, nir_imm_float(&b, 1.0), nir_imm_float(&b, 2.0));
+
+   nir_metadata_preserve(nir_shader_get_entrypoint(shader),
+                         nir_metadata_none);
+   (*remaining)--;
+   return true;
+}
+
+static bool
+add_intrinsic(nir_shader *shader, unsigned *remaining)
+{
+   if (*remaining == 0)
+      return false;
+
+   nir_builder b;
+   nir_builder_init(&b, nir_shader_get_entrypoint(shader));
+   b.cursor = nir_after_cf_list(&b.impl->body);
+   nir_load_local_invocation_index(&b);
+
+   nir_metadata_preserve(nir_shader_get_entrypoint(shader),
+                         nir_metadata_none);
+   (*remaining)--;
+   return true;
+}
+
+/* Claims progress without changing anything, the given number of times. */
+static bool
+fake_progress(nir_shader *shader, unsigned *remaining)
+{
+   if (*remaining == 0)
+      return false;
+
+   nir_metadata_preserve(nir_shader_get_entrypoint(shader),
+                         nir_metadata_none);
+   (*remaining)--;
+   return true;
+}
+
+} // namespace
+
+TEST_F(nir_pass_manager_test, skip_without_changes)
+{
+   unsigned remaining = 3, runs = 0, iterations = 0;
+   nir_pass_manager pm;
+   bool progress;
+
+   nir_pass_manager_init(&pm, b->shader);
+
+   do {
+      progress = false;
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, add_alu, &remaining);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, count_runs, &runs);
+      iterations++;
+   } while (progress);
+
+   /* Nothing changed after the third run of count_runs. */
+   EXPECT_EQ(iterations, 4u);
+   EXPECT_EQ(runs, 3u);
+}
+
+TEST_F(nir_pass_manager_test, skip_unrelated_changes)
+{
+   unsigned remaining = 2, alu_runs = 0, all_runs = 0;
+   nir_pass_manager pm;
+   bool progress;
+
+   nir_pass_manager_init(&pm, b->shader);
+
+   do {
+      progress = false;
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                    add_intrinsic, &remaining);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_alu,
+                    count_runs, &alu_runs);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                    count_other_runs, &all_runs);
+   } while (progress);
+
+   EXPECT_EQ(alu_runs, 1u);
+   EXPECT_EQ(all_runs, 2u);
+}
+
+TEST_F(nir_pass_manager_test, progress_without_changes)
+{
+   unsigned remaining = 2, runs = 0;
+   nir_pass_manager pm;
+   bool progress;
+
+   nir_pass_manager_init(&pm, b->shader);
+
+   /* Progress the hashes don't see must still rerun the other passes. */
+   do {
+      progress = false;
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                    fake_progress, &remaining);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_alu, count_runs, &runs);
+   } while (progress);
+
+   EXPECT_EQ(runs, 2u);
+}
+
+TEST_F(nir_pass_manager_test, loop_pass_v)
+{
+   unsigned remaining = 1, runs = 0;
+   nir_pass_manager pm;
+   bool progress;
+
+   nir_pass_manager_init(&pm, b->shader);
+
+   do {
+      progress = false;
+      NIR_LOOP_PASS_V(&pm, nir_pass_dep_all, add_alu, &remaining);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_alu, count_runs, &runs);
+   } while (progress);
+
+   EXPECT_EQ(remaining, 0u);
+   EXPECT_EQ(runs, 1u);
+}
@@ -282,3 +282,64 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+TEST_F(nir_serialize_test, entrypoint_only)
+{
+   nir_function *unused = nir_function_create(b->shader, "unused");
+   nir_function *used = nir_function_create(b->shader, "used");
+
+   nir_variable *global =
+      nir_variable_create(b->shader, nir_var_shader_temp, glsl_int_type(),
+                          "tmp");
+
+   nir_builder fb;
+   nir_builder_init(&fb, nir_function_impl_create(unused));
+   fb.cursor = nir_after_cf_list(&fb.impl->body);
+   nir_store_var(&fb, global, nir_imm_int(&fb, 1), 0x1);
+
+   nir_builder_init(&fb, nir_function_impl_create(used));
+   fb.cursor = nir_after_cf_list(&fb.impl->body);
+   nir_variable *local =
+      nir_local_variable_create(fb.impl, glsl_int_type(), "tmp");
+   nir_store_var(&fb, local, nir_imm_int(&fb, 2), 0x1);
+   nir_store_var(&fb, global, nir_load_var(&fb, local), 0x1);
+
+   nir_builder_instr_insert(b, &nir_call_instr_create(b->shader, used)->instr);
+
+   struct blob blob;
+   struct blob_reader reader;
+
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *full = nir_deserialize(mem_ctx, &options, &reader);
+   ASSERT_TRUE(full != NULL);
+   ASSERT_EQ(reader.current, reader.end);
+   ASSERT_EQ(exec_list_length(&full->functions), 3);
+
+   blob_reader_init(&reader, blob.data, blob.size);
+   dup = nir_deserialize_entrypoint(mem_ctx, &options, &reader);
+   blob_finish(&blob);
+
+   ASSERT_TRUE(dup != NULL);
+   ASSERT_EQ(reader.current, reader.end);
+   ASSERT_FALSE(reader.overrun);
+   nir_validate_shader(dup, "entrypoint only");
+
+   ASSERT_EQ(exec_list_length(&dup->functions), 2);
+   nir_foreach_function(fxn, dup) {
+      ASSERT_TRUE(fxn->impl != NULL);
+      ASSERT_TRUE(fxn->is_entrypoint || strcmp(fxn->name, "used") == 0);
+      if (!fxn->is_entrypoint) {
+         nir_variable *dup_local =
+            exec_node_data(nir_variable, exec_list_get_head(&fxn->impl->locals),
+                           node);
+         ASSERT_STREQ(dup_local->name, "tmp");
+      }
+   }
+
+   nir_variable *dup_global =
+      exec_node_data(nir_variable, exec_list_get_head(&dup->globals), node);
+   ASSERT_STREQ(dup_global->name, "tmp");
+}
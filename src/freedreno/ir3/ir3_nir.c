@@ -338,6 +338,12 @@ ir3_optimize_nir(struct ir3_shader *shader, nir_shader *s,
 	if (ubo_progress || idiv_progress)
 		ir3_optimize_loop(s);
 
+	/* Hoist loop invariants now that UBO loads have become uniform loads.
+	 * The register footprint limits the number of waves in flight, so
+	 * keep the values live across loops to a minimum.
+	 */
+	OPT_V(s, nir_opt_licm, 16);
+
 	/* Do late algebraic optimization to turn add(a, neg(b)) back into
 	* subs, then the mandatory cleanup after algebraic.  Note that it may
 	* produce fnegs, and if so then we need to keep running to squash
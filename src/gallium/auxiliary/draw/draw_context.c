@@ -1326,6 +1326,25 @@ draw_will_inject_frontface(const struct draw_context *draw)
             rast->fill_back != PIPE_POLYGON_MODE_FILL));
 }
 
+/**
+ * Let the driver provide a cache for the object code of the shaders the
+ * draw module generates with LLVM.
+ */
+void
+draw_set_disk_cache_callbacks(struct draw_context *draw,
+                              void *data_cookie,
+                              void (*find_shader)(void *cookie,
+                                                  struct lp_cached_code *cache,
+                                                  unsigned char ir_sha1_cache_key[20]),
+                              void (*insert_shader)(void *cookie,
+                                                    struct lp_cached_code *cache,
+                                                    unsigned char ir_sha1_cache_key[20]))
+{
+   draw->disk_cache_cookie = data_cookie;
+   draw->disk_cache_find_shader = find_shader;
+   draw->disk_cache_insert_shader = insert_shader;
+}
+
 void
 draw_set_tess_state(struct draw_context *draw,
 		    const float default_outer_level[4],
@@ -826,6 +826,17 @@ llvm_tess_eval_shader(struct draw_tess_eval_shader *tes)
    return (struct llvm_tess_eval_shader *)tes;
 }
 
+/**
+ * Number of vertices processed at once by the llvm vertex shader.
+ * The aos conversion code doesn't handle 512 bit vectors, so this
+ * stays at 8 even when the fragment side runs 16-wide.
+ */
+static inline unsigned
+draw_llvm_vs_vector_length(void)
+{
+   return MIN2(lp_native_vector_width, 256) / 32;
+}
+
 struct draw_llvm *
 draw_llvm_create(struct draw_context *draw, LLVMContextRef llvm_context);
 
@@ -508,6 +508,17 @@ int lp_build_conv_auto(struct gallivm_state *gallivm,
          lp_build_conv(gallivm, src_type, *dst_type, src, num_srcs, dst, num_dsts);
          return num_dsts;
       }
+
+      /* Special case 1x16x32 --> 1x16x8 */
+      if (src_type.length == 16 &&
+          util_cpu_caps.has_avx512f)
+      {
+         num_dsts = num_srcs;
+         dst_type->length = 16;
+
+         lp_build_conv(gallivm, src_type, *dst_type, src, num_srcs, dst, num_dsts);
+         return num_dsts;
+      }
    }
 
    /* lp_build_resize does not support M:N */
@@ -776,6 +787,66 @@ lp_build_conv(struct gallivm_state *gallivm,
       return;
    }
 
+   /* Special case 1x16x32 --> 1x16x8 (avx512)
+    * There are no pack instructions with saturation for 512bit vectors, but
+    * clamping and truncating directly maps to vpmovdb.
+    */
+   else if (src_type.norm     == 0 &&
+       src_type.width    == 32 &&
+       src_type.length   == 16 &&
+       src_type.fixed    == 0 &&
+
+       dst_type.floating == 0 &&
+       dst_type.fixed    == 0 &&
+       dst_type.width    == 8 &&
+       dst_type.length   == 16 &&
+       num_srcs == num_dsts &&
+
+       ((src_type.floating == 1 && src_type.sign == 1 && dst_type.norm == 1) ||
+        (src_type.floating == 0 && dst_type.floating == 0 &&
+         src_type.sign == dst_type.sign && dst_type.norm == 0)) &&
+
+      util_cpu_caps.has_avx512f) {
+
+      struct lp_build_context bld, int_bld;
+      LLVMValueRef const_scale;
+
+      lp_build_context_init(&bld, gallivm, src_type);
+      lp_build_context_init(&int_bld, gallivm, lp_int_type(src_type));
+
+      const_scale = lp_build_const_vec(gallivm, src_type, lp_const_scale(dst_type));
+
+      for (i = 0; i < num_dsts; ++i) {
+         LLVMValueRef a = src[i];
+
+         if (src_type.floating) {
+            if (dst_type.sign) {
+               a = lp_build_min(&bld, bld.one, a);
+            }
+            a = LLVMBuildFMul(builder, a, const_scale, "");
+            a = lp_build_iround(&bld, a);
+         }
+
+         /* Same clamping as the saturating packs of the paths above */
+         if (dst_type.sign) {
+            a = lp_build_max(&int_bld, a,
+                             lp_build_const_int_vec(gallivm, int_bld.type, -128));
+            a = lp_build_min(&int_bld, a,
+                             lp_build_const_int_vec(gallivm, int_bld.type, 127));
+         }
+         else {
+            if (src_type.floating || src_type.sign) {
+               a = lp_build_max(&int_bld, a, int_bld.zero);
+            }
+            a = lp_build_min(&int_bld, a,
+                             lp_build_const_int_vec(gallivm, int_bld.type, 255));
+         }
+
+         dst[i] = LLVMBuildTrunc(builder, a, lp_build_vec_type(gallivm, dst_type), "");
+      }
+      return;
+   }
+
    /* Special case -> 16bit half-float
     */
    else if (dst_type.floating && dst_type.width == 16)
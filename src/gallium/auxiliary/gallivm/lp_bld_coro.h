@@ -56,6 +56,7 @@ LLVMValueRef lp_build_coro_alloc(struct gallivm_state *gallivm, LLVMValueRef id)
 
 LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id);
 void lp_build_coro_free_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id, LLVMValueRef coro_hdl);
+void lp_build_coro_add_malloc_hooks(struct gallivm_state *gallivm);
 
 struct lp_build_coro_suspend_info {
    LLVMBasicBlockRef suspend;
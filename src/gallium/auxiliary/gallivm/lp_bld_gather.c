@@ -336,6 +336,19 @@ lp_build_gather_avx2(struct gallivm_state *gallivm,
       LLVMValueRef args[] = { src_ptr, alignment, mask, passthru };
 
       res = lp_build_intrinsic(builder, intrinsic, src_vec_type, args, 4, 0);
+   } else if (src_width == 32 && length == 16) {
+      /* avx512 gather, the mask is a plain i16 and the scale an i32 here */
+      const char *intrinsic = dst_type.floating ?
+                              "llvm.x86.avx512.gather.dps.512" :
+                              "llvm.x86.avx512.gather.dpi.512";
+      LLVMValueRef passthru = LLVMGetUndef(src_vec_type);
+      LLVMValueRef mask = LLVMConstInt(LLVMInt16TypeInContext(gallivm->context),
+                                       0xffff, 0);
+      LLVMValueRef scale = lp_build_const_int32(gallivm, 1);
+
+      LLVMValueRef args[] = { passthru, base_ptr, offsets, mask, scale };
+
+      res = lp_build_intrinsic(builder, intrinsic, src_vec_type, args, 5, 0);
    } else {
       LLVMTypeRef i8_type = LLVMIntTypeInContext(gallivm->context, 8);
       const char *intrinsic = NULL;
@@ -492,6 +505,10 @@ lp_build_gather(struct gallivm_state *gallivm,
               src_width == 32 && (length == 4 || length == 8)) {
       return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
                                   base_ptr, offsets);
+   } else if (util_cpu_caps.has_avx512f && !need_expansion &&
+              src_width == 32 && length == 16) {
+      return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
+                                  base_ptr, offsets);
    /*
     * This looks bad on paper wrt throughtput/latency on Haswell.
     * Even on Broadwell it doesn't look stellar.
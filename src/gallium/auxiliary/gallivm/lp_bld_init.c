@@ -37,6 +37,7 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
+#include "lp_bld_coro.h"
 
 #include <llvm/Config/llvm-config.h>
 #include <llvm-c/Analysis.h>
@@ -85,6 +86,7 @@ DEBUG_GET_ONCE_FLAGS_OPTION(gallivm_debug, "GALLIVM_DEBUG", lp_bld_debug_flags,
 static boolean gallivm_initialized = FALSE;
 
 unsigned lp_native_vector_width;
+unsigned lp_fs_vector_width;
 
 
 /*
@@ -165,6 +167,7 @@ create_pass_manager(struct gallivm_state *gallivm)
        * Even for sane shaders, the cost of licm is rather high (and not just
        * due to lcssa, licm itself too), though mostly only in cases when it
        * can actually move things, so having to disable it is a pity.
+       * lp_build_opt_nir() runs nir_opt_licm on NIR shaders instead.
        * LLVMAddLICMPass(gallivm->passmgr);
        */
       LLVMAddReassociatePass(gallivm->passmgr);
@@ -211,6 +214,15 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->cache) {
+      /* The object cache must outlive the engine which references it. */
+      lp_free_objcache(gallivm->cache->jit_obj_cache);
+      free(gallivm->cache->data);
+      gallivm->cache->jit_obj_cache = NULL;
+      gallivm->cache->data = NULL;
+      gallivm->cache->data_size = 0;
+   }
+
    FREE(gallivm->module_name);
 
    if (gallivm->target) {
@@ -230,6 +242,9 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
+   gallivm->coro_malloc_hook = NULL;
+   gallivm->coro_free_hook = NULL;
 }
 
 
@@ -267,6 +282,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     &gallivm->code,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
+                                                    gallivm->cache,
                                                     (unsigned) optlevel,
                                                     &error);
       if (ret) {
@@ -310,7 +326,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -319,6 +335,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   gallivm->cache = cache;
 
    if (!gallivm->context)
       goto fail;
@@ -432,6 +449,10 @@ lp_build_init(void)
       util_cpu_caps.has_avx2 = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512dq = 0;
+      util_cpu_caps.has_avx512bw = 0;
+      util_cpu_caps.has_avx512vl = 0;
    }
 #endif
 
@@ -444,8 +465,21 @@ lp_build_init(void)
       lp_native_vector_width = 128;
    }
 
-   lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
-                                                 lp_native_vector_width);
+   /* Only fragment shaders go 16-wide with AVX-512, where an invocation
+    * then covers a whole 4x4 stamp, see fs_type in lp_state_fs.c.
+    */
+   if (util_cpu_caps.has_avx512f && util_cpu_caps.has_avx512dq &&
+       util_cpu_caps.has_avx512bw && util_cpu_caps.has_avx512vl) {
+      lp_fs_vector_width = 512;
+   } else {
+      lp_fs_vector_width = lp_native_vector_width;
+   }
+
+   if (debug_get_option("LP_NATIVE_VECTOR_WIDTH", NULL)) {
+      lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
+                                                    lp_native_vector_width);
+      lp_fs_vector_width = lp_native_vector_width;
+   }
 
 #if LLVM_VERSION_MAJOR < 4
    if (lp_native_vector_width <= 128) {
@@ -494,15 +528,21 @@ lp_build_init(void)
 
 /**
  * Create a new gallivm_state object.
+ *
+ * \param cache  optional object code cache entry; if it holds object code
+ *               it is used instead of compiling the module, otherwise it
+ *               receives the generated object code.  It must stay valid
+ *               until gallivm_free_ir() is called, which releases its data.
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -567,6 +607,17 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       gallivm->builder = NULL;
    }
 
+   /* Object code with process specific addresses must not be reused. */
+   if (gallivm->cache && gallivm->cache->dont_cache) {
+      free(gallivm->cache->data);
+      gallivm->cache->data = NULL;
+      gallivm->cache->data_size = 0;
+   }
+
+   /* Nothing to optimize if the object code comes from the cache. */
+   if (gallivm->cache && gallivm->cache->data_size)
+      goto skip_cached;
+
    /* Dump bitcode to a file */
    if (gallivm_debug & GALLIVM_DEBUG_DUMP_BC) {
       char filename[256];
@@ -617,6 +668,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    gallivm->module_name, time_msec);
    }
 
+skip_cached:
    /* Setting the module's DataLayout to an empty string will cause the
     * ExecutionEngine to copy to the DataLayout string from its target machine
     * to the module.  As of LLVM 3.8 the module and the execution engine are
@@ -641,6 +693,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    }
    assert(gallivm->engine);
 
+   lp_build_coro_add_malloc_hooks(gallivm);
+
    ++gallivm->compiled;
 
    if (gallivm_debug & GALLIVM_DEBUG_ASM) {
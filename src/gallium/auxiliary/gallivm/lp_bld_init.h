@@ -39,6 +39,23 @@
 extern "C" {
 #endif
 
+/**
+ * Object code of a compiled module, as stored in or restored from an
+ * on-disk shader cache.
+ *
+ * If data_size is non-zero when the module is compiled, the object code is
+ * loaded directly and LLVM optimization and code generation are skipped.
+ * Otherwise it is filled in with the freshly generated object code, unless
+ * the IR embeds process specific addresses, in which case dont_cache gets
+ * set.
+ */
+struct lp_cached_code {
+   void *data;
+   size_t data_size;
+   bool dont_cache;
+   void *jit_obj_cache;
+};
+
 struct gallivm_state
 {
    char *module_name;
@@ -51,7 +68,10 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
    unsigned compiled;
+   LLVMValueRef coro_malloc_hook;
+   LLVMValueRef coro_free_hook;
 };
 
 
@@ -60,7 +80,8 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
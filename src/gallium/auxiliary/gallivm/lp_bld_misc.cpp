@@ -59,6 +59,8 @@
 #include <llvm/ADT/Triple.h>
 #include <llvm/Analysis/TargetLibraryInfo.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/PrettyStackTrace.h>
@@ -87,9 +89,11 @@
 #include "pipe/p_config.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
+#include "util/mesa-sha1.h"
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_init.h"
 
 namespace {
 
@@ -291,60 +295,14 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 
 
 /**
- * Same as LLVMCreateJITCompilerForModule, but:
- * - allows using MCJIT and enabling AVX feature where available.
- * - set target options
- *
- * See also:
- * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
- * - llvm/tools/lli/lli.cpp
- * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ * Determine the CPU name and feature attributes to generate code for.
  */
-extern "C"
-LLVMBool
-lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
-                                        lp_generated_code **OutCode,
-                                        LLVMModuleRef M,
-                                        LLVMMCJITMemoryManagerRef CMM,
-                                        unsigned OptLevel,
-                                        char **OutError)
+static void
+get_host_cpu_target(llvm::StringRef &MCPU,
+                    llvm::SmallVector<std::string, 16> &MAttrs)
 {
    using namespace llvm;
 
-   std::string Error;
-   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
-
-   /**
-    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
-    * friends for configuring code generation options, like stack alignment.
-    */
-   TargetOptions options;
-#if defined(PIPE_ARCH_X86)
-   options.StackAlignmentOverride = 4;
-#endif
-
-   builder.setEngineKind(EngineKind::JIT)
-          .setErrorStr(&Error)
-          .setTargetOptions(options)
-          .setOptLevel((CodeGenOpt::Level)OptLevel);
-
-#ifdef _WIN32
-    /*
-     * MCJIT works on Windows, but currently only through ELF object format.
-     *
-     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
-     * different strings for MinGW/MSVC, so better play it safe and be
-     * explicit.
-     */
-#  ifdef _WIN64
-    LLVMSetTarget(M, "x86_64-pc-win32-elf");
-#  else
-    LLVMSetTarget(M, "i686-pc-win32-elf");
-#  endif
-#endif
-
-   llvm::SmallVector<std::string, 16> MAttrs;
-
 #if LLVM_VERSION_MAJOR >= 4 && (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64) || defined(PIPE_ARCH_ARM))
    /* llvm-3.3+ implements sys::getHostCPUFeatures for Arm
     * and llvm-3.7+ for x86, which allows us to enable/disable
@@ -385,14 +343,14 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    MAttrs.push_back(util_cpu_caps.has_f16c ? "+f16c" : "-f16c");
    MAttrs.push_back(util_cpu_caps.has_fma  ? "+fma"  : "-fma");
    MAttrs.push_back(util_cpu_caps.has_avx2 ? "+avx2" : "-avx2");
-   /* disable avx512 and all subvariants */
-   MAttrs.push_back("-avx512cd");
+   MAttrs.push_back(util_cpu_caps.has_avx512f  ? "+avx512f"  : "-avx512f");
+   MAttrs.push_back(util_cpu_caps.has_avx512cd ? "+avx512cd" : "-avx512cd");
+   MAttrs.push_back(util_cpu_caps.has_avx512bw ? "+avx512bw" : "-avx512bw");
+   MAttrs.push_back(util_cpu_caps.has_avx512dq ? "+avx512dq" : "-avx512dq");
+   MAttrs.push_back(util_cpu_caps.has_avx512vl ? "+avx512vl" : "-avx512vl");
+   /* Xeon Phi only subvariants are never used */
    MAttrs.push_back("-avx512er");
-   MAttrs.push_back("-avx512f");
    MAttrs.push_back("-avx512pf");
-   MAttrs.push_back("-avx512bw");
-   MAttrs.push_back("-avx512dq");
-   MAttrs.push_back("-avx512vl");
 #endif
 #if defined(PIPE_ARCH_ARM)
    if (!util_cpu_caps.has_neon) {
@@ -433,19 +391,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 #endif
 #endif
 
-   builder.setMAttrs(MAttrs);
-
-   if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
-      int n = MAttrs.size();
-      if (n > 0) {
-         debug_printf("llc -mattr option(s): ");
-         for (int i = 0; i < n; i++)
-            debug_printf("%s%s", MAttrs[i].c_str(), (i < n - 1) ? "," : "");
-         debug_printf("\n");
-      }
-   }
-
-   StringRef MCPU = llvm::sys::getHostCPUName();
+   MCPU = llvm::sys::getHostCPUName();
    /*
     * The cpu bits are no longer set automatically, so need to set mcpu manually.
     * Note that the MAttrs set above will be sort of ignored (since we should
@@ -459,19 +405,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
     * can't handle. Not entirely sure if we really need to do anything yet.
     */
 
-#ifdef PIPE_ARCH_PPC_64
-   /*
-    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
-    * of the Medium code model once dynamically generated JIT-compiled shader
-    * programs are linked in and relocated.  Yet the default code model as of
-    * LLVM 8 is Medium or even Small.
-    * The cost of changing from Medium to Large is negligible:
-    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
-    * - change an add-immediate (addis) instruction to a load (ld).
-    */
-   builder.setCodeModel(CodeModel::Large);
-
-#if UTIL_ARCH_LITTLE_ENDIAN
+#if defined(PIPE_ARCH_PPC_64) && UTIL_ARCH_LITTLE_ENDIAN
    /*
     * Versions of LLVM prior to 4.0 lacked a table entry for "POWER8NVL",
     * resulting in (big-endian) "generic" being returned on
@@ -484,6 +418,132 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    if (MCPU == "generic")
       MCPU = "pwr8";
 #endif
+}
+
+
+/*
+ * Hands out object code restored from the shader cache instead of compiling
+ * the module, or captures the freshly compiled object code so it can be
+ * stored in the shader cache.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+
+   struct lp_cached_code *cache_out;
+
+   public:
+
+      LPObjectCache(struct lp_cached_code *cache) {
+         cache_out = cache;
+      }
+
+      virtual ~LPObjectCache() {
+      }
+
+      virtual void notifyObjectCompiled(const llvm::Module *M,
+                                        llvm::MemoryBufferRef Obj) {
+         assert(!cache_out->data_size);
+         cache_out->data_size = Obj.getBufferSize();
+         cache_out->data = malloc(cache_out->data_size);
+         if (!cache_out->data) {
+            cache_out->data_size = 0;
+            return;
+         }
+         memcpy(cache_out->data, Obj.getBufferStart(), cache_out->data_size);
+      }
+
+      virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) {
+         if (!cache_out->data_size)
+            return NULL;
+
+         return llvm::MemoryBuffer::getMemBuffer(
+            llvm::StringRef((const char *)cache_out->data, cache_out->data_size),
+            "", false);
+      }
+};
+
+
+/**
+ * Same as LLVMCreateJITCompilerForModule, but:
+ * - allows using MCJIT and enabling AVX feature where available.
+ * - set target options
+ *
+ * See also:
+ * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
+ * - llvm/tools/lli/lli.cpp
+ * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ */
+extern "C"
+LLVMBool
+lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
+                                        lp_generated_code **OutCode,
+                                        LLVMModuleRef M,
+                                        LLVMMCJITMemoryManagerRef CMM,
+                                        struct lp_cached_code *cache_out,
+                                        unsigned OptLevel,
+                                        char **OutError)
+{
+   using namespace llvm;
+
+   std::string Error;
+   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
+
+   /**
+    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
+    * friends for configuring code generation options, like stack alignment.
+    */
+   TargetOptions options;
+#if defined(PIPE_ARCH_X86)
+   options.StackAlignmentOverride = 4;
+#endif
+
+   builder.setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setTargetOptions(options)
+          .setOptLevel((CodeGenOpt::Level)OptLevel);
+
+#ifdef _WIN32
+    /*
+     * MCJIT works on Windows, but currently only through ELF object format.
+     *
+     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
+     * different strings for MinGW/MSVC, so better play it safe and be
+     * explicit.
+     */
+#  ifdef _WIN64
+    LLVMSetTarget(M, "x86_64-pc-win32-elf");
+#  else
+    LLVMSetTarget(M, "i686-pc-win32-elf");
+#  endif
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   StringRef MCPU;
+
+   get_host_cpu_target(MCPU, MAttrs);
+
+   builder.setMAttrs(MAttrs);
+
+   if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
+      int n = MAttrs.size();
+      if (n > 0) {
+         debug_printf("llc -mattr option(s): ");
+         for (int i = 0; i < n; i++)
+            debug_printf("%s%s", MAttrs[i].c_str(), (i < n - 1) ? "," : "");
+         debug_printf("\n");
+      }
+   }
+
+#ifdef PIPE_ARCH_PPC_64
+   /*
+    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
+    * of the Medium code model once dynamically generated JIT-compiled shader
+    * programs are linked in and relocated.  Yet the default code model as of
+    * LLVM 8 is Medium or even Small.
+    * The cost of changing from Medium to Large is negligible:
+    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
+    * - change an add-immediate (addis) instruction to a load (ld).
+    */
+   builder.setCodeModel(CodeModel::Large);
 #endif
    builder.setMCPU(MCPU);
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
@@ -506,6 +566,11 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+      if (cache_out) {
+         LPObjectCache *objcache = new LPObjectCache(cache_out);
+         JIT->setObjectCache(objcache);
+         cache_out->jit_obj_cache = (void *)objcache;
+      }
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -524,6 +589,33 @@ lp_free_generated_code(struct lp_generated_code *code)
    ShaderMemoryManager::freeGeneratedCode(code);
 }
 
+extern "C"
+void
+lp_free_objcache(void *objcache_ptr)
+{
+   LPObjectCache *objcache = (LPObjectCache *)objcache_ptr;
+   delete objcache;
+}
+
+/**
+ * Hash everything about the code generation target which affects the
+ * generated object code, for use in shader cache keys.
+ */
+extern "C"
+void
+lp_build_hash_cpu_target(struct mesa_sha1 *ctx)
+{
+   llvm::SmallVector<std::string, 16> MAttrs;
+   llvm::StringRef MCPU;
+
+   get_host_cpu_target(MCPU, MAttrs);
+
+   _mesa_sha1_update(ctx, LLVM_VERSION_STRING, strlen(LLVM_VERSION_STRING));
+   _mesa_sha1_update(ctx, MCPU.data(), MCPU.size());
+   for (unsigned i = 0; i < MAttrs.size(); i++)
+      _mesa_sha1_update(ctx, MAttrs[i].c_str(), MAttrs[i].size());
+}
+
 extern "C"
 LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager()
@@ -42,6 +42,8 @@ extern "C" {
 
 
 struct lp_generated_code;
+struct lp_cached_code;
+struct mesa_sha1;
 
 extern LLVMTargetLibraryInfoRef
 gallivm_create_target_library_info(const char *triple);
@@ -58,6 +60,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         struct lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef MM,
+                                        struct lp_cached_code *cache_out,
                                         unsigned OptLevel,
                                         char **OutError);
 
@@ -70,6 +73,12 @@ lp_get_default_memory_manager();
 extern void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr);
 
+extern void
+lp_free_objcache(void *objcache);
+
+extern void
+lp_build_hash_cpu_target(struct mesa_sha1 *ctx);
+
 extern LLVMValueRef
 lp_get_called_value(LLVMValueRef call);
 
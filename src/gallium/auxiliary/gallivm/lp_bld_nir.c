@@ -1950,5 +1950,11 @@ void lp_build_opt_nir(struct nir_shader *nir)
       nir_lower_tex_options options = { .lower_tex_without_implicit_lod = true };
       NIR_PASS_V(nir, nir_lower_tex, &options);
    } while (progress);
+
+   /* LLVM's LICM is too expensive to enable (see lp_bld_init.c), so hoist
+    * loop invariants in NIR instead.  Every component is a full SoA vector,
+    * so stay within the 16 vector registers of x86.
+    */
+   NIR_PASS_V(nir, nir_opt_licm, 16);
    nir_lower_bool_to_int32(nir);
 }
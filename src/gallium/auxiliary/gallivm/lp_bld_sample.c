@@ -2058,16 +2058,76 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along the x (axis 0) or y (axis 1)
+ * axis of a texture stored in LP_TILED_TEXTURE_BLOCK sized micro-tiles.
+ *
+ * Like for the linear layout, the offsets of both axes just need to be
+ * added to get the offset of the texel.
+ *
+ * @param texel_size  size of a texel in bytes
+ * @param coord       coordinate in texels
+ * @param stride      row stride in bytes, only used for the y axis
+ * @param out_offset  resulting relative offset in bytes
+ */
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned texel_size,
+                                     unsigned axis,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef *out_offset)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   const unsigned tile_shift = util_logbase2(LP_TILED_TEXTURE_BLOCK);
+   LLVMValueRef tile_mask =
+      lp_build_const_int_vec(bld->gallivm, bld->type,
+                             LP_TILED_TEXTURE_BLOCK - 1);
+   LLVMValueRef subcoord, tile, offset;
+
+   assert(axis < 2);
+
+   subcoord = LLVMBuildAnd(builder, coord, tile_mask, "");
+   tile = LLVMBuildXor(builder, coord, subcoord, "");
+
+   if (axis == 0) {
+      /*
+       * Tiles along x are tile_size^2 texels apart, texels within a tile
+       * are adjacent.
+       */
+      offset = lp_build_shl_imm(bld, tile, tile_shift);
+      offset = LLVMBuildOr(builder, offset, subcoord, "");
+      offset = lp_build_mul_imm(bld, offset, texel_size);
+   }
+   else {
+      /*
+       * A row of tiles covers tile_size rows of the row stride, the rows
+       * within a tile are tile_size texels apart.
+       */
+      LLVMValueRef sub_offset;
+      offset = lp_build_mul(bld, tile, stride);
+      sub_offset = lp_build_shl_imm(bld, subcoord, tile_shift);
+      sub_offset = lp_build_mul_imm(bld, sub_offset, texel_size);
+      offset = lp_build_add(bld, offset, sub_offset);
+   }
+
+   *out_offset = offset;
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * If tiled is set the texture is stored in micro-tiles, which is only
+ * supported for formats with 1x1 pixel blocks.
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2083,17 +2143,32 @@ lp_build_sample_offset(struct lp_build_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
-   lp_build_sample_partial_offset(bld,
-                                  format_desc->block.width,
-                                  x, x_stride,
-                                  &offset, out_i);
+   if (tiled) {
+      assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+      lp_build_sample_tiled_partial_offset(bld, format_desc->block.bits/8, 0,
+                                           x, NULL, &offset);
+      *out_i = bld->zero;
+   }
+   else {
+      lp_build_sample_partial_offset(bld,
+                                     format_desc->block.width,
+                                     x, x_stride,
+                                     &offset, out_i);
+   }
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
-      lp_build_sample_partial_offset(bld,
-                                     format_desc->block.height,
-                                     y, y_stride,
-                                     &y_offset, out_j);
+      if (tiled) {
+         lp_build_sample_tiled_partial_offset(bld, format_desc->block.bits/8,
+                                              1, y, y_stride, &y_offset);
+         *out_j = bld->zero;
+      }
+      else {
+         lp_build_sample_partial_offset(bld,
+                                        format_desc->block.height,
+                                        y, y_stride,
+                                        &y_offset, out_j);
+      }
       offset = lp_build_add(bld, offset, y_offset);
    }
    else {
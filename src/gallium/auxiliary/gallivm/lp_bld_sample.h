@@ -156,6 +156,17 @@ struct lp_img_params
  * These are the bits of state from pipe_resource/pipe_sampler_view that
  * are embedded in the generated code.
  */
+/**
+ * Size in texels of the square micro-tiles of textures stored in tiled
+ * layout (see lp_static_texture_state::tiled).  The tiles are stored in
+ * rows, a row of tiles spanning LP_TILED_TEXTURE_BLOCK rows of the row
+ * stride, and the texels of a tile in row-major order.  So the layout
+ * needs the same amount of memory as the linear one provided the width
+ * and height are aligned to the tile size.
+ */
+#define LP_TILED_TEXTURE_BLOCK 4
+
+
 struct lp_static_texture_state
 {
    /* pipe_sampler_view's state */
@@ -171,6 +182,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< texels stored in micro-tiles */
 };
 
 
@@ -638,9 +650,19 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned texel_size,
+                                     unsigned axis,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef *out_offset);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -53,6 +53,12 @@ extern "C" {
  */
 extern unsigned lp_native_vector_width;
 
+/**
+ * SIMD width used for fragment shaders, which can be wider than
+ * lp_native_vector_width.
+ */
+extern unsigned lp_fs_vector_width;
+
 /**
  * Maximum supported vector width (not necessarily supported at run-time).
  *
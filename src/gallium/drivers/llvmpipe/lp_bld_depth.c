@@ -457,6 +457,21 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
                                        LLVMInt32TypeInContext(context), bits);
       count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
    }
+   else if(util_cpu_caps.has_avx512f && type.length == 16) {
+      /*
+       * The sign bits of the mask form a <16 x i1> vector, which maps
+       * directly onto an avx512 mask register.
+       */
+      const char *popcntintr = "llvm.ctpop.i16";
+      LLVMTypeRef i16t = LLVMInt16TypeInContext(context);
+      LLVMValueRef bits = LLVMBuildBitCast(builder, maskvalue,
+                                           lp_build_int_vec_type(gallivm, type), "");
+      bits = LLVMBuildICmp(builder, LLVMIntSLT, bits,
+                           lp_build_zero(gallivm, lp_int_type(type)), "");
+      bits = LLVMBuildBitCast(builder, bits, i16t, "");
+      count = lp_build_intrinsic_unary(builder, popcntintr, i16t, bits);
+      count = LLVMBuildZExt(builder, count, LLVMIntTypeInContext(context, 64), "");
+   }
    else {
       unsigned i;
       LLVMValueRef countv = LLVMBuildAnd(builder, maskvalue, countmask, "countv");
@@ -565,11 +580,10 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
          shuffles[i] = lp_build_const_int32(gallivm, i);
       }
    }
-   else {
+   else if (z_src_type.length == 8) {
       unsigned i;
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
        * We load 2x4 values, and need to swizzle them (order
@@ -579,20 +593,53 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
          shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
       }
    }
+   else {
+      unsigned i;
+      assert(z_src_type.length == 16);
+      assert(!is_1d);
+      /*
+       * The whole 4x4 block is handled at once (so the loop counter is
+       * always zero). Each half is swizzled like the 8-wide case.
+       */
+      for (i = 0; i < 16; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8));
+      }
+   }
 
-   depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
+   if (z_src_type.length == 16) {
+      /* Load the four rows separately and pair them up */
+      struct lp_type row_type = zs_type;
+      LLVMTypeRef row_ptr_type;
+      LLVMValueRef rows[4];
+      unsigned i;
 
-   /* Load current z/stencil values from z/stencil buffer */
-   zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-   zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
-   if (is_1d) {
-      zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      row_type.length = 4;
+      row_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0);
+      for (i = 0; i < 4; i++) {
+         LLVMValueRef row_offset = LLVMBuildMul(builder, depth_stride,
+                                                lp_build_const_int32(gallivm, i), "");
+         zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &row_offset, 1, "");
+         zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, row_ptr_type, "");
+         rows[i] = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      }
+      zs_dst1 = lp_build_concat(gallivm, &rows[0], row_type, 2);
+      zs_dst2 = lp_build_concat(gallivm, &rows[2], row_type, 2);
    }
    else {
-      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+      depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
+
+      /* Load current z/stencil values from z/stencil buffer */
+      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
       zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-      zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      if (is_1d) {
+         zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      }
+      else {
+         zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+         zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+         zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      }
    }
 
    *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
@@ -646,6 +693,93 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    lp_build_name(*z_fb, "z_dst");
 }
 
+/**
+ * Store a whole 4x4 block of depth/stencil values held in a 16-wide
+ * vector (two 8-wide halves, each swizzled as 2x2 quads), one row at a time.
+ */
+static void
+lp_build_depth_stencil_write_rows(struct gallivm_state *gallivm,
+                                  struct lp_type z_src_type,
+                                  const struct util_format_description *format_desc,
+                                  LLVMValueRef mask_value,
+                                  LLVMValueRef z_fb,
+                                  LLVMValueRef s_fb,
+                                  LLVMValueRef depth_ptr,
+                                  LLVMValueRef depth_stride,
+                                  LLVMValueRef z_value,
+                                  LLVMValueRef s_value)
+{
+   struct lp_build_context z_bld;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH / 2];
+   struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
+   struct lp_type z_type = zs_type;
+   struct lp_type row_type = zs_type;
+   LLVMTypeRef row_ptr_type;
+   unsigned i, row;
+
+   row_type.length = 4;
+   row_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0);
+
+   z_type.width = z_src_type.width;
+   lp_build_context_init(&z_bld, gallivm, z_type);
+
+   if (format_desc->block.bits > 32) {
+      s_value = LLVMBuildBitCast(builder, s_value, z_bld.vec_type, "");
+   }
+
+   if (mask_value) {
+      z_value = lp_build_select(&z_bld, mask_value, z_value, z_fb);
+      if (format_desc->block.bits > 32) {
+         s_fb = LLVMBuildBitCast(builder, s_fb, z_bld.vec_type, "");
+         s_value = lp_build_select(&z_bld, mask_value, s_value, s_fb);
+      }
+   }
+
+   if (zs_type.width < z_src_type.width) {
+      /* Truncate ZS values (e.g., when writing to Z16_UNORM) */
+      z_value = LLVMBuildTrunc(builder, z_value,
+                               lp_build_int_vec_type(gallivm, zs_type), "");
+   }
+
+   for (row = 0; row < 4; row++) {
+      LLVMValueRef row_offset, row_ptr, row_val;
+
+      /*
+       * Memory position (x, y) lives in lane (x&1) + (y&1)*2 + (x&2)*2 +
+       * (y&2)*4, which is the same swizzle as used for loading.
+       */
+      for (i = 0; i < 4; i++) {
+         unsigned m = row * 4 + i;
+         unsigned lane = (m&1) + (m&2) * 2 + (m&4) / 2 + (m&8);
+         if (format_desc->block.bits <= 32) {
+            shuffles[i] = lp_build_const_int32(gallivm, lane);
+         }
+         else {
+            shuffles[i*2] = lp_build_const_int32(gallivm, lane);
+            shuffles[i*2+1] = lp_build_const_int32(gallivm, lane + z_src_type.length);
+         }
+      }
+
+      if (format_desc->block.bits <= 32) {
+         row_val = LLVMBuildShuffleVector(builder, z_value, z_value,
+                                          LLVMConstVector(shuffles, 4), "");
+      }
+      else {
+         row_val = LLVMBuildShuffleVector(builder, z_value, s_value,
+                                          LLVMConstVector(shuffles, 8), "");
+         row_val = LLVMBuildBitCast(builder, row_val,
+                                    lp_build_vec_type(gallivm, row_type), "");
+      }
+
+      row_offset = LLVMBuildMul(builder, depth_stride,
+                                lp_build_const_int32(gallivm, row), "");
+      row_ptr = LLVMBuildGEP(builder, depth_ptr, &row_offset, 1, "");
+      row_ptr = LLVMBuildBitCast(builder, row_ptr, row_ptr_type, "");
+      LLVMBuildStore(builder, row_val, row_ptr);
+   }
+}
+
 /**
  * Store depth/stencil values.
  * Incoming values are swizzled (typically n 2x2 quads), stored linear.
@@ -711,11 +845,10 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
                                    lp_build_const_int32(gallivm, depth_bytes * 2), "");
       depth_offset1 = LLVMBuildAdd(builder, depth_offset1, offset2, "");
    }
-   else {
+   else if (z_src_type.length == 8) {
       unsigned i;
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
        * We load 2x4 values, and need to swizzle them (order
@@ -725,6 +858,16 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
          shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
       }
    }
+   else {
+      assert(z_src_type.length == 16);
+      assert(!is_1d);
+      /* The whole 4x4 block is written at once, row by row. */
+      lp_build_depth_stencil_write_rows(gallivm, z_src_type, format_desc,
+                                        mask_value, z_fb, s_fb,
+                                        depth_ptr, depth_stride,
+                                        z_value, s_value);
+      return;
+   }
 
    depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
 
@@ -757,7 +900,6 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
          zs_dst2 = lp_build_extract_range(gallivm, z_value, 2, 2);
       }
       else {
-         assert(z_src_type.length == 8);
          zs_dst1 = LLVMBuildShuffleVector(builder, z_value, z_value,
                                           LLVMConstVector(&shuffles[0],
                                                           zs_load_type.length), "");
@@ -776,7 +918,6 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
       else {
          unsigned i;
          LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH / 2];
-         assert(z_src_type.length == 8);
          for (i = 0; i < 8; i++) {
             shuffles[i*2] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
             shuffles[i*2+1] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2 +
@@ -46,6 +46,7 @@
 #include "lp_surface.h"
 #include "lp_query.h"
 #include "lp_setup.h"
+#include "lp_screen.h"
 
 /* This is only safe if there's just one concurrent context */
 #ifdef EMBEDDED_DEVICE
@@ -59,6 +60,11 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
 
    lp_print_counters();
 
+   if (llvmpipe->fs_async_compile) {
+      util_queue_finish(&llvmpipe->fs_compile_queue);
+      util_queue_destroy(&llvmpipe->fs_compile_queue);
+   }
+
    if (llvmpipe->csctx) {
       lp_csctx_destroy(llvmpipe->csctx);
    }
@@ -137,6 +143,24 @@ llvmpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
    llvmpipe_flush(pipe, NULL, __FUNCTION__);
 }
 
+static void
+lp_draw_disk_cache_find_shader(void *cookie,
+                               struct lp_cached_code *cache,
+                               unsigned char ir_sha1_cache_key[20])
+{
+   struct llvmpipe_screen *screen = cookie;
+   lp_disk_cache_find_shader(screen, cache, ir_sha1_cache_key);
+}
+
+static void
+lp_draw_disk_cache_insert_shader(void *cookie,
+                                 struct lp_cached_code *cache,
+                                 unsigned char ir_sha1_cache_key[20])
+{
+   struct llvmpipe_screen *screen = cookie;
+   lp_disk_cache_insert_shader(screen, cache, ir_sha1_cache_key);
+}
+
 struct pipe_context *
 llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                         unsigned flags)
@@ -152,6 +176,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    make_empty_list(&llvmpipe->fs_variants_list);
+   make_empty_list(&llvmpipe->fs_pending_variants_list);
 
    make_empty_list(&llvmpipe->setup_variants_list);
 
@@ -194,6 +219,18 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->context)
       goto fail;
 
+#ifndef USE_GLOBAL_LLVM_CONTEXT
+   /*
+    * Compile fragment shader variants in the background, rendering with
+    * a generic variant until the specialized one is ready.
+    */
+   if (debug_get_bool_option("LP_ASYNC_COMPILE", FALSE) &&
+       util_queue_init(&llvmpipe->fs_compile_queue, "lpfs", 32, 1,
+                       UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                       UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY))
+      llvmpipe->fs_async_compile = TRUE;
+#endif
+
    /*
     * Create drawing context and plug our rendering stage into it.
     */
@@ -202,6 +239,11 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->draw)
       goto fail;
 
+   draw_set_disk_cache_callbacks(llvmpipe->draw,
+                                 llvmpipe_screen(screen),
+                                 lp_draw_disk_cache_find_shader,
+                                 lp_draw_disk_cache_insert_shader);
+
    /* FIXME: devise alternative to draw_texture_samplers */
 
    llvmpipe->setup = lp_setup_create( &llvmpipe->pipe,
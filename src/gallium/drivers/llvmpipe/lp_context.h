@@ -150,12 +150,21 @@ struct llvmpipe_context {
    struct blitter_context *blitter;
 
    unsigned tex_timestamp;
+   unsigned cs_tex_timestamp;
 
    /** List of all fragment shader variants */
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Background fragment shader variant compilation (LP_ASYNC_COMPILE) */
+   boolean fs_async_compile;
+   struct util_queue fs_compile_queue;
+   /** Variants still being compiled in the background */
+   struct lp_fs_variant_list_item fs_pending_variants_list;
+   /** Variant being compiled while a less specialized stand-in is bound */
+   struct lp_fragment_shader_variant *fs_wanted_variant;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
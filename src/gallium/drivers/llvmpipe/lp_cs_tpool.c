@@ -82,6 +82,15 @@ lp_cs_tpool_create(unsigned num_threads)
 
    list_inithead(&pool->workqueue);
    assert (num_threads <= LP_MAX_THREADS);
+   if (num_threads) {
+      pool->threads = CALLOC(num_threads, sizeof(thrd_t));
+      if (!pool->threads) {
+         cnd_destroy(&pool->new_work);
+         mtx_destroy(&pool->m);
+         FREE(pool);
+         return NULL;
+      }
+   }
    pool->num_threads = num_threads;
    for (unsigned i = 0; i < num_threads; i++)
       pool->threads[i] = u_thread_create(lp_cs_tpool_worker, pool);
@@ -105,6 +114,7 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
 
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -66,6 +66,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       return;
    }
 
+   /* Retire fragment shader variants compiled in the background */
+   llvmpipe_poll_fs_variants(lp);
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
@@ -66,7 +66,23 @@
 
 #define LP_MAX_SAMPLES 4
 
-#define LP_MAX_THREADS 16
+/**
+ * Sanity limit for the number of rasterizer threads.  The per-thread
+ * state is allocated at runtime for the actual number of threads.
+ */
+#define LP_MAX_THREADS 1024
+
+/**
+ * Max number of NUMA nodes the rasterizer distributes its threads and
+ * bins over.
+ */
+#define LP_MAX_NUMA_NODES 16
+
+/**
+ * Max number of scenes per context.  A context bins into one scene while
+ * the rasterizer threads work on the others it has queued.
+ */
+#define LP_MAX_SCENES 16
 
 
 /**
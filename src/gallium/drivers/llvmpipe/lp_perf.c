@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include "util/u_debug.h"
+#include "util/u_memory.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 
@@ -33,11 +34,44 @@
 
 struct lp_counters lp_count;
 
+struct lp_thread_counters *lp_thread_count;
+unsigned lp_num_thread_counters;
+
 
 void
 lp_reset_counters(void)
 {
    memset(&lp_count, 0, sizeof(lp_count));
+   if (lp_thread_count) {
+      memset(lp_thread_count, 0,
+             lp_num_thread_counters * sizeof(*lp_thread_count));
+   }
+}
+
+
+/**
+ * Make room for the counters of num_threads rasterizer threads.
+ * Only does something in debug builds when counters are enabled.
+ */
+void
+lp_init_thread_counters(unsigned num_threads)
+{
+   struct lp_thread_counters *counters;
+
+   if (!(LP_DEBUG & DEBUG_COUNTERS) ||
+       num_threads <= lp_num_thread_counters)
+      return;
+
+   counters = REALLOC(lp_thread_count,
+                      lp_num_thread_counters * sizeof(*counters),
+                      num_threads * sizeof(*counters));
+   if (!counters)
+      return;
+
+   memset(counters + lp_num_thread_counters, 0,
+          (num_threads - lp_num_thread_counters) * sizeof(*counters));
+   lp_thread_count = counters;
+   lp_num_thread_counters = num_threads;
 }
 
 
@@ -106,5 +140,16 @@ lp_print_counters(void)
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      for (unsigned i = 0; i < lp_num_thread_counters; i++) {
+         const struct lp_thread_counters *tc = &lp_thread_count[i];
+         int64_t total = tc->busy_time + tc->idle_time;
+
+         debug_printf("llvmpipe: thread %3u: bins %9u (%u stolen), "
+                      "busy %.3f sec, idle %.3f sec (%3.0f%%)\n",
+                      i, tc->nr_bins, tc->nr_stolen_bins,
+                      tc->busy_time / 1000000.0, tc->idle_time / 1000000.0,
+                      total ? 100.0 * tc->idle_time / total : 0.0);
+      }
+
    }
 }
@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "lp_debug.h"
 
 /**
  * Various counters
@@ -68,6 +69,35 @@ struct lp_counters
 extern struct lp_counters lp_count;
 
 
+/**
+ * Per rasterizer thread counters, to check how evenly the bins of the
+ * scenes are spread over the threads.
+ */
+struct lp_thread_counters
+{
+   unsigned nr_bins;         /**< bins rasterized */
+   unsigned nr_stolen_bins;  /**< bins taken from other threads */
+   int64_t busy_time;        /**< time spent rasterizing, in microseconds */
+   int64_t idle_time;        /**< time spent waiting for the other threads
+                              *   to finish the scene, in microseconds */
+};
+
+
+extern struct lp_thread_counters *lp_thread_count;
+extern unsigned lp_num_thread_counters;
+
+
+/** Add to the named counter of a rasterizer thread (only with
+ * LP_DEBUG=counters in debug builds)
+ */
+#define LP_THREAD_COUNT_ADD(thread, counter, incr)                      \
+   do {                                                                 \
+      if ((LP_DEBUG & DEBUG_COUNTERS) &&                                \
+          (thread) < lp_num_thread_counters)                            \
+         lp_thread_count[thread].counter += (incr);                     \
+   } while (0)
+
+
 /** Increment the named counter (only for debug builds) */
 #ifdef DEBUG
 #define LP_COUNT(counter) lp_count.counter++
@@ -84,6 +114,10 @@ extern void
 lp_reset_counters(void);
 
 
+extern void
+lp_init_thread_counters(unsigned num_threads);
+
+
 extern void
 lp_print_counters(void);
 
@@ -53,13 +53,18 @@ llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
    assert(type < PIPE_QUERY_TYPES);
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* the per-thread counters follow the query */
+   pq = CALLOC(1, sizeof *pq + 2 * num_threads * sizeof(uint64_t));
 
    if (pq) {
+      pq->start = (uint64_t *)(pq + 1);
+      pq->end = pq->start + num_threads;
       pq->type = type;
       pq->index = index;
    }
@@ -349,6 +354,8 @@ static bool
 llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
    /* Check if the query is already in the scene.  If so, we need to
@@ -359,9 +366,16 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __FUNCTION__);
    }
 
+   /* An issued scene may still be queued behind others, don't clear the
+    * counters under the rasterizer threads' feet.
+    */
+   if (pq->fence && !lp_fence_signalled(pq->fence)) {
+      lp_fence_wait(pq->fence);
+   }
+
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, num_threads * sizeof(*pq->start));
+   memset(pq->end, 0, num_threads * sizeof(*pq->end));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -33,8 +33,10 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_atomic.h"
 #include "util/u_memset.h"
 #include "util/os_time.h"
+#include "util/detect_os.h"
 
 #include "lp_scene_queue.h"
 #include "lp_context.h"
@@ -61,6 +63,140 @@ const float lp_sample_pos_4x[4][2] = { { 0.375, 0.125 },
                                        { 0.125, 0.625 },
                                        { 0.625, 0.875 } };
 
+/* An empty bin is one that just loads the contents of the tile and
+ * stores them again unchanged.  This typically happens when bins have
+ * been flushed for some reason in the middle of a frame, or when
+ * incremental updates are being made to a render target.
+ * 
+ * Try to avoid doing pointless work in this case.
+ */
+static boolean
+is_empty_bin( const struct cmd_bin *bin )
+{
+   return bin->head == NULL;
+}
+
+
+static inline uint64_t
+pack_deque(unsigned head, unsigned tail)
+{
+   return (uint64_t)tail << 32 | head;
+}
+
+
+/**
+ * Distribute the non-empty bins of the scene over the threads' deques.
+ *
+ * Each NUMA node gets the bins of a band of tile rows, which are split
+ * into contiguous runs of about equal estimated cost for the threads of
+ * the node.  Keeping the runs contiguous keeps neighbouring tiles, which
+ * tend to share textures and state, on the same thread; stealing then
+ * evens out what the cost estimate got wrong.
+ */
+static void
+seed_bin_deques(struct lp_rasterizer *rast,
+                struct lp_scene *scene)
+{
+   unsigned num_tasks = MAX2(1, rast->num_threads);
+   unsigned first_task = 0;
+   unsigned num_bins = 0;
+   unsigned node;
+
+   for (node = 0; node < rast->num_nodes; node++) {
+      unsigned row_begin = node * scene->tiles_y / rast->num_nodes;
+      unsigned row_end = (node + 1) * scene->tiles_y / rast->num_nodes;
+      unsigned band_begin = num_bins;
+      uint64_t total_cost = 0, cost = 0;
+      unsigned end_task, t, i, x, y;
+
+      for (end_task = first_task; end_task < num_tasks; end_task++) {
+         if (rast->tasks[end_task].node != node)
+            break;
+      }
+
+      for (y = row_begin; y < row_end; y++) {
+         for (x = 0; x < scene->tiles_x; x++) {
+            const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+            if (!is_empty_bin(bin)) {
+               rast->bins[num_bins++] = y * scene->tiles_x + x;
+               total_cost += lp_scene_bin_cost(bin);
+            }
+         }
+      }
+
+      /* Split the band at cost (k+1) * total / n for the k-th thread */
+      i = band_begin;
+      for (t = first_task; t < end_task; t++) {
+         unsigned head = i;
+         uint64_t limit = total_cost * (t - first_task + 1) /
+                          (end_task - first_task);
+
+         while (i < num_bins && (cost < limit || t == end_task - 1)) {
+            unsigned index = rast->bins[i];
+            cost += lp_scene_bin_cost(lp_scene_get_bin(scene,
+                                                       index % scene->tiles_x,
+                                                       index / scene->tiles_x));
+            i++;
+         }
+
+         rast->tasks[t].deque = pack_deque(head, i);
+      }
+
+      first_task = end_task;
+   }
+}
+
+
+/**
+ * Take the next bin from the head of the task's own deque, or steal one
+ * from the tail of another thread's deque.
+ * \return the bin index, or -1 when no work is left
+ */
+static int
+get_next_bin(struct lp_rasterizer_task *task)
+{
+   struct lp_rasterizer *rast = task->rast;
+   unsigned num_tasks = MAX2(1, rast->num_threads);
+   uint64_t old, cur;
+   unsigned i;
+
+   /* Pop from our own deque */
+   cur = p_atomic_read(&task->deque);
+   for (;;) {
+      unsigned head = (unsigned)cur, tail = (unsigned)(cur >> 32);
+      if (head >= tail)
+         break;
+      old = cur;
+      cur = p_atomic_cmpxchg(&task->deque, old, pack_deque(head + 1, tail));
+      if (cur == old)
+         return rast->bins[head];
+   }
+
+   /* Steal from the others, starting with our neighbours, which are
+    * normally on the same NUMA node.
+    */
+   for (i = 1; i < num_tasks; i++) {
+      struct lp_rasterizer_task *victim =
+         &rast->tasks[(task->thread_index + i) % num_tasks];
+
+      cur = p_atomic_read(&victim->deque);
+      for (;;) {
+         unsigned head = (unsigned)cur, tail = (unsigned)(cur >> 32);
+         if (head >= tail)
+            break;
+         old = cur;
+         cur = p_atomic_cmpxchg(&victim->deque, old, pack_deque(head, tail - 1));
+         if (cur == old) {
+            LP_THREAD_COUNT_ADD(task->thread_index, nr_stolen_bins, 1);
+            return rast->bins[tail - 1];
+         }
+      }
+   }
+
+   return -1;
+}
+
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -69,20 +205,29 @@ static void
 lp_rast_begin( struct lp_rasterizer *rast,
                struct lp_scene *scene )
 {
+   unsigned i;
+
    rast->curr_scene = scene;
 
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
+   /* Wait for the fragment shaders still being compiled in the background */
+   for (i = 0; i < scene->num_pending_fs_variants; i++)
+      util_queue_fence_wait(&scene->pending_fs_variants[i]->ready);
+
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   seed_bin_deques( rast, scene );
 }
 
 
+/**
+ * The scene itself is only cleaned up by the setup module once it wants
+ * to reuse it, after waiting on its fence, so that the context doesn't
+ * have to wait for the rasterizer after queuing each scene.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
-
    rast->curr_scene = NULL;
 }
 
@@ -327,6 +472,10 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   /* the background compile of the variant failed */
+   if (!variant->jit_function[RAST_WHOLE])
+      return;
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
@@ -435,6 +584,10 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
 
    assert(state);
 
+   /* the background compile of the variant failed */
+   if (!variant->jit_function[RAST_EDGE_TEST])
+      return;
+
    /* Sanity checks */
    assert(x < scene->tiles_x * TILE_SIZE);
    assert(y < scene->tiles_y * TILE_SIZE);
@@ -691,20 +844,6 @@ rasterize_bin(struct lp_rasterizer_task *task,
 }
 
 
-/* An empty bin is one that just loads the contents of the tile and
- * stores them again unchanged.  This typically happens when bins have
- * been flushed for some reason in the middle of a frame, or when
- * incremental updates are being made to a render target.
- * 
- * Try to avoid doing pointless work in this case.
- */
-static boolean
-is_empty_bin( const struct cmd_bin *bin )
-{
-   return bin->head == NULL;
-}
-
-
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -729,14 +868,25 @@ rasterize_scene(struct lp_rasterizer_task *task,
    if (!task->rast->no_rast) {
       /* loop over scene bins, rasterize each */
       {
-         struct cmd_bin *bin;
-         int i, j;
+         int64_t t0 = 0;
+         int index;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin( bin ))
-               rasterize_bin(task, bin, i, j);
+
+         if (LP_DEBUG & DEBUG_COUNTERS)
+            t0 = os_time_get();
+
+         while ((index = get_next_bin(task)) >= 0) {
+            int i = index % scene->tiles_x;
+            int j = index / scene->tiles_x;
+            rasterize_bin(task, lp_scene_get_bin(scene, i, j), i, j);
+
+            LP_THREAD_COUNT_ADD(task->thread_index, nr_bins, 1);
          }
+
+         if (LP_DEBUG & DEBUG_COUNTERS)
+            LP_THREAD_COUNT_ADD(task->thread_index, busy_time,
+                                os_time_get() - t0);
       }
    }
 
@@ -807,29 +957,12 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
-void
-lp_rast_finish( struct lp_rasterizer *rast )
-{
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
-   }
-}
-
-
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
- *   3. signal that we're done
+ *   3. signal that we're done, through the scene's fence
  */
 static int
 thread_function(void *init_data)
@@ -880,7 +1013,15 @@ thread_function(void *init_data)
                       rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
-      util_barrier_wait( &rast->barrier );
+      if (LP_DEBUG & DEBUG_COUNTERS) {
+         int64_t t0 = os_time_get();
+         util_barrier_wait( &rast->barrier );
+         LP_THREAD_COUNT_ADD(task->thread_index, idle_time,
+                             os_time_get() - t0);
+      }
+      else {
+         util_barrier_wait( &rast->barrier );
+      }
 
       /* XXX: shouldn't be necessary:
        */
@@ -888,11 +1029,8 @@ thread_function(void *init_data)
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -903,6 +1041,136 @@ thread_function(void *init_data)
 }
 
 
+#if defined(HAVE_PTHREAD_SETAFFINITY) && DETECT_OS_LINUX
+
+/**
+ * Parse a sysfs cpulist such as "0-15,32-47" into a CPU set.
+ */
+static void
+parse_cpulist(const char *list, cpu_set_t *cpus)
+{
+   const char *p = list;
+
+   CPU_ZERO(cpus);
+   while (*p) {
+      char *end;
+      unsigned long first, last, cpu;
+
+      first = strtoul(p, &end, 10);
+      if (end == p)
+         break;
+      last = first;
+      if (*end == '-')
+         last = strtoul(end + 1, &end, 10);
+      for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+         CPU_SET(cpu, cpus);
+      if (*end != ',')
+         break;
+      p = end + 1;
+   }
+}
+
+
+/**
+ * Get the CPUs of each NUMA node we may run on.
+ * \return the number of nodes, or 0 if the topology isn't known
+ */
+static unsigned
+get_numa_nodes(cpu_set_t *node_cpus, unsigned max_nodes)
+{
+   cpu_set_t allowed;
+   unsigned num_nodes = 0;
+   unsigned n;
+
+   if (pthread_getaffinity_np(pthread_self(), sizeof allowed, &allowed) != 0)
+      return 0;
+
+   for (n = 0; num_nodes < max_nodes; n++) {
+      char path[64];
+      char list[4096];
+      FILE *f;
+
+      snprintf(path, sizeof path, "/sys/devices/system/node/node%u/cpulist", n);
+      f = fopen(path, "r");
+      if (!f)
+         break;
+      if (!fgets(list, sizeof list, f)) {
+         fclose(f);
+         break;
+      }
+      fclose(f);
+
+      parse_cpulist(list, &node_cpus[num_nodes]);
+      CPU_AND(&node_cpus[num_nodes], &node_cpus[num_nodes], &allowed);
+
+      /* skip nodes without CPUs (memory-only) or outside our affinity */
+      if (CPU_COUNT(&node_cpus[num_nodes]) > 0)
+         num_nodes++;
+   }
+
+   return num_nodes;
+}
+
+#endif
+
+
+/**
+ * Spread the rasterizer tasks evenly over the NUMA nodes, each node
+ * getting a contiguous range of thread indices.
+ */
+static void
+assign_rast_nodes(struct lp_rasterizer *rast)
+{
+   unsigned i;
+
+   rast->num_nodes = 1;
+
+#if defined(HAVE_PTHREAD_SETAFFINITY) && DETECT_OS_LINUX
+   if (rast->num_threads > 1 &&
+       !debug_get_bool_option("LP_NO_NUMA", FALSE)) {
+      cpu_set_t node_cpus[LP_MAX_NUMA_NODES];
+      unsigned num_nodes = get_numa_nodes(node_cpus, LP_MAX_NUMA_NODES);
+
+      if (num_nodes > 1) {
+         rast->num_nodes = MIN2(num_nodes, rast->num_threads);
+         for (i = 0; i < rast->num_threads; i++)
+            rast->tasks[i].node = i * rast->num_nodes / rast->num_threads;
+         return;
+      }
+   }
+#endif
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++)
+      rast->tasks[i].node = 0;
+}
+
+
+/**
+ * Pin each rasterizer thread to the CPUs of its NUMA node, so the tiles
+ * of its band of bins, and the framebuffer pages behind them, stay local
+ * to the node from scene to scene.
+ */
+static void
+pin_rast_threads(struct lp_rasterizer *rast)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY) && DETECT_OS_LINUX
+   cpu_set_t node_cpus[LP_MAX_NUMA_NODES];
+   unsigned i;
+
+   if (rast->num_nodes <= 1)
+      return;
+
+   if (get_numa_nodes(node_cpus, LP_MAX_NUMA_NODES) < rast->num_nodes)
+      return;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pthread_setaffinity_np(rast->threads[i], sizeof(cpu_set_t),
+                             &node_cpus[rast->tasks[i].node]);
+   }
+#endif
+}
+
+
 /**
  * Initialize semaphores and spawn the threads.
  */
@@ -930,9 +1198,10 @@ create_rast_threads(struct lp_rasterizer *rast)
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
  * \param num_threads  number of rasterizer threads to create
+ * \param num_scenes  number of scenes that may be queued at once
  */
 struct lp_rasterizer *
-lp_rast_create( unsigned num_threads )
+lp_rast_create( unsigned num_threads, unsigned num_scenes )
 {
    struct lp_rasterizer *rast;
    unsigned i;
@@ -942,7 +1211,24 @@ lp_rast_create( unsigned num_threads )
       goto no_rast;
    }
 
-   rast->full_scenes = lp_scene_queue_create();
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof *rast->tasks);
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads > 0) {
+      rast->threads = CALLOC(num_threads, sizeof *rast->threads);
+      if (!rast->threads) {
+         goto no_threads;
+      }
+   }
+
+   rast->bins = MALLOC(TILES_X * TILES_Y * sizeof *rast->bins);
+   if (!rast->bins) {
+      goto no_bins;
+   }
+
+   rast->full_scenes = lp_scene_queue_create(num_scenes);
    if (!rast->full_scenes) {
       goto no_full_scenes;
    }
@@ -962,8 +1248,14 @@ lp_rast_create( unsigned num_threads )
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+   lp_init_thread_counters(MAX2(1, num_threads));
+
+   assign_rast_nodes(rast);
+
    create_rast_threads(rast);
 
+   pin_rast_threads(rast);
+
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
       util_barrier_init( &rast->barrier, rast->num_threads );
@@ -974,7 +1266,7 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
@@ -982,6 +1274,12 @@ no_thread_data_cache:
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
+   FREE(rast->bins);
+no_bins:
+   FREE(rast->threads);
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    FREE(rast);
 no_rast:
    return NULL;
@@ -1030,6 +1328,9 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->bins);
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
@@ -68,6 +68,8 @@ struct cmd_bin;
 
 #define LP_MAX_ACTIVE_BINNED_QUERIES 64
 
+#define LP_MAX_PENDING_FS_VARIANTS 16
+
 #define IMUL64(a, b) (((int64_t)(a)) * ((int64_t)(b)))
 
 struct lp_rasterizer_task;
@@ -158,7 +160,7 @@ struct lp_rast_clear_rb {
 
 
 struct lp_rasterizer *
-lp_rast_create( unsigned num_threads );
+lp_rast_create( unsigned num_threads, unsigned num_scenes );
 
 void
 lp_rast_destroy( struct lp_rasterizer * );
@@ -167,9 +169,6 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
-void
-lp_rast_finish( struct lp_rasterizer *rast );
-
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
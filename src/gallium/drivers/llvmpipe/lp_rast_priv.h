@@ -97,6 +97,17 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** NUMA node the thread runs on */
+   unsigned node;
+
+   /**
+    * The thread's deque of bins to rasterize, as a range [head, tail) of
+    * lp_rasterizer::bins packed into one word so that the owner (popping
+    * at the head) and thieves (stealing at the tail) can update it with a
+    * single compare-and-swap.
+    */
+   uint64_t deque;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -121,11 +132,17 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread (at least one) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
+
+   /** Number of NUMA nodes the threads are spread over */
+   unsigned num_nodes;
+
+   /** Indices of the non-empty bins of the current scene, see deque */
+   unsigned *bins;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
@@ -62,8 +62,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +88,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -301,6 +298,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    scene->resources = NULL;
    scene->scene_size = 0;
    scene->resource_reference_size = 0;
+   scene->num_pending_fs_variants = 0;
 
    scene->alloc_failed = FALSE;
 
@@ -434,6 +432,30 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 }
 
 
+/**
+ * Make the rasterizer wait for a fragment shader variant which is still
+ * being compiled in the background before running the scene.
+ * Returns FALSE if the scene can't wait for any more variants.
+ */
+boolean
+lp_scene_add_pending_fs_variant(struct lp_scene *scene,
+                                struct lp_fragment_shader_variant *variant)
+{
+   unsigned i;
+
+   for (i = 0; i < scene->num_pending_fs_variants; i++) {
+      if (scene->pending_fs_variants[i] == variant)
+         return TRUE;
+   }
+
+   if (scene->num_pending_fs_variants >= LP_MAX_PENDING_FS_VARIANTS)
+      return FALSE;
+
+   scene->pending_fs_variants[scene->num_pending_fs_variants++] = variant;
+   return TRUE;
+}
+
+
 /**
  * Does this scene have a reference to the given resource?
  */
@@ -454,66 +476,26 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-
-
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
-{
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
-}
-
-
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
-{
-   scene->curr_x = scene->curr_y = -1;
-}
-
-
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Does this scene render into the given resource?
  */
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+boolean
+lp_scene_is_fb_referenced(const struct lp_scene *scene,
+                          const struct pipe_resource *resource)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned i;
 
-   mtx_lock(&scene->mutex);
-
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         return TRUE;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
-
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return scene->fb.zsbuf && scene->fb.zsbuf->texture == resource;
 }
 
 
+
+
 void lp_scene_begin_binning(struct lp_scene *scene,
                             struct pipe_framebuffer_state *fb)
 {
@@ -41,6 +41,7 @@
 
 struct lp_scene_queue;
 struct lp_rast_state;
+struct lp_fragment_shader_variant;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
  * Will need a 64-bit version for larger framebuffers.
@@ -122,8 +123,8 @@ struct resource_ref;
  * Per-bin data goes into the 'tile' bins.
  * Shared data goes into the 'data' buffer.
  *
- * When there are multiple threads, will want to double-buffer between
- * scenes:
+ * Each setup context owns a small ring of scenes so that it can bin
+ * into one while the rasterizer threads work on the others.
  */
 struct lp_scene {
    struct pipe_context *pipe;
@@ -135,6 +136,12 @@ struct lp_scene {
    /* If queries were either active or there were begin/end query commands */
    boolean had_queries;
 
+   /* Fragment shader variants still compiling in the background, which
+    * the rasterizer waits for before running the scene.
+    */
+   struct lp_fragment_shader_variant *pending_fs_variants[LP_MAX_PENDING_FS_VARIANTS];
+   unsigned num_pending_fs_variants;
+
    /* Framebuffer mappings - valid only between begin_rasterization()
     * and end_rasterization().
     */
@@ -180,8 +187,6 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -206,9 +211,15 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
                                         boolean initializing_scene);
 
+boolean lp_scene_add_pending_fs_variant(struct lp_scene *scene,
+                                        struct lp_fragment_shader_variant *variant);
+
 boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
+boolean lp_scene_is_fb_referenced(const struct lp_scene *scene,
+                                  const struct pipe_resource *resource);
+
 
 /**
  * Allocate space for a command/data in the bin's data buffer.
@@ -385,11 +396,20 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+/**
+ * Estimated cost of rasterizing a bin, as the number of commands in it.
+ */
+static inline unsigned
+lp_scene_bin_cost( const struct cmd_bin *bin )
+{
+   const struct cmd_block *block;
+   unsigned cost = 0;
 
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+   for (block = bin->head; block; block = block->next)
+      cost += block->count;
+
+   return cost;
+}
 
 
 
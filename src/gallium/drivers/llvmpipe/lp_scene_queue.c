@@ -39,16 +39,13 @@
 
 
 
-#define SCENE_QUEUE_SIZE 4
-
-
-
 /**
  * A queue of scenes
  */
 struct lp_scene_queue
 {
-   struct lp_scene *scenes[SCENE_QUEUE_SIZE];
+   struct lp_scene **scenes;
+   unsigned size;
 
    mtx_t mutex;
    cnd_t change;
@@ -63,19 +60,27 @@ struct lp_scene_queue
 
 
 
-/** Allocate a new scene queue */
+/**
+ * Allocate a new scene queue.
+ * \param size  number of scenes the queue holds before lp_scene_enqueue()
+ *              blocks, rounded up to a power of two
+ */
 struct lp_scene_queue *
-lp_scene_queue_create(void)
+lp_scene_queue_create(unsigned size)
 {
-   /* Circular queue behavior depends on size being a power of two. */
-   STATIC_ASSERT(SCENE_QUEUE_SIZE > 0);
-   STATIC_ASSERT((SCENE_QUEUE_SIZE & (SCENE_QUEUE_SIZE - 1)) == 0);
-
    struct lp_scene_queue *queue = CALLOC_STRUCT(lp_scene_queue);
 
    if (!queue)
       return NULL;
 
+   /* Circular queue behavior depends on size being a power of two. */
+   queue->size = util_next_power_of_two(MAX2(size, 1));
+   queue->scenes = CALLOC(queue->size, sizeof *queue->scenes);
+   if (!queue->scenes) {
+      FREE(queue);
+      return NULL;
+   }
+
    (void) mtx_init(&queue->mutex, mtx_plain);
    cnd_init(&queue->change);
 
@@ -89,6 +94,7 @@ lp_scene_queue_destroy(struct lp_scene_queue *queue)
 {
    cnd_destroy(&queue->change);
    mtx_destroy(&queue->mutex);
+   FREE(queue->scenes);
    FREE(queue);
 }
 
@@ -110,7 +116,7 @@ lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait)
       }
    }
 
-   struct lp_scene *scene = queue->scenes[queue->head++ % SCENE_QUEUE_SIZE];
+   struct lp_scene *scene = queue->scenes[queue->head++ % queue->size];
 
    cnd_signal(&queue->change);
    mtx_unlock(&queue->mutex);
@@ -126,10 +132,10 @@ lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
    mtx_lock(&queue->mutex);
 
    /* Wait for free space. */
-   while (queue->tail - queue->head >= SCENE_QUEUE_SIZE)
+   while (queue->tail - queue->head >= queue->size)
       cnd_wait(&queue->change, &queue->mutex);
 
-   queue->scenes[queue->tail++ % SCENE_QUEUE_SIZE] = scene;
+   queue->scenes[queue->tail++ % queue->size] = scene;
 
    cnd_signal(&queue->change);
    mtx_unlock(&queue->mutex);
@@ -36,7 +36,7 @@ struct lp_scene;
 
 
 struct lp_scene_queue *
-lp_scene_queue_create(void);
+lp_scene_queue_create(unsigned size);
 
 void
 lp_scene_queue_destroy(struct lp_scene_queue *queue);
@@ -33,11 +33,15 @@
 #include "util/u_screen.h"
 #include "util/u_string.h"
 #include "util/format/u_format_s3tc.h"
+#include "util/disk_cache.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_nir.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_misc.h"
+#include "gallivm/lp_bld_debug.h"
 
 #include "util/os_misc.h"
 #include "util/os_time.h"
@@ -53,8 +57,10 @@
 #include "lp_cs_tpool.h"
 
 #include "frontend/sw_winsys.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "nir.h"
+#include "nir_serialize.h"
 
 #ifdef DEBUG
 int LP_DEBUG = 0;
@@ -75,6 +81,7 @@ static const struct debug_named_value lp_debug_flags[] = {
    { "cs", DEBUG_CS, NULL },
    { "tgsi_ir", DEBUG_TGSI_IR, NULL },
    { "cl", DEBUG_CL, NULL },
+   { "cache_stats", DEBUG_CACHE_STATS, NULL },
    DEBUG_NAMED_VALUE_END
 };
 #endif
@@ -756,6 +763,27 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
 
 
 
+/**
+ * Wait until the scenes queued so far by all the contexts have been
+ * rasterized.  The rasterizer runs them one after the other, so waiting for
+ * the last one is enough.
+ */
+void
+llvmpipe_screen_finish(struct llvmpipe_screen *screen)
+{
+   struct lp_fence *fence = NULL;
+
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+}
+
+
 static void
 llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
                            struct pipe_resource *resource,
@@ -768,8 +796,13 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* The frontends only flush the context before presenting, and the
+       * scenes rendering to the display target may still be running.
+       */
+      llvmpipe_screen_finish(screen);
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
 }
 
 static void
@@ -784,8 +817,16 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   lp_fence_reference(&screen->last_fence, NULL);
+
    lp_jit_screen_cleanup(screen);
 
+   if (LP_DEBUG & DEBUG_CACHE_STATS)
+      debug_printf("disk shader cache:    hits = %u, misses = %u\n",
+                   screen->num_disk_shader_cache_hits,
+                   screen->num_disk_shader_cache_misses);
+   disk_cache_destroy(screen->disk_shader_cache);
+
    if(winsys->destroy)
       winsys->destroy(winsys);
 
@@ -843,6 +884,118 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cache_id[20 * 2 + 1];
+
+   _mesa_sha1_init(&ctx);
+
+   if (!disk_cache_get_function_identifier(lp_disk_cache_create, &ctx) ||
+       !disk_cache_get_function_identifier(LLVMLinkInMCJIT, &ctx))
+      return;
+
+   /* The generated code also depends on the target CPU and on the options
+    * controlling optimizations and debug code.
+    */
+   lp_build_hash_cpu_target(&ctx);
+   _mesa_sha1_update(&ctx, &lp_native_vector_width, sizeof(lp_native_vector_width));
+   _mesa_sha1_update(&ctx, &lp_fs_vector_width, sizeof(lp_fs_vector_width));
+   _mesa_sha1_update(&ctx, &gallivm_perf, sizeof(gallivm_perf));
+#ifdef DEBUG
+   _mesa_sha1_update(&ctx, &gallivm_debug, sizeof(gallivm_debug));
+   _mesa_sha1_update(&ctx, &LP_DEBUG, sizeof(LP_DEBUG));
+#endif
+   _mesa_sha1_update(&ctx, &LP_PERF, sizeof(LP_PERF));
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", cache_id, 0);
+}
+
+static struct disk_cache *
+llvmpipe_get_disk_shader_cache(struct pipe_screen *_screen)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   return screen->disk_shader_cache;
+}
+
+/**
+ * Look up the object code of a shader variant in the disk cache.
+ * On a hit cache->data holds the object code afterwards.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+   size_t binary_size;
+   uint8_t *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20, sha1);
+
+   buffer = disk_cache_get(screen->disk_shader_cache, sha1, &binary_size);
+   if (!buffer) {
+      cache->data_size = 0;
+      p_atomic_inc(&screen->num_disk_shader_cache_misses);
+      return;
+   }
+   cache->data_size = binary_size;
+   cache->data = buffer;
+   p_atomic_inc(&screen->num_disk_shader_cache_hits);
+}
+
+/**
+ * Store the object code generated for a shader variant in the disk cache.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20, sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data, cache->data_size, NULL);
+}
+
+/**
+ * Hash the IR of a shader.  Combined with a variant key, this gives the
+ * disk cache key of the variant.  Without a disk cache the hash is never
+ * looked at, so don't bother serializing the shader.
+ */
+void
+lp_disk_cache_hash_shader(struct llvmpipe_screen *screen,
+                          const struct pipe_shader_state *state,
+                          unsigned char ir_sha1[20])
+{
+   if (!screen->disk_shader_cache)
+      return;
+
+   if (state->type == PIPE_SHADER_IR_TGSI) {
+      _mesa_sha1_compute(state->tokens,
+                         tgsi_num_tokens(state->tokens) * sizeof(struct tgsi_token),
+                         ir_sha1);
+   } else {
+      struct blob blob;
+
+      blob_init(&blob);
+      nir_serialize(&blob, state->ir.nir, true);
+      _mesa_sha1_compute(blob.data, blob.size, ir_sha1);
+      blob_finish(&blob);
+   }
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -893,6 +1046,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_timestamp = llvmpipe_get_timestamp;
 
    screen->base.finalize_nir = llvmpipe_finalize_nir;
+   screen->base.get_disk_shader_cache = llvmpipe_get_disk_shader_cache;
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
    screen->use_tgsi = (LP_DEBUG & DEBUG_TGSI_IR);
@@ -903,7 +1057,12 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
-   screen->rast = lp_rast_create(screen->num_threads);
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", FALSE);
+
+   screen->num_scenes = debug_get_num_option("LP_NUM_SCENES", 2);
+   screen->num_scenes = CLAMP(screen->num_scenes, 1, LP_MAX_SCENES);
+
+   screen->rast = lp_rast_create(screen->num_threads, screen->num_scenes);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
       FREE(screen);
@@ -920,5 +1079,6 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->cs_mutex, mtx_plain);
 
+   lp_disk_cache_create(screen);
    return &screen->base;
 }
@@ -41,7 +41,11 @@
 
 
 struct sw_winsys;
+struct lp_fence;
 struct lp_cs_tpool;
+struct lp_cached_code;
+struct pipe_shader_state;
+struct disk_cache;
 
 struct llvmpipe_screen
 {
@@ -50,6 +54,9 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_scenes;   /**< scenes per context, see LP_NUM_SCENES */
+
+   boolean tiled_textures;   /**< see LP_TILED_TEXTURES */
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -58,12 +65,33 @@ struct llvmpipe_screen
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
 
+   /** Fence of the last scene queued to rast, protected by rast_mutex */
+   struct lp_fence *last_fence;
+
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
    bool use_tgsi;
+
+   struct disk_cache *disk_shader_cache;
+   unsigned num_disk_shader_cache_hits;
+   unsigned num_disk_shader_cache_misses;
 };
 
+void llvmpipe_screen_finish(struct llvmpipe_screen *screen);
+
+void lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                               struct lp_cached_code *cache,
+                               unsigned char ir_sha1_cache_key[20]);
+
+void lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                                 struct lp_cached_code *cache,
+                                 unsigned char ir_sha1_cache_key[20]);
+
+void lp_disk_cache_hash_shader(struct llvmpipe_screen *screen,
+                               const struct pipe_shader_state *state,
+                               unsigned char ir_sha1[20]);
+
 
 
 
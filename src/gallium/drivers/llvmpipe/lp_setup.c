@@ -70,16 +70,21 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
+   /* The scenes are used round-robin, so this is the oldest one we
+    * queued.  Wait for the rasterizer to finish with it, then release
+    * what it still references.
+    */
    if (setup->scene->fence) {
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
                       __FUNCTION__, setup->scene->fence->id);
 
       lp_fence_wait(setup->scene->fence);
+      lp_scene_end_rasterization(setup->scene);
    }
 
    lp_scene_begin_binning(setup->scene, &setup->fb);
@@ -165,23 +170,16 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer here: we go on binning into the next
+    * scene while the threads work on this one.  The scene is only
+    * recycled, and its resources released, in lp_setup_get_empty_scene()
+    * after waiting for its fence.
     */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&screen->last_fence, scene->fence);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -1082,8 +1080,17 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
    }
 
    /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene != setup->scene && scene->fence &&
+          !lp_fence_signalled(scene->fence)) {
+         /* A queued scene may still write to any buffer it uses */
+         if (lp_scene_is_resource_referenced(scene, texture) ||
+             lp_scene_is_fb_referenced(scene, texture))
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      else if (lp_scene_is_resource_referenced(scene, texture)) {
          return LP_REFERENCED_FOR_READ;
       }
    }
@@ -1298,6 +1305,44 @@ try_update_scene_state( struct lp_setup_context *setup )
                }
             }
          }
+
+         /* Likewise for the shader buffers and images, which must stay
+          * around until the scene is rasterized as it may be queued
+          * behind others.
+          */
+         for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+            if (setup->ssbos[i].current.buffer) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->ssbos[i].current.buffer,
+                                                    new_scene)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+
+         for (i = 0; i < ARRAY_SIZE(setup->images); i++) {
+            if (setup->images[i].current.resource) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->images[i].current.resource,
+                                                    new_scene)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+
+         /* A variant compiled in the background may be bound before it is
+          * ready, the rasterizer then waits for it when starting the scene.
+          */
+         if (setup->fs.current.variant &&
+             !util_queue_fence_is_signalled(&setup->fs.current.variant->ready)) {
+            if (!lp_scene_add_pending_fs_variant(scene,
+                                                 setup->fs.current.variant)) {
+               assert(!new_scene);
+               return FALSE;
+            }
+         }
       }
    }
 
@@ -1417,12 +1462,14 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->ssbos[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   /* wait for the queued scenes and free them all */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
+      if (scene->fence) {
          lp_fence_wait(scene->fence);
+         lp_scene_end_rasterization(scene);
+      }
 
       lp_scene_destroy(scene);
    }
@@ -1459,6 +1506,7 @@ lp_setup_create( struct pipe_context *pipe,
 
 
    setup->num_threads = screen->num_threads;
+   setup->num_scenes = screen->num_scenes;
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1468,7 +1516,7 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_render(draw, &setup->base);
 
    /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       setup->scenes[i] = lp_scene_create( pipe );
       if (!setup->scenes[i]) {
          goto no_scenes;
@@ -1488,7 +1536,7 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       if (setup->scenes[i]) {
          lp_scene_destroy(setup->scenes[i]);
       }
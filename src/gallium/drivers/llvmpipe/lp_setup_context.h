@@ -55,12 +55,6 @@
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
-
-
-
 /**
  * Point/line/triangle setup context.
  * Note: "stored" below indicates data which is stored in the bins,
@@ -88,8 +82,9 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
+   unsigned num_scenes;
    unsigned scene_idx;
-   struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
+   struct lp_scene *scenes[LP_MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
    struct lp_fence *last_fence;
@@ -69,6 +69,8 @@
 #define LP_CSNEW_SSBOS 0x10
 #define LP_CSNEW_IMAGES 0x20
 
+struct lp_static_texture_state;
+
 struct vertex_info;
 struct pipe_context;
 struct llvmpipe_context;
@@ -113,6 +115,9 @@ llvmpipe_set_framebuffer_state(struct pipe_context *,
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp);
 
+void
+llvmpipe_poll_fs_variants(struct llvmpipe_context *lp);
+
 void 
 llvmpipe_update_setup(struct llvmpipe_context *lp);
 
@@ -155,6 +160,10 @@ llvmpipe_init_rasterizer_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_so_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_sampler_static_texture_state(struct lp_static_texture_state *state,
+                                      const struct pipe_sampler_view *view);
+
 void
 llvmpipe_prepare_vertex_sampling(struct llvmpipe_context *ctx,
                                  unsigned num,
@@ -27,6 +27,7 @@
 #include "util/os_time.h"
 #include "util/u_dump.h"
 #include "util/u_string.h"
+#include "util/mesa-sha1.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_parse.h"
 #include "gallivm/lp_bld_const.h"
@@ -92,11 +93,12 @@ generate_compute(struct llvmpipe_context *lp,
    cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    cs_type.width = 32;           /* 32-bit float */
    cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
-   snprintf(func_name, sizeof(func_name), "cs%u_variant%u",
-            shader->no, variant->no);
+   /* The function names must not depend on the shader or variant number,
+    * as the object code may get reused from the disk cache.
+    */
+   snprintf(func_name, sizeof(func_name), "cs_variant");
 
-   snprintf(func_name_coro, sizeof(func_name), "cs_co_%u_variant%u",
-            shader->no, variant->no);
+   snprintf(func_name_coro, sizeof(func_name), "cs_co_variant");
 
    arg_types[0] = variant->jit_cs_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* block_x_size */
@@ -451,6 +453,9 @@ llvmpipe_create_compute_state(struct pipe_context *pipe,
    shader->req_local_mem = templ->req_local_mem;
    make_empty_list(&shader->variants);
 
+   lp_disk_cache_hash_shader(llvmpipe_screen(pipe->screen),
+                             &shader->base, shader->ir_sha1);
+
    nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
    nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
    shader->variant_key_size = Offset(struct lp_compute_shader_variant_key,
@@ -563,8 +568,8 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&key->state[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    }
@@ -572,8 +577,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&key->state[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    }
@@ -657,13 +662,30 @@ lp_debug_cs_variant(const struct lp_compute_shader_variant *variant)
    debug_printf("\n");
 }
 
+static void
+lp_cs_get_ir_cache_key(struct lp_compute_shader *shader,
+                       const struct lp_compute_shader_variant_key *key,
+                       unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_update(&ctx, shader->ir_sha1, sizeof(shader->ir_sha1));
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
 static struct lp_compute_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_compute_shader *shader,
                  const struct lp_compute_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_compute_shader_variant *variant;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
 
    variant = CALLOC_STRUCT(lp_compute_shader_variant);
    if (!variant)
@@ -672,8 +694,14 @@ generate_variant(struct llvmpipe_context *lp,
    snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
             shader->no, shader->variants_created);
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
+   lp_cs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = true;
+
+   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
    if (!variant->gallivm) {
+      free(cached.data);
       FREE(variant);
       return NULL;
    }
@@ -699,6 +727,9 @@ generate_variant(struct llvmpipe_context *lp,
 
    variant->jit_function = (lp_jit_cs_func)gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
    return variant;
 }
@@ -1150,7 +1181,20 @@ update_csctx_ssbo(struct llvmpipe_context *llvmpipe)
 static void
 llvmpipe_cs_update_derived(struct llvmpipe_context *llvmpipe, void *input)
 {
-   if (llvmpipe->cs_dirty & (LP_CSNEW_CS))
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(llvmpipe->pipe.screen);
+
+   /* Check for updated textures, which may have changed layout.
+    */
+   if (llvmpipe->cs_tex_timestamp != lp_screen->timestamp) {
+      llvmpipe->cs_tex_timestamp = lp_screen->timestamp;
+      llvmpipe->cs_dirty |= LP_CSNEW_SAMPLER_VIEW;
+   }
+
+   /* The shader variant key depends on the sampler and image state too */
+   if (llvmpipe->cs_dirty & (LP_CSNEW_CS |
+                             LP_CSNEW_SAMPLER |
+                             LP_CSNEW_SAMPLER_VIEW |
+                             LP_CSNEW_IMAGES))
       llvmpipe_update_cs(llvmpipe);
 
    if (llvmpipe->cs_dirty & LP_CSNEW_CONSTANTS) {
@@ -92,6 +92,9 @@ struct lp_compute_shader {
 
    int max_global_buffers;
    struct pipe_resource **global_buffers;
+
+   /** Hash of the shader IR, for the disk cache keys of the variants */
+   unsigned char ir_sha1[20];
 };
 
 struct lp_cs_exec {
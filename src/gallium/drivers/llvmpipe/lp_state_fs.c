@@ -68,6 +68,7 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -103,6 +104,7 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_screen.h"
 #include "nir/nir_to_tgsi_info.h"
 
 /** Fragment shader number (for debugging) */
@@ -2146,7 +2148,8 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   /* rows are at most 256 bits, also with 16-wide shading */
+   vector_width    = dst_type.floating ? MIN2(lp_native_vector_width, 256) : lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2724,8 +2727,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2772,7 +2774,7 @@ generate_fragment(struct llvmpipe_context *lp,
    const boolean dual_source_blend = key->blend.rt[0].blend_enable &&
                                      util_blend_state_is_dual(&key->blend, 0);
 
-   assert(lp_native_vector_width / 32 >= 4);
+   assert(lp_fs_vector_width / 32 >= 4);
 
    /* Adjust color input interpolation according to flatshade state:
     */
@@ -2798,7 +2800,10 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.sign = TRUE;          /* values are signed */
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
-   fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   fs_type.length = MIN2(lp_fs_vector_width / 32, 16); /* n*4 elements per vector */
+   /* 1d resources only use the upper half of the stamp */
+   if (key->resource_1d)
+      fs_type.length = MIN2(fs_type.length, 8);
 
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
@@ -2816,8 +2821,11 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-            shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* The function name must not depend on the shader or variant number,
+    * as the object code may get reused from the disk cache.
+    */
+   snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+            partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -3103,11 +3111,48 @@ generate_fragment(struct llvmpipe_context *lp,
 
             lp_build_name(out_ptr, "color_ptr%d", cbuf);
 
-            generate_unswizzled_blend(gallivm, cbuf, variant,
-                                      key->cbuf_format[cbuf],
-                                      num_fs, fs_type, &fs_mask[mask_idx], fs_out_color[out_idx],
-                                      context_ptr, out_ptr, stride,
-                                      partial_mask, do_branch);
+            if (fs_type.length > 8) {
+               /*
+                * The blend code works on rows of at most 256 bits, so
+                * hand it the two halves of the 16-wide shader outputs.
+                */
+               struct lp_type half_type = fs_type;
+               LLVMValueRef half_mask[2];
+               LLVMValueRef half_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][4];
+               LLVMTypeRef half_ptr_type;
+               unsigned h;
+
+               assert(num_fs == 1);
+               half_type.length = 8;
+               half_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, half_type), 0);
+               for (h = 0; h < 2; h++) {
+                  LLVMValueRef hidx = lp_build_const_int32(gallivm, h);
+                  half_mask[h] = lp_build_extract_range(gallivm, fs_mask[mask_idx],
+                                                        h * 8, 8);
+                  for (unsigned c = 0; c < PIPE_MAX_COLOR_BUFS; c++) {
+                     if (c != cbuf && !(c == 1 && dual_source_blend))
+                        continue;
+                     for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+                        LLVMValueRef ptr = fs_out_color[out_idx][c][chan][0];
+                        ptr = LLVMBuildBitCast(builder, ptr, half_ptr_type, "");
+                        half_out_color[c][chan][h] = LLVMBuildGEP(builder, ptr,
+                                                                  &hidx, 1, "");
+                     }
+                  }
+               }
+               generate_unswizzled_blend(gallivm, cbuf, variant,
+                                         key->cbuf_format[cbuf],
+                                         2, half_type, half_mask, half_out_color,
+                                         context_ptr, out_ptr, stride,
+                                         partial_mask, do_branch);
+            }
+            else {
+               generate_unswizzled_blend(gallivm, cbuf, variant,
+                                         key->cbuf_format[cbuf],
+                                         num_fs, fs_type, &fs_mask[mask_idx], fs_out_color[out_idx],
+                                         context_ptr, out_ptr, stride,
+                                         partial_mask, do_branch);
+            }
          }
       }
    }
@@ -3248,38 +3293,43 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
 }
 
 
+static void
+lp_fs_get_ir_cache_key(struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key,
+                       unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_update(&ctx, shader->ir_sha1, sizeof(shader->ir_sha1));
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Allocate a new fragment shader variant for the given key.  The variant
+ * must still be compiled with compile_variant() before it can be used.
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key)
 {
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
    if (!variant)
       return NULL;
 
    memset(variant, 0, sizeof(*variant));
-   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-            shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
 
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
+   variant->list_item_pending.base = variant;
    variant->no = shader->variants_created++;
+   util_queue_fence_init(&variant->ready);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -3305,22 +3355,60 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   return variant;
+}
+
+
+/**
+ * Generate and compile the code of a fragment shader variant in the
+ * given LLVM context.  This doesn't touch any context state, so it may
+ * run on a background thread.
+ */
+static boolean
+compile_variant(struct llvmpipe_screen *screen,
+                struct lp_fragment_shader_variant *variant,
+                LLVMContextRef context)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
+
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+            shader->no, variant->no);
+
+   lp_fs_get_ir_cache_key(shader, &variant->key, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = true;
+
+   variant->gallivm = gallivm_create(module_name, context, &cached);
+   if (!variant->gallivm) {
+      free(cached.data);
+      return FALSE;
+   }
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
 
    lp_jit_init_types(variant);
-   
+
+   mtx_lock(&shader->ir_lock);
+
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
       if (variant->opaque) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(shader, variant, RAST_WHOLE);
       }
    }
 
+   mtx_unlock(&shader->ir_lock);
+
    /*
     * Compile everything
     */
@@ -3343,12 +3431,162 @@ generate_variant(struct llvmpipe_context *lp,
       variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
    }
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
+   return TRUE;
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader_variant *variant;
+
+   int64_t t0, t1, dt;
+   boolean ok;
+
+   variant = create_variant(shader, key);
+   if (!variant)
+      return NULL;
+
+   t0 = os_time_get();
+   ok = compile_variant(screen, variant, lp->context);
+   t1 = os_time_get();
+   dt = t1 - t0;
+   LP_COUNT_ADD(llvm_compile_time, dt);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+
+   if (!ok) {
+      util_queue_fence_destroy(&variant->ready);
+      FREE(variant);
+      return NULL;
+   }
+
    return variant;
 }
 
 
+struct lp_fs_compile_job
+{
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+};
+
+
+static void
+fs_compile_job_execute(void *data, int thread_index)
+{
+   struct lp_fs_compile_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+
+   variant->context = LLVMContextCreate();
+   if (!variant->context)
+      return;
+
+   /* On failure the variant is left without code, which
+    * llvmpipe_update_fs() checks for once the fence signals.
+    */
+   compile_variant(job->screen, variant, variant->context);
+}
+
+
+static void
+fs_compile_job_cleanup(void *data, int thread_index)
+{
+   FREE(data);
+}
+
+
+/**
+ * Create a variant for the given key and queue its compilation on the
+ * context's background compile queue.  The variant is put on the context's
+ * pending list until fs_variant_ready() sees it signalled.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant_async(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fs_compile_job *job;
+
+   job = CALLOC_STRUCT(lp_fs_compile_job);
+   if (!job)
+      return NULL;
+
+   variant = create_variant(shader, key);
+   if (!variant) {
+      FREE(job);
+      return NULL;
+   }
+
+   variant->pending = TRUE;
+   job->screen = llvmpipe_screen(lp->pipe.screen);
+   job->variant = variant;
+
+   util_queue_add_job(&lp->fs_compile_queue, job, &variant->ready,
+                      fs_compile_job_execute, fs_compile_job_cleanup, 0);
+   insert_at_tail(&lp->fs_pending_variants_list, &variant->list_item_pending);
+
+   return variant;
+}
+
+
+/**
+ * Check whether a variant compiled in the background is ready for use,
+ * and account for its instructions when it first is.
+ */
+static boolean
+fs_variant_ready(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader_variant *variant)
+{
+   if (!variant->pending)
+      return TRUE;
+
+   if (!util_queue_fence_is_signalled(&variant->ready))
+      return FALSE;
+
+   variant->pending = FALSE;
+   remove_from_list(&variant->list_item_pending);
+   lp->nr_fs_instrs += variant->nr_instrs;
+   return TRUE;
+}
+
+
+/**
+ * Retire the variants which finished compiling in the background, and
+ * have the variant the bound one stands in for swapped in once it is ready.
+ * Called before each draw.
+ */
+void
+llvmpipe_poll_fs_variants(struct llvmpipe_context *lp)
+{
+   struct lp_fs_variant_list_item *li, *next;
+
+   li = first_elem(&lp->fs_pending_variants_list);
+   while (!at_end(&lp->fs_pending_variants_list, li)) {
+      next = next_elem(li);
+      fs_variant_ready(lp, li->base);
+      li = next;
+   }
+
+   if (lp->fs_wanted_variant && !lp->fs_wanted_variant->pending) {
+      lp->fs_wanted_variant = NULL;
+      lp->dirty |= LP_NEW_FS;
+   }
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
@@ -3366,6 +3604,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
+   (void) mtx_init(&shader->ir_lock, mtx_plain);
 
    shader->base.type = templ->type;
    if (templ->type == PIPE_SHADER_IR_TGSI) {
@@ -3379,8 +3618,12 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       nir_tgsi_scan_shader(templ->ir.nir, &shader->info.base, true);
    }
 
+   lp_disk_cache_hash_shader(llvmpipe_screen(pipe->screen),
+                             &shader->base, shader->ir_sha1);
+
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      mtx_destroy(&shader->ir_lock);
       FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
@@ -3486,7 +3729,17 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
-   gallivm_destroy(variant->gallivm);
+   /* wait for a background compile of this variant to finish */
+   util_queue_fence_wait(&variant->ready);
+   fs_variant_ready(lp, variant);
+   if (lp->fs_wanted_variant == variant)
+      lp->fs_wanted_variant = NULL;
+
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   if (variant->context)
+      LLVMContextDispose(variant->context);
+   util_queue_fence_destroy(&variant->ready);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3531,6 +3784,7 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    if (shader->base.ir.nir)
       ralloc_free(shader->base.ir.nir);
    assert(shader->variants_cached == 0);
+   mtx_destroy(&shader->ir_lock);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -3637,6 +3891,13 @@ llvmpipe_set_shader_images(struct pipe_context *pipe,
    for (i = start_slot, idx = 0; i < start_slot + count; i++, idx++) {
       const struct pipe_image_view *image = images ? &images[idx] : NULL;
 
+      /* Image access is only implemented for linear textures, leave the
+       * images which can't be converted unbound.
+       */
+      if (image && image->resource &&
+          !llvmpipe_resource_untile(pipe, image->resource))
+         image = NULL;
+
       util_copy_image_view(&llvmpipe->images[shader][i], image);
    }
 
@@ -3877,8 +4138,8 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3886,8 +4147,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3906,6 +4167,165 @@ make_variant_key(struct llvmpipe_context *lp,
 
 
 
+/**
+ * Clear the sampler, texture and image key bits which only enable
+ * optimizations, so that the variant generated for the resulting key can
+ * stand in for any key which differs from it only in those bits.
+ */
+static void
+make_generic_variant_key(struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_image_static_state *images = lp_fs_variant_key_images(key);
+   unsigned i;
+
+   for (i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++) {
+      struct lp_static_sampler_state *sampler = &key->samplers[i].sampler_state;
+      struct lp_static_texture_state *texture = &key->samplers[i].texture_state;
+
+      /* lod bias and clamps are always applied from the dynamic state */
+      sampler->lod_bias_non_zero = 1;
+      sampler->apply_min_lod = 1;
+      sampler->apply_max_lod = 1;
+
+      texture->pot_width = 0;
+      texture->pot_height = 0;
+      texture->pot_depth = 0;
+      texture->level_zero_only = 0;
+   }
+
+   for (i = 0; i < key->nr_images; i++) {
+      images[i].image_state.pot_width = 0;
+      images[i].image_state.pot_height = 0;
+      images[i].image_state.pot_depth = 0;
+      images[i].image_state.level_zero_only = 0;
+   }
+}
+
+
+static boolean
+texture_state_covers(const struct lp_static_texture_state *general,
+                     const struct lp_static_texture_state *state)
+{
+   return (!general->pot_width || state->pot_width) &&
+          (!general->pot_height || state->pot_height) &&
+          (!general->pot_depth || state->pot_depth) &&
+          (!general->level_zero_only || state->level_zero_only);
+}
+
+
+/**
+ * Whether a variant built for the key 'general' renders correctly for
+ * 'key', given both keys are equal after make_generic_variant_key().
+ */
+static boolean
+variant_key_covers(struct lp_fragment_shader_variant_key *general,
+                   struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_image_static_state *general_images = lp_fs_variant_key_images(general);
+   struct lp_image_static_state *images = lp_fs_variant_key_images(key);
+   unsigned i;
+
+   for (i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++) {
+      const struct lp_static_sampler_state *gs = &general->samplers[i].sampler_state;
+      const struct lp_static_sampler_state *s = &key->samplers[i].sampler_state;
+
+      if ((!gs->lod_bias_non_zero && s->lod_bias_non_zero) ||
+          (!gs->apply_min_lod && s->apply_min_lod) ||
+          (!gs->apply_max_lod && s->apply_max_lod))
+         return FALSE;
+
+      if (!texture_state_covers(&general->samplers[i].texture_state,
+                                &key->samplers[i].texture_state))
+         return FALSE;
+   }
+
+   for (i = 0; i < key->nr_images; i++) {
+      if (!texture_state_covers(&general_images[i].image_state,
+                                &images[i].image_state))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Find an already compiled variant which can stand in for the key, i.e.
+ * one which differs from it only by being less specialized.
+ */
+static struct lp_fragment_shader_variant *
+find_compatible_variant(struct llvmpipe_context *lp,
+                        struct lp_fragment_shader *shader,
+                        const struct lp_fragment_shader_variant_key *key)
+{
+   char generic_store[LP_FS_MAX_VARIANT_KEY_SIZE];
+   char store[LP_FS_MAX_VARIANT_KEY_SIZE];
+   struct lp_fragment_shader_variant_key *generic_key =
+      (struct lp_fragment_shader_variant_key *)generic_store;
+   struct lp_fragment_shader_variant_key *tmp =
+      (struct lp_fragment_shader_variant_key *)store;
+   struct lp_fs_variant_list_item *li;
+
+   memcpy(generic_key, key, shader->variant_key_size);
+   make_generic_variant_key(generic_key);
+
+   li = first_elem(&shader->variants);
+   while(!at_end(&shader->variants, li)) {
+      struct lp_fragment_shader_variant *variant = li->base;
+
+      if (fs_variant_ready(lp, variant) &&
+          variant->jit_function[RAST_EDGE_TEST]) {
+         memcpy(tmp, &variant->key, shader->variant_key_size);
+         make_generic_variant_key(tmp);
+         if (memcmp(tmp, generic_key, shader->variant_key_size) == 0 &&
+             variant_key_covers(&variant->key,
+                                (struct lp_fragment_shader_variant_key *)key))
+            return variant;
+      }
+      li = next_elem(li);
+   }
+
+   return NULL;
+}
+
+
+static void
+insert_fs_variant(struct llvmpipe_context *lp,
+                  struct lp_fragment_shader *shader,
+                  struct lp_fragment_shader_variant *variant)
+{
+   insert_at_head(&shader->variants, &variant->list_item_local);
+   insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
+   lp->nr_fs_variants++;
+   if (!variant->pending)
+      lp->nr_fs_instrs += variant->nr_instrs;
+   shader->variants_cached++;
+}
+
+
+/**
+ * Pick the variant to bind for a variant which is still being compiled in
+ * the background: a compiled, less specialized variant standing in for it
+ * if there is one, otherwise the pending variant itself, which the
+ * rasterizer then waits for.  Nothing is compiled here.
+ */
+static struct lp_fragment_shader_variant *
+bind_pending_fs_variant(struct llvmpipe_context *lp,
+                        struct lp_fragment_shader *shader,
+                        struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fragment_shader_variant *fallback =
+      find_compatible_variant(lp, shader, &variant->key);
+
+   if (!fallback)
+      return variant;
+
+   move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+   lp->fs_wanted_variant = variant;
+   return fallback;
+}
+
+
 /**
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
@@ -3918,9 +4338,12 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fragment_shader_variant *variant = NULL;
    struct lp_fs_variant_list_item *li;
    char store[LP_FS_MAX_VARIANT_KEY_SIZE];
+   boolean compile_failed = FALSE;
 
    key = make_variant_key(lp, shader, store);
 
+   lp->fs_wanted_variant = NULL;
+
    /* Search the variants for one which matches the key */
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
@@ -3931,6 +4354,21 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       li = next_elem(li);
    }
 
+   if (variant && !fs_variant_ready(lp, variant)) {
+      /* still compiling in the background */
+      variant = bind_pending_fs_variant(lp, shader, variant);
+   }
+   else if (variant && !variant->jit_function[RAST_EDGE_TEST]) {
+      /*
+       * Background compilation failed, try again synchronously.  Scenes
+       * may still reference the variant, so they must be done with it.
+       */
+      llvmpipe_finish(&lp->pipe, __FUNCTION__);
+      llvmpipe_remove_shader_variant(lp, variant);
+      variant = NULL;
+      compile_failed = TRUE;
+   }
+
    if (variant) {
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
@@ -3939,7 +4377,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
    else {
       /* variant not found, create it now */
-      int64_t t0, t1, dt;
       unsigned i;
       unsigned variants_to_cull;
 
@@ -3993,22 +4430,23 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       }
 
       /*
-       * Generate the new variant.
+       * Generate the new variant, or in async mode queue its compilation
+       * and bind it, or a variant standing in for it, right away.
        */
-      t0 = os_time_get();
-      variant = generate_variant(lp, shader, key);
-      t1 = os_time_get();
-      dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      if (lp->fs_async_compile && !compile_failed) {
+         variant = generate_variant_async(lp, shader, key);
+         if (variant) {
+            insert_fs_variant(lp, shader, variant);
+            variant = bind_pending_fs_variant(lp, shader, variant);
+         }
+      }
+
+      if (!variant) {
+         variant = generate_variant(lp, shader, key);
 
-      /* Put the new variant into the list */
-      if (variant) {
-         insert_at_head(&shader->variants, &variant->list_item_local);
-         insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
-         lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
-         shader->variants_cached++;
+         /* Put the new variant into the list */
+         if (variant)
+            insert_fs_variant(lp, shader, variant);
       }
    }
 
@@ -4019,7 +4457,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
 
 
-
 void
 llvmpipe_init_fs_funcs(struct llvmpipe_context *llvmpipe)
 {
@@ -36,6 +36,7 @@
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
+#include "util/u_queue.h" /* for struct util_queue_fence */
 
 
 struct tgsi_token;
@@ -150,6 +151,19 @@ struct lp_fragment_shader_variant
    /* For debugging/profiling purposes */
    unsigned no;
 
+   /*
+    * Background compilation state (LP_ASYNC_COMPILE).  A pending variant
+    * is on the variant lists and the context's pending list, and may be
+    * bound before the fence has signalled: scenes using it wait for the
+    * fence before being rasterized.  Variants compiled in the background
+    * get a private LLVM context, as contexts can't be shared between
+    * threads.
+    */
+   struct util_queue_fence ready;
+   LLVMContextRef context;
+   boolean pending;
+   struct lp_fs_variant_list_item list_item_pending;
+
    /* key is variable-sized, must be last */
    struct lp_fragment_shader_variant_key key;
 };
@@ -174,6 +188,15 @@ struct lp_fragment_shader
 
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
+
+   /** Hash of the shader IR, for the disk cache keys of the variants */
+   unsigned char ir_sha1[20];
+
+   /**
+    * Serializes IR generation between variants compiled on different
+    * threads, since lp_build_nir_soa() lowers the NIR in place.
+    */
+   mtx_t ir_lock;
 };
 
 
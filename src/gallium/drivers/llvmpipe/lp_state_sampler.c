@@ -34,10 +34,13 @@
 
 #include "draw/draw_context.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_debug.h"
+#include "lp_texture.h"
 #include "frontend/sw_winsys.h"
 
 
@@ -128,6 +131,8 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
 
    /* set the new sampler views */
    for (i = 0; i < num; i++) {
+      struct pipe_sampler_view *view = views[i];
+
       /*
        * Warn if someone tries to set a view created in a different context
        * (which is why we need the hack above in the first place).
@@ -137,8 +142,20 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
          debug_printf("Illegal setting of sampler_view %d created in another "
                       "context\n", i);
       }
+
+      /* The draw module only samples linear textures, leave the views which
+       * can't be converted unbound.
+       */
+      if (view &&
+          (shader == PIPE_SHADER_VERTEX ||
+           shader == PIPE_SHADER_GEOMETRY ||
+           shader == PIPE_SHADER_TESS_CTRL ||
+           shader == PIPE_SHADER_TESS_EVAL) &&
+          !llvmpipe_resource_untile(pipe, view->texture))
+         view = NULL;
+
       pipe_sampler_view_reference(&llvmpipe->sampler_views[shader][start + i],
-                                  views[i]);
+                                  view);
    }
 
    /* find highest non-null sampler_views[] entry */
@@ -166,6 +183,21 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
 }
 
 
+/**
+ * lp_sampler_static_texture_state() plus the bits of the texture state
+ * which are specific to llvmpipe resources.
+ */
+void
+llvmpipe_sampler_static_texture_state(struct lp_static_texture_state *state,
+                                      const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture && llvmpipe_resource_is_texture(view->texture))
+      state->tiled = llvmpipe_resource_is_tiled(view->texture);
+}
+
+
 static struct pipe_sampler_view *
 llvmpipe_create_sampler_view(struct pipe_context *pipe,
                             struct pipe_resource *texture,
@@ -30,6 +30,7 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
 #include "gallivm/lp_bld_const.h"
@@ -710,13 +711,17 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    struct lp_setup_variant *variant = NULL;
    struct gallivm_state *gallivm;
    struct lp_setup_args args;
-   char func_name[64];
+   char module_name[64];
    LLVMTypeRef vec4f_type;
    LLVMTypeRef func_type;
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
    int64_t t0 = 0, t1;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
 
    if (0)
       goto fail;
@@ -727,11 +732,18 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->no = setup_no++;
 
-   snprintf(func_name, sizeof(func_name), "setup_variant_%u",
+   snprintf(module_name, sizeof(module_name), "setup_variant_%u",
             variant->no);
 
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
+   /* There is no shader IR involved, the key determines the code. */
+   _mesa_sha1_compute(key, key->size, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = true;
+
+   variant->gallivm = gallivm = gallivm_create(module_name, lp->context, &cached);
    if (!variant->gallivm) {
+      free(cached.data);
       goto fail;
    }
 
@@ -761,7 +773,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, ARRAY_SIZE(arg_types), 0);
 
-   variant->function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   variant->function = LLVMAddFunction(gallivm->module, "setup_variant", func_type);
    if (!variant->function)
       goto fail;
 
@@ -805,6 +817,9 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
    /*
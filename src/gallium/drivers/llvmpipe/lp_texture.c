@@ -35,12 +35,14 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "util/u_box.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
 #include "lp_context.h"
@@ -51,6 +53,8 @@
 #include "lp_state.h"
 #include "lp_rast.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "frontend/sw_winsys.h"
 
 
@@ -179,6 +183,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       else {
          memset(lpr->tex_data, 0, total_size);
       }
+      lpr->total_alloc_size = total_size;
    }
 
    return TRUE;
@@ -188,6 +193,188 @@ fail:
 }
 
 
+/**
+ * Whether a new texture gets the tiled layout.
+ *
+ * This is limited to textures which are likely to be only sampled: the
+ * gallium frontends set the render target bind flag on about everything,
+ * so rendering to a texture instead converts it to linear on the fly.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   if (!screen->tiled_textures)
+      return FALSE;
+
+   if (llvmpipe_resource_is_1d(pt) ||
+       pt->nr_samples > 1 ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       (pt->bind & (PIPE_BIND_DEPTH_STENCIL |
+                    PIPE_BIND_SHADER_IMAGE |
+                    PIPE_BIND_LINEAR)) ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)))
+      return FALSE;
+
+   /* Only plain 1x1 blocks, see lp_build_sample_offset() */
+   if (desc->block.width != 1 || desc->block.height != 1 ||
+       util_format_is_depth_or_stencil(pt->format))
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Byte offset of texel (x, y) within an image stored in micro-tiles.
+ * This is what lp_build_sample_tiled_partial_offset() computes.
+ */
+static inline unsigned
+tiled_texel_offset(unsigned row_stride, unsigned texel_size,
+                   unsigned x, unsigned y)
+{
+   const unsigned mask = LP_TILED_TEXTURE_BLOCK - 1;
+
+   return (y & ~mask) * row_stride +
+          ((x & ~mask) * LP_TILED_TEXTURE_BLOCK +
+           (y & mask) * LP_TILED_TEXTURE_BLOCK + (x & mask)) * texel_size;
+}
+
+
+/**
+ * Copy a box of a tiled texture level from or to a linear buffer.
+ */
+static void
+tiled_copy_box(struct llvmpipe_resource *lpr,
+               unsigned level,
+               const struct pipe_box *box,
+               uint8_t *linear,
+               unsigned stride,
+               unsigned layer_stride,
+               boolean to_tiled)
+{
+   const unsigned texel_size = util_format_get_blocksize(lpr->base.format);
+   const unsigned row_stride = lpr->row_stride[level];
+   int x, y, z;
+
+   assert(lpr->tiled);
+
+   for (z = 0; z < box->depth; z++) {
+      uint8_t *tiled = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                          level);
+      uint8_t *row = linear + z * layer_stride;
+
+      for (y = box->y; y < box->y + box->height; y++) {
+         for (x = box->x; x < box->x + box->width; ) {
+            /* the texels of a row within a tile are contiguous */
+            unsigned count = MIN2(LP_TILED_TEXTURE_BLOCK -
+                                  (x & (LP_TILED_TEXTURE_BLOCK - 1)),
+                                  box->x + box->width - x);
+            uint8_t *t = tiled + tiled_texel_offset(row_stride, texel_size,
+                                                    x, y);
+            uint8_t *l = row + (x - box->x) * texel_size;
+
+            if (to_tiled)
+               memcpy(t, l, count * texel_size);
+            else
+               memcpy(l, t, count * texel_size);
+
+            x += count;
+         }
+         row += stride;
+      }
+   }
+}
+
+
+/**
+ * Convert a tiled texture to the linear layout, for when it is about to be
+ * used as anything but a fragment or compute shader sampler view.
+ *
+ * Other contexts may have bound the texture, with its address cached in
+ * their jit state and in scenes which are still being binned, so the
+ * conversion is done in place: a row of tiles covers exactly the same
+ * LP_TILED_TEXTURE_BLOCK rows in both layouts.  All the queued scenes are
+ * waited for first, and the other contexts pick up the new layout on their
+ * next draw.
+ *
+ * \return FALSE if out of memory, in which case the texture stays tiled.
+ */
+boolean
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *pt)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pt->screen);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
+   const unsigned texel_size = util_format_get_blocksize(pt->format);
+   unsigned level;
+   uint8_t *band;
+
+   if (!llvmpipe_resource_is_texture(pt) || !lpr->tiled)
+      return TRUE;
+
+   band = MALLOC(LP_TILED_TEXTURE_BLOCK * lpr->row_stride[0]);
+   if (!band) {
+      debug_printf("llvmpipe: out of memory converting tiled texture\n");
+      return FALSE;
+   }
+
+   llvmpipe_flush_resource(pipe, pt, 0,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+   llvmpipe_screen_finish(screen);
+
+   for (level = 0; level <= pt->last_level; level++) {
+      const unsigned row_stride = lpr->row_stride[level];
+      const unsigned band_size = LP_TILED_TEXTURE_BLOCK * row_stride;
+      const unsigned width = align(u_minify(pt->width0, level),
+                                   LP_TILED_TEXTURE_BLOCK);
+      const unsigned num_rows = lpr->img_stride[level] / row_stride;
+      const unsigned num_slices = pt->target == PIPE_TEXTURE_3D ?
+         u_minify(pt->depth0, level) : pt->array_size;
+      unsigned slice, y, r, x;
+
+      for (slice = 0; slice < num_slices; slice++) {
+         uint8_t *image = llvmpipe_get_texture_image_address(lpr, slice,
+                                                             level);
+
+         for (y = 0; y < num_rows; y += LP_TILED_TEXTURE_BLOCK) {
+            uint8_t *linear = image + y * row_stride;
+
+            memcpy(band, linear, band_size);
+
+            for (r = 0; r < LP_TILED_TEXTURE_BLOCK; r++) {
+               for (x = 0; x < width; x += LP_TILED_TEXTURE_BLOCK) {
+                  memcpy(linear + r * row_stride + x * texel_size,
+                         band + tiled_texel_offset(row_stride, texel_size,
+                                                   x, r),
+                         LP_TILED_TEXTURE_BLOCK * texel_size);
+               }
+            }
+         }
+      }
+   }
+
+   FREE(band);
+
+   lpr->tiled = FALSE;
+
+   /* The shader variants and jit texture state depend on the layout */
+   screen->timestamp++;
+   llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+   llvmpipe->cs_dirty |= LP_CSNEW_SAMPLER_VIEW;
+
+   return TRUE;
+}
+
+
 /**
  * Check the size of the texture specified by 'res'.
  * \return TRUE if OK, FALSE if too large.
@@ -269,6 +456,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
          /* texture map */
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
+
+         lpr->tiled = llvmpipe_texture_can_tile(screen, &lpr->base);
       }
    }
    else {
@@ -565,6 +754,10 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
       }
    }
 
+   /* Tiled textures are only accessible through a linear staging copy */
+   if (lpr->tiled && (usage & PIPE_TRANSFER_MAP_DIRECTLY))
+      return NULL;
+
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
@@ -577,6 +770,31 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
    pt->usage = usage;
    *transfer = pt;
 
+   if (lpr->tiled) {
+      assert(sample == 0);
+
+      pt->stride = box->width * util_format_get_blocksize(lpr->base.format);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = MALLOC(pt->layer_stride * box->depth);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         tiled_copy_box(lpr, level, box, lpt->staging,
+                        pt->stride, pt->layer_stride, FALSE);
+      }
+
+      if (usage & PIPE_TRANSFER_WRITE)
+         screen->timestamp++;
+
+      return lpt->staging;
+   }
+
    assert(level < LP_MAX_TEXTURE_LEVELS);
 
    /*
@@ -640,15 +858,44 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const struct pipe_box *box = &transfer->box;
+
+      if (!(transfer->usage & PIPE_TRANSFER_WRITE)) {
+         /* nothing to write back */
+      }
+      else if (lpr->tiled) {
+         tiled_copy_box(lpr, transfer->level, box, lpt->staging,
+                        transfer->stride, transfer->layer_stride, TRUE);
+      }
+      else {
+         /* the texture was converted to linear while mapped */
+         util_copy_box(llvmpipe_get_texture_image_address(lpr, 0,
+                                                          transfer->level),
+                       lpr->base.format,
+                       lpr->row_stride[transfer->level],
+                       lpr->img_stride[transfer->level],
+                       box->x, box->y, box->z,
+                       box->width, box->height, box->depth,
+                       lpt->staging,
+                       transfer->stride, transfer->layer_stride,
+                       0, 0, 0);
+      }
+      FREE(lpt->staging);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
 
    /* Effectively do the texture_update work here - if texture images
     * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+    * where it would happen.  For llvmpipe, that's only the tiling above.
     */
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
@@ -80,6 +80,15 @@ struct llvmpipe_resource
     */
    void *tex_data;
 
+   /**
+    * Whether tex_data is stored in LP_TILED_TEXTURE_BLOCK sized micro-tiles
+    * (see LP_TILED_TEXTURES) rather than linearly.  Tiled textures can only
+    * be sampled by the fragment and compute shaders, so they are converted
+    * to the linear layout for good by llvmpipe_resource_untile() as soon as
+    * they get used in any other way by the GPU.
+    */
+   boolean tiled;
+
    /**
     * Data for non-texture resources.
     */
@@ -103,6 +112,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the mapped box of a tiled texture */
+   uint8_t *staging;
 };
 
 
@@ -176,6 +188,13 @@ llvmpipe_resource_is_1d(const struct pipe_resource *resource)
 }
 
 
+static inline boolean
+llvmpipe_resource_is_tiled(const struct pipe_resource *resource)
+{
+   return llvmpipe_resource_const(resource)->tiled;
+}
+
+
 static inline unsigned
 llvmpipe_layer_stride(struct pipe_resource *resource,
                       unsigned level)
@@ -226,6 +245,10 @@ ubyte *
 llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
                                    unsigned face_slice, unsigned level);
 
+boolean
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
 
 extern void
 llvmpipe_print_resources(void);
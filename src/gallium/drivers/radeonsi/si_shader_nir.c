@@ -934,6 +934,11 @@ static void si_lower_nir(struct si_screen *sscreen, struct nir_shader *nir)
    if (changed)
       si_nir_opts(nir);
 
+   /* Hoist loop invariants, while leaving enough VGPRs to keep the
+    * occupancy of loops up.
+    */
+   NIR_PASS_V(nir, nir_opt_licm, 32);
+
    NIR_PASS_V(nir, nir_lower_bool_to_int32);
    NIR_PASS_V(nir, nir_remove_dead_variables, nir_var_function_temp);
 
@@ -471,6 +471,16 @@ brw_nir_lower_fs_outputs(nir_shader *nir)
    this_progress;                                          \
 })
 
+/* Like OPT, for the passes of a loop using nir_pass_manager pm. */
+#define LOOP_OPT(deps, pass, ...) ({                       \
+   bool this_progress = false;                             \
+   NIR_LOOP_PASS(this_progress, &pm, deps, pass,           \
+                 ##__VA_ARGS__);                           \
+   if (this_progress)                                      \
+      progress = true;                                     \
+   this_progress;                                          \
+})
+
 static nir_variable_mode
 brw_nir_no_indirect_mask(const struct brw_compiler *compiler,
                          gl_shader_stage stage)
@@ -494,43 +504,50 @@ brw_nir_optimize(nir_shader *nir, const struct brw_compiler *compiler,
    nir_variable_mode indirect_mask =
       brw_nir_no_indirect_mask(compiler, nir->info.stage);
 
+   nir_pass_manager pm;
    bool progress;
    unsigned lower_flrp =
       (nir->options->lower_flrp16 ? 16 : 0) |
       (nir->options->lower_flrp32 ? 32 : 0) |
       (nir->options->lower_flrp64 ? 64 : 0);
 
+   nir_pass_manager_init(&pm, nir);
+
    do {
       progress = false;
-      OPT(nir_split_array_vars, nir_var_function_temp);
-      OPT(nir_shrink_vec_array_vars, nir_var_function_temp);
-      OPT(nir_opt_deref);
-      OPT(nir_lower_vars_to_ssa);
+      LOOP_OPT(nir_pass_dep_var_access,
+               nir_split_array_vars, nir_var_function_temp);
+      LOOP_OPT(nir_pass_dep_var_access,
+               nir_shrink_vec_array_vars, nir_var_function_temp);
+      LOOP_OPT(nir_pass_dep_var_access, nir_opt_deref);
+      LOOP_OPT(nir_pass_dep_var_access, nir_lower_vars_to_ssa);
       if (allow_copies) {
          /* Only run this pass in the first call to brw_nir_optimize.  Later
           * calls assume that we've lowered away any copy_deref instructions
           * and we don't want to introduce any more.
           */
-         OPT(nir_opt_find_array_copies);
+         LOOP_OPT(nir_pass_dep_var_access, nir_opt_find_array_copies);
       }
-      OPT(nir_opt_copy_prop_vars);
-      OPT(nir_opt_dead_write_vars);
-      OPT(nir_opt_combine_stores, nir_var_all);
+      LOOP_OPT(nir_pass_dep_var_access, nir_opt_copy_prop_vars);
+      LOOP_OPT(nir_pass_dep_var_access, nir_opt_dead_write_vars);
+      LOOP_OPT(nir_pass_dep_var_access,
+               nir_opt_combine_stores, nir_var_all);
 
       if (is_scalar) {
-         OPT(nir_lower_alu_to_scalar, NULL, NULL);
+         LOOP_OPT(nir_pass_dep_alu, nir_lower_alu_to_scalar, NULL, NULL);
       }
 
-      OPT(nir_copy_prop);
+      LOOP_OPT(nir_pass_dep_all, nir_copy_prop);
 
       if (is_scalar) {
-         OPT(nir_lower_phis_to_scalar);
+         LOOP_OPT(nir_pass_dep_all, nir_lower_phis_to_scalar);
       }
 
-      OPT(nir_copy_prop);
-      OPT(nir_opt_dce);
-      OPT(nir_opt_cse);
-      OPT(nir_opt_combine_stores, nir_var_all);
+      LOOP_OPT(nir_pass_dep_all, nir_copy_prop);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_dce);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_cse);
+      LOOP_OPT(nir_pass_dep_var_access,
+               nir_opt_combine_stores, nir_var_all);
 
       /* Passing 0 to the peephole select pass causes it to convert
        * if-statements that contain only move instructions in the branches
@@ -552,21 +569,28 @@ brw_nir_optimize(nir_shader *nir, const struct brw_compiler *compiler,
       const bool is_vec4_tessellation = !is_scalar &&
          (nir->info.stage == MESA_SHADER_TESS_CTRL ||
           nir->info.stage == MESA_SHADER_TESS_EVAL);
-      OPT(nir_opt_peephole_select, 0, !is_vec4_tessellation, false);
-      OPT(nir_opt_peephole_select, 8, !is_vec4_tessellation,
-          compiler->devinfo->gen >= 6);
-
-      OPT(nir_opt_intrinsics);
-      OPT(nir_opt_idiv_const, 32);
-      OPT(nir_opt_algebraic);
-      OPT(nir_opt_constant_folding);
+      LOOP_OPT(nir_pass_dep_all,
+               nir_opt_peephole_select, 0, !is_vec4_tessellation, false);
+      LOOP_OPT(nir_pass_dep_all,
+               nir_opt_peephole_select, 8, !is_vec4_tessellation,
+               compiler->devinfo->gen >= 6);
+
+      LOOP_OPT(nir_pass_dep_all, nir_opt_intrinsics);
+      LOOP_OPT(nir_pass_dep_alu | nir_pass_dep_load_const,
+               nir_opt_idiv_const, 32);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_algebraic);
+      LOOP_OPT(nir_pass_dep_alu | nir_pass_dep_intrinsic |
+               nir_pass_dep_load_const,
+               nir_opt_constant_folding);
 
       if (lower_flrp != 0) {
-         if (OPT(nir_lower_flrp,
-                 lower_flrp,
-                 false /* always_precise */,
-                 compiler->devinfo->gen >= 6)) {
-            OPT(nir_opt_constant_folding);
+         if (LOOP_OPT(nir_pass_dep_all, nir_lower_flrp,
+                      lower_flrp,
+                      false /* always_precise */,
+                      compiler->devinfo->gen >= 6)) {
+            LOOP_OPT(nir_pass_dep_alu | nir_pass_dep_intrinsic |
+                     nir_pass_dep_load_const,
+                     nir_opt_constant_folding);
          }
 
          /* Nothing should rematerialize any flrps, so we only need to do this
@@ -575,23 +599,23 @@ brw_nir_optimize(nir_shader *nir, const struct brw_compiler *compiler,
          lower_flrp = 0;
       }
 
-      OPT(nir_opt_dead_cf);
-      if (OPT(nir_opt_trivial_continues)) {
+      LOOP_OPT(nir_pass_dep_all, nir_opt_dead_cf);
+      if (LOOP_OPT(nir_pass_dep_all, nir_opt_trivial_continues)) {
          /* If nir_opt_trivial_continues makes progress, then we need to clean
           * things up if we want any hope of nir_opt_if or nir_opt_loop_unroll
           * to make progress.
           */
-         OPT(nir_copy_prop);
-         OPT(nir_opt_dce);
+         LOOP_OPT(nir_pass_dep_all, nir_copy_prop);
+         LOOP_OPT(nir_pass_dep_all, nir_opt_dce);
       }
-      OPT(nir_opt_if, false);
-      OPT(nir_opt_conditional_discard);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_if, false);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_conditional_discard);
       if (nir->options->max_unroll_iterations != 0) {
-         OPT(nir_opt_loop_unroll, indirect_mask);
+         LOOP_OPT(nir_pass_dep_all, nir_opt_loop_unroll, indirect_mask);
       }
-      OPT(nir_opt_remove_phis);
-      OPT(nir_opt_undef);
-      OPT(nir_lower_pack);
+      LOOP_OPT(nir_pass_dep_phi | nir_pass_dep_cf, nir_opt_remove_phis);
+      LOOP_OPT(nir_pass_dep_all, nir_opt_undef);
+      LOOP_OPT(nir_pass_dep_alu, nir_lower_pack);
    } while (progress);
 
    /* Workaround Gfxbench unused local sampler variable which will trigger an
@@ -930,6 +954,11 @@ brw_postprocess_nir(nir_shader *nir, const struct brw_compiler *compiler,
    if (OPT(nir_lower_int64, nir->options->lower_int64_options))
       brw_nir_optimize(nir, compiler, is_scalar, false);
 
+   /* Hoist loop invariants once the lowering is done.  Keep the values live
+    * across loops within a quarter of the register file in SIMD16.
+    */
+   OPT(nir_opt_licm, 16);
+
    if (devinfo->gen >= 6) {
       /* Try and fuse multiply-adds */
       OPT(brw_nir_opt_peephole_ffma);
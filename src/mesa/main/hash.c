@@ -38,6 +38,7 @@
 #include "glheader.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 
 
@@ -89,18 +90,37 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL ||
+       table->NumDenseEntries) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   for (unsigned i = 0; i < HASH_DENSE_NUM_BLOCKS; i++)
+      free(table->Dense[i]);
+
    mtx_destroy(&table->Mutex);
    free(table);
 }
 
 
 
+/**
+ * Lookup a key below HASH_DENSE_MAX_KEY.  This is safe without the mutex.
+ */
+static inline void *
+_mesa_HashLookup_dense(struct _mesa_HashTable *table, GLuint key)
+{
+   void **block = p_atomic_read(&table->Dense[key >> HASH_DENSE_BLOCK_BITS]);
+
+   if (!block)
+      return NULL;
+
+   return p_atomic_read(&block[key & (HASH_DENSE_BLOCK_SIZE - 1)]);
+}
+
+
 /**
  * Lookup an entry in the hash table, without locking.
  * \sa _mesa_HashLookup
@@ -113,8 +133,8 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < HASH_DENSE_MAX_KEY)
+      return _mesa_HashLookup_dense(table, key);
 
    entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                               uint_hash(key),
@@ -138,6 +158,13 @@ void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
+   assert(table);
+   assert(key);
+
+   if (key < HASH_DENSE_MAX_KEY)
+      return _mesa_HashLookup_dense(table, key);
+
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -175,8 +202,22 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   if (key < HASH_DENSE_MAX_KEY) {
+      void **block = table->Dense[key >> HASH_DENSE_BLOCK_BITS];
+      void **slot;
+
+      if (!block) {
+         block = calloc(HASH_DENSE_BLOCK_SIZE, sizeof(void *));
+         if (!block) {
+            _mesa_error_no_memory(__func__);
+            return;
+         }
+         p_atomic_set(&table->Dense[key >> HASH_DENSE_BLOCK_BITS], block);
+      }
+
+      slot = &block[key & (HASH_DENSE_BLOCK_SIZE - 1)];
+      table->NumDenseEntries += (data != NULL) - (*slot != NULL);
+      p_atomic_set(slot, data);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -245,8 +286,13 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < HASH_DENSE_MAX_KEY) {
+      void **block = table->Dense[key >> HASH_DENSE_BLOCK_BITS];
+
+      if (block && block[key & (HASH_DENSE_BLOCK_SIZE - 1)]) {
+         p_atomic_set(&block[key & (HASH_DENSE_BLOCK_SIZE - 1)], NULL);
+         table->NumDenseEntries--;
+      }
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                                  uint_hash(key),
@@ -287,14 +333,23 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    assert(callback);
    _mesa_HashLockMutex(table);
    table->InDeleteAll = GL_TRUE;
+   for (unsigned i = 0; i < HASH_DENSE_NUM_BLOCKS; i++) {
+      void **block = table->Dense[i];
+
+      for (unsigned j = 0; block && j < HASH_DENSE_BLOCK_SIZE; j++) {
+         void *data = block[j];
+
+         if (data) {
+            callback(i * HASH_DENSE_BLOCK_SIZE + j, data, userData);
+            p_atomic_set(&block[j], NULL);
+         }
+      }
+   }
+   table->NumDenseEntries = 0;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    _mesa_HashUnlockMutex(table);
 }
@@ -315,11 +370,18 @@ hash_walk_unlocked(const struct _mesa_HashTable *table,
    assert(table);
    assert(callback);
 
+   /* The callback may remove entries, so read every entry again. */
+   for (unsigned i = 0; i < HASH_DENSE_NUM_BLOCKS; i++) {
+      void **block = table->Dense[i];
+
+      for (unsigned j = 0; block && j < HASH_DENSE_BLOCK_SIZE; j++) {
+         if (block[j])
+            callback(i * HASH_DENSE_BLOCK_SIZE + j, block[j], userData);
+      }
+   }
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
 }
 
 
@@ -358,8 +420,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -416,10 +476,7 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
+   GLuint count = table->NumDenseEntries;
 
    count += _mesa_hash_table_num_entries(table->ht);
 
@@ -39,18 +39,32 @@
 #include "c11/threads.h"
 
 /**
- * Magic GLuint object name that gets stored outside of the struct hash_table.
+ * Magic GLuint object name that marks deleted keys in the struct hash_table.
  *
  * The hash table needs a particular pointer to be the marker for a key that
  * was deleted from the table, along with NULL for the "never allocated in the
  * table" marker.  Legacy GL allows any GLuint to be used as a GL object name,
- * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
- * able to track a GLuint that happens to match the deleted key outside of
- * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * and we use a 1:1 mapping from GLuints to key pointers.  Names below
+ * HASH_DENSE_MAX_KEY are never stored in the struct hash_table, so any of
+ * them can be the deleted key.
  */
 #define DELETED_KEY_VALUE 1
 
+/** @{
+ * Names below HASH_DENSE_MAX_KEY are stored in a two-level array instead of
+ * the struct hash_table.  Names from glGen*() are small contiguous integers,
+ * so that's where nearly all objects end up.
+ *
+ * The blocks of the array are allocated on first use and only freed with the
+ * table, and entries are updated atomically, so looking up these names
+ * doesn't need the mutex.  Only inserting and removing them does.
+ */
+#define HASH_DENSE_BLOCK_BITS 10
+#define HASH_DENSE_BLOCK_SIZE (1 << HASH_DENSE_BLOCK_BITS)
+#define HASH_DENSE_NUM_BLOCKS 1024
+#define HASH_DENSE_MAX_KEY    (HASH_DENSE_BLOCK_SIZE * HASH_DENSE_NUM_BLOCKS)
+/** @} */
+
 /** @{
  * Mapping from our use of GLuint as both the key and the hash value to the
  * hash_table.h API
@@ -99,12 +113,15 @@ uint_key(GLuint id)
  * The hash table data structure.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct hash_table *ht;                /**< keys >= HASH_DENSE_MAX_KEY */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                          /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
+   /** Entries for keys < HASH_DENSE_MAX_KEY, in blocks of
+    * HASH_DENSE_BLOCK_SIZE.  A NULL entry means the key isn't in the table.
+    */
+   void **Dense[HASH_DENSE_NUM_BLOCKS];
+   GLuint NumDenseEntries;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -166,6 +166,33 @@ static void check_attrib_edgeflag(struct st_context *st)
 }
 
 
+/* Shaders with inlinable uniforms select their variant from the uniform
+ * values, so they have to be revalidated when their constants change in a
+ * way that may select another variant, and on every draw until a variant
+ * has been chosen for the current values.
+ */
+static void
+check_inlinable_uniforms(struct st_context *st)
+{
+   const uint64_t constants[MESA_SHADER_STAGES] = {
+      ST_NEW_VS_CONSTANTS, ST_NEW_TCS_CONSTANTS, ST_NEW_TES_CONSTANTS,
+      ST_NEW_GS_CONSTANTS, ST_NEW_FS_CONSTANTS, ST_NEW_CS_CONSTANTS,
+   };
+   const uint64_t shaders[MESA_SHADER_STAGES] = {
+      ST_NEW_VS_STATE, ST_NEW_TCS_STATE, ST_NEW_TES_STATE,
+      ST_NEW_GS_STATE, ST_NEW_FS_STATE, ST_NEW_CS_STATE,
+   };
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct st_program *stp = st_program(st->current_program[i]);
+
+      if (stp && stp->num_inlinable_uniforms &&
+          st_inlined_uniforms_need_update(st, stp, st->dirty & constants[i]))
+         st->dirty |= shaders[i];
+   }
+}
+
+
 /***********************************************************************
  * Update all derived state:
  */
@@ -247,6 +274,9 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
       unreachable("Invalid pipeline specified");
    }
 
+   if (st->inline_uniforms)
+      check_inlinable_uniforms(st);
+
    dirty = st->dirty & pipeline_mask;
    if (!dirty)
       return;
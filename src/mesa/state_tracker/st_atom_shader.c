@@ -109,6 +109,7 @@ st_update_fp( struct st_context *st )
    if (st->shader_has_one_variant[MESA_SHADER_FRAGMENT] &&
        !stfp->ati_fs && /* ATI_fragment_shader always has multiple variants */
        !stfp->Base.ExternalSamplersUsed && /* external samplers need variants */
+       !stfp->num_inlinable_uniforms && /* so do inlined uniforms */
        stfp->variants &&
        !st_fp_variant(stfp->variants)->key.drawpixels &&
        !st_fp_variant(stfp->variants)->key.bitmap) {
@@ -160,6 +161,10 @@ st_update_fp( struct st_context *st )
 
       key.external = st_get_external_sampler_key(st, &stfp->Base);
 
+      key.inline_uniforms =
+         st_get_inlined_uniform_values(st, stfp,
+                                       key.inlined_uniform_values);
+
       shader = st_get_fp_variant(st, stfp, &key)->base.driver_shader;
    }
 
@@ -186,6 +191,7 @@ st_update_vp( struct st_context *st )
    assert(stvp->Base.Target == GL_VERTEX_PROGRAM_ARB);
 
    if (st->shader_has_one_variant[MESA_SHADER_VERTEX] &&
+       !stvp->num_inlinable_uniforms &&
        stvp->variants &&
        st_common_variant(stvp->variants)->key.passthrough_edgeflags == st->vertdata_edgeflags &&
        !st_common_variant(stvp->variants)->key.is_draw_shader) {
@@ -231,6 +237,10 @@ st_update_vp( struct st_context *st )
       if (st->lower_ucp && st_user_clip_planes_enabled(st->ctx))
          key.lower_ucp = st->ctx->Transform.ClipPlanesEnabled;
 
+      key.inline_uniforms =
+         st_get_inlined_uniform_values(st, stvp,
+                                       key.inlined_uniform_values);
+
       st->vp_variant = st_get_vp_variant(st, stvp, &key);
    }
 
@@ -255,7 +265,8 @@ st_update_common_program(struct st_context *st, struct gl_program *prog,
    stp = st_program(prog);
    st_reference_prog(st, dst, stp);
 
-   if (st->shader_has_one_variant[prog->info.stage] && stp->variants)
+   if (st->shader_has_one_variant[prog->info.stage] &&
+       !stp->num_inlinable_uniforms && stp->variants)
       return stp->variants->driver_shader;
 
    struct st_common_variant_key key;
@@ -287,6 +298,9 @@ st_update_common_program(struct st_context *st, struct gl_program *prog,
 
    }
 
+   key.inline_uniforms =
+      st_get_inlined_uniform_values(st, stp, key.inlined_uniform_values);
+
    return st_get_common_variant(st, stp, &key)->driver_shader;
 }
 
@@ -69,6 +69,8 @@ st_new_program(struct gl_context *ctx, gl_shader_stage stage, GLuint id,
       break;
    }
 
+   simple_mtx_init(&prog->inline_mutex, mtx_plain);
+
    return _mesa_init_gl_program(&prog->Base, stage, id, is_arb_asm);
 }
 
@@ -88,6 +90,7 @@ st_delete_program(struct gl_context *ctx, struct gl_program *prog)
       free_glsl_to_tgsi_visitor(stp->glsl_to_tgsi);
 
    free(stp->serialized_nir);
+   simple_mtx_destroy(&stp->inline_mutex);
 
    /* delete base class */
    _mesa_delete_program( ctx, prog );
@@ -151,10 +154,15 @@ st_new_ati_fs(struct gl_context *ctx, struct ati_fragment_shader *curProg)
 static void
 st_max_shader_compiler_threads(struct gl_context *ctx, unsigned count)
 {
-   struct pipe_screen *screen = st_context(ctx)->pipe->screen;
+   struct st_context *st = st_context(ctx);
+   struct pipe_screen *screen = st->pipe->screen;
 
    if (screen->set_max_shader_compiler_threads)
       screen->set_max_shader_compiler_threads(screen, count);
+
+   /* A count of 0 makes linking serial, see st_link_run_jobs(). */
+   if (util_queue_is_initialized(&st->link_queue) && count > 0)
+      util_queue_adjust_num_threads(&st->link_queue, count);
 }
 
 static bool
@@ -91,6 +91,7 @@
 
 
 DEBUG_GET_ONCE_BOOL_OPTION(mesa_mvp_dp4, "MESA_MVP_DP4", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(parallel_link, "GALLIUM_PARALLEL_LINK", FALSE)
 
 
 /**
@@ -440,6 +441,65 @@ st_context_free_zombie_objects(struct st_context *st)
 }
 
 
+struct st_link_job {
+   st_link_job_func func;
+   void *data;
+   unsigned index;
+   struct util_queue_fence fence;
+};
+
+
+static void
+st_link_job_execute(void *data, int thread_index)
+{
+   struct st_link_job *job = (struct st_link_job *)data;
+
+   job->func(job->data, job->index);
+}
+
+
+/**
+ * Calls func(data, i) for each i below count, which is at most the number of
+ * shader stages, and returns once they are all done.
+ *
+ * With GALLIUM_PARALLEL_LINK, the calls run in parallel on the link queue,
+ * so func must only touch its own stage, and the screen.
+ */
+void
+st_link_run_jobs(struct st_context *st, unsigned count,
+                 st_link_job_func func, void *data)
+{
+   struct st_link_job jobs[MESA_SHADER_STAGES];
+
+   assert(count <= MESA_SHADER_STAGES);
+
+   /* glMaxShaderCompilerThreadsKHR(0) asks for no parallel compilation. */
+   if (count < 2 || !util_queue_is_initialized(&st->link_queue) ||
+       st->ctx->Hint.MaxShaderCompilerThreads == 0) {
+      for (unsigned i = 0; i < count; i++)
+         func(data, i);
+      return;
+   }
+
+   for (unsigned i = 1; i < count; i++) {
+      jobs[i].func = func;
+      jobs[i].data = data;
+      jobs[i].index = i;
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&st->link_queue, &jobs[i], &jobs[i].fence,
+                         st_link_job_execute, NULL, 0);
+   }
+
+   /* Do the first job ourselves instead of just waiting. */
+   func(data, 0);
+
+   for (unsigned i = 1; i < count; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
+
 static void
 st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
 {
@@ -461,6 +521,9 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
       pipe_sampler_view_reference(&st->state.frag_sampler_views[i], NULL);
    }
 
+   if (util_queue_is_initialized(&st->link_queue))
+      util_queue_destroy(&st->link_queue);
+
    /* free glReadPixels cache data */
    st_invalidate_readpix_cache(st);
    util_throttle_deinit(st->pipe->screen, &st->throttle);
@@ -701,6 +764,19 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
       !screen->get_param(screen, PIPE_CAP_CLIP_PLANES);
    st->allow_st_finalize_nir_twice = screen->finalize_nir != NULL;
 
+   /* Uniform inlining works on the UBO 0 loads packed uniforms are lowered
+    * to, and relies on the driver finalizing variants again.
+    */
+   st->inline_uniforms = st->allow_st_finalize_nir_twice &&
+                         ctx->Const.PackedDriverUniformStorage &&
+                         !(ST_DEBUG & DEBUG_NOINLINE);
+
+   /* The thread calling st_link_run_jobs() runs one of the stages itself. */
+   if (debug_get_option_parallel_link() && util_cpu_caps.nr_cpus > 1) {
+      util_queue_init(&st->link_queue, "gl_link", MESA_SHADER_STAGES,
+                      MIN2(util_cpu_caps.nr_cpus, MESA_SHADER_STAGES) - 1, 0);
+   }
+
    st->has_hw_atomics =
       screen->get_shader_param(screen, PIPE_SHADER_FRAGMENT,
                                PIPE_SHADER_CAP_MAX_HW_ATOMIC_COUNTERS)
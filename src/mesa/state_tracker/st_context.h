@@ -36,6 +36,7 @@
 #include "util/u_helpers.h"
 #include "util/u_inlines.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 #include "vbo/vbo.h"
 #include "util/list.h"
 #include "cso_cache/cso_context.h"
@@ -84,6 +85,9 @@ struct st_bound_handles
 };
 
 
+/** Uniform inlining limit, per program */
+#define ST_MAX_INLINABLE_UNIFORMS 4
+
 #define NUM_DRAWPIX_CACHE_ENTRIES 4
 
 struct drawpix_cache_entry
@@ -165,6 +169,12 @@ struct st_context
     */
    boolean allow_st_finalize_nir_twice;
 
+   /**
+    * Whether shaders may get variants specialised on the values of the
+    * uniforms controlling their branches and loops.
+    */
+   boolean inline_uniforms;
+
    /**
     * If a shader can be created when we get its source.
     * This means it has only 1 variant, not counting glBitmap and
@@ -266,6 +276,20 @@ struct st_context
 
    struct st_common_variant *vp_variant;
 
+   /**
+    * Uniform inlining state of the bound programs, per stage.  This is kept
+    * per context so that contexts sharing a program don't disturb each
+    * other, see st_get_inlined_uniform_values().
+    */
+   struct st_inlined_uniforms_state {
+      struct gl_program *prog;
+      /** Values seen by the last validations, and how many saw them */
+      uint32_t values[ST_MAX_INLINABLE_UNIFORMS];
+      unsigned draws;
+      /** Whether the bound variant is specialised on the values */
+      bool inlined;
+   } inlined_uniforms[MESA_SHADER_STAGES];
+
    struct {
       struct pipe_resource *pixelmap_texture;
       struct pipe_sampler_view *pixelmap_sampler_view;
@@ -377,6 +401,10 @@ struct st_context
       simple_mtx_t mutex;
    } zombie_shaders;
 
+   /* Runs the independent per-stage parts of linking in parallel, see
+    * st_link_run_jobs().  Only initialized if GALLIUM_PARALLEL_LINK is set.
+    */
+   struct util_queue link_queue;
 };
 
 
@@ -418,6 +446,12 @@ st_save_zombie_shader(struct st_context *st,
 void
 st_context_free_zombie_objects(struct st_context *st);
 
+typedef void (*st_link_job_func)(void *data, unsigned index);
+
+extern void
+st_link_run_jobs(struct st_context *st, unsigned count,
+                 st_link_job_func func, void *data);
+
 
 
 /**
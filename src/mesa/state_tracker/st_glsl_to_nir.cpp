@@ -245,48 +245,64 @@ st_nir_assign_uniform_locations(struct gl_context *ctx,
 void
 st_nir_opts(nir_shader *nir)
 {
+   nir_pass_manager pm;
    bool progress;
 
+   nir_pass_manager_init(&pm, nir);
+
    do {
       progress = false;
 
-      NIR_PASS_V(nir, nir_lower_vars_to_ssa);
-      
+      NIR_LOOP_PASS_V(&pm, nir_pass_dep_var_access, nir_lower_vars_to_ssa);
+
       /* Linking deals with unused inputs/outputs, but here we can remove
        * things local to the shader in the hopes that we can cleanup other
        * things. This pass will also remove variables with only stores, so we
        * might be able to make progress after it.
        */
-      NIR_PASS(progress, nir, nir_remove_dead_variables,
-               (nir_variable_mode)(nir_var_function_temp |
-                                   nir_var_shader_temp |
-                                   nir_var_mem_shared));
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_var_access,
+                    nir_remove_dead_variables,
+                    (nir_variable_mode)(nir_var_function_temp |
+                                        nir_var_shader_temp |
+                                        nir_var_mem_shared));
 
-      NIR_PASS(progress, nir, nir_opt_copy_prop_vars);
-      NIR_PASS(progress, nir, nir_opt_dead_write_vars);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_var_access,
+                    nir_opt_copy_prop_vars);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_var_access,
+                    nir_opt_dead_write_vars);
 
       if (nir->options->lower_to_scalar) {
-         NIR_PASS_V(nir, nir_lower_alu_to_scalar, NULL, NULL);
-         NIR_PASS_V(nir, nir_lower_phis_to_scalar);
+         NIR_LOOP_PASS_V(&pm, nir_pass_dep_alu,
+                         nir_lower_alu_to_scalar, NULL, NULL);
+         NIR_LOOP_PASS_V(&pm, nir_pass_dep_all, nir_lower_phis_to_scalar);
       }
 
-      NIR_PASS_V(nir, nir_lower_alu);
-      NIR_PASS_V(nir, nir_lower_pack);
-      NIR_PASS(progress, nir, nir_copy_prop);
-      NIR_PASS(progress, nir, nir_opt_remove_phis);
-      NIR_PASS(progress, nir, nir_opt_dce);
-      if (nir_opt_trivial_continues(nir)) {
+      NIR_LOOP_PASS_V(&pm, nir_pass_dep_alu, nir_lower_alu);
+      NIR_LOOP_PASS_V(&pm, nir_pass_dep_alu, nir_lower_pack);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_copy_prop);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_phi | nir_pass_dep_cf,
+                    nir_opt_remove_phis);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_dce);
+
+      bool trivial_continues_progress = false;
+      NIR_LOOP_PASS(trivial_continues_progress, &pm, nir_pass_dep_all,
+                    nir_opt_trivial_continues);
+      if (trivial_continues_progress) {
          progress = true;
-         NIR_PASS(progress, nir, nir_copy_prop);
-         NIR_PASS(progress, nir, nir_opt_dce);
+         NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_copy_prop);
+         NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_dce);
       }
-      NIR_PASS(progress, nir, nir_opt_if, false);
-      NIR_PASS(progress, nir, nir_opt_dead_cf);
-      NIR_PASS(progress, nir, nir_opt_cse);
-      NIR_PASS(progress, nir, nir_opt_peephole_select, 8, true, true);
-
-      NIR_PASS(progress, nir, nir_opt_algebraic);
-      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_if, false);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_dead_cf);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_cse);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                    nir_opt_peephole_select, 8, true, true);
+
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_algebraic);
+      NIR_LOOP_PASS(progress, &pm,
+                    nir_pass_dep_alu | nir_pass_dep_intrinsic |
+                    nir_pass_dep_load_const,
+                    nir_opt_constant_folding);
 
       if (!nir->info.flrp_lowered) {
          unsigned lower_flrp =
@@ -297,13 +313,16 @@ st_nir_opts(nir_shader *nir)
          if (lower_flrp) {
             bool lower_flrp_progress = false;
 
-            NIR_PASS(lower_flrp_progress, nir, nir_lower_flrp,
-                     lower_flrp,
-                     false /* always_precise */,
-                     nir->options->lower_ffma);
+            NIR_LOOP_PASS(lower_flrp_progress, &pm, nir_pass_dep_all,
+                          nir_lower_flrp,
+                          lower_flrp,
+                          false /* always_precise */,
+                          nir->options->lower_ffma);
             if (lower_flrp_progress) {
-               NIR_PASS(progress, nir,
-                        nir_opt_constant_folding);
+               NIR_LOOP_PASS(progress, &pm,
+                             nir_pass_dep_alu | nir_pass_dep_intrinsic |
+                             nir_pass_dep_load_const,
+                             nir_opt_constant_folding);
                progress = true;
             }
          }
@@ -314,10 +333,12 @@ st_nir_opts(nir_shader *nir)
          nir->info.flrp_lowered = true;
       }
 
-      NIR_PASS(progress, nir, nir_opt_undef);
-      NIR_PASS(progress, nir, nir_opt_conditional_discard);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all, nir_opt_undef);
+      NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                    nir_opt_conditional_discard);
       if (nir->options->max_unroll_iterations) {
-         NIR_PASS(progress, nir, nir_opt_loop_unroll, (nir_variable_mode)0);
+         NIR_LOOP_PASS(progress, &pm, nir_pass_dep_all,
+                       nir_opt_loop_unroll, (nir_variable_mode)0);
       }
    } while (progress);
 }
@@ -474,6 +495,16 @@ st_glsl_to_nir_post_opts(struct st_context *st, struct gl_program *prog,
    _mesa_associate_uniform_storage(st->ctx, shader_program, prog);
 
    st_set_prog_affected_state_flags(prog);
+}
+
+/* Lowering after st_glsl_to_nir_post_opts().  This only touches the NIR
+ * and the gl_program of the stage, so the stages can be lowered in parallel.
+ */
+static void
+st_glsl_to_nir_post_opts_lower(struct st_context *st, struct gl_program *prog,
+                               struct gl_shader_program *shader_program)
+{
+   nir_shader *nir = prog->nir;
 
    /* None of the builtins being lowered here can be produced by SPIR-V.  See
     * _mesa_builtin_uniform_desc.
@@ -512,15 +543,22 @@ st_glsl_to_nir_post_opts(struct st_context *st, struct gl_program *prog,
 
    if (st->allow_st_finalize_nir_twice)
       st_finalize_nir(st, prog, shader_program, nir, true);
+}
 
-   if (st->ctx->_Shader->Flags & GLSL_DUMP) {
-      _mesa_log("\n");
-      _mesa_log("NIR IR for linked %s program %d:\n",
-             _mesa_shader_stage_to_string(prog->info.stage),
-             shader_program->Name);
-      nir_print_shader(nir, _mesa_get_log_file());
-      _mesa_log("\n\n");
-   }
+struct st_link_nir_state {
+   struct st_context *st;
+   struct gl_shader_program *shader_program;
+   struct gl_linked_shader **linked_shader;
+};
+
+static void
+st_glsl_to_nir_post_opts_lower_job(void *data, unsigned index)
+{
+   struct st_link_nir_state *state = (struct st_link_nir_state *)data;
+
+   st_glsl_to_nir_post_opts_lower(state->st,
+                                  state->linked_shader[index]->Program,
+                                  state->shader_program);
 }
 
 static void
@@ -546,7 +584,24 @@ st_nir_vectorize_io(nir_shader *producer, nir_shader *consumer)
 }
 
 static void
-st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
+st_nir_opts_job(void *data, unsigned index)
+{
+   st_nir_opts(((nir_shader **)data)[index]);
+}
+
+/* Optimizes both shaders, in parallel if possible. */
+static void
+st_nir_opts_pair(struct st_context *st, nir_shader *producer,
+                 nir_shader *consumer)
+{
+   nir_shader *shaders[2] = { producer, consumer };
+
+   st_link_run_jobs(st, 2, st_nir_opts_job, shaders);
+}
+
+static void
+st_nir_link_shaders(struct st_context *st, nir_shader *producer,
+                    nir_shader *consumer)
 {
    if (producer->options->lower_to_scalar) {
       NIR_PASS_V(producer, nir_lower_io_to_scalar_early, nir_var_shader_out);
@@ -555,8 +610,7 @@ st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
 
    nir_lower_io_arrays_to_elements(producer, consumer);
 
-   st_nir_opts(producer);
-   st_nir_opts(consumer);
+   st_nir_opts_pair(st, producer, consumer);
 
    if (nir_link_opt_varyings(producer, consumer))
       st_nir_opts(consumer);
@@ -568,8 +622,7 @@ st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
       NIR_PASS_V(producer, nir_lower_global_vars_to_local);
       NIR_PASS_V(consumer, nir_lower_global_vars_to_local);
 
-      st_nir_opts(producer);
-      st_nir_opts(consumer);
+      st_nir_opts_pair(st, producer, consumer);
 
       /* Optimizations can cause varyings to become unused.
        * nir_compact_varyings() depends on all dead varyings being removed so
@@ -719,7 +772,7 @@ st_link_nir(struct gl_context *ctx,
     * stage.
     */
    for (int i = num_shaders - 2; i >= 0; i--) {
-      st_nir_link_shaders(linked_shader[i]->Program->nir,
+      st_nir_link_shaders(st, linked_shader[i]->Program->nir,
                           linked_shader[i + 1]->Program->nir);
    }
    /* Linking shaders also optimizes them. Separate shaders, compute shaders
@@ -813,11 +866,26 @@ st_link_nir(struct gl_context *ctx,
       prev_info = info;
    }
 
+   for (unsigned i = 0; i < num_shaders; i++)
+      st_glsl_to_nir_post_opts(st, linked_shader[i]->Program, shader_program);
+
+   struct st_link_nir_state state = { st, shader_program, linked_shader };
+   st_link_run_jobs(st, num_shaders, st_glsl_to_nir_post_opts_lower_job,
+                    &state);
+
    for (unsigned i = 0; i < num_shaders; i++) {
       struct gl_linked_shader *shader = linked_shader[i];
       struct gl_program *prog = shader->Program;
       struct st_program *stp = st_program(prog);
-      st_glsl_to_nir_post_opts(st, prog, shader_program);
+
+      if (ctx->_Shader->Flags & GLSL_DUMP) {
+         _mesa_log("\n");
+         _mesa_log("NIR IR for linked %s program %d:\n",
+                   _mesa_shader_stage_to_string(prog->info.stage),
+                   shader_program->Name);
+         nir_print_shader(prog->nir, _mesa_get_log_file());
+         _mesa_log("\n\n");
+      }
 
       /* Initialize st_vertex_program members. */
       if (shader->Stage == MESA_SHADER_VERTEX)
@@ -323,6 +323,13 @@ st_release_variants(struct st_context *st, struct st_program *p)
 
    p->variants = NULL;
 
+   /* The program may be retranslated, so analyze it again. */
+   p->inlinable_uniforms_analyzed = false;
+   p->num_inlinable_uniforms = 0;
+   simple_mtx_lock(&p->inline_mutex);
+   p->num_inlined_variants = 0;
+   simple_mtx_unlock(&p->inline_mutex);
+
    if (p->state.tokens) {
       ureg_free_tokens(p->state.tokens);
       p->state.tokens = NULL;
@@ -645,6 +652,182 @@ st_translate_vertex_program(struct st_context *st,
    return stp->state.tokens != NULL;
 }
 
+static bool
+st_is_uniform_dw(struct gl_program_parameter_list *params, unsigned dw)
+{
+   for (unsigned i = 0; i < params->NumParameters; i++) {
+      unsigned offset = params->ParameterValueOffset[i];
+
+      if (dw >= offset && dw < offset + params->Parameters[i].Size)
+         return params->Parameters[i].Type == PROGRAM_UNIFORM;
+   }
+
+   return false;
+}
+
+/**
+ * Find the uniforms controlling the branches and loops of the program,
+ * which its variants can be specialised on.  This is done once, on the
+ * first NIR shader variants are created from.
+ */
+static void
+st_find_inlinable_uniforms(struct st_context *st, struct st_program *stp,
+                           nir_shader *nir)
+{
+   if (stp->inlinable_uniforms_analyzed)
+      return;
+
+   stp->inlinable_uniforms_analyzed = true;
+   stp->num_inlinable_uniforms = 0;
+
+   /* Subroutine indices are only written when constants are uploaded. */
+   if (!st->inline_uniforms || stp->Base.sh.NumSubroutineUniformRemapTable)
+      return;
+
+   uint32_t dw_offsets[ST_MAX_INLINABLE_UNIFORMS];
+   unsigned num = nir_find_inlinable_uniforms(nir, dw_offsets,
+                                              ST_MAX_INLINABLE_UNIFORMS);
+
+   /* Likewise for state parameters, so only inline the uniforms set by the
+    * application.
+    */
+   for (unsigned i = 0; i < num; i++) {
+      if (st_is_uniform_dw(stp->Base.Parameters, dw_offsets[i])) {
+         stp->inlinable_uniform_dw_offsets[stp->num_inlinable_uniforms++] =
+            dw_offsets[i];
+      }
+   }
+}
+
+/**
+ * Specialise the shader on the given values of the inlinable uniforms, and
+ * remove the control flow depending on them.
+ */
+static void
+st_nir_inline_uniforms(struct st_program *stp, nir_shader *nir,
+                       const uint32_t *values)
+{
+   NIR_PASS_V(nir, nir_opt_constant_folding);
+   NIR_PASS_V(nir, nir_inline_uniforms, stp->num_inlinable_uniforms, values,
+              stp->inlinable_uniform_dw_offsets);
+
+   /* This folds the branches, and unrolls the loops which got a constant
+    * trip count.
+    */
+   st_nir_opts(nir);
+}
+
+static void
+get_inlinable_uniform_values(struct st_program *stp, uint32_t *values)
+{
+   const gl_constant_value *params = stp->Base.Parameters->ParameterValues;
+
+   for (unsigned i = 0; i < stp->num_inlinable_uniforms; i++)
+      values[i] = params[stp->inlinable_uniform_dw_offsets[i]].u;
+}
+
+/* The caller must hold inline_mutex. */
+static bool
+has_inlined_variant(struct st_program *stp, const uint32_t *values)
+{
+   unsigned size = stp->num_inlinable_uniforms * sizeof(uint32_t);
+
+   for (unsigned i = 0; i < stp->num_inlined_variants; i++) {
+      if (!memcmp(stp->inlined_uniform_values[i], values, size))
+         return true;
+   }
+   return false;
+}
+
+/**
+ * Decide whether the program should use a variant specialised on the
+ * current values of its inlinable uniforms, and return them in values.
+ *
+ * Specialising on values which change all the time would only waste
+ * compile time, so a variant is only created once the same values have been
+ * seen by ST_INLINE_UNIFORMS_MIN_DRAWS consecutive validations, and for at
+ * most ST_MAX_INLINED_VARIANTS sets of values.  The generic variant is used
+ * otherwise.
+ */
+bool
+st_get_inlined_uniform_values(struct st_context *st, struct st_program *stp,
+                              uint32_t *values)
+{
+   unsigned size = stp->num_inlinable_uniforms * sizeof(uint32_t);
+   uint32_t current[ST_MAX_INLINABLE_UNIFORMS];
+
+   if (!stp->num_inlinable_uniforms)
+      return false;
+
+   get_inlinable_uniform_values(stp, current);
+
+   struct st_inlined_uniforms_state *state =
+      &st->inlined_uniforms[stp->Base.info.stage];
+
+   if (state->prog != &stp->Base || memcmp(state->values, current, size)) {
+      state->prog = &stp->Base;
+      memcpy(state->values, current, size);
+      state->draws = 0;
+   }
+
+   if (state->draws < ST_INLINE_UNIFORMS_MIN_DRAWS)
+      state->draws++;
+
+   simple_mtx_lock(&stp->inline_mutex);
+   bool inlined = has_inlined_variant(stp, current);
+   if (!inlined && state->draws == ST_INLINE_UNIFORMS_MIN_DRAWS &&
+       stp->num_inlined_variants < ST_MAX_INLINED_VARIANTS) {
+      memcpy(stp->inlined_uniform_values[stp->num_inlined_variants++],
+             current, size);
+      inlined = true;
+   }
+   simple_mtx_unlock(&stp->inline_mutex);
+
+   state->inlined = inlined;
+   if (inlined)
+      memcpy(values, current, size);
+   return inlined;
+}
+
+/**
+ * Return whether the variant bound for the program may have to change,
+ * because its constants changed or because it is still waiting for stable
+ * values to specialise on.
+ */
+bool
+st_inlined_uniforms_need_update(struct st_context *st, struct st_program *stp,
+                                bool constants_changed)
+{
+   struct st_inlined_uniforms_state *state =
+      &st->inlined_uniforms[stp->Base.info.stage];
+
+   if (state->prog != &stp->Base)
+      return true;
+
+   if (constants_changed) {
+      unsigned size = stp->num_inlinable_uniforms * sizeof(uint32_t);
+      uint32_t current[ST_MAX_INLINABLE_UNIFORMS];
+
+      get_inlinable_uniform_values(stp, current);
+      if (memcmp(state->values, current, size)) {
+         /* A specialised variant doesn't match the new values anymore.  The
+          * generic one only has to be replaced if a variant may be created
+          * or already exists for them.
+          */
+         if (state->inlined)
+            return true;
+
+         simple_mtx_lock(&stp->inline_mutex);
+         bool update = stp->num_inlined_variants < ST_MAX_INLINED_VARIANTS ||
+                       has_inlined_variant(stp, current);
+         simple_mtx_unlock(&stp->inline_mutex);
+         return update;
+      }
+   }
+
+   return state->draws < ST_INLINE_UNIFORMS_MIN_DRAWS;
+}
+
 static struct nir_shader *
 get_nir_shader(struct st_context *st, struct st_program *stp)
 {
@@ -665,7 +848,7 @@ get_nir_shader(struct st_context *st, struct st_program *stp)
       st->ctx->Const.ShaderCompilerOptions[stp->Base.info.stage].NirOptions;
 
    blob_reader_init(&blob_reader, stp->serialized_nir, stp->serialized_nir_size);
-   return nir_deserialize(NULL, options, &blob_reader);
+   return nir_deserialize_entrypoint(NULL, options, &blob_reader);
 }
 
 static const gl_state_index16 depth_range_state[STATE_LENGTH] =
@@ -695,6 +878,14 @@ st_create_vp_variant(struct st_context *st,
 
       state.type = PIPE_SHADER_IR_NIR;
       state.ir.nir = get_nir_shader(st, stvp);
+      st_find_inlinable_uniforms(st, stvp, state.ir.nir);
+
+      if (key->inline_uniforms) {
+         st_nir_inline_uniforms(stvp, state.ir.nir,
+                                key->inlined_uniform_values);
+         finalize = true;
+      }
+
       if (key->clamp_color) {
          NIR_PASS_V(state.ir.nir, nir_lower_clamp_color_outputs);
          finalize = true;
@@ -1253,6 +1444,13 @@ st_create_fp_variant(struct st_context *st,
 
       state.type = PIPE_SHADER_IR_NIR;
       state.ir.nir = get_nir_shader(st, stfp);
+      st_find_inlinable_uniforms(st, stfp, state.ir.nir);
+
+      if (key->inline_uniforms) {
+         st_nir_inline_uniforms(stfp, state.ir.nir,
+                                key->inlined_uniform_values);
+         finalize = true;
+      }
 
       if (key->clamp_color) {
          NIR_PASS_V(state.ir.nir, nir_lower_clamp_color_outputs);
@@ -1784,6 +1982,13 @@ st_get_common_variant(struct st_context *st,
 
 	    state.type = PIPE_SHADER_IR_NIR;
 	    state.ir.nir = get_nir_shader(st, prog);
+            st_find_inlinable_uniforms(st, prog, state.ir.nir);
+
+            if (key->inline_uniforms) {
+               st_nir_inline_uniforms(prog, state.ir.nir,
+                                      key->inlined_uniform_values);
+               finalize = true;
+            }
 
             if (key->clamp_color) {
                NIR_PASS_V(state.ir.nir, nir_lower_clamp_color_outputs);
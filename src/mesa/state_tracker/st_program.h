@@ -49,6 +49,15 @@ extern "C" {
 
 #define ST_DOUBLE_ATTRIB_PLACEHOLDER 0xff
 
+/** Uniform inlining limit, per program */
+#define ST_MAX_INLINED_VARIANTS 8
+
+/**
+ * Number of consecutive shader validations which must see the same uniform
+ * values before a variant is specialised on them.
+ */
+#define ST_INLINE_UNIFORMS_MIN_DRAWS 4
+
 struct st_external_sampler_key
 {
    GLuint lower_nv12;             /**< bitmask of 2 plane YUV samplers */
@@ -143,6 +152,10 @@ struct st_fp_variant_key
    char texture_targets[MAX_NUM_FRAGMENT_REGISTERS_ATI];
 
    struct st_external_sampler_key external;
+
+   /** for uniform inlining */
+   GLuint inline_uniforms:1;
+   uint32_t inlined_uniform_values[ST_MAX_INLINABLE_UNIFORMS];
 };
 
 /**
@@ -201,6 +214,10 @@ struct st_common_variant_key
     * not for the driver.
     */
    bool is_draw_shader;
+
+   /** for uniform inlining */
+   bool inline_uniforms;
+   uint32_t inlined_uniform_values[ST_MAX_INLINABLE_UNIFORMS];
 };
 
 
@@ -239,6 +256,20 @@ struct st_program
    struct gl_shader_program *shader_program;
 
    struct st_variant *variants;
+
+   /** Uniform inlining, see st_get_inlined_uniform_values() */
+   bool inlinable_uniforms_analyzed;
+   unsigned num_inlinable_uniforms;
+   uint32_t inlinable_uniform_dw_offsets[ST_MAX_INLINABLE_UNIFORMS];
+
+   /**
+    * Values which have specialised variants.  Programs are shared between
+    * contexts, so these are protected by inline_mutex.
+    */
+   simple_mtx_t inline_mutex;
+   unsigned num_inlined_variants;
+   uint32_t inlined_uniform_values[ST_MAX_INLINED_VARIANTS]
+                                  [ST_MAX_INLINABLE_UNIFORMS];
 };
 
 
@@ -314,6 +345,14 @@ st_get_common_variant(struct st_context *st,
                       struct st_program *p,
                       const struct st_common_variant_key *key);
 
+extern bool
+st_get_inlined_uniform_values(struct st_context *st, struct st_program *p,
+                              uint32_t *values);
+
+extern bool
+st_inlined_uniforms_need_update(struct st_context *st, struct st_program *p,
+                                bool constants_changed);
+
 extern void
 st_release_variants(struct st_context *st, struct st_program *p);
 
@@ -42,18 +42,27 @@
 
 #ifdef HAVE_ZSTD
 #include "zstd.h"
+#include "zdict.h"
 #endif
 
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/list.h"
+#include "util/macros.h"
+#include "util/os_time.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
+#include "util/u_dynarray.h"
 #include "util/u_queue.h"
 #include "util/mesa-sha1.h"
 #include "util/ralloc.h"
+#include "util/simple_mtx.h"
 #include "util/compiler.h"
 
 #include "disk_cache.h"
+#include "disk_cache_journal.h"
+#include "disk_cache_pack.h"
 
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
@@ -76,10 +85,42 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
 
-/* 3 is the recomended level, with 22 as the absolute maximum */
-#define ZSTD_COMPRESSION_LEVEL 3
+/* Compression levels accepted in MESA_GLSL_CACHE_COMPRESSION_LEVEL. For
+ * zstd, 3 is the recomended level, with 22 as the absolute maximum.
+ */
+#ifdef HAVE_ZSTD
+#define MIN_COMPRESSION_LEVEL 1
+#define MAX_COMPRESSION_LEVEL ZSTD_maxCLevel()
+#define DEFAULT_COMPRESSION_LEVEL 3
+#else
+#define MIN_COMPRESSION_LEVEL Z_NO_COMPRESSION
+#define MAX_COMPRESSION_LEVEL Z_BEST_COMPRESSION
+#define DEFAULT_COMPRESSION_LEVEL Z_BEST_COMPRESSION
+#endif
+
+/* Entries up to this size are used as samples to train the shared
+ * dictionary, bigger ones compress well enough on their own.
+ */
+#define DICT_MAX_SAMPLE_SIZE (16 * 1024)
+
+/* Number of samples collected before training the dictionary. */
+#define DICT_NUM_SAMPLES 256
+
+/* Maximum size of the trained dictionary. */
+#define DICT_MAX_SIZE (64 * 1024)
+
+#ifdef HAVE_ZSTD
+struct disk_cache_dict {
+   uint32_t id;
+   ZSTD_CDict *cdict;
+   ZSTD_DDict *ddict;
+};
+#endif
+
+/* Default size of the in-memory cache in front of the disk. */
+#define CACHE_MEM_DEFAULT_MAX_SIZE (16 * 1024 * 1024)
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -105,10 +146,56 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Once max_size is reached, entries are evicted down to this size. */
+   uint64_t low_size;
+
+   /* LRU journal of the file per entry layout, NULL if it couldn't be
+    * opened.
+    */
+   struct disk_cache_journal *journal;
+
+   /* Packed storage, replacing the file per entry layout when
+    * MESA_GLSL_CACHE_PACKED is set.
+    */
+   struct disk_cache_pack *pack;
+
+   /* In-memory LRU cache of recently read items, so that repeated lookups
+    * of the same key don't read and inflate the entry again. Items are
+    * kept decompressed, most recently used first in mem_lru.
+    */
+   simple_mtx_t mem_lock;
+   struct hash_table *mem_ht;
+   struct list_head mem_lru;
+   uint64_t mem_size;
+   uint64_t mem_max_size;
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
 
+   /* Compression level, from MESA_GLSL_CACHE_COMPRESSION_LEVEL. */
+   int compression_level;
+
+   /* Updated atomically by the threads compressing and decompressing. */
+   struct disk_cache_stats stats;
+
+#ifdef HAVE_ZSTD
+   /* Shared dictionary for the entries of this driver, when
+    * MESA_GLSL_CACHE_DICT is set. It is kept in dict_path in the cache
+    * directory, or trained from the first small entries stored if there is
+    * none yet. Once set, it doesn't change until the cache is destroyed, so
+    * it is read without locking.
+    */
+   struct disk_cache_dict *dict;
+   char *dict_path;
+
+   /* Samples collected for training the dictionary. */
+   simple_mtx_t dict_lock;
+   bool dict_collecting;
+   struct util_dynarray dict_samples;
+   struct util_dynarray dict_sample_sizes;
+#endif
+
    disk_cache_put_cb blob_put_cb;
    disk_cache_get_cb blob_get_cb;
 };
@@ -129,6 +216,239 @@ struct disk_cache_put_job {
    struct cache_item_metadata cache_item_metadata;
 };
 
+struct disk_cache_get_job {
+   struct util_queue_fence fence;
+
+   struct disk_cache *cache;
+
+   cache_key key;
+
+   /* Uncompressed data read from disk, or NULL if the item wasn't found. */
+   void *data;
+
+   size_t size;
+};
+
+struct disk_cache_mem_entry {
+   struct list_head link;
+
+   cache_key key;
+
+   void *data;
+   size_t size;
+};
+
+static uint32_t
+mem_cache_key_hash(const void *key)
+{
+   /* Keys are SHA-1 hashes already, the first bytes will do. */
+   uint32_t hash;
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+mem_cache_key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+static void
+mem_cache_init(struct disk_cache *cache, uint64_t max_size)
+{
+   simple_mtx_init(&cache->mem_lock, mtx_plain);
+   list_inithead(&cache->mem_lru);
+   cache->mem_size = 0;
+   cache->mem_max_size = max_size;
+
+   if (max_size) {
+      cache->mem_ht = _mesa_hash_table_create(cache, mem_cache_key_hash,
+                                              mem_cache_key_equals);
+   }
+}
+
+static void
+mem_cache_finish(struct disk_cache *cache)
+{
+   list_for_each_entry_safe(struct disk_cache_mem_entry, entry,
+                            &cache->mem_lru, link) {
+      free(entry->data);
+      free(entry);
+   }
+
+   simple_mtx_destroy(&cache->mem_lock);
+}
+
+static void
+mem_cache_remove_entry(struct disk_cache *cache,
+                       struct disk_cache_mem_entry *entry)
+{
+   _mesa_hash_table_remove_key(cache->mem_ht, entry->key);
+   list_del(&entry->link);
+   cache->mem_size -= entry->size;
+
+   free(entry->data);
+   free(entry);
+}
+
+/* Return a malloc'ed copy of the item stored in memory for key, or NULL. */
+static void *
+mem_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct disk_cache_mem_entry *entry;
+   void *data = NULL;
+
+   if (!cache->mem_ht)
+      return NULL;
+
+   simple_mtx_lock(&cache->mem_lock);
+
+   struct hash_entry *he = _mesa_hash_table_search(cache->mem_ht, key);
+   if (he) {
+      entry = he->data;
+
+      data = malloc(entry->size);
+      if (data) {
+         memcpy(data, entry->data, entry->size);
+         if (size)
+            *size = entry->size;
+
+         list_del(&entry->link);
+         list_add(&entry->link, &cache->mem_lru);
+      }
+   }
+
+   simple_mtx_unlock(&cache->mem_lock);
+
+   return data;
+}
+
+static bool
+mem_cache_contains(struct disk_cache *cache, const cache_key key)
+{
+   bool found;
+
+   if (!cache->mem_ht)
+      return false;
+
+   simple_mtx_lock(&cache->mem_lock);
+   found = _mesa_hash_table_search(cache->mem_ht, key) != NULL;
+   simple_mtx_unlock(&cache->mem_lock);
+
+   return found;
+}
+
+/* Add an item to the memory cache, evicting the least recently used ones
+ * to make room for it. Takes ownership of the malloc'ed data.
+ */
+static void
+mem_cache_insert(struct disk_cache *cache, const cache_key key,
+                 void *data, size_t size)
+{
+   struct disk_cache_mem_entry *entry;
+
+   if (!cache->mem_ht || size > cache->mem_max_size / 4) {
+      free(data);
+      return;
+   }
+
+   entry = malloc(sizeof(*entry));
+   if (!entry) {
+      free(data);
+      return;
+   }
+
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   entry->data = data;
+   entry->size = size;
+
+   simple_mtx_lock(&cache->mem_lock);
+
+   if (_mesa_hash_table_search(cache->mem_ht, key)) {
+      simple_mtx_unlock(&cache->mem_lock);
+      free(data);
+      free(entry);
+      return;
+   }
+
+   while (cache->mem_size + size > cache->mem_max_size) {
+      mem_cache_remove_entry(cache,
+                             LIST_ENTRY(struct disk_cache_mem_entry,
+                                        cache->mem_lru.prev, link));
+   }
+
+   _mesa_hash_table_insert(cache->mem_ht, entry->key, entry);
+   list_add(&entry->link, &cache->mem_lru);
+   cache->mem_size += size;
+
+   simple_mtx_unlock(&cache->mem_lock);
+}
+
+static void
+mem_cache_insert_copy(struct disk_cache *cache, const cache_key key,
+                      const void *data, size_t size)
+{
+   void *copy;
+
+   if (!cache->mem_ht || size > cache->mem_max_size / 4)
+      return;
+
+   copy = malloc(size);
+   if (!copy)
+      return;
+
+   memcpy(copy, data, size);
+   mem_cache_insert(cache, key, copy, size);
+}
+
+static void
+mem_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   if (!cache->mem_ht)
+      return;
+
+   simple_mtx_lock(&cache->mem_lock);
+
+   struct hash_entry *he = _mesa_hash_table_search(cache->mem_ht, key);
+   if (he)
+      mem_cache_remove_entry(cache, he->data);
+
+   simple_mtx_unlock(&cache->mem_lock);
+}
+
+/* Parse a size with an optional K, M or G suffix, defaulting to G. Returns
+ * 0 if the string isn't a number.
+ */
+static uint64_t
+parse_size_str(const char *str)
+{
+   uint64_t size;
+   char *end;
+
+   size = strtoul(str, &end, 10);
+   if (end == str)
+      return 0;
+
+   switch (*end) {
+   case 'K':
+   case 'k':
+      size *= 1024;
+      break;
+   case 'M':
+   case 'm':
+      size *= 1024*1024;
+      break;
+   case '\0':
+   case 'G':
+   case 'g':
+   default:
+      size *= 1024*1024*1024;
+      break;
+   }
+
+   return size;
+}
+
 /* Create a directory named 'path' if it does not already exist.
  *
  * Returns: 0 if path already exists as a directory or if created.
@@ -189,6 +509,213 @@ concatenate_and_mkdir(void *ctx, const char *path, const char *name)
       return NULL;
 }
 
+static ssize_t
+read_all(int fd, void *buf, size_t count)
+{
+   char *in = buf;
+   ssize_t read_ret;
+   size_t done;
+
+   for (done = 0; done < count; done += read_ret) {
+      read_ret = read(fd, in + done, count - done);
+      if (read_ret == -1 || read_ret == 0)
+         return -1;
+   }
+   return done;
+}
+
+static ssize_t
+write_all(int fd, const void *buf, size_t count)
+{
+   const char *out = buf;
+   ssize_t written;
+   size_t done;
+
+   for (done = 0; done < count; done += written) {
+      written = write(fd, out + done, count - done);
+      if (written == -1)
+         return -1;
+   }
+   return done;
+}
+
+#ifdef HAVE_ZSTD
+static bool
+dict_set(struct disk_cache *cache, const void *data, size_t size)
+{
+   struct disk_cache_dict *dict = malloc(sizeof(*dict));
+   if (dict == NULL)
+      return false;
+
+   dict->id = ZDICT_getDictID(data, size);
+   dict->cdict = ZSTD_createCDict(data, size, cache->compression_level);
+   dict->ddict = ZSTD_createDDict(data, size);
+   if (dict->id == 0 || dict->cdict == NULL || dict->ddict == NULL) {
+      ZSTD_freeCDict(dict->cdict);
+      ZSTD_freeDDict(dict->ddict);
+      free(dict);
+      return false;
+   }
+
+   /* The cmpxchg makes sure the dictionary is complete before others see
+    * it.
+    */
+   if (p_atomic_cmpxchg(&cache->dict, NULL, dict) != NULL) {
+      ZSTD_freeCDict(dict->cdict);
+      ZSTD_freeDDict(dict->ddict);
+      free(dict);
+   }
+   return true;
+}
+
+static bool
+dict_load(struct disk_cache *cache)
+{
+   struct stat sb;
+   void *data = NULL;
+   bool ret = false;
+
+   int fd = open(cache->dict_path, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return false;
+
+   if (fstat(fd, &sb) == -1 || sb.st_size == 0 || sb.st_size > DICT_MAX_SIZE)
+      goto done;
+
+   data = malloc(sb.st_size);
+   if (data == NULL || read_all(fd, data, sb.st_size) == -1)
+      goto done;
+
+   ret = dict_set(cache, data, sb.st_size);
+
+ done:
+   free(data);
+   close(fd);
+   return ret;
+}
+
+/* Trains a dictionary from the collected samples and stores it in the cache
+ * directory. If another process stored one first, that one is used instead,
+ * so that all processes end up with the same dictionary.
+ */
+static void
+dict_train(struct disk_cache *cache)
+{
+   unsigned num_samples =
+      util_dynarray_num_elements(&cache->dict_sample_sizes, size_t);
+   char *filename_tmp = NULL;
+   int fd = -1;
+
+   void *data = malloc(DICT_MAX_SIZE);
+   if (data == NULL)
+      return;
+
+   size_t size = ZDICT_trainFromBuffer(data, DICT_MAX_SIZE,
+                                       cache->dict_samples.data,
+                                       cache->dict_sample_sizes.data,
+                                       num_samples);
+   if (ZDICT_isError(size))
+      goto done;
+
+   if (asprintf(&filename_tmp, "%s.%d.tmp", cache->dict_path,
+                (int) getpid()) == -1) {
+      filename_tmp = NULL;
+      goto done;
+   }
+
+   fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1)
+      goto done;
+
+   if (write_all(fd, data, size) == -1) {
+      unlink(filename_tmp);
+      goto done;
+   }
+
+   /* Unlike rename(), link() doesn't replace a dictionary stored by
+    * another process in the meantime.
+    */
+   if (link(filename_tmp, cache->dict_path) == 0)
+      dict_set(cache, data, size);
+   else if (errno == EEXIST)
+      dict_load(cache);
+
+   unlink(filename_tmp);
+
+ done:
+   if (fd != -1)
+      close(fd);
+   free(filename_tmp);
+   free(data);
+}
+
+static void
+dict_init(struct disk_cache *cache)
+{
+   unsigned char sha1[20];
+   char buf[41];
+
+   /* Dictionaries are per driver, look them up by the hash of the driver
+    * keys.
+    */
+   _mesa_sha1_compute(cache->driver_keys_blob, cache->driver_keys_blob_size,
+                      sha1);
+   _mesa_sha1_format(buf, sha1);
+
+   cache->dict_path = ralloc_asprintf(cache, "%s/dict-%s", cache->path, buf);
+   if (cache->dict_path == NULL)
+      return;
+
+   simple_mtx_init(&cache->dict_lock, mtx_plain);
+   util_dynarray_init(&cache->dict_samples, cache);
+   util_dynarray_init(&cache->dict_sample_sizes, cache);
+
+   if (!dict_load(cache))
+      cache->dict_collecting = true;
+}
+
+static void
+dict_finish(struct disk_cache *cache)
+{
+   if (cache->dict) {
+      ZSTD_freeCDict(cache->dict->cdict);
+      ZSTD_freeDDict(cache->dict->ddict);
+      free(cache->dict);
+   }
+   simple_mtx_destroy(&cache->dict_lock);
+}
+
+static void
+dict_add_sample(struct disk_cache *cache, const void *data, size_t size)
+{
+   if (!p_atomic_read(&cache->dict_collecting) ||
+       size > DICT_MAX_SAMPLE_SIZE)
+      return;
+
+   simple_mtx_lock(&cache->dict_lock);
+
+   if (cache->dict_collecting) {
+      memcpy(util_dynarray_grow_bytes(&cache->dict_samples, 1, size),
+             data, size);
+      util_dynarray_append(&cache->dict_sample_sizes, size_t, size);
+
+      if (util_dynarray_num_elements(&cache->dict_sample_sizes, size_t) ==
+          DICT_NUM_SAMPLES) {
+         dict_train(cache);
+
+         /* Only try once, if there are too few distinct samples to train a
+          * dictionary from, waiting for more won't help much.
+          */
+         cache->dict_collecting = false;
+         util_dynarray_fini(&cache->dict_samples);
+         util_dynarray_fini(&cache->dict_sample_sizes);
+      }
+   }
+
+   simple_mtx_unlock(&cache->dict_lock);
+}
+#endif
+
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -201,8 +728,9 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
 {
    void *local;
    struct disk_cache *cache = NULL;
-   char *path, *max_size_str;
-   uint64_t max_size;
+   char *path, *max_size_str, *mem_size_str;
+   const char *low_size_str;
+   uint64_t max_size, low_size, mem_max_size;
    int fd = -1;
    struct stat sb;
    size_t size;
@@ -341,31 +869,18 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    cache->stored_keys = cache->index_mmap + sizeof(uint64_t);
 
    max_size = 0;
+   low_size = 0;
 
+   /* The maximum size can be followed by a low watermark, as in "1G,768M",
+    * which eviction frees space down to once the maximum is reached.
+    */
    max_size_str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
    if (max_size_str) {
-      char *end;
-      max_size = strtoul(max_size_str, &end, 10);
-      if (end == max_size_str) {
-         max_size = 0;
-      } else {
-         switch (*end) {
-         case 'K':
-         case 'k':
-            max_size *= 1024;
-            break;
-         case 'M':
-         case 'm':
-            max_size *= 1024*1024;
-            break;
-         case '\0':
-         case 'G':
-         case 'g':
-         default:
-            max_size *= 1024*1024*1024;
-            break;
-         }
-      }
+      max_size = parse_size_str(max_size_str);
+
+      low_size_str = strchr(max_size_str, ',');
+      if (low_size_str)
+         low_size = parse_size_str(low_size_str + 1);
    }
 
    /* Default to 1GB for maximum cache size. */
@@ -373,7 +888,27 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
       max_size = 1024*1024*1024;
    }
 
+   /* Default to evicting down to 7/8 of the maximum, so that a full cache
+    * doesn't have to evict on every put.
+    */
+   if (low_size == 0 || low_size > max_size)
+      low_size = max_size - max_size / 8;
+
    cache->max_size = max_size;
+   cache->low_size = low_size;
+
+   if (env_var_as_boolean("MESA_GLSL_CACHE_PACKED", false)) {
+      cache->pack = disk_cache_pack_open(cache->path, max_size, low_size);
+      if (cache->pack == NULL) {
+         munmap(cache->index_mmap, cache->index_mmap_size);
+         goto path_fail;
+      }
+   } else {
+      /* Without the journal, eviction falls back to walking the cache
+       * directories.
+       */
+      cache->journal = disk_cache_journal_open(cache->path);
+   }
 
    /* 4 threads were chosen below because just about all modern CPUs currently
     * available that run Mesa have *at least* 4 cores. For these CPUs allowing
@@ -388,7 +923,21 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    util_queue_init(&cache->cache_queue, "disk$", 32, 4,
                    UTIL_QUEUE_INIT_RESIZE_IF_FULL |
                    UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY |
-                   UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY);
+                   UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY |
+                   UTIL_QUEUE_INIT_WORK_STEALING);
+
+   /* Setting MESA_GLSL_CACHE_MEM_SIZE to 0 disables the memory cache. */
+   mem_max_size = CACHE_MEM_DEFAULT_MAX_SIZE;
+   mem_size_str = getenv("MESA_GLSL_CACHE_MEM_SIZE");
+   if (mem_size_str)
+      mem_max_size = parse_size_str(mem_size_str);
+
+   mem_cache_init(cache, mem_max_size);
+
+   cache->compression_level =
+      CLAMP((int)env_var_as_unsigned("MESA_GLSL_CACHE_COMPRESSION_LEVEL",
+                                     DEFAULT_COMPRESSION_LEVEL),
+            MIN_COMPRESSION_LEVEL, MAX_COMPRESSION_LEVEL);
 
    cache->path_init_failed = false;
 
@@ -427,6 +976,12 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+#ifdef HAVE_ZSTD
+   if (!cache->path_init_failed &&
+       env_var_as_boolean("MESA_GLSL_CACHE_DICT", false))
+      dict_init(cache);
+#endif
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
@@ -448,7 +1003,15 @@ disk_cache_destroy(struct disk_cache *cache)
    if (cache && !cache->path_init_failed) {
       util_queue_finish(&cache->cache_queue);
       util_queue_destroy(&cache->cache_queue);
+      disk_cache_pack_close(cache->pack);
+      if (cache->journal)
+         disk_cache_journal_close(cache->journal);
       munmap(cache->index_mmap, cache->index_mmap_size);
+      mem_cache_finish(cache);
+#ifdef HAVE_ZSTD
+      if (cache->dict_path)
+         dict_finish(cache);
+#endif
    }
 
    ralloc_free(cache);
@@ -684,8 +1247,8 @@ evict_lru_item(struct disk_cache *cache)
       p_atomic_add(cache->size, - (uint64_t)size);
 }
 
-void
-disk_cache_remove(struct disk_cache *cache, const cache_key key)
+static void
+unlink_cache_file(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
@@ -706,132 +1269,113 @@ disk_cache_remove(struct disk_cache *cache, const cache_key key)
       p_atomic_add(cache->size, - (uint64_t)sb.st_blocks * 512);
 }
 
-static ssize_t
-read_all(int fd, void *buf, size_t count)
+/* Evict entries until the cache is down to the low watermark, leaving room
+ * for needed more bytes. Evicting in batches means a full cache only pays
+ * for eviction every so often, rather than on every put.
+ */
+static void
+evict_lru_batch(struct disk_cache *cache, uint64_t needed)
 {
-   char *in = buf;
-   ssize_t read_ret;
-   size_t done;
+   uint64_t target = cache->low_size > needed ? cache->low_size - needed : 0;
+   cache_key key;
 
-   for (done = 0; done < count; done += read_ret) {
-      read_ret = read(fd, in + done, count - done);
-      if (read_ret == -1 || read_ret == 0)
-         return -1;
+   if (cache->journal) {
+      while (*cache->size > target &&
+             disk_cache_journal_pop_lru(cache->journal, key))
+         unlink_cache_file(cache, key);
    }
-   return done;
+
+   /* The journal doesn't know about entries stored before it existed, find
+    * those by walking the directories, as many as are needed to fit.
+    */
+   for (unsigned i = 0; i < 8 && *cache->size + needed > cache->max_size; i++)
+      evict_lru_item(cache);
 }
 
-static ssize_t
-write_all(int fd, const void *buf, size_t count)
+void
+disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
-   const char *out = buf;
-   ssize_t written;
-   size_t done;
+   mem_cache_remove(cache, key);
 
-   for (done = 0; done < count; done += written) {
-      written = write(fd, out + done, count - done);
-      if (written == -1)
-         return -1;
+   if (cache->pack) {
+      disk_cache_pack_remove(cache->pack, key);
+      return;
    }
-   return done;
-}
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
+   unlink_cache_file(cache, key);
+
+   if (cache->journal)
+      disk_cache_journal_remove(cache->journal, key);
+}
 
 /**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
+ * Compresses cache entry in memory. Returns a malloc'ed buffer holding the
+ * compressed data, or NULL on failure. \p dict_id is set to the ID of the
+ * dictionary used, or 0.
  */
-static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+static void *
+deflate_cache_data(struct disk_cache *cache, const void *in_data,
+                   size_t in_data_size, size_t *out_data_size,
+                   uint32_t *dict_id)
 {
-#ifdef HAVE_ZSTD
-   /* from the zstd docs (https://facebook.github.io/zstd/zstd_manual.html):
-    * compression runs faster if `dstCapacity` >= `ZSTD_compressBound(srcSize)`.
-    */
-   size_t out_size = ZSTD_compressBound(in_data_size);
-   void * out = malloc(out_size);
+   int64_t start = os_time_get_nano();
 
-   size_t ret = ZSTD_compress(out, out_size, in_data, in_data_size,
-                              ZSTD_COMPRESSION_LEVEL);
-   if (ZSTD_isError(ret)) {
-      free(out);
-      return 0;
-   }
-   ssize_t written = write_all(dest, out, ret);
-   if (written == -1) {
-      free(out);
-      return 0;
-   }
-   free(out);
-   return ret;
-#else
-   unsigned char *out;
+   *dict_id = 0;
 
-   /* allocate deflate state */
-   z_stream strm;
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
-   strm.next_in = (uint8_t *) in_data;
-   strm.avail_in = in_data_size;
-
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
-   if (ret != Z_OK)
-       return 0;
-
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-
-   out = malloc(BUFSIZE * sizeof(unsigned char));
+#ifdef HAVE_ZSTD
+   size_t out_size = ZSTD_compressBound(in_data_size);
+   void *out = malloc(out_size);
    if (out == NULL)
-      return 0;
-
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
+      return NULL;
 
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
+   const struct disk_cache_dict *dict = p_atomic_read(&cache->dict);
+   size_t ret;
+   if (dict) {
+      ZSTD_CCtx *cctx = ZSTD_createCCtx();
+      if (cctx == NULL) {
+         free(out);
+         return NULL;
+      }
 
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+      ret = ZSTD_compress_usingCDict(cctx, out, out_size, in_data,
+                                     in_data_size, dict->cdict);
+      ZSTD_freeCCtx(cctx);
+      *dict_id = dict->id;
+   } else {
+      ret = ZSTD_compress(out, out_size, in_data, in_data_size,
+                          cache->compression_level);
+   }
 
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
+   if (ZSTD_isError(ret)) {
+      free(out);
+      return NULL;
+   }
 
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            free(out);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
+   *out_data_size = ret;
+#else
+   uLongf out_size = compressBound(in_data_size);
+   void *out = malloc(out_size);
+   if (out == NULL)
+      return NULL;
 
-      /* all input should be used */
-      assert(strm.avail_in == 0);
+   int ret = compress2(out, &out_size, in_data, in_data_size,
+                       cache->compression_level);
+   if (ret != Z_OK) {
+      free(out);
+      return NULL;
+   }
 
-   } while (flush != Z_FINISH);
+   *out_data_size = out_size;
+#endif
 
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
+   p_atomic_inc(&cache->stats.compressed_entries);
+   if (*dict_id)
+      p_atomic_inc(&cache->stats.dict_entries);
+   p_atomic_add(&cache->stats.uncompressed_size, in_data_size);
+   p_atomic_add(&cache->stats.compressed_size, *out_data_size);
+   p_atomic_add(&cache->stats.compress_ns, os_time_get_nano() - start);
 
-   /* clean up and return */
-   (void)deflateEnd(&strm);
-   free(out);
-   return compressed_size;
-# endif
+   return out;
 }
 
 static struct disk_cache_put_job *
@@ -893,28 +1437,112 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+
+   /* ID of the shared dictionary the data was compressed with, or 0. */
+   uint32_t dict_id;
 };
 
+#define ITEM_CPY(_dst, _src, _src_size) \
+do {                                    \
+   memcpy(_dst, _src, _src_size);       \
+   _dst += _src_size;                   \
+} while (0);
+
+/**
+ * Serializes a cache entry into memory, in the same layout as the cache
+ * files: driver keys, item metadata, cache_entry_file_data and the
+ * compressed data. Returns a malloc'ed buffer, or NULL on failure.
+ */
+static uint8_t *
+create_cache_item(struct disk_cache_put_job *dc_job, size_t *item_size)
+{
+   struct disk_cache *cache = dc_job->cache;
+   size_t compressed_size;
+   void *compressed;
+   uint8_t *item, *ptr;
+   size_t size;
+
+   struct cache_entry_file_data cf_data;
+   compressed = deflate_cache_data(cache, dc_job->data, dc_job->size,
+                                   &compressed_size, &cf_data.dict_id);
+   if (compressed == NULL)
+      return NULL;
+
+   size = cache->driver_keys_blob_size + sizeof(uint32_t) +
+          sizeof(struct cache_entry_file_data) + compressed_size;
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      size += sizeof(uint32_t) +
+              dc_job->cache_item_metadata.num_keys * sizeof(cache_key);
+   }
+
+   item = malloc(size);
+   if (item == NULL) {
+      free(compressed);
+      return NULL;
+   }
+
+   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data.uncompressed_size = dc_job->size;
+
+   ptr = item;
+   ITEM_CPY(ptr, cache->driver_keys_blob, cache->driver_keys_blob_size)
+   ITEM_CPY(ptr, &dc_job->cache_item_metadata.type, sizeof(uint32_t))
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      ITEM_CPY(ptr, &dc_job->cache_item_metadata.num_keys, sizeof(uint32_t))
+      ITEM_CPY(ptr, dc_job->cache_item_metadata.keys[0],
+               dc_job->cache_item_metadata.num_keys * sizeof(cache_key))
+   }
+   ITEM_CPY(ptr, &cf_data, sizeof(cf_data))
+   ITEM_CPY(ptr, compressed, compressed_size)
+   assert(ptr == item + size);
+
+   free(compressed);
+
+   *item_size = size;
+   return item;
+}
+
+static void
+cache_put_packed(struct disk_cache_put_job *dc_job)
+{
+   size_t item_size;
+   uint8_t *item = create_cache_item(dc_job, &item_size);
+
+   if (item == NULL)
+      return;
+
+   disk_cache_pack_put(dc_job->cache->pack, dc_job->key, item, item_size);
+   free(item);
+}
+
 static void
 cache_put(void *job, int thread_index)
 {
    assert(job);
 
    int fd = -1, fd_final = -1, err, ret;
-   unsigned i = 0;
    char *filename = NULL, *filename_tmp = NULL;
+   void *compressed = NULL;
+   size_t compressed_size;
    struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
 
+#ifdef HAVE_ZSTD
+   if (dc_job->cache->dict_path)
+      dict_add_sample(dc_job->cache, dc_job->data, dc_job->size);
+#endif
+
+   if (dc_job->cache->pack) {
+      cache_put_packed(dc_job);
+      return;
+   }
+
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
       goto done;
 
    /* If the cache is too large, evict something else first. */
-   while (*dc_job->cache->size + dc_job->size > dc_job->cache->max_size &&
-          i < 8) {
-      evict_lru_item(dc_job->cache);
-      i++;
-   }
+   if (*dc_job->cache->size + dc_job->size > dc_job->cache->max_size)
+      evict_lru_batch(dc_job->cache, dc_job->size);
 
    /* Write to a temporary file to allow for an atomic rename to the
     * final destination filename, (to prevent any readers from seeing
@@ -1012,10 +1640,20 @@ cache_put(void *job, int thread_index)
       }
    }
 
+   /* Compress the data first, the header records which dictionary it was
+    * compressed with.
+    */
+   struct cache_entry_file_data cf_data;
+   compressed = deflate_cache_data(dc_job->cache, dc_job->data, dc_job->size,
+                                   &compressed_size, &cf_data.dict_id);
+   if (compressed == NULL) {
+      unlink(filename_tmp);
+      goto done;
+   }
+
    /* Create CRC of the data. We will read this when restoring the cache and
     * use it to check for corruption.
     */
-   struct cache_entry_file_data cf_data;
    cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
    cf_data.uncompressed_size = dc_job->size;
 
@@ -1030,9 +1668,8 @@ cache_put(void *job, int thread_index)
     * rename them atomically to the destination filename, and also
     * perform an atomic increment of the total cache size.
     */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
+   ret = write_all(fd, compressed, compressed_size);
+   if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
@@ -1051,6 +1688,11 @@ cache_put(void *job, int thread_index)
 
    p_atomic_add(dc_job->cache->size, sb.st_blocks * 512);
 
+   if (dc_job->cache->journal) {
+      disk_cache_journal_put(dc_job->cache->journal, dc_job->key,
+                             sb.st_blocks * 512);
+   }
+
  done:
    if (fd_final != -1)
       close(fd_final);
@@ -1059,6 +1701,7 @@ cache_put(void *job, int thread_index)
     */
    if (fd != -1)
       close(fd);
+   free(compressed);
    free(filename_tmp);
    free(filename);
 }
@@ -1090,15 +1733,37 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
  * Decompresses cache entry, returns true if successful.
  */
 static bool
-inflate_cache_data(uint8_t *in_data, size_t in_data_size,
+inflate_cache_data(struct disk_cache *cache, uint32_t dict_id,
+                   uint8_t *in_data, size_t in_data_size,
                    uint8_t *out_data, size_t out_data_size)
 {
 #ifdef HAVE_ZSTD
-   size_t ret = ZSTD_decompress(out_data, out_data_size, in_data, in_data_size);
+   size_t ret;
+   if (dict_id) {
+      /* Entries compressed with another dictionary are treated as misses,
+       * they get replaced as they are evicted.
+       */
+      const struct disk_cache_dict *dict = p_atomic_read(&cache->dict);
+      if (dict == NULL || dict->id != dict_id)
+         return false;
+
+      ZSTD_DCtx *dctx = ZSTD_createDCtx();
+      if (dctx == NULL)
+         return false;
+
+      ret = ZSTD_decompress_usingDDict(dctx, out_data, out_data_size,
+                                       in_data, in_data_size, dict->ddict);
+      ZSTD_freeDCtx(dctx);
+   } else {
+      ret = ZSTD_decompress(out_data, out_data_size, in_data, in_data_size);
+   }
    return !ZSTD_isError(ret);
 #else
    z_stream strm;
 
+   if (dict_id)
+      return false;
+
    /* allocate inflate state */
    strm.zalloc = Z_NULL;
    strm.zfree = Z_NULL;
@@ -1130,15 +1795,150 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
 #endif
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Checks and decompresses a serialized cache entry, as written by cache_put()
+ * or create_cache_item(). Returns the malloc'ed uncompressed data, or NULL.
+ */
+static void *
+parse_cache_item(struct disk_cache *cache, const uint8_t *item,
+                 size_t item_size, size_t *size)
+{
+   const uint8_t *ptr = item;
+   const uint8_t *end = item + item_size;
+   uint8_t *uncompressed_data;
+
+   size_t ck_size = cache->driver_keys_blob_size;
+   if (end - ptr < ck_size)
+      return NULL;
+
+   /* Check for extremely unlikely hash collisions */
+   if (memcmp(cache->driver_keys_blob, ptr, ck_size) != 0) {
+      assert(!"Mesa cache keys mismatch!");
+      return NULL;
+   }
+   ptr += ck_size;
+
+   uint32_t md_type;
+   if (end - ptr < sizeof(uint32_t))
+      return NULL;
+   memcpy(&md_type, ptr, sizeof(uint32_t));
+   ptr += sizeof(uint32_t);
+
+   if (md_type == CACHE_ITEM_TYPE_GLSL) {
+      uint32_t num_keys;
+      if (end - ptr < sizeof(uint32_t))
+         return NULL;
+      memcpy(&num_keys, ptr, sizeof(uint32_t));
+      ptr += sizeof(uint32_t);
+
+      /* The cache item metadata is currently just used for distributing
+       * precompiled shaders, they are not used by Mesa so just skip them for
+       * now.
+       * TODO: pass the metadata back to the caller and do some basic
+       * validation.
+       */
+      if (end - ptr < (uint64_t) num_keys * sizeof(cache_key))
+         return NULL;
+      ptr += num_keys * sizeof(cache_key);
+   }
+
+   /* Load the CRC that was created when the file was written. */
+   struct cache_entry_file_data cf_data;
+   if (end - ptr < sizeof(cf_data))
+      return NULL;
+   memcpy(&cf_data, ptr, sizeof(cf_data));
+   ptr += sizeof(cf_data);
+
+   /* Uncompress the cache data */
+   uncompressed_data = malloc(cf_data.uncompressed_size);
+   if (uncompressed_data == NULL)
+      return NULL;
+
+   int64_t start = os_time_get_nano();
+
+   if (!inflate_cache_data(cache, cf_data.dict_id, (uint8_t *) ptr,
+                           end - ptr, uncompressed_data,
+                           cf_data.uncompressed_size)) {
+      free(uncompressed_data);
+      return NULL;
+   }
+
+   p_atomic_inc(&cache->stats.decompressed_entries);
+   p_atomic_add(&cache->stats.decompress_ns, os_time_get_nano() - start);
+
+   /* Check the data for corruption */
+   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
+                                        cf_data.uncompressed_size)) {
+      free(uncompressed_data);
+      return NULL;
+   }
+
+   if (size)
+      *size = cf_data.uncompressed_size;
+
+   return uncompressed_data;
+}
+
+/* Read an item from the disk, bypassing the memory cache. */
+static void *
+load_cache_item(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    int fd = -1, ret;
    struct stat sb;
    char *filename = NULL;
    uint8_t *data = NULL;
+   size_t data_size;
    uint8_t *uncompressed_data = NULL;
-   uint8_t *file_header = NULL;
+
+   if (cache->pack) {
+      data = disk_cache_pack_get(cache->pack, key, &data_size);
+      if (data == NULL)
+         return NULL;
+
+      uncompressed_data = parse_cache_item(cache, data, data_size, size);
+      free(data);
+
+      return uncompressed_data;
+   }
+
+   filename = get_cache_file(cache, key);
+   if (filename == NULL)
+      goto fail;
+
+   fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      goto fail;
+
+   if (fstat(fd, &sb) == -1)
+      goto fail;
+
+   data_size = sb.st_size;
+   data = malloc(data_size);
+   if (data == NULL)
+      goto fail;
+
+   ret = read_all(fd, data, data_size);
+   if (ret == -1)
+      goto fail;
+
+   uncompressed_data = parse_cache_item(cache, data, data_size, size);
+   if (uncompressed_data && cache->journal)
+      disk_cache_journal_access(cache->journal, key);
+
+ fail:
+   free(data);
+   free(filename);
+   if (fd != -1)
+      close(fd);
+
+   return uncompressed_data;
+}
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   void *data;
+   size_t data_size = 0;
 
    if (size)
       *size = 0;
@@ -1165,112 +1965,132 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       return blob;
    }
 
-   filename = get_cache_file(cache, key);
-   if (filename == NULL)
-      goto fail;
+   if (cache->path_init_failed)
+      return NULL;
 
-   fd = open(filename, O_RDONLY | O_CLOEXEC);
-   if (fd == -1)
-      goto fail;
+   data = mem_cache_get(cache, key, size);
+   if (data)
+      return data;
 
-   if (fstat(fd, &sb) == -1)
-      goto fail;
+   data = load_cache_item(cache, key, &data_size);
+   if (data) {
+      mem_cache_insert_copy(cache, key, data, data_size);
+      if (size)
+         *size = data_size;
+   }
 
-   data = malloc(sb.st_size);
-   if (data == NULL)
-      goto fail;
+   return data;
+}
 
-   size_t ck_size = cache->driver_keys_blob_size;
-   file_header = malloc(ck_size);
-   if (!file_header)
-      goto fail;
+static void
+cache_get(void *job, int thread_index)
+{
+   struct disk_cache_get_job *dc_job = (struct disk_cache_get_job *) job;
 
-   if (sb.st_size < ck_size)
-      goto fail;
+   dc_job->data = load_cache_item(dc_job->cache, dc_job->key, &dc_job->size);
+}
 
-   ret = read_all(fd, file_header, ck_size);
-   if (ret == -1)
-      goto fail;
+unsigned
+disk_cache_get_batch(struct disk_cache *cache, const cache_key *keys,
+                     unsigned num_keys, void **data, size_t *sizes)
+{
+   struct disk_cache_get_job *jobs = NULL;
+   unsigned found = 0;
+
+   if (!cache->blob_get_cb && !cache->path_init_failed)
+      jobs = calloc(num_keys, sizeof(*jobs));
+
+   /* Fall back to one lookup at a time if there are no threads to use. */
+   if (!jobs) {
+      for (unsigned i = 0; i < num_keys; i++) {
+         data[i] = disk_cache_get(cache, keys[i], &sizes[i]);
+         if (data[i])
+            found++;
+      }
+      return found;
+   }
 
-   /* Check for extremely unlikely hash collisions */
-   if (memcmp(cache->driver_keys_blob, file_header, ck_size) != 0) {
-      assert(!"Mesa cache keys mismatch!");
-      goto fail;
+   for (unsigned i = 0; i < num_keys; i++) {
+      sizes[i] = 0;
+      data[i] = mem_cache_get(cache, keys[i], &sizes[i]);
+      if (data[i])
+         continue;
+
+      jobs[i].cache = cache;
+      memcpy(jobs[i].key, keys[i], CACHE_KEY_SIZE);
+      util_queue_fence_init(&jobs[i].fence);
+      /* The caller is waiting for these, let them overtake the writes. */
+      util_queue_add_job_ex(&cache->cache_queue, &jobs[i], &jobs[i].fence,
+                            cache_get, NULL, 0, UTIL_QUEUE_PRIORITY_HIGH,
+                            UTIL_QUEUE_ANY_THREAD);
    }
 
-   size_t cache_item_md_size = sizeof(uint32_t);
-   uint32_t md_type;
-   ret = read_all(fd, &md_type, cache_item_md_size);
-   if (ret == -1)
-      goto fail;
+   for (unsigned i = 0; i < num_keys; i++) {
+      if (jobs[i].cache) {
+         util_queue_fence_wait(&jobs[i].fence);
+         util_queue_fence_destroy(&jobs[i].fence);
 
-   if (md_type == CACHE_ITEM_TYPE_GLSL) {
-      uint32_t num_keys;
-      cache_item_md_size += sizeof(uint32_t);
-      ret = read_all(fd, &num_keys, sizeof(uint32_t));
-      if (ret == -1)
-         goto fail;
+         data[i] = jobs[i].data;
+         sizes[i] = jobs[i].size;
+         if (data[i])
+            mem_cache_insert_copy(cache, keys[i], data[i], sizes[i]);
+      }
 
-      /* The cache item metadata is currently just used for distributing
-       * precompiled shaders, they are not used by Mesa so just skip them for
-       * now.
-       * TODO: pass the metadata back to the caller and do some basic
-       * validation.
-       */
-      cache_item_md_size += num_keys * sizeof(cache_key);
-      ret = lseek(fd, num_keys * sizeof(cache_key), SEEK_CUR);
-      if (ret == -1)
-         goto fail;
+      if (data[i])
+         found++;
    }
 
-   /* Load the CRC that was created when the file was written. */
-   struct cache_entry_file_data cf_data;
-   size_t cf_data_size = sizeof(cf_data);
-   ret = read_all(fd, &cf_data, cf_data_size);
-   if (ret == -1)
-      goto fail;
+   free(jobs);
 
-   /* Load the actual cache data. */
-   size_t cache_data_size =
-      sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
-      goto fail;
+   return found;
+}
 
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
-      goto fail;
+static void
+cache_prefetch(void *job, int thread_index)
+{
+   struct disk_cache_get_job *dc_job = (struct disk_cache_get_job *) job;
 
-   /* Check the data for corruption */
-   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
-                                        cf_data.uncompressed_size))
-      goto fail;
+   if (mem_cache_contains(dc_job->cache, dc_job->key))
+      return;
 
-   free(data);
-   free(filename);
-   free(file_header);
-   close(fd);
+   dc_job->data = load_cache_item(dc_job->cache, dc_job->key, &dc_job->size);
+   if (dc_job->data) {
+      mem_cache_insert(dc_job->cache, dc_job->key, dc_job->data, dc_job->size);
+      dc_job->data = NULL;
+   }
+}
 
-   if (size)
-      *size = cf_data.uncompressed_size;
+static void
+destroy_get_job(void *job, int thread_index)
+{
+   struct disk_cache_get_job *dc_job = (struct disk_cache_get_job *) job;
 
-   return uncompressed_data;
+   util_queue_fence_destroy(&dc_job->fence);
+   free(dc_job);
+}
 
- fail:
-   if (data)
-      free(data);
-   if (uncompressed_data)
-      free(uncompressed_data);
-   if (filename)
-      free(filename);
-   if (file_header)
-      free(file_header);
-   if (fd != -1)
-      close(fd);
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   if (cache->blob_get_cb || cache->path_init_failed || !cache->mem_ht)
+      return;
 
-   return NULL;
+   for (unsigned i = 0; i < num_keys; i++) {
+      if (mem_cache_contains(cache, keys[i]))
+         continue;
+
+      struct disk_cache_get_job *dc_job = calloc(1, sizeof(*dc_job));
+      if (!dc_job)
+         return;
+
+      dc_job->cache = cache;
+      memcpy(dc_job->key, keys[i], CACHE_KEY_SIZE);
+      util_queue_fence_init(&dc_job->fence);
+      util_queue_add_job_ex(&cache->cache_queue, dc_job, &dc_job->fence,
+                            cache_prefetch, destroy_get_job, 0,
+                            UTIL_QUEUE_PRIORITY_LOW, UTIL_QUEUE_ANY_THREAD);
+   }
 }
 
 void
@@ -1333,6 +2153,19 @@ disk_cache_compute_key(struct disk_cache *cache, const void *data, size_t size,
    _mesa_sha1_final(&ctx, key);
 }
 
+void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats)
+{
+   stats->compressed_entries = p_atomic_read(&cache->stats.compressed_entries);
+   stats->dict_entries = p_atomic_read(&cache->stats.dict_entries);
+   stats->uncompressed_size = p_atomic_read(&cache->stats.uncompressed_size);
+   stats->compressed_size = p_atomic_read(&cache->stats.compressed_size);
+   stats->compress_ns = p_atomic_read(&cache->stats.compress_ns);
+   stats->decompressed_entries =
+      p_atomic_read(&cache->stats.decompressed_entries);
+   stats->decompress_ns = p_atomic_read(&cache->stats.decompress_ns);
+}
+
 void
 disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
                          disk_cache_get_cb get)
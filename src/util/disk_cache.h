@@ -32,6 +32,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <sys/stat.h>
 #include "util/mesa-sha1.h"
 
@@ -74,6 +75,27 @@ struct cache_item_metadata {
    uint32_t num_keys;
 };
 
+/**
+ * Counters of the compression work done by a cache, see
+ * disk_cache_get_stats().
+ */
+struct disk_cache_stats {
+   /** Entries compressed, and how many of them used the shared dictionary */
+   uint64_t compressed_entries;
+   uint64_t dict_entries;
+
+   /** Sizes of the compressed entries before and after compression */
+   uint64_t uncompressed_size;
+   uint64_t compressed_size;
+
+   /** Time spent compressing entries, in nanoseconds */
+   uint64_t compress_ns;
+
+   /** Entries decompressed, and the time spent on it in nanoseconds */
+   uint64_t decompressed_entries;
+   uint64_t decompress_ns;
+};
+
 struct disk_cache;
 
 static inline char *
@@ -216,6 +238,33 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
 
+/**
+ * Retrieve several items at once, reading the ones that aren't in memory
+ * in parallel on the cache threads.
+ *
+ * On return data[i] and sizes[i] hold the object stored under keys[i], as
+ * disk_cache_get() would return it, or NULL if it wasn't found.
+ *
+ * The reads are queued ahead of pending disk_cache_put() writes, so an item
+ * which was just put may not be found yet.  Call disk_cache_wait_for_idle()
+ * first if that matters.
+ *
+ * \return The number of objects found.
+ */
+unsigned
+disk_cache_get_batch(struct disk_cache *cache, const cache_key *keys,
+                     unsigned num_keys, void **data, size_t *sizes);
+
+/**
+ * Start loading the items stored under \keys into the in-memory cache in
+ * the background, so that later disk_cache_get() calls for them don't have
+ * to wait for the disk. Intended for warming up the cache when the keys of
+ * the objects that will be needed soon are known in advance.
+ */
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys);
+
 /**
  * Store the name \key within the cache, (without any associated data).
  *
@@ -252,6 +301,12 @@ void
 disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
                          disk_cache_get_cb get);
 
+/**
+ * Return the compression statistics of \p cache since it was created.
+ */
+void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats);
+
 #else
 
 static inline struct disk_cache *
@@ -286,6 +341,24 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static inline unsigned
+disk_cache_get_batch(struct disk_cache *cache, const cache_key *keys,
+                     unsigned num_keys, void **data, size_t *sizes)
+{
+   for (unsigned i = 0; i < num_keys; i++) {
+      data[i] = NULL;
+      sizes[i] = 0;
+   }
+   return 0;
+}
+
+static inline void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   return;
+}
+
 static inline void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -312,6 +385,12 @@ disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
    return;
 }
 
+static inline void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+}
+
 #endif /* ENABLE_SHADER_CACHE */
 
 #ifdef __cplusplus
@@ -0,0 +1,491 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef ENABLE_SHADER_CACHE
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "c11/threads.h"
+#include "util/hash_table.h"
+#include "util/list.h"
+#include "util/macros.h"
+#include "util/ralloc.h"
+
+#include "disk_cache_journal.h"
+
+#define JOURNAL_RECORD_MAGIC 0x4e524a4d /* "MJRN" */
+
+/* Rewrite the journal once it holds more than twice as many records as
+ * there are live entries, and at least this many.
+ */
+#define JOURNAL_MIN_COMPACT_RECORDS 4096
+
+/* Check whether the journal needs rewriting every that many records
+ * appended by this process, whatever their type.
+ */
+#define JOURNAL_COMPACT_CHECK_INTERVAL 256
+
+enum journal_record_type {
+   JOURNAL_PUT = 1,
+   JOURNAL_ACCESS,
+   JOURNAL_REMOVE,
+};
+
+/* Records are fixed size, and appended with a single write() to a file
+ * opened with O_APPEND, so that the records of concurrent processes don't
+ * interleave.
+ */
+struct journal_record {
+   uint32_t magic;
+   uint32_t type;
+   /* Size on disk of a stored entry. */
+   uint64_t size;
+   /* Seconds since the epoch. Not used for ordering, which is the order of
+    * the records, but handy when looking at a journal.
+    */
+   uint64_t time;
+   cache_key key;
+   uint32_t pad;
+};
+
+struct journal_entry {
+   struct list_head link;
+   cache_key key;
+   uint64_t size;
+   uint64_t time;
+};
+
+struct disk_cache_journal {
+   /* Serializes the threads of the process, the records written by other
+    * processes are picked up by replaying the journal.
+    */
+   mtx_t mutex;
+
+   char *path;
+   int fd;
+
+   /* How far the journal was replayed, and how many records that was. */
+   uint64_t offset;
+   unsigned num_records;
+
+   unsigned appends_since_check;
+
+   /* Maps keys to their journal_entry. */
+   struct hash_table *entries;
+
+   /* All entries, least recently used first. */
+   struct list_head lru;
+};
+
+/* The keys are SHA-1 hashes, so any part of them makes a good hash value. */
+static uint32_t
+key_hash(const void *key)
+{
+   uint32_t hash;
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(cache_key)) == 0;
+}
+
+static bool
+write_all(int fd, const void *buf, size_t count)
+{
+   const uint8_t *out = buf;
+   size_t done;
+   ssize_t ret;
+
+   for (done = 0; done < count; done += ret) {
+      ret = write(fd, out + done, count - done);
+      if (ret == -1)
+         return false;
+   }
+   return true;
+}
+
+static bool
+journal_trylock_file(int fd)
+{
+#ifdef HAVE_FLOCK
+   return flock(fd, LOCK_EX | LOCK_NB) == 0;
+#else
+   struct flock lock = {
+      .l_start = 0,
+      .l_len = 0, /* entire file */
+      .l_type = F_WRLCK,
+      .l_whence = SEEK_SET
+   };
+   return fcntl(fd, F_SETLK, &lock) == 0;
+#endif
+}
+
+static void
+journal_unlock_file(int fd)
+{
+#ifdef HAVE_FLOCK
+   flock(fd, LOCK_UN);
+#else
+   struct flock lock = {
+      .l_start = 0,
+      .l_len = 0, /* entire file */
+      .l_type = F_UNLCK,
+      .l_whence = SEEK_SET
+   };
+   fcntl(fd, F_SETLK, &lock);
+#endif
+}
+
+static void
+journal_append(struct disk_cache_journal *journal,
+               enum journal_record_type type, const cache_key key,
+               uint64_t size)
+{
+   struct journal_record record = {
+      .magic = JOURNAL_RECORD_MAGIC,
+      .type = type,
+      .size = size,
+      .time = time(NULL),
+   };
+   memcpy(record.key, key, sizeof(cache_key));
+
+   /* A failed or short write only loses a hint, a torn record is skipped
+    * by the replay.
+    */
+   ssize_t ret = write(journal->fd, &record, sizeof(record));
+   (void) ret;
+
+   journal->appends_since_check++;
+}
+
+static void
+journal_remove_entry(struct disk_cache_journal *journal,
+                     struct journal_entry *entry)
+{
+   _mesa_hash_table_remove_key(journal->entries, entry->key);
+   list_del(&entry->link);
+   ralloc_free(entry);
+}
+
+static void
+journal_reset(struct disk_cache_journal *journal)
+{
+   list_for_each_entry_safe(struct journal_entry, entry, &journal->lru, link)
+      ralloc_free(entry);
+   list_inithead(&journal->lru);
+   _mesa_hash_table_clear(journal->entries, NULL);
+
+   journal->offset = 0;
+   journal->num_records = 0;
+}
+
+static void
+journal_apply(struct disk_cache_journal *journal,
+              const struct journal_record *record)
+{
+   struct hash_entry *he;
+   struct journal_entry *entry;
+
+   if (record->magic != JOURNAL_RECORD_MAGIC)
+      return;
+
+   he = _mesa_hash_table_search(journal->entries, record->key);
+   entry = he ? he->data : NULL;
+
+   switch (record->type) {
+   case JOURNAL_PUT:
+      if (!entry) {
+         entry = ralloc(journal, struct journal_entry);
+         if (!entry)
+            return;
+         memcpy(entry->key, record->key, sizeof(cache_key));
+         _mesa_hash_table_insert(journal->entries, entry->key, entry);
+      } else {
+         list_del(&entry->link);
+      }
+      entry->size = record->size;
+      entry->time = record->time;
+      list_addtail(&entry->link, &journal->lru);
+      break;
+   case JOURNAL_ACCESS:
+      if (entry) {
+         entry->time = record->time;
+         list_del(&entry->link);
+         list_addtail(&entry->link, &journal->lru);
+      }
+      break;
+   case JOURNAL_REMOVE:
+      if (entry)
+         journal_remove_entry(journal, entry);
+      break;
+   }
+}
+
+/* Bring the in-memory LRU list up to date with the records appended since
+ * the last replay, by this and by other processes.
+ */
+static void
+journal_replay(struct disk_cache_journal *journal)
+{
+   struct journal_record records[256];
+   struct stat path_sb, fd_sb;
+
+   /* Another process rewrote the journal, start over from the new file. */
+   if (stat(journal->path, &path_sb) == 0 &&
+       fstat(journal->fd, &fd_sb) == 0 &&
+       (path_sb.st_ino != fd_sb.st_ino || path_sb.st_dev != fd_sb.st_dev)) {
+      int fd = open(journal->path, O_RDWR | O_APPEND | O_CLOEXEC);
+      if (fd != -1) {
+         close(journal->fd);
+         journal->fd = fd;
+         journal_reset(journal);
+      }
+   }
+
+   while (true) {
+      ssize_t ret = pread(journal->fd, records, sizeof(records),
+                          journal->offset);
+      if (ret <= 0)
+         break;
+
+      /* A record still being written is left for the next replay. */
+      unsigned count = ret / sizeof(records[0]);
+      if (count == 0)
+         break;
+
+      for (unsigned i = 0; i < count; i++)
+         journal_apply(journal, &records[i]);
+
+      journal->offset += count * sizeof(records[0]);
+      journal->num_records += count;
+   }
+}
+
+/* Replace the journal with one holding a single record per live entry, in
+ * LRU order. Skipped if another process is already doing it.
+ */
+static void
+journal_compact(struct disk_cache_journal *journal)
+{
+   struct journal_record records[256];
+   unsigned count = 0, total = 0;
+   char *filename_tmp;
+   int old_fd = journal->fd;
+   int fd;
+
+   if (!journal_trylock_file(old_fd))
+      return;
+
+   /* Pick up what was appended until now, it would be lost otherwise. A
+    * process appending after this loses its record, which is fine for a
+    * hint.
+    */
+   journal_replay(journal);
+   if (journal->fd != old_fd) {
+      /* Someone else rewrote the journal in the meantime. */
+      journal_unlock_file(old_fd);
+      return;
+   }
+
+   filename_tmp = ralloc_asprintf(NULL, "%s.%d.tmp", journal->path,
+                                  (int) getpid());
+   if (!filename_tmp)
+      goto done;
+
+   fd = open(filename_tmp, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+             0644);
+   if (fd == -1)
+      goto done;
+
+   list_for_each_entry(struct journal_entry, entry, &journal->lru, link) {
+      records[count] = (struct journal_record) {
+         .magic = JOURNAL_RECORD_MAGIC,
+         .type = JOURNAL_PUT,
+         .size = entry->size,
+         .time = entry->time,
+      };
+      memcpy(records[count].key, entry->key, sizeof(cache_key));
+
+      if (++count == ARRAY_SIZE(records)) {
+         if (!write_all(fd, records, sizeof(records)))
+            goto fail;
+         total += count;
+         count = 0;
+      }
+   }
+
+   if (!write_all(fd, records, count * sizeof(records[0])))
+      goto fail;
+   total += count;
+
+   if (rename(filename_tmp, journal->path) == -1)
+      goto fail;
+
+   journal->fd = fd;
+   journal->offset = (uint64_t) total * sizeof(records[0]);
+   journal->num_records = total;
+   close(old_fd);
+   ralloc_free(filename_tmp);
+   return;
+
+fail:
+   close(fd);
+   unlink(filename_tmp);
+done:
+   ralloc_free(filename_tmp);
+   journal_unlock_file(old_fd);
+}
+
+static void
+journal_maybe_compact(struct disk_cache_journal *journal)
+{
+   unsigned live = _mesa_hash_table_num_entries(journal->entries);
+
+   journal->appends_since_check = 0;
+
+   if (journal->num_records > JOURNAL_MIN_COMPACT_RECORDS &&
+       journal->num_records > 2 * live)
+      journal_compact(journal);
+}
+
+/* Keep the journal short no matter what is appended to it: a cache which
+ * is only read from appends an access record for every hit.
+ */
+static void
+journal_check_compact(struct disk_cache_journal *journal)
+{
+   if (journal->appends_since_check >= JOURNAL_COMPACT_CHECK_INTERVAL) {
+      journal_replay(journal);
+      journal_maybe_compact(journal);
+   }
+}
+
+struct disk_cache_journal *
+disk_cache_journal_open(const char *cache_path)
+{
+   struct disk_cache_journal *journal;
+
+   journal = rzalloc(NULL, struct disk_cache_journal);
+   if (!journal)
+      return NULL;
+
+   journal->fd = -1;
+   mtx_init(&journal->mutex, mtx_plain);
+   list_inithead(&journal->lru);
+
+   journal->path = ralloc_asprintf(journal, "%s/journal", cache_path);
+   if (!journal->path)
+      goto fail;
+
+   journal->entries = _mesa_hash_table_create(journal, key_hash, key_equals);
+   if (!journal->entries)
+      goto fail;
+
+   journal->fd = open(journal->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644);
+   if (journal->fd == -1)
+      goto fail;
+
+   return journal;
+
+fail:
+   disk_cache_journal_close(journal);
+   return NULL;
+}
+
+void
+disk_cache_journal_close(struct disk_cache_journal *journal)
+{
+   if (journal->fd != -1)
+      close(journal->fd);
+   mtx_destroy(&journal->mutex);
+   ralloc_free(journal);
+}
+
+void
+disk_cache_journal_put(struct disk_cache_journal *journal,
+                       const cache_key key, uint64_t size)
+{
+   mtx_lock(&journal->mutex);
+   journal_append(journal, JOURNAL_PUT, key, size);
+   journal_check_compact(journal);
+   mtx_unlock(&journal->mutex);
+}
+
+void
+disk_cache_journal_access(struct disk_cache_journal *journal,
+                          const cache_key key)
+{
+   mtx_lock(&journal->mutex);
+   journal_append(journal, JOURNAL_ACCESS, key, 0);
+   journal_check_compact(journal);
+   mtx_unlock(&journal->mutex);
+}
+
+void
+disk_cache_journal_remove(struct disk_cache_journal *journal,
+                          const cache_key key)
+{
+   mtx_lock(&journal->mutex);
+   journal_append(journal, JOURNAL_REMOVE, key, 0);
+   journal_check_compact(journal);
+   mtx_unlock(&journal->mutex);
+}
+
+bool
+disk_cache_journal_pop_lru(struct disk_cache_journal *journal,
+                           cache_key key)
+{
+   struct journal_entry *entry;
+
+   mtx_lock(&journal->mutex);
+   journal_replay(journal);
+
+   if (list_is_empty(&journal->lru)) {
+      mtx_unlock(&journal->mutex);
+      return false;
+   }
+
+   entry = list_first_entry(&journal->lru, struct journal_entry, link);
+   memcpy(key, entry->key, sizeof(cache_key));
+   journal_remove_entry(journal, entry);
+   journal_append(journal, JOURNAL_REMOVE, key, 0);
+
+   journal_maybe_compact(journal);
+   mtx_unlock(&journal->mutex);
+
+   return true;
+}
+
+#endif /* ENABLE_SHADER_CACHE */
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * LRU journal of the file per entry layout of the shader disk cache.
+ *
+ * Stores, accesses and removals of entries are appended to the "journal"
+ * file in the cache directory, by all the processes using the cache. When
+ * entries need to be evicted, the journal is replayed into an in-memory LRU
+ * list, so that victims are found without walking the cache directories.
+ * Only the records appended since the last replay are read, and the journal
+ * is rewritten with just the live entries once it grows too long.
+ *
+ * The journal is a hint: entries it doesn't know about, e.g. ones stored by
+ * older versions, are still evicted by walking the directories.
+ */
+
+#ifndef DISK_CACHE_JOURNAL_H
+#define DISK_CACHE_JOURNAL_H
+
+#include "util/disk_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct disk_cache_journal;
+
+struct disk_cache_journal *
+disk_cache_journal_open(const char *cache_path);
+
+void
+disk_cache_journal_close(struct disk_cache_journal *journal);
+
+/**
+ * Record that the entry for key was stored, taking size bytes on disk.
+ */
+void
+disk_cache_journal_put(struct disk_cache_journal *journal,
+                       const cache_key key, uint64_t size);
+
+/**
+ * Record that the entry for key was read.
+ */
+void
+disk_cache_journal_access(struct disk_cache_journal *journal,
+                          const cache_key key);
+
+/**
+ * Record that the entry for key was removed.
+ */
+void
+disk_cache_journal_remove(struct disk_cache_journal *journal,
+                          const cache_key key);
+
+/**
+ * Remove the least recently used entry from the journal and return its key
+ * in key, for the caller to remove the file. Returns false if the journal
+ * has no entries.
+ */
+bool
+disk_cache_journal_pop_lru(struct disk_cache_journal *journal,
+                           cache_key key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_JOURNAL_H */
@@ -0,0 +1,620 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef ENABLE_SHADER_CACHE
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "c11/threads.h"
+#include "util/ralloc.h"
+#include "util/u_atomic.h"
+
+#include "disk_cache_pack.h"
+
+#define PACK_INDEX_MAGIC 0x4b50434d /* "MCPK" */
+#define PACK_RECORD_MAGIC 0x4552434d /* "MCRE" */
+
+/* Bump this whenever the layout of the index or the records changes, the
+ * cache is then simply started over.
+ */
+#define PACK_VERSION 1
+
+/* Number of slots of the hash table, must be a power of two. */
+#define PACK_INDEX_SLOTS (1 << 18)
+
+/* Keep the hash table at most 3/4 full, counting removed slots. */
+#define PACK_MAX_ENTRIES (PACK_INDEX_SLOTS / 4 * 3)
+
+enum pack_slot_state {
+   PACK_SLOT_EMPTY = 0,
+   PACK_SLOT_LIVE,
+   PACK_SLOT_DEAD,
+};
+
+/* Lives at the start of the mmap'ed index and is shared between all
+ * processes using the cache. Only modified with the index locked.
+ */
+struct pack_index_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_live;
+   uint32_t num_dead;
+
+   /* Where the next record gets appended. */
+   uint64_t pack_end;
+
+   /* Bytes used by live and by removed records in the pack. */
+   uint64_t live_bytes;
+   uint64_t dead_bytes;
+
+   /* Incremented on every access, used to order entries for eviction. */
+   uint64_t clock;
+
+   uint64_t pad[2];
+};
+
+struct pack_index_slot {
+   cache_key key;
+   uint32_t state;
+
+   /* Size of the record, including its header. */
+   uint32_t size;
+   uint32_t pad;
+
+   uint64_t offset;
+
+   /* Value of the clock on last access. */
+   uint64_t stamp;
+};
+
+/* Precedes every entry in the pack file. Readers don't lock the index, so
+ * this is checked to catch entries being moved or replaced under them.
+ */
+struct pack_record_header {
+   uint32_t magic;
+   uint32_t size;
+   cache_key key;
+};
+
+struct disk_cache_pack {
+   /* flock() locks are per open file, this serializes the threads of
+    * the process.
+    */
+   mtx_t mutex;
+
+   int index_fd;
+   int pack_fd;
+
+   uint8_t *index_mmap;
+   size_t index_mmap_size;
+
+   struct pack_index_header *header;
+   struct pack_index_slot *slots;
+
+   uint64_t max_size;
+   uint64_t low_size;
+};
+
+static bool
+pack_lock(struct disk_cache_pack *pack)
+{
+   mtx_lock(&pack->mutex);
+
+#ifdef HAVE_FLOCK
+   int err = flock(pack->index_fd, LOCK_EX);
+#else
+   struct flock lock = {
+      .l_start = 0,
+      .l_len = 0, /* entire file */
+      .l_type = F_WRLCK,
+      .l_whence = SEEK_SET
+   };
+   int err = fcntl(pack->index_fd, F_SETLKW, &lock);
+#endif
+   if (err == -1) {
+      mtx_unlock(&pack->mutex);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+pack_unlock(struct disk_cache_pack *pack)
+{
+#ifdef HAVE_FLOCK
+   flock(pack->index_fd, LOCK_UN);
+#else
+   struct flock lock = {
+      .l_start = 0,
+      .l_len = 0, /* entire file */
+      .l_type = F_UNLCK,
+      .l_whence = SEEK_SET
+   };
+   fcntl(pack->index_fd, F_SETLK, &lock);
+#endif
+
+   mtx_unlock(&pack->mutex);
+}
+
+static bool
+pread_all(int fd, void *buf, size_t count, uint64_t offset)
+{
+   uint8_t *in = buf;
+   size_t done;
+   ssize_t ret;
+
+   for (done = 0; done < count; done += ret) {
+      ret = pread(fd, in + done, count - done, offset + done);
+      if (ret == -1 || ret == 0)
+         return false;
+   }
+   return true;
+}
+
+static bool
+pwrite_all(int fd, const void *buf, size_t count, uint64_t offset)
+{
+   const uint8_t *out = buf;
+   size_t done;
+   ssize_t ret;
+
+   for (done = 0; done < count; done += ret) {
+      ret = pwrite(fd, out + done, count - done, offset + done);
+      if (ret == -1)
+         return false;
+   }
+   return true;
+}
+
+/* Find the slot holding key. With for_insert, return the slot the key
+ * should be stored in if it isn't present.
+ *
+ * The keys are SHA-1 hashes, so any part of them makes a good hash value.
+ */
+static struct pack_index_slot *
+pack_find_slot(struct disk_cache_pack *pack, const cache_key key,
+               bool for_insert)
+{
+   struct pack_index_slot *insert = NULL;
+   uint32_t hash;
+
+   memcpy(&hash, key, sizeof(hash));
+
+   for (unsigned i = 0; i < PACK_INDEX_SLOTS; i++) {
+      struct pack_index_slot *slot =
+         &pack->slots[(hash + i) & (PACK_INDEX_SLOTS - 1)];
+      uint32_t state = p_atomic_read(&slot->state);
+
+      if (state == PACK_SLOT_EMPTY)
+         return for_insert ? (insert ? insert : slot) : NULL;
+
+      if (state == PACK_SLOT_DEAD) {
+         if (!insert)
+            insert = slot;
+         continue;
+      }
+
+      if (memcmp(slot->key, key, CACHE_KEY_SIZE) == 0)
+         return slot;
+   }
+
+   return for_insert ? insert : NULL;
+}
+
+static void
+pack_reset(struct disk_cache_pack *pack)
+{
+   memset(pack->index_mmap, 0, pack->index_mmap_size);
+   pack->header->magic = PACK_INDEX_MAGIC;
+   pack->header->version = PACK_VERSION;
+
+   if (ftruncate(pack->pack_fd, 0) == -1) {
+      /* Nothing to do about it, the space just gets reused. */
+   }
+}
+
+static void
+pack_remove_slot(struct disk_cache_pack *pack, struct pack_index_slot *slot)
+{
+   p_atomic_set(&slot->state, PACK_SLOT_DEAD);
+   pack->header->num_live--;
+   pack->header->num_dead++;
+   pack->header->live_bytes -= slot->size;
+   pack->header->dead_bytes += slot->size;
+}
+
+static int
+compare_slots_by_stamp(const void *a, const void *b)
+{
+   const struct pack_index_slot *sa = *(const struct pack_index_slot **)a;
+   const struct pack_index_slot *sb = *(const struct pack_index_slot **)b;
+
+   return sa->stamp < sb->stamp ? -1 : sa->stamp > sb->stamp;
+}
+
+static int
+compare_slots_by_offset(const void *a, const void *b)
+{
+   const struct pack_index_slot *sa = a;
+   const struct pack_index_slot *sb = b;
+
+   return sa->offset < sb->offset ? -1 : sa->offset > sb->offset;
+}
+
+/* Remove the least recently used entries until both limits are met. */
+static void
+pack_evict_lru(struct disk_cache_pack *pack, uint64_t max_bytes,
+               uint32_t max_entries)
+{
+   struct pack_index_slot **live;
+   unsigned num_live = 0;
+
+   live = malloc(pack->header->num_live * sizeof(*live));
+   if (!live)
+      return;
+
+   for (unsigned i = 0; i < PACK_INDEX_SLOTS; i++) {
+      if (pack->slots[i].state == PACK_SLOT_LIVE &&
+          num_live < pack->header->num_live)
+         live[num_live++] = &pack->slots[i];
+   }
+
+   qsort(live, num_live, sizeof(*live), compare_slots_by_stamp);
+
+   for (unsigned i = 0; i < num_live; i++) {
+      if (pack->header->live_bytes <= max_bytes &&
+          pack->header->num_live <= max_entries)
+         break;
+
+      pack_remove_slot(pack, live[i]);
+   }
+
+   free(live);
+}
+
+/* Move all live records to the front of the pack, in place, and rebuild
+ * the hash table without the removed slots.
+ *
+ * Records only ever move towards the start of the file, so copying them
+ * in offset order never overwrites one that still has to be moved.
+ * Readers racing with this just see a record header or checksum mismatch.
+ */
+static void
+pack_compact(struct disk_cache_pack *pack)
+{
+   struct pack_index_slot *live;
+   unsigned num_live = 0;
+   uint64_t end = 0;
+   uint8_t *buf = NULL;
+   size_t buf_size = 0;
+
+   live = malloc(pack->header->num_live * sizeof(*live));
+   if (!live)
+      return;
+
+   for (unsigned i = 0; i < PACK_INDEX_SLOTS; i++) {
+      if (pack->slots[i].state == PACK_SLOT_LIVE &&
+          num_live < pack->header->num_live)
+         live[num_live++] = pack->slots[i];
+   }
+
+   qsort(live, num_live, sizeof(*live), compare_slots_by_offset);
+
+   for (unsigned i = 0; i < num_live; i++) {
+      if (live[i].offset != end) {
+         if (live[i].size > buf_size) {
+            uint8_t *tmp = realloc(buf, live[i].size);
+            if (!tmp)
+               goto fail;
+            buf = tmp;
+            buf_size = live[i].size;
+         }
+
+         if (!pread_all(pack->pack_fd, buf, live[i].size, live[i].offset) ||
+             !pwrite_all(pack->pack_fd, buf, live[i].size, end))
+            goto fail;
+
+         live[i].offset = end;
+      }
+      end += live[i].size;
+   }
+
+   memset(pack->slots, 0, PACK_INDEX_SLOTS * sizeof(*pack->slots));
+   for (unsigned i = 0; i < num_live; i++) {
+      struct pack_index_slot *slot = pack_find_slot(pack, live[i].key, true);
+      *slot = live[i];
+   }
+
+   pack->header->num_live = num_live;
+   pack->header->num_dead = 0;
+   pack->header->pack_end = end;
+   pack->header->live_bytes = end;
+   pack->header->dead_bytes = 0;
+
+   if (ftruncate(pack->pack_fd, end) == -1) {
+      /* The tail is overwritten by the next appends anyway. */
+   }
+
+   free(buf);
+   free(live);
+   return;
+
+ fail:
+   /* Some records may have been moved already without the index knowing
+    * about it. Start over rather than guessing.
+    */
+   pack_reset(pack);
+   free(buf);
+   free(live);
+}
+
+struct disk_cache_pack *
+disk_cache_pack_open(const char *cache_path, uint64_t max_size,
+                     uint64_t low_size)
+{
+   struct disk_cache_pack *pack;
+   struct stat sb;
+   char *path;
+
+   pack = rzalloc(NULL, struct disk_cache_pack);
+   if (!pack)
+      return NULL;
+
+   pack->index_fd = -1;
+   pack->pack_fd = -1;
+   pack->max_size = max_size;
+   pack->low_size = low_size;
+   mtx_init(&pack->mutex, mtx_plain);
+
+   path = ralloc_asprintf(pack, "%s/pack_index", cache_path);
+   if (!path)
+      goto fail;
+
+   pack->index_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (pack->index_fd == -1)
+      goto fail;
+
+   path = ralloc_asprintf(pack, "%s/pack", cache_path);
+   if (!path)
+      goto fail;
+
+   pack->pack_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (pack->pack_fd == -1)
+      goto fail;
+
+   if (!pack_lock(pack))
+      goto fail;
+
+   if (fstat(pack->index_fd, &sb) == -1)
+      goto fail_locked;
+
+   /* Force the index file to be the expected size, a new file reads as
+    * all zeros and gets initialized below.
+    */
+   pack->index_mmap_size = sizeof(struct pack_index_header) +
+                           PACK_INDEX_SLOTS * sizeof(struct pack_index_slot);
+   if (sb.st_size != pack->index_mmap_size) {
+      if (ftruncate(pack->index_fd, 0) == -1 ||
+          ftruncate(pack->index_fd, pack->index_mmap_size) == -1)
+         goto fail_locked;
+   }
+
+   /* Mapped shared so that other processes see our updates, just like
+    * the key index of the regular cache.
+    */
+   pack->index_mmap = mmap(NULL, pack->index_mmap_size,
+                           PROT_READ | PROT_WRITE, MAP_SHARED,
+                           pack->index_fd, 0);
+   if (pack->index_mmap == MAP_FAILED) {
+      pack->index_mmap = NULL;
+      goto fail_locked;
+   }
+
+   pack->header = (struct pack_index_header *) pack->index_mmap;
+   pack->slots = (struct pack_index_slot *) (pack->header + 1);
+
+   if (pack->header->magic != PACK_INDEX_MAGIC ||
+       pack->header->version != PACK_VERSION)
+      pack_reset(pack);
+
+   pack_unlock(pack);
+
+   return pack;
+
+ fail_locked:
+   pack_unlock(pack);
+ fail:
+   disk_cache_pack_close(pack);
+   return NULL;
+}
+
+void
+disk_cache_pack_close(struct disk_cache_pack *pack)
+{
+   if (!pack)
+      return;
+
+   if (pack->index_mmap)
+      munmap(pack->index_mmap, pack->index_mmap_size);
+   if (pack->index_fd != -1)
+      close(pack->index_fd);
+   if (pack->pack_fd != -1)
+      close(pack->pack_fd);
+
+   mtx_destroy(&pack->mutex);
+   ralloc_free(pack);
+}
+
+bool
+disk_cache_pack_put(struct disk_cache_pack *pack, const cache_key key,
+                    const void *data, size_t size)
+{
+   struct pack_record_header record;
+   struct pack_index_slot *slot;
+   uint64_t record_size = sizeof(record) + size;
+   bool ret = false;
+
+   if (record_size > pack->max_size || record_size > UINT32_MAX)
+      return false;
+
+   if (!pack_lock(pack))
+      return false;
+
+   slot = pack_find_slot(pack, key, true);
+   if (slot && slot->state == PACK_SLOT_LIVE) {
+      /* Someone else got there first. */
+      slot->stamp = p_atomic_inc_return(&pack->header->clock);
+      ret = true;
+      goto done;
+   }
+
+   /* Evict in batches, down to the low watermark and 7/8 of the entry
+    * limit, so that a full cache doesn't have to sort the index on every
+    * put.
+    */
+   if (pack->header->live_bytes + record_size > pack->max_size ||
+       pack->header->num_live >= PACK_MAX_ENTRIES) {
+      uint64_t max_bytes = pack->low_size;
+      max_bytes = max_bytes > record_size ? max_bytes - record_size : 0;
+
+      pack_evict_lru(pack, max_bytes, PACK_MAX_ENTRIES - PACK_MAX_ENTRIES / 8);
+   }
+
+   /* Reclaim the space of removed entries once they make up half of the
+    * pack, or the hash table is full of removed slots.
+    */
+   if (pack->header->dead_bytes > pack->header->live_bytes ||
+       pack->header->num_live + pack->header->num_dead >= PACK_MAX_ENTRIES) {
+      pack_compact(pack);
+   }
+
+   slot = pack_find_slot(pack, key, true);
+   if (!slot)
+      goto done;
+
+   record.magic = PACK_RECORD_MAGIC;
+   record.size = size;
+   memcpy(record.key, key, CACHE_KEY_SIZE);
+
+   uint64_t offset = pack->header->pack_end;
+   if (!pwrite_all(pack->pack_fd, &record, sizeof(record), offset) ||
+       !pwrite_all(pack->pack_fd, data, size, offset + sizeof(record)))
+      goto done;
+
+   if (slot->state == PACK_SLOT_DEAD)
+      pack->header->num_dead--;
+
+   memcpy(slot->key, key, CACHE_KEY_SIZE);
+   slot->size = record_size;
+   slot->offset = offset;
+   slot->stamp = p_atomic_inc_return(&pack->header->clock);
+   p_atomic_set(&slot->state, PACK_SLOT_LIVE);
+
+   pack->header->pack_end += record_size;
+   pack->header->live_bytes += record_size;
+   pack->header->num_live++;
+   ret = true;
+
+ done:
+   pack_unlock(pack);
+   return ret;
+}
+
+void *
+disk_cache_pack_get(struct disk_cache_pack *pack, const cache_key key,
+                    size_t *size)
+{
+   struct pack_record_header record;
+   struct pack_index_slot *slot;
+   uint64_t offset;
+   uint32_t record_size;
+   void *data;
+
+   /* Lookups don't lock the index, a concurrent writer can at worst make
+    * us miss, or read a record that no longer belongs to the key, which
+    * the record header catches.
+    */
+   slot = pack_find_slot(pack, key, false);
+   if (!slot)
+      return NULL;
+
+   offset = slot->offset;
+   record_size = slot->size;
+   if (record_size < sizeof(record))
+      return NULL;
+
+   if (!pread_all(pack->pack_fd, &record, sizeof(record), offset))
+      return NULL;
+
+   if (record.magic != PACK_RECORD_MAGIC ||
+       record.size != record_size - sizeof(record) ||
+       memcmp(record.key, key, CACHE_KEY_SIZE) != 0)
+      return NULL;
+
+   data = malloc(record.size);
+   if (!data)
+      return NULL;
+
+   if (!pread_all(pack->pack_fd, data, record.size, offset + sizeof(record))) {
+      free(data);
+      return NULL;
+   }
+
+   slot->stamp = p_atomic_inc_return(&pack->header->clock);
+
+   if (size)
+      *size = record.size;
+   return data;
+}
+
+void
+disk_cache_pack_remove(struct disk_cache_pack *pack, const cache_key key)
+{
+   struct pack_index_slot *slot;
+
+   if (!pack_lock(pack))
+      return;
+
+   slot = pack_find_slot(pack, key, false);
+   if (slot)
+      pack_remove_slot(pack, slot);
+
+   pack_unlock(pack);
+}
+
+uint64_t
+disk_cache_pack_size(struct disk_cache_pack *pack)
+{
+   return p_atomic_read(&pack->header->live_bytes);
+}
+
+#endif /* ENABLE_SHADER_CACHE */
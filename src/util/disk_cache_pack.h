@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Packed storage backend for the shader disk cache.
+ *
+ * Instead of one file per entry, all entries are appended to a single
+ * "pack" file, and a fixed size hash table mapping keys to their location
+ * in the pack is kept in the mmap'ed "pack_index" file next to it. Lookups
+ * never touch the file system metadata, and eviction drops the least
+ * recently used entries of the whole cache in batches, reclaiming the
+ * space by compacting the pack in place.
+ *
+ * The pack only stores opaque blobs, serializing and compressing the
+ * entries is left to disk_cache.c.
+ */
+
+#ifndef DISK_CACHE_PACK_H
+#define DISK_CACHE_PACK_H
+
+#include "util/disk_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct disk_cache_pack;
+
+/**
+ * Open the pack in cache_path. Once the live entries reach max_size, they
+ * are evicted down to low_size.
+ */
+struct disk_cache_pack *
+disk_cache_pack_open(const char *cache_path, uint64_t max_size,
+                     uint64_t low_size);
+
+void
+disk_cache_pack_close(struct disk_cache_pack *pack);
+
+/**
+ * Append an entry, evicting old ones as needed. Does nothing if the key
+ * is already present. Returns false if the entry couldn't be stored.
+ */
+bool
+disk_cache_pack_put(struct disk_cache_pack *pack, const cache_key key,
+                    const void *data, size_t size);
+
+/**
+ * Returns a malloc'ed copy of the entry stored for key, or NULL.
+ */
+void *
+disk_cache_pack_get(struct disk_cache_pack *pack, const cache_key key,
+                    size_t *size);
+
+void
+disk_cache_pack_remove(struct disk_cache_pack *pack, const cache_key key);
+
+/**
+ * Total size of the live entries in the pack.
+ */
+uint64_t
+disk_cache_pack_size(struct disk_cache_pack *pack);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_PACK_H */
@@ -32,14 +32,104 @@
  * @author Jose Fonseca <jfonseca@vmware.com>
  */
 
+#include "c11/threads.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_s3tc.h"
+#include "util/format/u_format_simd.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_math.h"
 
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 
 
+static once_flag util_format_description_table_once = ONCE_FLAG_INIT;
+
+static const struct util_format_description *
+util_format_description_table[PIPE_FORMAT_COUNT];
+
+/* Copies of the descriptions of the formats with vectorized functions. */
+static struct util_format_description util_format_simd_descriptions[16];
+
+
+static const struct util_format_simd_funcs *
+util_format_simd_funcs(enum pipe_format format)
+{
+   const struct util_format_simd_funcs *funcs = NULL;
+
+   if (!UTIL_ARCH_LITTLE_ENDIAN)
+      return NULL;
+
+#if defined(USE_AVX2)
+   if (!funcs && util_cpu_caps.has_avx2)
+      funcs = util_format_simd_funcs_avx2(format);
+#endif
+#if defined(USE_SSE41)
+   if (!funcs && util_cpu_caps.has_sse4_1)
+      funcs = util_format_simd_funcs_sse41(format);
+#endif
+#if defined(UTIL_FORMAT_HAVE_NEON)
+   if (!funcs && util_cpu_caps.has_neon)
+      funcs = util_format_simd_funcs_neon(format);
+#endif
+
+   return funcs;
+}
+
+
+static void
+util_format_description_table_init(void)
+{
+   unsigned num_simd = 0;
+
+   util_cpu_detect();
+
+   for (unsigned format = 0; format < PIPE_FORMAT_COUNT; format++) {
+      const struct util_format_description *desc =
+         util_format_description_generic(format);
+      const struct util_format_simd_funcs *funcs =
+         desc ? util_format_simd_funcs(format) : NULL;
+
+      if (funcs && num_simd < ARRAY_SIZE(util_format_simd_descriptions)) {
+         struct util_format_description *simd =
+            &util_format_simd_descriptions[num_simd++];
+
+         *simd = *desc;
+
+#define REPLACE(func) \
+         if (funcs->func) \
+            simd->func = funcs->func;
+
+         REPLACE(unpack_rgba_8unorm);
+         REPLACE(pack_rgba_8unorm);
+         REPLACE(unpack_rgba_float);
+         REPLACE(pack_rgba_float);
+         REPLACE(unpack_z_float);
+         REPLACE(pack_z_float);
+
+#undef REPLACE
+
+         desc = simd;
+      }
+
+      util_format_description_table[format] = desc;
+   }
+}
+
+
+const struct util_format_description *
+util_format_description(enum pipe_format format)
+{
+   if (format >= PIPE_FORMAT_COUNT)
+      return NULL;
+
+   call_once(&util_format_description_table_once,
+             util_format_description_table_init);
+
+   return util_format_description_table[format];
+}
+
+
 /**
  * Copy 2D rect from one place to another.
  * Position and sizes are in pixels.
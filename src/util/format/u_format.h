@@ -425,9 +425,20 @@ struct util_format_description
 };
 
 
+/**
+ * Returns the description of format, with the generated pack/unpack
+ * functions of some formats replaced by vectorized ones the CPU supports.
+ */
 const struct util_format_description *
 util_format_description(enum pipe_format format);
 
+/**
+ * Returns the description of format with only the generated pack/unpack
+ * functions.
+ */
+const struct util_format_description *
+util_format_description_generic(enum pipe_format format);
+
 
 /*
  * Format query functions.
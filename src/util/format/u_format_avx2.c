@@ -0,0 +1,461 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * AVX2 versions of the pack/unpack functions, 8 pixels at a time. Formats
+ * not handled here fall back to the SSE4.1 versions.
+ *
+ * This deliberately doesn't use FMA, which would round differently from
+ * the generated functions.
+ */
+
+#include <immintrin.h>
+
+#include "u_format_simd.h"
+
+/* Swaps the R and B bytes of 32-bit pixels. */
+static inline __m256i
+swap_rb_8888(__m256i v)
+{
+   const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15,
+                                         2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15);
+   return _mm256_shuffle_epi8(v, mask);
+}
+
+/* Undoes the lane interleaving of two levels of 256-bit packs. */
+static inline __m256i
+unpermute_pack32(__m256i v)
+{
+   return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5,
+                                                            2, 6, 3, 7));
+}
+
+/* Matches ubyte_to_float(). */
+static inline __m256
+ubyte8_to_float(__m256i v)
+{
+   return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / 255.0f));
+}
+
+/* Matches float_to_ubyte(), returning the bytes in 32-bit lanes. */
+static inline __m256i
+float8_to_ubyte(__m256 f)
+{
+   /* max() returns its second operand for NaN, which turns it into 0. */
+   f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()),
+                     _mm256_set1_ps(1.0f));
+   f = _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f / 256.0f)),
+                     _mm256_set1_ps(32768.0f));
+   return _mm256_and_si256(_mm256_castps_si256(f), _mm256_set1_epi32(0xff));
+}
+
+/* Matches util_iround() of a non-negative value. */
+static inline __m256i
+iround8(__m256 f)
+{
+#if defined(PIPE_ARCH_X86)
+   /* util_iround() uses the x87 rounding mode there, to nearest even. */
+   return _mm256_cvtps_epi32(f);
+#else
+   return _mm256_cvttps_epi32(_mm256_add_ps(f, _mm256_set1_ps(0.5f)));
+#endif
+}
+
+/* Matches util_half_to_float(). */
+static inline __m256
+half8_to_float(__m256i h)
+{
+   const __m256 magic = _mm256_castsi256_ps(_mm256_set1_epi32(0xef << 23));
+   __m256 f = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(h, _mm256_set1_epi32(0x7fff)), 13));
+
+   f = _mm256_mul_ps(f, magic);
+
+   /* Inf / NaN */
+   __m256 infnan = _mm256_cmp_ps(f, _mm256_set1_ps(65536.0f), _CMP_GE_OQ);
+   f = _mm256_or_ps(f, _mm256_and_ps(infnan, _mm256_castsi256_ps(
+      _mm256_set1_epi32(0xff << 23))));
+
+   /* Sign */
+   __m256i sign = _mm256_slli_epi32(
+      _mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16);
+   return _mm256_or_ps(f, _mm256_castsi256_ps(sign));
+}
+
+/* Matches util_float_to_half_rtz(), returning the halves in 32-bit lanes. */
+static inline __m256i
+float8_to_half_rtz(__m256 f)
+{
+   const __m256i round_mask = _mm256_set1_epi32(~0xfff);
+   const __m256i f32inf = _mm256_set1_epi32(0xff << 23);
+   const __m256 magic = _mm256_castsi256_ps(_mm256_set1_epi32(0xf << 23));
+   __m256i u = _mm256_castps_si256(f);
+   __m256i sign = _mm256_and_si256(u, _mm256_set1_epi32(0x80000000));
+   __m256i is_inf, is_nan, h;
+
+   u = _mm256_xor_si256(u, sign);
+   is_inf = _mm256_cmpeq_epi32(u, f32inf);
+   is_nan = _mm256_cmpgt_epi32(u, f32inf);
+
+   /* Number */
+   u = _mm256_and_si256(u, round_mask);
+   u = _mm256_castps_si256(_mm256_mul_ps(_mm256_castsi256_ps(u), magic));
+   u = _mm256_sub_epi32(u, round_mask);
+
+   /* Clamp to max finite value if overflowed. */
+   u = _mm256_blendv_epi8(u, _mm256_set1_epi32((0x1f << 23) - 1),
+                          _mm256_cmpgt_epi32(u, _mm256_set1_epi32(0x1f << 23)));
+   h = _mm256_srli_epi32(u, 13);
+
+   h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7c00), is_inf);
+   h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7e00), is_nan);
+
+   return _mm256_or_si256(h, _mm256_srli_epi32(sign, 16));
+}
+
+/*
+ * R8G8B8A8_UNORM and B8G8R8A8_UNORM
+ */
+
+static inline void
+unpack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   __m256i v = _mm256_loadu_si256((const __m256i *)src);
+
+   if (swap_rb)
+      v = swap_rb_8888(v);
+
+   for (unsigned i = 0; i < 2; i++) {
+      __m128i half = i == 0 ? _mm256_castsi256_si128(v) :
+                              _mm256_extracti128_si256(v, 1);
+
+      _mm256_storeu_ps((float *)dst + i * 16,
+                       ubyte8_to_float(_mm256_cvtepu8_epi32(half)));
+      _mm256_storeu_ps((float *)dst + i * 16 + 8,
+                       ubyte8_to_float(_mm256_cvtepu8_epi32(
+                          _mm_srli_si128(half, 8))));
+   }
+}
+
+static inline void
+pack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   const float *f = (const float *)src;
+   __m256i p01 = float8_to_ubyte(_mm256_loadu_ps(f + 0));
+   __m256i p23 = float8_to_ubyte(_mm256_loadu_ps(f + 8));
+   __m256i p45 = float8_to_ubyte(_mm256_loadu_ps(f + 16));
+   __m256i p67 = float8_to_ubyte(_mm256_loadu_ps(f + 24));
+   __m256i v = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23),
+                                   _mm256_packus_epi32(p45, p67));
+
+   v = unpermute_pack32(v);
+
+   if (swap_rb)
+      v = swap_rb_8888(v);
+
+   _mm256_storeu_si256((__m256i *)dst, v);
+}
+
+static inline void
+rgba8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, true);
+}
+
+static inline void
+rgba8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, true);
+}
+
+/* Unpacking and packing 8unorm are the same swizzle. */
+static inline void
+bgra8_swap_rb_block(uint8_t *dst, const uint8_t *src)
+{
+   __m256i v = _mm256_loadu_si256((const __m256i *)src);
+   _mm256_storeu_si256((__m256i *)dst, swap_rb_8888(v));
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba8_unpack_rgba_float, float, uint8_t, 8, 16, 4,
+                      rgba8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba8_pack_rgba_float, uint8_t, float, 8, 4, 16,
+                      rgba8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_float, float, uint8_t, 8, 16, 4,
+                      bgra8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_float, uint8_t, float, 8, 4, 16,
+                      bgra8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_8unorm, uint8_t, uint8_t, 8, 4, 4,
+                      bgra8_swap_rb_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_8unorm, uint8_t, uint8_t, 8, 4, 4,
+                      bgra8_swap_rb_block)
+
+/*
+ * R10G10B10A2_UNORM
+ *
+ * Works on the pixels as they are laid out, with each channel in its own
+ * lane, using variable shifts.
+ */
+
+static inline void
+rgb10a2_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m256i shift = _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30);
+   const __m256i mask = _mm256_setr_epi32(0x3ff, 0x3ff, 0x3ff, 0x3,
+                                          0x3ff, 0x3ff, 0x3ff, 0x3);
+   const __m256 scale = _mm256_setr_ps(1.0f / 0x3ff, 1.0f / 0x3ff,
+                                       1.0f / 0x3ff, 1.0f / 0x3,
+                                       1.0f / 0x3ff, 1.0f / 0x3ff,
+                                       1.0f / 0x3ff, 1.0f / 0x3);
+   __m256i v = _mm256_loadu_si256((const __m256i *)src);
+
+   for (unsigned i = 0; i < 4; i++) {
+      /* Pixels 2 * i and 2 * i + 1, each in all of the lanes of a half. */
+      __m256i idx = _mm256_setr_epi32(2 * i, 2 * i, 2 * i, 2 * i,
+                                      2 * i + 1, 2 * i + 1,
+                                      2 * i + 1, 2 * i + 1);
+      __m256i p = _mm256_permutevar8x32_epi32(v, idx);
+
+      p = _mm256_and_si256(_mm256_srlv_epi32(p, shift), mask);
+      _mm256_storeu_ps((float *)dst + i * 8,
+                       _mm256_mul_ps(_mm256_cvtepi32_ps(p), scale));
+   }
+}
+
+static inline void
+rgb10a2_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+   const __m256i shift = _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30);
+   const __m256 scale = _mm256_setr_ps(0x3ff, 0x3ff, 0x3ff, 0x3,
+                                       0x3ff, 0x3ff, 0x3ff, 0x3);
+   __m256i p[4];
+
+   for (unsigned i = 0; i < 4; i++) {
+      __m256 v = _mm256_loadu_ps(f + i * 8);
+
+      /* NaN becomes 0, like the out of range result of util_iround(). */
+      v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()),
+                        _mm256_set1_ps(1.0f));
+      p[i] = _mm256_sllv_epi32(iround8(_mm256_mul_ps(v, scale)), shift);
+   }
+
+   /* The channels don't overlap, so adding them up ORs them together. */
+   __m256i v = _mm256_hadd_epi32(_mm256_hadd_epi32(p[0], p[1]),
+                                 _mm256_hadd_epi32(p[2], p[3]));
+
+   _mm256_storeu_si256((__m256i *)dst, unpermute_pack32(v));
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_unpack_rgba_float, float, uint8_t, 8, 16, 4,
+                      rgb10a2_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_pack_rgba_float, uint8_t, float, 8, 4, 16,
+                      rgb10a2_pack_float_block)
+
+/*
+ * R16G16B16A16_FLOAT
+ */
+
+static inline void
+rgba16f_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   for (unsigned i = 0; i < 4; i++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src + i);
+
+      _mm256_storeu_ps((float *)dst + i * 8,
+                       half8_to_float(_mm256_cvtepu16_epi32(v)));
+   }
+}
+
+static inline void
+rgba16f_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+
+   for (unsigned i = 0; i < 2; i++) {
+      __m256i lo = float8_to_half_rtz(_mm256_loadu_ps(f + i * 16));
+      __m256i hi = float8_to_half_rtz(_mm256_loadu_ps(f + i * 16 + 8));
+      __m256i v = _mm256_packus_epi32(lo, hi);
+
+      _mm256_storeu_si256((__m256i *)dst + i,
+                          _mm256_permute4x64_epi64(v, 0xd8));
+   }
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba16f_unpack_rgba_float, float, uint8_t, 8, 16, 8,
+                      rgba16f_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba16f_pack_rgba_float, uint8_t, float, 8, 8, 16,
+                      rgba16f_pack_float_block)
+
+/*
+ * Z16_UNORM and Z24_UNORM_S8_UINT
+ */
+
+static inline void
+z16_unpack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m256 scale = _mm256_set1_ps((float)(1.0 / 0xffff));
+
+   for (unsigned i = 0; i < 2; i++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src + i);
+
+      _mm256_storeu_ps((float *)dst + i * 8,
+                       _mm256_mul_ps(_mm256_cvtepi32_ps(
+                          _mm256_cvtepu16_epi32(v)), scale));
+   }
+}
+
+static inline __m256i
+z16_pack_z8(__m256 z)
+{
+   z = _mm256_min_ps(_mm256_max_ps(z, _mm256_setzero_ps()),
+                     _mm256_set1_ps(1.0f));
+   z = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(0xffff)),
+                     _mm256_set1_ps(0.5f));
+   return _mm256_cvttps_epi32(z);
+}
+
+static inline void
+z16_pack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+   __m256i v = _mm256_packus_epi32(z16_pack_z8(_mm256_loadu_ps(f)),
+                                   z16_pack_z8(_mm256_loadu_ps(f + 8)));
+
+   _mm256_storeu_si256((__m256i *)dst, _mm256_permute4x64_epi64(v, 0xd8));
+}
+
+/* z24_unorm_to_z32_float() converts in double precision. */
+static inline void
+z24s8_unpack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m256d scale = _mm256_set1_pd(1.0 / 0xffffff);
+   __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)src),
+                                _mm256_set1_epi32(0xffffff));
+   __m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(
+      _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), scale));
+   __m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(
+      _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), scale));
+
+   _mm256_storeu_ps((float *)dst,
+                    _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+}
+
+static inline void
+z24s8_pack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m256d scale = _mm256_set1_pd(0xffffff);
+   __m256 z = _mm256_loadu_ps((const float *)src);
+   __m128i lo, hi;
+   __m256i v;
+
+   z = _mm256_min_ps(_mm256_max_ps(z, _mm256_setzero_ps()),
+                     _mm256_set1_ps(1.0f));
+   lo = _mm256_cvttpd_epi32(_mm256_mul_pd(
+      _mm256_cvtps_pd(_mm256_castps256_ps128(z)), scale));
+   hi = _mm256_cvttpd_epi32(_mm256_mul_pd(
+      _mm256_cvtps_pd(_mm256_extractf128_ps(z, 1)), scale));
+
+   /* Keep the stencil bits. */
+   v = _mm256_loadu_si256((const __m256i *)dst);
+   v = _mm256_and_si256(v, _mm256_set1_epi32(0xff000000));
+   v = _mm256_or_si256(v, _mm256_inserti128_si256(
+      _mm256_castsi128_si256(lo), hi, 1));
+
+   _mm256_storeu_si256((__m256i *)dst, v);
+}
+
+UTIL_FORMAT_SIMD_FUNC(z16_unpack_z_float, float, uint8_t, 16, 4, 2,
+                      z16_unpack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z16_pack_z_float, uint8_t, float, 16, 2, 4,
+                      z16_pack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z24s8_unpack_z_float, float, uint8_t, 8, 4, 4,
+                      z24s8_unpack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z24s8_pack_z_float, uint8_t, float, 8, 4, 4,
+                      z24s8_pack_z_float_block)
+
+static const struct util_format_simd_funcs rgba8_funcs = {
+   .unpack_rgba_float = rgba8_unpack_rgba_float,
+   .pack_rgba_float = rgba8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs bgra8_funcs = {
+   .unpack_rgba_8unorm = bgra8_unpack_rgba_8unorm,
+   .pack_rgba_8unorm = bgra8_pack_rgba_8unorm,
+   .unpack_rgba_float = bgra8_unpack_rgba_float,
+   .pack_rgba_float = bgra8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs rgb10a2_funcs = {
+   .unpack_rgba_float = rgb10a2_unpack_rgba_float,
+   .pack_rgba_float = rgb10a2_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs rgba16f_funcs = {
+   .unpack_rgba_float = rgba16f_unpack_rgba_float,
+   .pack_rgba_float = rgba16f_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs z16_funcs = {
+   .unpack_z_float = z16_unpack_z_float,
+   .pack_z_float = z16_pack_z_float,
+};
+
+static const struct util_format_simd_funcs z24s8_funcs = {
+   .unpack_z_float = z24s8_unpack_z_float,
+   .pack_z_float = z24s8_pack_z_float,
+};
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_avx2(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return &rgba8_funcs;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return &bgra8_funcs;
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+      return &rgb10a2_funcs;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      return &rgba16f_funcs;
+   case PIPE_FORMAT_Z16_UNORM:
+      return &z16_funcs;
+   case PIPE_FORMAT_Z24_UNORM_S8_UINT:
+      return &z24s8_funcs;
+   default:
+      return NULL;
+   }
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * NEON versions of the pack/unpack functions. The interleaving loads and
+ * stores split the pixels into one register per channel.
+ *
+ * Only built when the compiler targets NEON, which is always the case on
+ * aarch64.
+ */
+
+#include "u_format_simd.h"
+
+#ifdef UTIL_FORMAT_HAVE_NEON
+
+#include <arm_neon.h>
+
+/* Matches ubyte_to_float() of the 16 bytes of v, into 4 registers. */
+static inline void
+ubyte16_to_float(uint8x16_t v, float32x4_t out[4])
+{
+   const float32x4_t scale = vdupq_n_f32(1.0f / 255.0f);
+   uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+   uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+   out[0] = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale);
+   out[1] = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale);
+   out[2] = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale);
+   out[3] = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale);
+}
+
+/* Clamps to [0, 1], turning NaN into 0. */
+static inline float32x4_t
+saturate(float32x4_t f)
+{
+   const float32x4_t zero = vdupq_n_f32(0.0f);
+
+   f = vbslq_f32(vcgtq_f32(f, zero), f, zero);
+   return vminq_f32(f, vdupq_n_f32(1.0f));
+}
+
+/* Matches float_to_ubyte(), returning the bytes in 32-bit lanes. */
+static inline uint32x4_t
+float4_to_ubyte(float32x4_t f)
+{
+   f = vaddq_f32(vmulq_f32(saturate(f), vdupq_n_f32(255.0f / 256.0f)),
+                 vdupq_n_f32(32768.0f));
+   return vandq_u32(vreinterpretq_u32_f32(f), vdupq_n_u32(0xff));
+}
+
+static inline uint8x16_t
+float16_to_ubyte(const float32x4_t f[4])
+{
+   uint16x8_t lo = vcombine_u16(vmovn_u32(float4_to_ubyte(f[0])),
+                                vmovn_u32(float4_to_ubyte(f[1])));
+   uint16x8_t hi = vcombine_u16(vmovn_u32(float4_to_ubyte(f[2])),
+                                vmovn_u32(float4_to_ubyte(f[3])));
+
+   return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+#ifdef __aarch64__
+/* The magic multiplies need denormals, which 32-bit NEON flushes to zero. */
+
+/* Matches util_half_to_float(). */
+static inline float32x4_t
+half4_to_float(uint16x4_t h16)
+{
+   const float32x4_t magic = vreinterpretq_f32_u32(vdupq_n_u32(0xef << 23));
+   uint32x4_t h = vmovl_u16(h16);
+   float32x4_t f = vreinterpretq_f32_u32(
+      vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x7fff)), 13));
+
+   f = vmulq_f32(f, magic);
+
+   /* Inf / NaN */
+   uint32x4_t infnan = vcgeq_f32(f, vdupq_n_f32(65536.0f));
+   uint32x4_t u = vorrq_u32(vreinterpretq_u32_f32(f),
+                            vandq_u32(infnan, vdupq_n_u32(0xff << 23)));
+
+   /* Sign */
+   u = vorrq_u32(u, vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x8000)), 16));
+   return vreinterpretq_f32_u32(u);
+}
+
+/* Matches util_float_to_half_rtz(). */
+static inline uint16x4_t
+float4_to_half_rtz(float32x4_t f)
+{
+   const uint32x4_t round_mask = vdupq_n_u32(~0xfff);
+   const uint32x4_t f32inf = vdupq_n_u32(0xff << 23);
+   const float32x4_t magic = vreinterpretq_f32_u32(vdupq_n_u32(0xf << 23));
+   uint32x4_t u = vreinterpretq_u32_f32(f);
+   uint32x4_t sign = vandq_u32(u, vdupq_n_u32(0x80000000));
+   uint32x4_t is_inf, is_nan, h;
+
+   u = veorq_u32(u, sign);
+   is_inf = vceqq_u32(u, f32inf);
+   is_nan = vcgtq_u32(u, f32inf);
+
+   /* Number */
+   u = vandq_u32(u, round_mask);
+   u = vreinterpretq_u32_f32(vmulq_f32(vreinterpretq_f32_u32(u), magic));
+   u = vsubq_u32(u, round_mask);
+
+   /* Clamp to max finite value if overflowed. */
+   u = vbslq_u32(vcgtq_u32(u, vdupq_n_u32(0x1f << 23)),
+                 vdupq_n_u32((0x1f << 23) - 1), u);
+   h = vshrq_n_u32(u, 13);
+
+   h = vbslq_u32(is_inf, vdupq_n_u32(0x7c00), h);
+   h = vbslq_u32(is_nan, vdupq_n_u32(0x7e00), h);
+
+   return vmovn_u32(vorrq_u32(h, vshrq_n_u32(sign, 16)));
+}
+#endif
+
+/*
+ * R8G8B8A8_UNORM and B8G8R8A8_UNORM, 16 pixels at a time.
+ */
+
+static inline void
+unpack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   uint8x16x4_t v = vld4q_u8(src);
+   float32x4_t c[4][4];
+
+   for (unsigned i = 0; i < 4; i++)
+      ubyte16_to_float(v.val[swap_rb && i != 3 ? 2 - i : i], c[i]);
+
+   for (unsigned j = 0; j < 4; j++) {
+      float32x4x4_t out = { { c[0][j], c[1][j], c[2][j], c[3][j] } };
+      vst4q_f32((float *)dst + j * 16, out);
+   }
+}
+
+static inline void
+pack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   float32x4_t c[4][4];
+   uint8x16x4_t out;
+
+   for (unsigned j = 0; j < 4; j++) {
+      float32x4x4_t v = vld4q_f32((const float *)src + j * 16);
+      for (unsigned i = 0; i < 4; i++)
+         c[i][j] = v.val[i];
+   }
+
+   for (unsigned i = 0; i < 4; i++)
+      out.val[swap_rb && i != 3 ? 2 - i : i] = float16_to_ubyte(c[i]);
+
+   vst4q_u8(dst, out);
+}
+
+static inline void
+rgba8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, true);
+}
+
+static inline void
+rgba8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, true);
+}
+
+/* Unpacking and packing 8unorm are the same swizzle. */
+static inline void
+bgra8_swap_rb_block(uint8_t *dst, const uint8_t *src)
+{
+   uint8x16x4_t v = vld4q_u8(src);
+   uint8x16_t tmp = v.val[0];
+
+   v.val[0] = v.val[2];
+   v.val[2] = tmp;
+   vst4q_u8(dst, v);
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba8_unpack_rgba_float, float, uint8_t, 16, 16, 4,
+                      rgba8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba8_pack_rgba_float, uint8_t, float, 16, 4, 16,
+                      rgba8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_float, float, uint8_t, 16, 16, 4,
+                      bgra8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_float, uint8_t, float, 16, 4, 16,
+                      bgra8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_8unorm, uint8_t, uint8_t, 16, 4, 4,
+                      bgra8_swap_rb_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_8unorm, uint8_t, uint8_t, 16, 4, 4,
+                      bgra8_swap_rb_block)
+
+/*
+ * R10G10B10A2_UNORM, 4 pixels at a time.
+ */
+
+static inline void
+rgb10a2_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const uint32x4_t mask = vdupq_n_u32(0x3ff);
+   const float32x4_t scale = vdupq_n_f32(1.0f / 0x3ff);
+   uint32x4_t v = vld1q_u32((const uint32_t *)src);
+   float32x4x4_t out;
+
+   out.val[0] = vmulq_f32(vcvtq_f32_u32(vandq_u32(v, mask)), scale);
+   out.val[1] = vmulq_f32(vcvtq_f32_u32(
+      vandq_u32(vshrq_n_u32(v, 10), mask)), scale);
+   out.val[2] = vmulq_f32(vcvtq_f32_u32(
+      vandq_u32(vshrq_n_u32(v, 20), mask)), scale);
+   out.val[3] = vmulq_f32(vcvtq_f32_u32(vshrq_n_u32(v, 30)),
+                          vdupq_n_f32(1.0f / 0x3));
+
+   vst4q_f32((float *)dst, out);
+}
+
+/* Matches util_iround() of a non-negative value. */
+static inline uint32x4_t
+iround4(float32x4_t f)
+{
+   return vcvtq_u32_f32(vaddq_f32(f, vdupq_n_f32(0.5f)));
+}
+
+static inline void
+rgb10a2_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float32x4_t scale = vdupq_n_f32(0x3ff);
+   float32x4x4_t c = vld4q_f32((const float *)src);
+   uint32x4_t v;
+
+   v = iround4(vmulq_f32(saturate(c.val[0]), scale));
+   v = vorrq_u32(v, vshlq_n_u32(
+      iround4(vmulq_f32(saturate(c.val[1]), scale)), 10));
+   v = vorrq_u32(v, vshlq_n_u32(
+      iround4(vmulq_f32(saturate(c.val[2]), scale)), 20));
+   v = vorrq_u32(v, vshlq_n_u32(
+      iround4(vmulq_f32(saturate(c.val[3]), vdupq_n_f32(0x3))), 30));
+
+   vst1q_u32((uint32_t *)dst, v);
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_unpack_rgba_float, float, uint8_t, 4, 16, 4,
+                      rgb10a2_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_pack_rgba_float, uint8_t, float, 4, 4, 16,
+                      rgb10a2_pack_float_block)
+
+#ifdef __aarch64__
+/*
+ * R16G16B16A16_FLOAT, 4 pixels at a time.
+ */
+
+static inline void
+rgba16f_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   for (unsigned i = 0; i < 2; i++) {
+      uint16x8_t v = vld1q_u16((const uint16_t *)src + i * 8);
+
+      vst1q_f32((float *)dst + i * 8, half4_to_float(vget_low_u16(v)));
+      vst1q_f32((float *)dst + i * 8 + 4, half4_to_float(vget_high_u16(v)));
+   }
+}
+
+static inline void
+rgba16f_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+
+   for (unsigned i = 0; i < 2; i++) {
+      uint16x8_t v = vcombine_u16(float4_to_half_rtz(vld1q_f32(f + i * 8)),
+                                  float4_to_half_rtz(vld1q_f32(f + i * 8 + 4)));
+      vst1q_u16((uint16_t *)dst + i * 8, v);
+   }
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba16f_unpack_rgba_float, float, uint8_t, 4, 16, 8,
+                      rgba16f_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba16f_pack_rgba_float, uint8_t, float, 4, 8, 16,
+                      rgba16f_pack_float_block)
+#endif
+
+/*
+ * Z16_UNORM, 8 pixels at a time. Z24_UNORM_S8_UINT converts in double
+ * precision, which 32-bit NEON doesn't have, and is left to the generated
+ * functions.
+ */
+
+static inline void
+z16_unpack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float32x4_t scale = vdupq_n_f32((float)(1.0 / 0xffff));
+   uint16x8_t v = vld1q_u16((const uint16_t *)src);
+
+   vst1q_f32((float *)dst, vmulq_f32(
+      vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+   vst1q_f32((float *)dst + 4, vmulq_f32(
+      vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+}
+
+static inline uint16x4_t
+z16_pack_z4(float32x4_t z)
+{
+   z = vaddq_f32(vmulq_f32(saturate(z), vdupq_n_f32(0xffff)),
+                 vdupq_n_f32(0.5f));
+   return vmovn_u32(vcvtq_u32_f32(z));
+}
+
+static inline void
+z16_pack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+
+   vst1q_u16((uint16_t *)dst, vcombine_u16(z16_pack_z4(vld1q_f32(f)),
+                                           z16_pack_z4(vld1q_f32(f + 4))));
+}
+
+UTIL_FORMAT_SIMD_FUNC(z16_unpack_z_float, float, uint8_t, 8, 4, 2,
+                      z16_unpack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z16_pack_z_float, uint8_t, float, 8, 2, 4,
+                      z16_pack_z_float_block)
+
+static const struct util_format_simd_funcs rgba8_funcs = {
+   .unpack_rgba_float = rgba8_unpack_rgba_float,
+   .pack_rgba_float = rgba8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs bgra8_funcs = {
+   .unpack_rgba_8unorm = bgra8_unpack_rgba_8unorm,
+   .pack_rgba_8unorm = bgra8_pack_rgba_8unorm,
+   .unpack_rgba_float = bgra8_unpack_rgba_float,
+   .pack_rgba_float = bgra8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs rgb10a2_funcs = {
+   .unpack_rgba_float = rgb10a2_unpack_rgba_float,
+   .pack_rgba_float = rgb10a2_pack_rgba_float,
+};
+
+#ifdef __aarch64__
+static const struct util_format_simd_funcs rgba16f_funcs = {
+   .unpack_rgba_float = rgba16f_unpack_rgba_float,
+   .pack_rgba_float = rgba16f_pack_rgba_float,
+};
+#endif
+
+static const struct util_format_simd_funcs z16_funcs = {
+   .unpack_z_float = z16_unpack_z_float,
+   .pack_z_float = z16_pack_z_float,
+};
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_neon(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return &rgba8_funcs;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return &bgra8_funcs;
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+      return &rgb10a2_funcs;
+#ifdef __aarch64__
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      return &rgba16f_funcs;
+#endif
+   case PIPE_FORMAT_Z16_UNORM:
+      return &z16_funcs;
+   default:
+      return NULL;
+   }
+}
+
+#endif /* UTIL_FORMAT_HAVE_NEON */
@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Vectorized pack/unpack functions for the most common formats.
+ *
+ * util_format_description() replaces the generated functions of those
+ * formats with these, using the widest instruction set the CPU supports.
+ * They give exactly the same results as the generated functions, which the
+ * format tests check.
+ *
+ * Each instruction set lives in its own file, so that it can be built with
+ * the matching compiler flags, and only be called after checking
+ * util_cpu_caps.
+ */
+
+#ifndef U_FORMAT_SIMD_H
+#define U_FORMAT_SIMD_H
+
+#include <string.h>
+
+#include "util/format/u_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define UTIL_FORMAT_HAVE_NEON 1
+#endif
+
+/**
+ * Replacements for the functions of struct util_format_description, NULL
+ * members keep the generated function.
+ */
+struct util_format_simd_funcs
+{
+   void
+   (*unpack_rgba_8unorm)(uint8_t *dst, unsigned dst_stride,
+                         const uint8_t *src, unsigned src_stride,
+                         unsigned width, unsigned height);
+   void
+   (*pack_rgba_8unorm)(uint8_t *dst, unsigned dst_stride,
+                       const uint8_t *src, unsigned src_stride,
+                       unsigned width, unsigned height);
+   void
+   (*unpack_rgba_float)(float *dst, unsigned dst_stride,
+                        const uint8_t *src, unsigned src_stride,
+                        unsigned width, unsigned height);
+   void
+   (*pack_rgba_float)(uint8_t *dst, unsigned dst_stride,
+                      const float *src, unsigned src_stride,
+                      unsigned width, unsigned height);
+   void
+   (*unpack_z_float)(float *dst, unsigned dst_stride,
+                     const uint8_t *src, unsigned src_stride,
+                     unsigned width, unsigned height);
+   void
+   (*pack_z_float)(uint8_t *dst, unsigned dst_stride,
+                   const float *src, unsigned src_stride,
+                   unsigned width, unsigned height);
+};
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_sse41(enum pipe_format format);
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_avx2(enum pipe_format format);
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_neon(enum pipe_format format);
+
+/**
+ * Defines a pack/unpack function from a block function converting n pixels
+ * at a time, from src to dst. The pixels at the end of each row that don't
+ * fill a block go through a temporary, which also holds the previous
+ * contents of dst for the functions only updating some bits of it.
+ */
+#define UTIL_FORMAT_SIMD_FUNC(name, dst_type, src_type, n, dst_bpp, src_bpp, block) \
+static void                                                                  \
+name(dst_type *dst_row, unsigned dst_stride,                                 \
+     const src_type *src_row, unsigned src_stride,                           \
+     unsigned width, unsigned height)                                        \
+{                                                                            \
+   uint8_t *dst_bytes = (uint8_t *)dst_row;                                  \
+   const uint8_t *src_bytes = (const uint8_t *)src_row;                      \
+                                                                             \
+   for (unsigned y = 0; y < height; y++) {                                   \
+      unsigned x = 0;                                                        \
+                                                                             \
+      for (; x + (n) <= width; x += (n))                                     \
+         block(dst_bytes + x * (dst_bpp), src_bytes + x * (src_bpp));        \
+                                                                             \
+      if (x < width) {                                                       \
+         uint8_t dst_tmp[(n) * (dst_bpp)] = { 0 };                           \
+         uint8_t src_tmp[(n) * (src_bpp)] = { 0 };                           \
+                                                                             \
+         memcpy(src_tmp, src_bytes + x * (src_bpp), (width - x) * (src_bpp)); \
+         memcpy(dst_tmp, dst_bytes + x * (dst_bpp), (width - x) * (dst_bpp)); \
+         block(dst_tmp, src_tmp);                                            \
+         memcpy(dst_bytes + x * (dst_bpp), dst_tmp, (width - x) * (dst_bpp)); \
+      }                                                                      \
+                                                                             \
+      dst_bytes += dst_stride;                                               \
+      src_bytes += src_stride;                                               \
+   }                                                                         \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_FORMAT_SIMD_H */
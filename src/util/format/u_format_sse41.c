@@ -0,0 +1,431 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * SSE4.1 versions of the pack/unpack functions, 4 pixels at a time.
+ */
+
+#include <smmintrin.h>
+
+#include "u_format_simd.h"
+
+/* Swaps the R and B bytes of 32-bit pixels. */
+static inline __m128i
+swap_rb_8888(__m128i v)
+{
+   const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                      10, 9, 8, 11, 14, 13, 12, 15);
+   return _mm_shuffle_epi8(v, mask);
+}
+
+/* Matches ubyte_to_float(). */
+static inline __m128
+ubyte4_to_float(__m128i v)
+{
+   return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255.0f));
+}
+
+/* Matches float_to_ubyte(), returning the bytes in 32-bit lanes. */
+static inline __m128i
+float4_to_ubyte(__m128 f)
+{
+   /* max() returns its second operand for NaN, which turns it into 0. */
+   f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   return _mm_and_si128(_mm_castps_si128(f), _mm_set1_epi32(0xff));
+}
+
+/* Matches util_iround() of a non-negative value. */
+static inline __m128i
+iround4(__m128 f)
+{
+#if defined(PIPE_ARCH_X86)
+   /* util_iround() uses the x87 rounding mode there, to nearest even. */
+   return _mm_cvtps_epi32(f);
+#else
+   return _mm_cvttps_epi32(_mm_add_ps(f, _mm_set1_ps(0.5f)));
+#endif
+}
+
+/* Matches util_half_to_float(). */
+static inline __m128
+half4_to_float(__m128i h)
+{
+   const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(0xef << 23));
+   __m128 f = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13));
+
+   f = _mm_mul_ps(f, magic);
+
+   /* Inf / NaN */
+   __m128 infnan = _mm_cmpge_ps(f, _mm_set1_ps(65536.0f));
+   f = _mm_or_ps(f, _mm_and_ps(infnan,
+                               _mm_castsi128_ps(_mm_set1_epi32(0xff << 23))));
+
+   /* Sign */
+   __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+   return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+
+/* Matches util_float_to_half_rtz(), returning the halves in 32-bit lanes. */
+static inline __m128i
+float4_to_half_rtz(__m128 f)
+{
+   const __m128i round_mask = _mm_set1_epi32(~0xfff);
+   const __m128i f32inf = _mm_set1_epi32(0xff << 23);
+   const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(0xf << 23));
+   __m128i u = _mm_castps_si128(f);
+   __m128i sign = _mm_and_si128(u, _mm_set1_epi32(0x80000000));
+   __m128i is_inf, is_nan, h;
+
+   u = _mm_xor_si128(u, sign);
+   is_inf = _mm_cmpeq_epi32(u, f32inf);
+   is_nan = _mm_cmpgt_epi32(u, f32inf);
+
+   /* Number */
+   u = _mm_and_si128(u, round_mask);
+   u = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(u), magic));
+   u = _mm_sub_epi32(u, round_mask);
+
+   /* Clamp to max finite value if overflowed. */
+   u = _mm_blendv_epi8(u, _mm_set1_epi32((0x1f << 23) - 1),
+                       _mm_cmpgt_epi32(u, _mm_set1_epi32(0x1f << 23)));
+   h = _mm_srli_epi32(u, 13);
+
+   h = _mm_blendv_epi8(h, _mm_set1_epi32(0x7c00), is_inf);
+   h = _mm_blendv_epi8(h, _mm_set1_epi32(0x7e00), is_nan);
+
+   return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+}
+
+/*
+ * R8G8B8A8_UNORM and B8G8R8A8_UNORM
+ */
+
+static inline void
+unpack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   __m128i v = _mm_loadu_si128((const __m128i *)src);
+
+   if (swap_rb)
+      v = swap_rb_8888(v);
+
+   _mm_storeu_ps((float *)dst + 0, ubyte4_to_float(_mm_cvtepu8_epi32(v)));
+   _mm_storeu_ps((float *)dst + 4,
+                 ubyte4_to_float(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))));
+   _mm_storeu_ps((float *)dst + 8,
+                 ubyte4_to_float(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+   _mm_storeu_ps((float *)dst + 12,
+                 ubyte4_to_float(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))));
+}
+
+static inline void
+pack_8888_float_block(uint8_t *dst, const uint8_t *src, bool swap_rb)
+{
+   const float *f = (const float *)src;
+   __m128i p0 = float4_to_ubyte(_mm_loadu_ps(f + 0));
+   __m128i p1 = float4_to_ubyte(_mm_loadu_ps(f + 4));
+   __m128i p2 = float4_to_ubyte(_mm_loadu_ps(f + 8));
+   __m128i p3 = float4_to_ubyte(_mm_loadu_ps(f + 12));
+   __m128i v = _mm_packus_epi16(_mm_packus_epi32(p0, p1),
+                                _mm_packus_epi32(p2, p3));
+
+   if (swap_rb)
+      v = swap_rb_8888(v);
+
+   _mm_storeu_si128((__m128i *)dst, v);
+}
+
+static inline void
+rgba8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   unpack_8888_float_block(dst, src, true);
+}
+
+static inline void
+rgba8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, false);
+}
+
+static inline void
+bgra8_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   pack_8888_float_block(dst, src, true);
+}
+
+/* Unpacking and packing 8unorm are the same swizzle. */
+static inline void
+bgra8_swap_rb_block(uint8_t *dst, const uint8_t *src)
+{
+   __m128i v = _mm_loadu_si128((const __m128i *)src);
+   _mm_storeu_si128((__m128i *)dst, swap_rb_8888(v));
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba8_unpack_rgba_float, float, uint8_t, 4, 16, 4,
+                      rgba8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba8_pack_rgba_float, uint8_t, float, 4, 4, 16,
+                      rgba8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_float, float, uint8_t, 4, 16, 4,
+                      bgra8_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_float, uint8_t, float, 4, 4, 16,
+                      bgra8_pack_float_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_unpack_rgba_8unorm, uint8_t, uint8_t, 4, 4, 4,
+                      bgra8_swap_rb_block)
+UTIL_FORMAT_SIMD_FUNC(bgra8_pack_rgba_8unorm, uint8_t, uint8_t, 4, 4, 4,
+                      bgra8_swap_rb_block)
+
+/*
+ * R10G10B10A2_UNORM
+ */
+
+static inline void
+rgb10a2_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m128i mask = _mm_set1_epi32(0x3ff);
+   const __m128 scale = _mm_set1_ps(1.0f / 0x3ff);
+   __m128i v = _mm_loadu_si128((const __m128i *)src);
+   __m128 r, g, b, a;
+
+   r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)), scale);
+   g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 10), mask)),
+                  scale);
+   b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 20), mask)),
+                  scale);
+   a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 30)),
+                  _mm_set1_ps(1.0f / 0x3));
+
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+
+   _mm_storeu_ps((float *)dst + 0, r);
+   _mm_storeu_ps((float *)dst + 4, g);
+   _mm_storeu_ps((float *)dst + 8, b);
+   _mm_storeu_ps((float *)dst + 12, a);
+}
+
+static inline void
+rgb10a2_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(0x3ff);
+   __m128 r = _mm_loadu_ps(f + 0);
+   __m128 g = _mm_loadu_ps(f + 4);
+   __m128 b = _mm_loadu_ps(f + 8);
+   __m128 a = _mm_loadu_ps(f + 12);
+   __m128i v;
+
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+
+   /* NaN becomes 0, like the out of range result of util_iround(). */
+   r = _mm_min_ps(_mm_max_ps(r, zero), one);
+   g = _mm_min_ps(_mm_max_ps(g, zero), one);
+   b = _mm_min_ps(_mm_max_ps(b, zero), one);
+   a = _mm_min_ps(_mm_max_ps(a, zero), one);
+
+   v = iround4(_mm_mul_ps(r, scale));
+   v = _mm_or_si128(v, _mm_slli_epi32(iround4(_mm_mul_ps(g, scale)), 10));
+   v = _mm_or_si128(v, _mm_slli_epi32(iround4(_mm_mul_ps(b, scale)), 20));
+   v = _mm_or_si128(v, _mm_slli_epi32(
+      iround4(_mm_mul_ps(a, _mm_set1_ps(0x3))), 30));
+
+   _mm_storeu_si128((__m128i *)dst, v);
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_unpack_rgba_float, float, uint8_t, 4, 16, 4,
+                      rgb10a2_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgb10a2_pack_rgba_float, uint8_t, float, 4, 4, 16,
+                      rgb10a2_pack_float_block)
+
+/*
+ * R16G16B16A16_FLOAT
+ */
+
+static inline void
+rgba16f_unpack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   for (unsigned i = 0; i < 2; i++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src + i);
+
+      _mm_storeu_ps((float *)dst + i * 8,
+                    half4_to_float(_mm_cvtepu16_epi32(v)));
+      _mm_storeu_ps((float *)dst + i * 8 + 4,
+                    half4_to_float(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8))));
+   }
+}
+
+static inline void
+rgba16f_pack_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+
+   for (unsigned i = 0; i < 2; i++) {
+      __m128i lo = float4_to_half_rtz(_mm_loadu_ps(f + i * 8));
+      __m128i hi = float4_to_half_rtz(_mm_loadu_ps(f + i * 8 + 4));
+
+      _mm_storeu_si128((__m128i *)dst + i, _mm_packus_epi32(lo, hi));
+   }
+}
+
+UTIL_FORMAT_SIMD_FUNC(rgba16f_unpack_rgba_float, float, uint8_t, 4, 16, 8,
+                      rgba16f_unpack_float_block)
+UTIL_FORMAT_SIMD_FUNC(rgba16f_pack_rgba_float, uint8_t, float, 4, 8, 16,
+                      rgba16f_pack_float_block)
+
+/*
+ * Z16_UNORM and Z24_UNORM_S8_UINT
+ */
+
+static inline void
+z16_unpack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m128 scale = _mm_set1_ps((float)(1.0 / 0xffff));
+   __m128i v = _mm_loadu_si128((const __m128i *)src);
+
+   _mm_storeu_ps((float *)dst + 0,
+                 _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(v)), scale));
+   _mm_storeu_ps((float *)dst + 4,
+                 _mm_mul_ps(_mm_cvtepi32_ps(
+                    _mm_cvtepu16_epi32(_mm_srli_si128(v, 8))), scale));
+}
+
+static inline __m128i
+z16_pack_z4(__m128 z)
+{
+   z = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   z = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(0xffff)), _mm_set1_ps(0.5f));
+   return _mm_cvttps_epi32(z);
+}
+
+static inline void
+z16_pack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const float *f = (const float *)src;
+   __m128i lo = z16_pack_z4(_mm_loadu_ps(f));
+   __m128i hi = z16_pack_z4(_mm_loadu_ps(f + 4));
+
+   _mm_storeu_si128((__m128i *)dst, _mm_packus_epi32(lo, hi));
+}
+
+/* z24_unorm_to_z32_float() converts in double precision. */
+static inline void
+z24s8_unpack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m128d scale = _mm_set1_pd(1.0 / 0xffffff);
+   __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)src),
+                             _mm_set1_epi32(0xffffff));
+   __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(v), scale));
+   __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)),
+                                       scale));
+
+   _mm_storeu_ps((float *)dst, _mm_movelh_ps(lo, hi));
+}
+
+static inline void
+z24s8_pack_z_float_block(uint8_t *dst, const uint8_t *src)
+{
+   const __m128d scale = _mm_set1_pd(0xffffff);
+   __m128 z = _mm_loadu_ps((const float *)src);
+   __m128i lo, hi, v;
+
+   z = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   lo = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(z), scale));
+   hi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(z, z)), scale));
+
+   /* Keep the stencil bits. */
+   v = _mm_loadu_si128((const __m128i *)dst);
+   v = _mm_and_si128(v, _mm_set1_epi32(0xff000000));
+   v = _mm_or_si128(v, _mm_unpacklo_epi64(lo, hi));
+
+   _mm_storeu_si128((__m128i *)dst, v);
+}
+
+UTIL_FORMAT_SIMD_FUNC(z16_unpack_z_float, float, uint8_t, 8, 4, 2,
+                      z16_unpack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z16_pack_z_float, uint8_t, float, 8, 2, 4,
+                      z16_pack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z24s8_unpack_z_float, float, uint8_t, 4, 4, 4,
+                      z24s8_unpack_z_float_block)
+UTIL_FORMAT_SIMD_FUNC(z24s8_pack_z_float, uint8_t, float, 4, 4, 4,
+                      z24s8_pack_z_float_block)
+
+static const struct util_format_simd_funcs rgba8_funcs = {
+   .unpack_rgba_float = rgba8_unpack_rgba_float,
+   .pack_rgba_float = rgba8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs bgra8_funcs = {
+   .unpack_rgba_8unorm = bgra8_unpack_rgba_8unorm,
+   .pack_rgba_8unorm = bgra8_pack_rgba_8unorm,
+   .unpack_rgba_float = bgra8_unpack_rgba_float,
+   .pack_rgba_float = bgra8_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs rgb10a2_funcs = {
+   .unpack_rgba_float = rgb10a2_unpack_rgba_float,
+   .pack_rgba_float = rgb10a2_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs rgba16f_funcs = {
+   .unpack_rgba_float = rgba16f_unpack_rgba_float,
+   .pack_rgba_float = rgba16f_pack_rgba_float,
+};
+
+static const struct util_format_simd_funcs z16_funcs = {
+   .unpack_z_float = z16_unpack_z_float,
+   .pack_z_float = z16_pack_z_float,
+};
+
+static const struct util_format_simd_funcs z24s8_funcs = {
+   .unpack_z_float = z24s8_unpack_z_float,
+   .pack_z_float = z24s8_pack_z_float,
+};
+
+const struct util_format_simd_funcs *
+util_format_simd_funcs_sse41(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return &rgba8_funcs;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return &bgra8_funcs;
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+      return &rgb10a2_funcs;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      return &rgba16f_funcs;
+   case PIPE_FORMAT_Z16_UNORM:
+      return &z16_funcs;
+   case PIPE_FORMAT_Z24_UNORM_S8_UINT:
+      return &z24s8_funcs;
+   default:
+      return NULL;
+   }
+}
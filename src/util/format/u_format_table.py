@@ -204,7 +204,7 @@ def write_format_table(formats):
         print()
         
     print("const struct util_format_description *")
-    print("util_format_description(enum pipe_format format)")
+    print("util_format_description_generic(enum pipe_format format)")
     print("{")
     print("   if (format >= PIPE_FORMAT_COUNT) {")
     print("      return NULL;")
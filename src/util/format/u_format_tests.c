@@ -28,9 +28,12 @@
 
 #include <math.h>
 #include <float.h>
+#include <stdio.h>
 
 #include "pipe/p_config.h"
+#include "util/os_time.h"
 #include "util/u_memory.h"
+#include "util/format/u_format.h"
 #include "util/format/u_format_tests.h"
 
 
@@ -1032,3 +1035,98 @@ util_format_test_cases[] =
 
 
 const unsigned util_format_nr_test_cases = ARRAY_SIZE(util_format_test_cases);
+
+
+/*
+ * Throughput of the pack/unpack functions of the formats with vectorized
+ * implementations.
+ */
+
+#define BENCHMARK_WIDTH  256
+#define BENCHMARK_HEIGHT 256
+#define BENCHMARK_REPEAT 64
+
+static const enum pipe_format
+util_format_benchmark_formats[] = {
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_Z16_UNORM,
+   PIPE_FORMAT_Z24_UNORM_S8_UINT,
+};
+
+
+static double
+benchmark_mpix_per_s(int64_t ns)
+{
+   double pixels = (double)BENCHMARK_WIDTH * BENCHMARK_HEIGHT * BENCHMARK_REPEAT;
+
+   return ns > 0 ? pixels * 1000.0 / ns : 0.0;
+}
+
+
+void
+util_format_benchmark(void)
+{
+   unsigned packed_stride = BENCHMARK_WIDTH * UTIL_FORMAT_MAX_PACKED_BYTES;
+   unsigned float_stride = BENCHMARK_WIDTH * 4 * sizeof(float);
+   unsigned unorm8_stride = BENCHMARK_WIDTH * 4;
+   uint8_t *packed = MALLOC(packed_stride * BENCHMARK_HEIGHT);
+   uint8_t *unorm8 = MALLOC(unorm8_stride * BENCHMARK_HEIGHT);
+   float *floats = MALLOC(float_stride * BENCHMARK_HEIGHT);
+   unsigned i;
+
+   if (!packed || !unorm8 || !floats)
+      goto out;
+
+   for (i = 0; i < packed_stride * BENCHMARK_HEIGHT; i++)
+      packed[i] = i * 7;
+   for (i = 0; i < unorm8_stride * BENCHMARK_HEIGHT; i++)
+      unorm8[i] = i * 13;
+   for (i = 0; i < BENCHMARK_WIDTH * 4 * BENCHMARK_HEIGHT; i++)
+      floats[i] = (float)(i % 1021) / 1020.0f;
+
+   printf("%-32s %-20s %12s %12s\n",
+          "format", "function", "generic", "dispatched");
+
+   for (i = 0; i < ARRAY_SIZE(util_format_benchmark_formats); i++) {
+      enum pipe_format format = util_format_benchmark_formats[i];
+      const struct util_format_description *descs[2] = {
+         util_format_description_generic(format),
+         util_format_description(format),
+      };
+
+#define BENCHMARK(func, dst, dst_stride, src, src_stride) \
+      if (descs[0]->func) { \
+         int64_t ns[2]; \
+         for (unsigned d = 0; d < 2; d++) { \
+            int64_t start; \
+            descs[d]->func(dst, dst_stride, src, src_stride, \
+                           BENCHMARK_WIDTH, BENCHMARK_HEIGHT); \
+            start = os_time_get_nano(); \
+            for (unsigned r = 0; r < BENCHMARK_REPEAT; r++) \
+               descs[d]->func(dst, dst_stride, src, src_stride, \
+                              BENCHMARK_WIDTH, BENCHMARK_HEIGHT); \
+            ns[d] = os_time_get_nano() - start; \
+         } \
+         printf("%-32s %-20s %7.1f Mpx/s %7.1f Mpx/s\n", \
+                descs[0]->name, #func, \
+                benchmark_mpix_per_s(ns[0]), benchmark_mpix_per_s(ns[1])); \
+      }
+
+      BENCHMARK(unpack_rgba_8unorm, unorm8, unorm8_stride, packed, packed_stride);
+      BENCHMARK(pack_rgba_8unorm, packed, packed_stride, unorm8, unorm8_stride);
+      BENCHMARK(unpack_rgba_float, floats, float_stride, packed, packed_stride);
+      BENCHMARK(pack_rgba_float, packed, packed_stride, floats, float_stride);
+      BENCHMARK(unpack_z_float, floats, float_stride, packed, packed_stride);
+      BENCHMARK(pack_z_float, packed, packed_stride, floats, float_stride);
+
+#undef BENCHMARK
+   }
+
+out:
+   FREE(packed);
+   FREE(unorm8);
+   FREE(floats);
+}
@@ -68,4 +68,12 @@ util_format_test_cases[];
 extern const unsigned util_format_nr_test_cases;
 
 
+/**
+ * Print the throughput of the generic and of the dispatched pack/unpack
+ * functions of the formats with vectorized implementations.
+ */
+void
+util_format_benchmark(void);
+
+
 #endif /* U_FORMAT_TESTS_H_ */
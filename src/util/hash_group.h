@@ -0,0 +1,192 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Control byte helpers for the grouped mode of hash_table.c and set.c.
+ *
+ * In grouped mode the table is split into groups of HASH_GROUP_SIZE slots,
+ * and each slot has a control byte next to the entry array.  A control byte
+ * is either HASH_CTRL_EMPTY, HASH_CTRL_DELETED, or 7 bits of the entry's
+ * hash.  A whole group of control bytes is compared against the searched
+ * hash at once, so a probe only touches the entries whose 7 bits match,
+ * instead of walking the entries one by one.
+ *
+ * The matches of a group are returned as a bitmask.  Each slot is
+ * represented by HASH_GROUP_BITS_PER_SLOT bits, which lets the NEON path
+ * avoid an emulated movemask.
+ */
+
+#ifndef HASH_GROUP_H
+#define HASH_GROUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bitscan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HASH_GROUP_SIZE 16
+
+#define HASH_CTRL_EMPTY   0x80
+#define HASH_CTRL_DELETED 0xfe
+
+#if defined(__SSE2__)
+typedef uint32_t hash_group_mask;
+#define HASH_GROUP_BITS_PER_SLOT 1
+#elif defined(__ARM_NEON)
+typedef uint64_t hash_group_mask;
+#define HASH_GROUP_BITS_PER_SLOT 4
+#else
+typedef uint32_t hash_group_mask;
+#define HASH_GROUP_BITS_PER_SLOT 1
+#endif
+
+/**
+ * Scrambles the user supplied hash, so that pointer hashes with few varying
+ * bits still spread over all the groups and control byte values.
+ */
+static inline uint32_t
+hash_group_mix(uint32_t hash)
+{
+   return hash * 0x9e3779b1u;
+}
+
+/**
+ * Returns the first group to probe, from the high bits of the mixed hash.
+ */
+static inline uint32_t
+hash_group_start(uint32_t mixed_hash, uint32_t num_groups)
+{
+   return ((uint64_t)mixed_hash * num_groups) >> 32;
+}
+
+/**
+ * Returns the control byte stored for a present entry.  The bits are taken
+ * below the ones selecting the group, and above the low bits of the
+ * product, which are poorly mixed.
+ */
+static inline uint8_t
+hash_group_ctrl(uint32_t mixed_hash)
+{
+   return (mixed_hash >> 7) & 0x7f;
+}
+
+/**
+ * Returns the mask of the slots of the group whose control byte is c.
+ */
+static inline hash_group_mask
+hash_group_match(const uint8_t *ctrl, uint8_t c)
+{
+#if defined(__SSE2__)
+   __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#elif defined(__ARM_NEON)
+   uint8x16_t eq = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(c));
+   uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+   return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+#else
+   hash_group_mask mask = 0;
+   for (unsigned i = 0; i < HASH_GROUP_SIZE; i++) {
+      if (ctrl[i] == c)
+         mask |= 1u << i;
+   }
+   return mask;
+#endif
+}
+
+/**
+ * Returns the mask of the slots of the group that don't hold an entry,
+ * either never used or deleted.
+ */
+static inline hash_group_mask
+hash_group_match_available(const uint8_t *ctrl)
+{
+#if defined(__SSE2__)
+   return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#elif defined(__ARM_NEON)
+   uint8x16_t avail = vtstq_u8(vld1q_u8(ctrl), vdupq_n_u8(0x80));
+   uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(avail), 4);
+   return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+#else
+   hash_group_mask mask = 0;
+   for (unsigned i = 0; i < HASH_GROUP_SIZE; i++) {
+      if (ctrl[i] & 0x80)
+         mask |= 1u << i;
+   }
+   return mask;
+#endif
+}
+
+static inline bool
+hash_group_has_empty(const uint8_t *ctrl)
+{
+   return hash_group_match(ctrl, HASH_CTRL_EMPTY) != 0;
+}
+
+/**
+ * Returns the index within the group of the first slot in mask.
+ */
+static inline unsigned
+hash_group_mask_first(hash_group_mask mask)
+{
+#if HASH_GROUP_BITS_PER_SLOT == 4
+   return (ffsll(mask) - 1) / 4;
+#else
+   return ffs(mask) - 1;
+#endif
+}
+
+static inline hash_group_mask
+hash_group_mask_clear_first(hash_group_mask mask)
+{
+#if HASH_GROUP_BITS_PER_SLOT == 4
+   return mask & ~((hash_group_mask)0xf << (ffsll(mask) - 1));
+#else
+   return mask & (mask - 1);
+#endif
+}
+
+/**
+ * Advances to the next group of a triangular probe sequence, which visits
+ * every group once when the number of groups is a power of two.
+ */
+static inline uint32_t
+hash_group_next(uint32_t group, uint32_t step, uint32_t num_groups)
+{
+   return (group + step) & (num_groups - 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HASH_GROUP_H */
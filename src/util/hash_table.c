@@ -38,6 +38,12 @@
  * For more information, see:
  *
  * http://cgit.freedesktop.org/~anholt/hash_table/tree/README
+ *
+ * Tables created with _mesa_hash_table_create_grouped() instead use a power
+ * of two number of slots split in groups, with a control byte per slot that
+ * lets a whole group be probed at once (see hash_group.h).  The entry array
+ * keeps using NULL and deleted_key for unused slots in both modes, so the
+ * iteration functions don't need to know about the control bytes.
  */
 
 #include <stdlib.h>
@@ -49,6 +55,7 @@
 #include "macros.h"
 #include "u_memory.h"
 #include "fast_urem_by_const.h"
+#include "hash_group.h"
 #include "util/u_memory.h"
 
 #define XXH_INLINE_ALL
@@ -164,10 +171,66 @@ _mesa_hash_table_init(struct hash_table *ht,
    ht->entries = 0;
    ht->deleted_entries = 0;
    ht->deleted_key = &deleted_key_value;
+   ht->ctrl = NULL;
 
    return ht->table != NULL;
 }
 
+/* Sizes the grouped table to HASH_GROUP_SIZE << size_index slots, allocating
+ * the entries and control bytes.  Grouped tables are kept at most 7/8 full.
+ */
+static bool
+hash_table_alloc_grouped(struct hash_table *ht, void *mem_ctx,
+                         unsigned size_index)
+{
+   uint32_t size = HASH_GROUP_SIZE << size_index;
+   struct hash_entry *table;
+   uint8_t *ctrl;
+
+   table = rzalloc_array(mem_ctx, struct hash_entry, size);
+   if (table == NULL)
+      return false;
+
+   ctrl = ralloc_array(table, uint8_t, size);
+   if (ctrl == NULL) {
+      ralloc_free(table);
+      return false;
+   }
+   memset(ctrl, HASH_CTRL_EMPTY, size);
+
+   ht->table = table;
+   ht->ctrl = ctrl;
+   ht->size_index = size_index;
+   ht->size = size;
+   ht->max_entries = size - size / 8;
+   ht->rehash = 0;
+   ht->size_magic = 0;
+   ht->rehash_magic = 0;
+   return true;
+}
+
+/**
+ * Initializes a table in grouped mode.  The API is the same as for
+ * _mesa_hash_table_init(), but searches probe a group of slots at a time
+ * with SIMD compares on their control bytes, which is faster for tables
+ * that are large or see a lot of failed searches.
+ */
+bool
+_mesa_hash_table_init_grouped(struct hash_table *ht,
+                              void *mem_ctx,
+                              uint32_t (*key_hash_function)(const void *key),
+                              bool (*key_equals_function)(const void *a,
+                                                          const void *b))
+{
+   ht->key_hash_function = key_hash_function;
+   ht->key_equals_function = key_equals_function;
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+   ht->deleted_key = &deleted_key_value;
+
+   return hash_table_alloc_grouped(ht, mem_ctx, 0);
+}
+
 struct hash_table *
 _mesa_hash_table_create(void *mem_ctx,
                         uint32_t (*key_hash_function)(const void *key),
@@ -191,6 +254,27 @@ _mesa_hash_table_create(void *mem_ctx,
    return ht;
 }
 
+struct hash_table *
+_mesa_hash_table_create_grouped(void *mem_ctx,
+                                uint32_t (*key_hash_function)(const void *key),
+                                bool (*key_equals_function)(const void *a,
+                                                            const void *b))
+{
+   struct hash_table *ht;
+
+   ht = ralloc(mem_ctx, struct hash_table);
+   if (ht == NULL)
+      return NULL;
+
+   if (!_mesa_hash_table_init_grouped(ht, ht, key_hash_function,
+                                      key_equals_function)) {
+      ralloc_free(ht);
+      return NULL;
+   }
+
+   return ht;
+}
+
 struct hash_table *
 _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx)
 {
@@ -210,6 +294,15 @@ _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx)
 
    memcpy(ht->table, src->table, ht->size * sizeof(struct hash_entry));
 
+   if (src->ctrl) {
+      ht->ctrl = ralloc_array(ht->table, uint8_t, ht->size);
+      if (ht->ctrl == NULL) {
+         ralloc_free(ht);
+         return NULL;
+      }
+      memcpy(ht->ctrl, src->ctrl, ht->size);
+   }
+
    return ht;
 }
 
@@ -256,6 +349,9 @@ _mesa_hash_table_clear(struct hash_table *ht,
       entry->key = NULL;
    }
 
+   if (ht->ctrl)
+      memset(ht->ctrl, HASH_CTRL_EMPTY, ht->size);
+
    ht->entries = 0;
    ht->deleted_entries = 0;
 }
@@ -276,11 +372,49 @@ _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
    ht->deleted_key = deleted_key;
 }
 
+static struct hash_entry *
+hash_table_search_grouped(struct hash_table *ht, uint32_t hash,
+                          const void *key)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+   uint8_t c = hash_group_ctrl(mixed);
+
+   for (uint32_t step = 1; step <= num_groups; step++) {
+      const uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, c);
+
+      while (mask) {
+         struct hash_entry *entry =
+            ht->table + group * HASH_GROUP_SIZE + hash_group_mask_first(mask);
+
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key))
+            return entry;
+
+         mask = hash_group_mask_clear_first(mask);
+      }
+
+      /* An insertion would have stopped at the first group with an empty
+       * slot, so the key can't be further down the sequence.
+       */
+      if (hash_group_has_empty(ctrl))
+         return NULL;
+
+      group = hash_group_next(group, step, num_groups);
+   }
+
+   return NULL;
+}
+
 static struct hash_entry *
 hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
 {
    assert(!key_pointer_is_reserved(ht, key));
 
+   if (ht->ctrl)
+      return hash_table_search_grouped(ht, hash, key);
+
    uint32_t size = ht->size;
    uint32_t start_hash_address = util_fast_urem32(hash, size, ht->size_magic);
    uint32_t double_hash = 1 + util_fast_urem32(hash, ht->rehash,
@@ -356,12 +490,72 @@ hash_table_insert_rehash(struct hash_table *ht, uint32_t hash,
    } while (true);
 }
 
+static void
+hash_table_insert_rehash_grouped(struct hash_table *ht, uint32_t hash,
+                                 const void *key, void *data)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+
+   for (uint32_t step = 1; ; step++) {
+      uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, HASH_CTRL_EMPTY);
+
+      if (likely(mask)) {
+         unsigned slot = hash_group_mask_first(mask);
+         struct hash_entry *entry = ht->table + group * HASH_GROUP_SIZE + slot;
+
+         ctrl[slot] = hash_group_ctrl(mixed);
+         entry->hash = hash;
+         entry->key = key;
+         entry->data = data;
+         return;
+      }
+
+      group = hash_group_next(group, step, num_groups);
+   }
+}
+
+static void
+hash_table_rehash_grouped(struct hash_table *ht, unsigned new_size_index)
+{
+   struct hash_table old_ht;
+
+   /* Keep the group count within what hash_group_start() can address. */
+   if (new_size_index >= 28)
+      return;
+
+   old_ht = *ht;
+
+   if (!hash_table_alloc_grouped(ht, ralloc_parent(old_ht.table),
+                                 new_size_index))
+      return;
+
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+
+   hash_table_foreach(&old_ht, entry) {
+      hash_table_insert_rehash_grouped(ht, entry->hash, entry->key,
+                                       entry->data);
+   }
+
+   ht->entries = old_ht.entries;
+
+   ralloc_free(old_ht.table);
+}
+
 static void
 _mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
 {
    struct hash_table old_ht;
    struct hash_entry *table;
 
+   if (ht->ctrl) {
+      hash_table_rehash_grouped(ht, new_size_index);
+      return;
+   }
+
    if (new_size_index >= ARRAY_SIZE(hash_sizes))
       return;
 
@@ -391,6 +585,67 @@ _mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
    ralloc_free(old_ht.table);
 }
 
+static struct hash_entry *
+hash_table_insert_grouped(struct hash_table *ht, uint32_t hash,
+                          const void *key, void *data)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+   uint8_t c = hash_group_ctrl(mixed);
+   uint8_t *available_ctrl = NULL;
+   struct hash_entry *available_entry = NULL;
+
+   for (uint32_t step = 1; step <= num_groups; step++) {
+      uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      struct hash_entry *entries = ht->table + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, c);
+
+      /* Replace the entry if the key is already present, as the non-grouped
+       * path does.
+       */
+      while (mask) {
+         struct hash_entry *entry = entries + hash_group_mask_first(mask);
+
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key)) {
+            entry->key = key;
+            entry->data = data;
+            return entry;
+         }
+
+         mask = hash_group_mask_clear_first(mask);
+      }
+
+      /* Stash the first available slot we find */
+      if (available_entry == NULL) {
+         hash_group_mask avail = hash_group_match_available(ctrl);
+         if (avail) {
+            unsigned slot = hash_group_mask_first(avail);
+            available_ctrl = ctrl + slot;
+            available_entry = entries + slot;
+         }
+      }
+
+      if (hash_group_has_empty(ctrl))
+         break;
+
+      group = hash_group_next(group, step, num_groups);
+   }
+
+   if (available_entry) {
+      if (*available_ctrl == HASH_CTRL_DELETED)
+         ht->deleted_entries--;
+      *available_ctrl = c;
+      available_entry->hash = hash;
+      available_entry->key = key;
+      available_entry->data = data;
+      ht->entries++;
+      return available_entry;
+   }
+
+   return NULL;
+}
+
 static struct hash_entry *
 hash_table_insert(struct hash_table *ht, uint32_t hash,
                   const void *key, void *data)
@@ -405,6 +660,9 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
       _mesa_hash_table_rehash(ht, ht->size_index);
    }
 
+   if (ht->ctrl)
+      return hash_table_insert_grouped(ht, hash, key, data);
+
    uint32_t size = ht->size;
    uint32_t start_hash_address = util_fast_urem32(hash, size, ht->size_magic);
    uint32_t double_hash = 1 + util_fast_urem32(hash, ht->rehash,
@@ -495,6 +753,24 @@ _mesa_hash_table_remove(struct hash_table *ht,
    if (!entry)
       return;
 
+   if (ht->ctrl) {
+      uint32_t index = entry - ht->table;
+      uint8_t *group = ht->ctrl + (index & ~(HASH_GROUP_SIZE - 1));
+
+      /* No probe sequence ever went past a group that still has an empty
+       * slot, so the slot can go back to empty instead of leaving a
+       * tombstone.
+       */
+      if (hash_group_has_empty(group)) {
+         ht->ctrl[index] = HASH_CTRL_EMPTY;
+         entry->key = NULL;
+         ht->entries--;
+         return;
+      }
+
+      ht->ctrl[index] = HASH_CTRL_DELETED;
+   }
+
    entry->key = ht->deleted_key;
    ht->entries--;
    ht->deleted_entries++;
@@ -58,6 +58,8 @@ struct hash_table {
    uint32_t size_index;
    uint32_t entries;
    uint32_t deleted_entries;
+   /* Control bytes of the groups, NULL unless created in grouped mode. */
+   uint8_t *ctrl;
 };
 
 struct hash_table *
@@ -73,6 +75,19 @@ _mesa_hash_table_init(struct hash_table *ht,
                       bool (*key_equals_function)(const void *a,
                                                   const void *b));
 
+struct hash_table *
+_mesa_hash_table_create_grouped(void *mem_ctx,
+                                uint32_t (*key_hash_function)(const void *key),
+                                bool (*key_equals_function)(const void *a,
+                                                            const void *b));
+
+bool
+_mesa_hash_table_init_grouped(struct hash_table *ht,
+                              void *mem_ctx,
+                              uint32_t (*key_hash_function)(const void *key),
+                              bool (*key_equals_function)(const void *a,
+                                                          const void *b));
+
 struct hash_table *
 _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx);
 void _mesa_hash_table_destroy(struct hash_table *ht,
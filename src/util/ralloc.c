@@ -67,9 +67,15 @@ __declspec(align(16))
 {
 #ifndef NDEBUG
    /* A canary value used to determine whether a pointer is ralloc'd. */
-   unsigned canary;
+   unsigned canary:24;
 #endif
 
+   /* RALLOC_FLAG_* */
+   unsigned flags:8;
+
+   /* Size of the allocation, for nodes allocated from an arena. */
+   uint32_t arena_size;
+
    struct ralloc_header *parent;
 
    /* The first child (head of a linked list) */
@@ -84,6 +90,40 @@ __declspec(align(16))
 
 typedef struct ralloc_header ralloc_header;
 
+/* The node was carved out of an arena chunk instead of malloc'ed. */
+#define RALLOC_FLAG_ARENA_NODE 0x1
+/* The node is an arena context, its arena pointer precedes the header. */
+#define RALLOC_FLAG_ARENA_CTX  0x2
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_CHUNK_SIZE (8 * 1024)
+#define ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+#define ARENA_CTX_PREFIX ALIGN_POT(sizeof(struct ralloc_arena *), ARENA_ALIGN)
+#define ARENA_CHUNK_HEADER ALIGN_POT(sizeof(struct ralloc_arena_chunk), ARENA_ALIGN)
+
+struct ralloc_arena_chunk {
+   struct ralloc_arena_chunk *next;
+};
+
+struct ralloc_arena {
+   /* One reference held by the arena context, plus one for each context
+    * holding nodes that were moved out of the arena.
+    */
+   unsigned refcount;
+
+   /* Whether freeing the arena context needs to visit its descendants,
+    * because one of them has a destructor or owns memory of its own.
+    */
+   bool needs_walk;
+
+   /* Free space of the current chunk. */
+   char *next;
+   char *end;
+
+   unsigned chunk_size;
+   struct ralloc_arena_chunk *chunks;
+};
+
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
 
@@ -98,6 +138,101 @@ get_header(const void *ptr)
 
 #define PTR_FROM_HEADER(info) (((char *) info) + sizeof(ralloc_header))
 
+static struct ralloc_arena *
+arena_of_ctx(const ralloc_header *info)
+{
+   assert(info->flags & RALLOC_FLAG_ARENA_CTX);
+   return *(struct ralloc_arena **)((char *) info - ARENA_CTX_PREFIX);
+}
+
+/* Return the arena that allocations with info as their parent come from:
+ * the closest arena context above info, as long as everything in between
+ * was allocated from it.
+ */
+static struct ralloc_arena *
+find_arena(const ralloc_header *info)
+{
+   for (; info != NULL; info = info->parent) {
+      if (info->flags & RALLOC_FLAG_ARENA_CTX)
+         return arena_of_ctx(info);
+      if (!(info->flags & RALLOC_FLAG_ARENA_NODE))
+         return NULL;
+   }
+   return NULL;
+}
+
+static void *
+arena_alloc(struct ralloc_arena *arena, size_t size)
+{
+   struct ralloc_arena_chunk *chunk;
+   char *ptr;
+
+   size = ALIGN_POT(size, ARENA_ALIGN);
+
+   if (likely(size <= (size_t)(arena->end - arena->next))) {
+      ptr = arena->next;
+      arena->next += size;
+      return ptr;
+   }
+
+   /* Big allocations get a chunk of their own, so that they don't waste the
+    * rest of the current one.
+    */
+   if (size > arena->chunk_size / 4) {
+      chunk = malloc(ARENA_CHUNK_HEADER + size);
+      if (unlikely(chunk == NULL))
+         return NULL;
+
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      return (char *) chunk + ARENA_CHUNK_HEADER;
+   }
+
+   chunk = malloc(ARENA_CHUNK_HEADER + arena->chunk_size);
+   if (unlikely(chunk == NULL))
+      return NULL;
+
+   chunk->next = arena->chunks;
+   arena->chunks = chunk;
+   ptr = (char *) chunk + ARENA_CHUNK_HEADER;
+   arena->next = ptr + size;
+   arena->end = ptr + arena->chunk_size;
+
+   if (arena->chunk_size < ARENA_MAX_CHUNK_SIZE)
+      arena->chunk_size *= 2;
+
+   return ptr;
+}
+
+static void
+arena_free_chunks(struct ralloc_arena *arena)
+{
+   while (arena->chunks) {
+      struct ralloc_arena_chunk *chunk = arena->chunks;
+      arena->chunks = chunk->next;
+      free(chunk);
+   }
+   arena->next = NULL;
+   arena->end = NULL;
+}
+
+static void
+arena_unref(struct ralloc_arena *arena)
+{
+   assert(arena->refcount > 0);
+   if (--arena->refcount)
+      return;
+
+   arena_free_chunks(arena);
+   free(arena);
+}
+
+static void
+arena_ref_destructor(void *ptr)
+{
+   arena_unref(*(struct ralloc_arena **) ptr);
+}
+
 static void
 add_child(ralloc_header *parent, ralloc_header *info)
 {
@@ -117,34 +252,63 @@ ralloc_context(const void *ctx)
    return ralloc_size(ctx, 0);
 }
 
-void *
-ralloc_size(const void *ctx, size_t size)
+static void
+init_header(ralloc_header *info, ralloc_header *parent, unsigned flags)
 {
-   void *block = malloc(size + sizeof(ralloc_header));
-   ralloc_header *info;
-   ralloc_header *parent;
-
-   if (unlikely(block == NULL))
-      return NULL;
-
-   info = (ralloc_header *) block;
    /* measurements have shown that calloc is slower (because of
     * the multiplication overflow checking?), so clear things
     * manually
     */
+   info->flags = flags;
    info->parent = NULL;
    info->child = NULL;
    info->prev = NULL;
    info->next = NULL;
    info->destructor = NULL;
 
-   parent = ctx != NULL ? get_header(ctx) : NULL;
-
    add_child(parent, info);
 
 #ifndef NDEBUG
    info->canary = CANARY;
 #endif
+}
+
+/* Allocate a node, from the arena of the parent if it has one. */
+static ralloc_header *
+alloc_node(ralloc_header *parent, size_t size)
+{
+   struct ralloc_arena *arena = parent ? find_arena(parent) : NULL;
+   ralloc_header *info;
+
+   if (arena && likely(size <= UINT32_MAX)) {
+      info = arena_alloc(arena, size + sizeof(ralloc_header));
+      if (unlikely(info == NULL))
+         return NULL;
+
+      info->arena_size = size;
+      init_header(info, parent, RALLOC_FLAG_ARENA_NODE);
+      return info;
+   }
+
+   info = malloc(size + sizeof(ralloc_header));
+   if (unlikely(info == NULL))
+      return NULL;
+
+   if (arena)
+      arena->needs_walk = true;
+
+   init_header(info, parent, 0);
+   return info;
+}
+
+void *
+ralloc_size(const void *ctx, size_t size)
+{
+   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
+   ralloc_header *info = alloc_node(parent, size);
+
+   if (unlikely(info == NULL))
+      return NULL;
 
    return PTR_FROM_HEADER(info);
 }
@@ -160,6 +324,51 @@ rzalloc_size(const void *ctx, size_t size)
    return ptr;
 }
 
+/* Resize a node allocated from an arena.  It is grown in place when it is
+ * the last allocation of the current chunk, and copied otherwise, leaving
+ * the old copy for the arena to reclaim.
+ */
+static ralloc_header *
+arena_resize(ralloc_header *old, size_t size)
+{
+   struct ralloc_arena *arena = find_arena(old);
+   size_t old_size = old->arena_size;
+   ralloc_header *info;
+
+   if (arena && size <= UINT32_MAX) {
+      char *old_end = (char *) old +
+         ALIGN_POT(sizeof(ralloc_header) + old_size, ARENA_ALIGN);
+      char *new_end = (char *) old +
+         ALIGN_POT(sizeof(ralloc_header) + size, ARENA_ALIGN);
+
+      if (old_end == arena->next && new_end <= arena->end) {
+         arena->next = new_end;
+         old->arena_size = size;
+         return old;
+      }
+
+      info = arena_alloc(arena, sizeof(ralloc_header) + size);
+   } else {
+      /* The node was moved out of its arena, or got too big for it. */
+      info = malloc(sizeof(ralloc_header) + size);
+      if (arena)
+         arena->needs_walk = true;
+   }
+
+   if (unlikely(info == NULL))
+      return NULL;
+
+   memcpy(info, old, sizeof(ralloc_header) + MIN2(old_size, size));
+
+   if (arena && size <= UINT32_MAX) {
+      info->arena_size = size;
+   } else {
+      info->flags &= ~RALLOC_FLAG_ARENA_NODE;
+   }
+
+   return info;
+}
+
 /* helper function - assumes ptr != NULL */
 static void *
 resize(void *ptr, size_t size)
@@ -167,7 +376,16 @@ resize(void *ptr, size_t size)
    ralloc_header *child, *old, *info;
 
    old = get_header(ptr);
-   info = realloc(old, size + sizeof(ralloc_header));
+
+   if (old->flags & RALLOC_FLAG_ARENA_NODE) {
+      info = arena_resize(old, size);
+   } else if (old->flags & RALLOC_FLAG_ARENA_CTX) {
+      char *block = realloc((char *) old - ARENA_CTX_PREFIX,
+                            ARENA_CTX_PREFIX + sizeof(ralloc_header) + size);
+      info = block ? (ralloc_header *) (block + ARENA_CTX_PREFIX) : NULL;
+   } else {
+      info = realloc(old, size + sizeof(ralloc_header));
+   }
 
    if (info == NULL)
       return NULL;
@@ -288,19 +506,81 @@ unlink_block(ralloc_header *info)
 static void
 unsafe_free(ralloc_header *info)
 {
-   /* Recursively free any children...don't waste time unlinking them. */
-   ralloc_header *temp;
-   while (info->child != NULL) {
-      temp = info->child;
-      info->child = temp->next;
-      unsafe_free(temp);
+   ralloc_header *refs = NULL;
+
+   /* Recursively free any children...don't waste time unlinking them.  The
+    * descendants of an arena context only need to be visited if some of them
+    * have destructors or memory of their own to free.
+    */
+   if (!(info->flags & RALLOC_FLAG_ARENA_CTX) ||
+       arena_of_ctx(info)->needs_walk) {
+      ralloc_header *temp;
+      while (info->child != NULL) {
+         temp = info->child;
+         info->child = temp->next;
+         /* Arena references must outlive the nodes they keep alive, which
+          * may be this block and its other children.
+          */
+         if (temp->destructor == arena_ref_destructor) {
+            temp->next = refs;
+            refs = temp;
+            continue;
+         }
+         unsafe_free(temp);
+      }
    }
 
    /* Free the block itself.  Call the destructor first, if any. */
    if (info->destructor != NULL)
       info->destructor(PTR_FROM_HEADER(info));
 
-   free(info);
+   if (info->flags & RALLOC_FLAG_ARENA_CTX) {
+      arena_unref(arena_of_ctx(info));
+      free((char *) info - ARENA_CTX_PREFIX);
+   } else if (!(info->flags & RALLOC_FLAG_ARENA_NODE)) {
+      free(info);
+   }
+
+   while (refs != NULL) {
+      ralloc_header *next = refs->next;
+      arena_unref(*(struct ralloc_arena **) PTR_FROM_HEADER(refs));
+      free(refs);
+      refs = next;
+   }
+}
+
+/* Keep the arena alive as long as holder, which got some of its nodes. */
+static void
+arena_add_ref(ralloc_header *holder, struct ralloc_arena *arena)
+{
+   ralloc_header *info = malloc(sizeof(ralloc_header) +
+                                sizeof(struct ralloc_arena *));
+
+   /* Leak the arena rather than risking a use after free. */
+   arena->refcount++;
+   if (unlikely(info == NULL))
+      return;
+
+   init_header(info, holder, 0);
+   *(struct ralloc_arena **) PTR_FROM_HEADER(info) = arena;
+   info->destructor = arena_ref_destructor;
+}
+
+/* Bookkeeping after some nodes that were in the src arena (or none) moved
+ * below holder, which is in the dst arena (or none).
+ */
+static void
+arena_moved(ralloc_header *holder, struct ralloc_arena *src,
+            struct ralloc_arena *dst)
+{
+   if (src == dst)
+      return;
+
+   if (dst)
+      dst->needs_walk = true;
+
+   if (src)
+      arena_add_ref(holder, src);
 }
 
 void
@@ -314,9 +594,16 @@ ralloc_steal(const void *new_ctx, void *ptr)
    info = get_header(ptr);
    parent = new_ctx ? get_header(new_ctx) : NULL;
 
+   struct ralloc_arena *src = NULL;
+   if (info->flags & RALLOC_FLAG_ARENA_NODE)
+      src = find_arena(info->parent);
+
    unlink_block(info);
 
    add_child(parent, info);
+
+   if (src || (parent && parent->flags))
+      arena_moved(info, src, parent ? find_arena(parent) : NULL);
 }
 
 void
@@ -334,6 +621,9 @@ ralloc_adopt(const void *new_ctx, void *old_ctx)
    if (unlikely(old_info->child == NULL))
       return;
 
+   struct ralloc_arena *src = find_arena(old_info);
+   struct ralloc_arena *dst = find_arena(new_info);
+
    /* Set all the children's parent to new_ctx; get a pointer to the last child. */
    for (child = old_info->child; child->next != NULL; child = child->next) {
       child->parent = new_info;
@@ -344,8 +634,30 @@ ralloc_adopt(const void *new_ctx, void *old_ctx)
    child->next = new_info->child;
    if (child->next)
       child->next->prev = child;
+   /* The arena of new_ctx has no live nodes left, and the one of old_ctx
+    * only has the ones being moved: simply swap their memory.
+    */
+   if (src && dst && src != dst &&
+       (new_info->flags & RALLOC_FLAG_ARENA_CTX) && new_info->child == NULL &&
+       (old_info->flags & RALLOC_FLAG_ARENA_CTX) &&
+       src->refcount == 1 && dst->refcount == 1) {
+      arena_free_chunks(dst);
+      dst->chunks = src->chunks;
+      dst->next = src->next;
+      dst->end = src->end;
+      dst->chunk_size = src->chunk_size;
+      dst->needs_walk = src->needs_walk;
+      src->chunks = NULL;
+      src->next = NULL;
+      src->end = NULL;
+      src->needs_walk = false;
+      src = dst;
+   }
+
    new_info->child = old_info->child;
    old_info->child = NULL;
+
+   arena_moved(new_info, src, dst);
 }
 
 void *
@@ -365,6 +677,73 @@ ralloc_set_destructor(const void *ptr, void(*destructor)(void *))
 {
    ralloc_header *info = get_header(ptr);
    info->destructor = destructor;
+
+   if (destructor && (info->flags & RALLOC_FLAG_ARENA_NODE)) {
+      struct ralloc_arena *arena = find_arena(info);
+      if (arena)
+         arena->needs_walk = true;
+   }
+}
+
+void *
+ralloc_arena_size(const void *ctx, size_t size)
+{
+   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
+   struct ralloc_arena *arena;
+   ralloc_header *info;
+   char *block;
+
+   arena = malloc(sizeof(*arena));
+   if (unlikely(arena == NULL))
+      return NULL;
+
+   block = malloc(ARENA_CTX_PREFIX + sizeof(ralloc_header) + size);
+   if (unlikely(block == NULL)) {
+      free(arena);
+      return NULL;
+   }
+
+   arena->refcount = 1;
+   arena->needs_walk = false;
+   arena->next = NULL;
+   arena->end = NULL;
+   arena->chunk_size = ARENA_MIN_CHUNK_SIZE;
+   arena->chunks = NULL;
+
+   *(struct ralloc_arena **) block = arena;
+   info = (ralloc_header *) (block + ARENA_CTX_PREFIX);
+
+   /* The context owns memory, an enclosing arena has to free it. */
+   struct ralloc_arena *outer = parent ? find_arena(parent) : NULL;
+   if (outer)
+      outer->needs_walk = true;
+
+   init_header(info, parent, RALLOC_FLAG_ARENA_CTX);
+
+   return PTR_FROM_HEADER(info);
+}
+
+void *
+rzalloc_arena_size(const void *ctx, size_t size)
+{
+   void *ptr = ralloc_arena_size(ctx, size);
+
+   if (likely(ptr))
+      memset(ptr, 0, size);
+
+   return ptr;
+}
+
+void *
+ralloc_arena_context(const void *ctx)
+{
+   return ralloc_arena_size(ctx, 0);
+}
+
+bool
+ralloc_is_arena(const void *ptr)
+{
+   return ptr && (get_header(ptr)->flags & RALLOC_FLAG_ARENA_CTX);
 }
 
 char *
@@ -313,6 +313,45 @@ void *ralloc_parent(const void *ptr);
  */
 void ralloc_set_destructor(const void *ptr, void(*destructor)(void *));
 
+/// \defgroup arena Arena Contexts @{
+/**
+ * Create a new ralloc context whose descendants are allocated from an arena.
+ *
+ * Allocations made with the arena context, or one of its descendants, as
+ * their parent are carved out of large chunks of memory with a pointer bump
+ * instead of a malloc each.  They are regular ralloc nodes otherwise: they
+ * can have children and destructors, be stolen and be freed.
+ *
+ * The memory of a node freed individually is only reclaimed when the whole
+ * arena is.  That happens when the arena context is freed, unless some of its
+ * nodes were stolen or adopted out of it, in which case the chunks live until
+ * the last of those nodes is freed as well.  Freeing the arena context skips
+ * walking its descendants entirely unless one of them has a destructor or
+ * wasn't allocated from the arena.
+ *
+ * This is meant for contexts like compiler IR that make a lot of small
+ * allocations which mostly all die together.
+ */
+void *ralloc_arena_context(const void *ctx);
+
+/**
+ * Like ralloc_size(), but the allocated object is the arena context.
+ */
+void *ralloc_arena_size(const void *ctx, size_t size) MALLOCLIKE;
+
+/**
+ * Like rzalloc_size(), but the allocated object is the arena context.
+ */
+void *rzalloc_arena_size(const void *ctx, size_t size) MALLOCLIKE;
+
+#define rzalloc_arena(ctx, type) ((type *) rzalloc_arena_size(ctx, sizeof(type)))
+
+/**
+ * Return whether \p ptr is an arena context.
+ */
+bool ralloc_is_arena(const void *ptr);
+/// @}
+
 /// \defgroup array String Functions @{
 /**
  * Duplicate a string, allocating the memory from the given context.
@@ -0,0 +1,157 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include "util/ralloc.h"
+
+static unsigned destroyed;
+
+static void
+count_destructor(void *ptr)
+{
+   destroyed++;
+}
+
+TEST(ralloc_arena, basic)
+{
+   void *arena = ralloc_arena_context(NULL);
+   EXPECT_TRUE(ralloc_is_arena(arena));
+
+   void *prev = arena;
+   for (unsigned i = 0; i < 100000; i++) {
+      unsigned *p = ralloc(i % 7 ? arena : prev, unsigned);
+      *p = i;
+      EXPECT_EQ(ralloc_parent(p), i % 7 ? arena : prev);
+      EXPECT_FALSE(ralloc_is_arena(p));
+      prev = p;
+   }
+
+   /* Big allocations come from dedicated chunks. */
+   char *big = (char *)ralloc_size(arena, 1 << 20);
+   memset(big, 0xff, 1 << 20);
+
+   char *str = ralloc_strdup(arena, "hello");
+   ralloc_strcat(&str, " world");
+   EXPECT_STREQ(str, "hello world");
+
+   ralloc_free(arena);
+}
+
+TEST(ralloc_arena, destructor)
+{
+   void *arena = ralloc_arena_context(NULL);
+
+   destroyed = 0;
+   void *a = ralloc_context(arena);
+   void *b = ralloc_size(a, 16);
+   ralloc_set_destructor(b, count_destructor);
+
+   ralloc_free(a);
+   EXPECT_EQ(destroyed, 1);
+
+   b = ralloc_size(arena, 16);
+   ralloc_set_destructor(b, count_destructor);
+   ralloc_free(arena);
+   EXPECT_EQ(destroyed, 2);
+}
+
+TEST(ralloc_arena, resize)
+{
+   void *arena = ralloc_arena_context(NULL);
+
+   unsigned *a = ralloc_array(arena, unsigned, 4);
+   for (unsigned i = 0; i < 4; i++)
+      a[i] = i;
+   unsigned *child = ralloc(a, unsigned);
+
+   /* a is the last allocation, it grows in place. */
+   a = reralloc(arena, a, unsigned, 8);
+   EXPECT_EQ(ralloc_parent(child), a);
+
+   unsigned *b = ralloc(arena, unsigned);
+   *b = 42;
+
+   /* Not anymore, it gets copied. */
+   a = reralloc(arena, a, unsigned, 1024);
+   for (unsigned i = 0; i < 4; i++)
+      EXPECT_EQ(a[i], i);
+   EXPECT_EQ(ralloc_parent(child), a);
+   EXPECT_EQ(*b, 42);
+
+   ralloc_free(arena);
+}
+
+TEST(ralloc_arena, steal_out)
+{
+   void *ctx = ralloc_context(NULL);
+   void *arena = ralloc_arena_context(NULL);
+
+   char *str = ralloc_strdup(arena, "survivor");
+   char *child = ralloc_strdup(str, "child");
+   ralloc_steal(ctx, str);
+   EXPECT_EQ(ralloc_parent(str), ctx);
+
+   /* The stolen node and its children outlive the arena context. */
+   ralloc_free(arena);
+   EXPECT_STREQ(str, "survivor");
+   EXPECT_STREQ(child, "child");
+
+   /* Allocations under it now come from malloc. */
+   char *other = ralloc_strdup(str, "other");
+   ralloc_free(other);
+
+   ralloc_free(ctx);
+}
+
+TEST(ralloc_arena, adopt)
+{
+   void *dst = ralloc_arena_context(NULL);
+   void *src = ralloc_arena_context(NULL);
+
+   for (unsigned i = 0; i < 1000; i++)
+      ralloc_size(dst, 64);
+
+   /* The nir_shader_replace() sequence: drop dst's children, then move
+    * src's to it.
+    */
+   void *dead = ralloc_context(NULL);
+   ralloc_adopt(dead, dst);
+   ralloc_free(dead);
+
+   char *str = ralloc_strdup(src, "moved");
+   ralloc_adopt(dst, src);
+   ralloc_free(src);
+
+   EXPECT_EQ(ralloc_parent(str), dst);
+   EXPECT_STREQ(str, "moved");
+
+   /* Adopting from an arena that isn't otherwise empty keeps it alive. */
+   void *other = ralloc_arena_context(NULL);
+   char *str2 = ralloc_strdup(other, "kept");
+   ralloc_adopt(dst, other);
+   ralloc_free(other);
+   EXPECT_STREQ(str2, "kept");
+
+   ralloc_free(dst);
+}
@@ -71,16 +71,24 @@
  */
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "blob.h"
 #include "ralloc.h"
 #include "main/macros.h"
 #include "util/bitset.h"
+#include "util/detect_os.h"
+#include "util/os_misc.h"
+#include "util/u_atomic.h"
 #include "util/u_dynarray.h"
 #include "u_math.h"
 #include "register_allocate.h"
 
+#if DETECT_OS_UNIX
+#include <unistd.h>
+#endif
+
 struct ra_reg {
    BITSET_WORD *conflicts;
    struct util_dynarray conflict_list;
@@ -195,6 +203,21 @@ struct ra_graph {
        */
       unsigned int *min_q_node;
 
+      /**
+       * Bit-set indicating, for each BITSET_WORD, if pq_test may be set for
+       * some of its nodes that aren't in the stack yet.
+       */
+      BITSET_WORD *pq_words;
+
+      /**
+       * For each group of BITSET_WORDBITS BITSET_WORDs, the minimum
+       * min_q_total or ~0 if all of its nodes are gone, and the matching
+       * node.  Only valid if the bit of the group isn't set in group_dirty.
+       */
+      unsigned int *group_min_q_total;
+      unsigned int *group_min_q_node;
+      BITSET_WORD *group_dirty;
+
       /**
        * Tracks the start of the set of optimistically-colored registers in the
        * stack.
@@ -561,6 +584,15 @@ ra_realloc_interference_graph(struct ra_graph *g, unsigned int alloc)
    g->tmp.min_q_node = reralloc(g, g->tmp.min_q_node, unsigned int,
                                 bitset_count);
 
+   unsigned group_count = BITSET_WORDS(bitset_count);
+   g->tmp.pq_words = reralloc(g, g->tmp.pq_words, BITSET_WORD, group_count);
+   g->tmp.group_min_q_total = reralloc(g, g->tmp.group_min_q_total,
+                                       unsigned int, group_count);
+   g->tmp.group_min_q_node = reralloc(g, g->tmp.group_min_q_node,
+                                      unsigned int, group_count);
+   g->tmp.group_dirty = reralloc(g, g->tmp.group_dirty, BITSET_WORD,
+                                 BITSET_WORDS(group_count));
+
    g->alloc = alloc;
 }
 
@@ -648,6 +680,7 @@ update_pq_info(struct ra_graph *g, unsigned int n)
    int n_class = g->nodes[n].class;
    if (g->nodes[n].tmp.q_total < g->regs->classes[n_class]->p) {
       BITSET_SET(g->tmp.pq_test, n);
+      BITSET_SET(g->tmp.pq_words, i);
    } else if (g->tmp.min_q_total[i] != UINT_MAX) {
       /* Only update min_q_total and min_q_node if min_q_total != UINT_MAX so
        * that we don't update while we have stale data and accidentally mark
@@ -660,26 +693,62 @@ update_pq_info(struct ra_graph *g, unsigned int n)
            n > g->tmp.min_q_node[i])) {
          g->tmp.min_q_total[i] = g->nodes[n].tmp.q_total;
          g->tmp.min_q_node[i] = n;
+
+         /* The same goes for the minimum of the group of words. */
+         int k = i / BITSET_WORDBITS;
+         if (!BITSET_TEST(g->tmp.group_dirty, k) &&
+             (g->nodes[n].tmp.q_total < g->tmp.group_min_q_total[k] ||
+              (g->nodes[n].tmp.q_total == g->tmp.group_min_q_total[k] &&
+               n > g->tmp.group_min_q_node[k]))) {
+            g->tmp.group_min_q_total[k] = g->nodes[n].tmp.q_total;
+            g->tmp.group_min_q_node[k] = n;
+         }
       }
    }
 }
 
+static void
+remove_neighbor_q(struct ra_graph *g, unsigned int n2, unsigned int n_class)
+{
+   unsigned int n2_class = g->nodes[n2].class;
+
+   assert(g->nodes[n2].tmp.q_total >= g->regs->classes[n2_class]->q[n_class]);
+   g->nodes[n2].tmp.q_total -= g->regs->classes[n2_class]->q[n_class];
+   update_pq_info(g, n2);
+}
+
 static void
 add_node_to_stack(struct ra_graph *g, unsigned int n)
 {
    int n_class = g->nodes[n].class;
+   unsigned int num_words = BITSET_WORDS(g->count);
 
    assert(!BITSET_TEST(g->tmp.in_stack, n));
 
-   util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
-      unsigned int n2 = *n2p;
-      unsigned int n2_class = g->nodes[n2].class;
+   if (util_dynarray_num_elements(&g->nodes[n].adjacency_list,
+                                  unsigned int) > num_words) {
+      /* For nodes with many neighbors, mask out the ones already in the
+       * stack or pre-assigned a whole word at a time, instead of testing
+       * them one by one.  Most of them are gone late in the simplify.
+       */
+      const BITSET_WORD *adjacency = g->nodes[n].adjacency;
 
-      if (!BITSET_TEST(g->tmp.in_stack, n2) &&
-          !BITSET_TEST(g->tmp.reg_assigned, n2)) {
-         assert(g->nodes[n2].tmp.q_total >= g->regs->classes[n2_class]->q[n_class]);
-         g->nodes[n2].tmp.q_total -= g->regs->classes[n2_class]->q[n_class];
-         update_pq_info(g, n2);
+      for (unsigned int i = 0; i < num_words; i++) {
+         BITSET_WORD live = adjacency[i] &
+            ~(g->tmp.in_stack[i] | g->tmp.reg_assigned[i]);
+
+         while (live) {
+            unsigned int j = u_bit_scan(&live);
+            remove_neighbor_q(g, i * BITSET_WORDBITS + j, n_class);
+         }
+      }
+   } else {
+      util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
+         unsigned int n2 = *n2p;
+
+         if (!BITSET_TEST(g->tmp.in_stack, n2) &&
+             !BITSET_TEST(g->tmp.reg_assigned, n2))
+            remove_neighbor_q(g, n2, n_class);
       }
    }
 
@@ -689,6 +758,75 @@ add_node_to_stack(struct ra_graph *g, unsigned int n)
 
    /* Flag the min_q_total for n's block as dirty so it gets recalculated */
    g->tmp.min_q_total[n / BITSET_WORDBITS] = UINT_MAX;
+   BITSET_SET(g->tmp.group_dirty, n / BITSET_WORDBITS / BITSET_WORDBITS);
+}
+
+/**
+ * Returns the highest bit set in the bitset at or below bit i, or -1.
+ */
+static int
+ra_prev_set_bit(const BITSET_WORD *set, int i)
+{
+   for (int w = i / BITSET_WORDBITS; i >= 0 && w >= 0; w--) {
+      BITSET_WORD word = set[w];
+      if (w == i / BITSET_WORDBITS)
+         word &= BITSET_MASK(i % BITSET_WORDBITS + 1);
+      if (word)
+         return w * BITSET_WORDBITS + util_last_bit(word) - 1;
+   }
+
+   return -1;
+}
+
+/**
+ * Recomputes the node with the lowest q_total of a group of words, along
+ * with the dirty minimums of its words.
+ */
+static void
+ra_update_group_min(struct ra_graph *g, int k)
+{
+   const int num_words = BITSET_WORDS(g->count);
+   const int first = k * BITSET_WORDBITS;
+   const int last = MIN2(first + BITSET_WORDBITS, num_words) - 1;
+
+   g->tmp.group_min_q_total[k] = UINT_MAX;
+   g->tmp.group_min_q_node[k] = UINT_MAX;
+
+   for (int i = last; i >= first; i--) {
+      const int high_bit = i == num_words - 1 ?
+                           (g->count - 1) % BITSET_WORDBITS :
+                           BITSET_WORDBITS - 1;
+      BITSET_WORD mask = ~(BITSET_WORD)0 >> (31 - high_bit);
+
+      BITSET_WORD skip = g->tmp.in_stack[i] | g->tmp.reg_assigned[i];
+      if (skip == mask)
+         continue;
+
+      if (g->tmp.min_q_total[i] == UINT_MAX) {
+         /* The min_q_total and min_q_node are dirty because we added
+          * one of these nodes to the stack.  It needs to be
+          * recalculated.
+          */
+         for (int j = high_bit; j >= 0; j--) {
+            if (skip & BITSET_BIT(j))
+               continue;
+
+            unsigned int n = i * BITSET_WORDBITS + j;
+            assert(n < g->count);
+            if (g->nodes[n].tmp.q_total < g->tmp.min_q_total[i]) {
+               g->tmp.min_q_total[i] = g->nodes[n].tmp.q_total;
+               g->tmp.min_q_node[i] = n;
+            }
+         }
+      }
+
+      if (g->tmp.min_q_total[i] < g->tmp.group_min_q_total[k]) {
+         g->tmp.group_min_q_total[k] = g->tmp.min_q_total[i];
+         g->tmp.group_min_q_node[k] = g->tmp.min_q_node[i];
+      }
+   }
+
+   BITSET_CLEAR(g->tmp.group_dirty, k);
 }
 
 /**
@@ -707,6 +845,9 @@ ra_simplify(struct ra_graph *g)
    bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
 
+   const int num_words = BITSET_WORDS(g->count);
+   const int num_groups = BITSET_WORDS(num_words);
+
    /* Figure out the high bit and bit mask for the first iteration of a loop
     * over BITSET_WORDs.
     */
@@ -714,7 +855,10 @@ ra_simplify(struct ra_graph *g)
 
    /* Do a quick pre-pass to set things up */
    g->tmp.stack_count = 0;
-   for (int i = BITSET_WORDS(g->count) - 1, high_bit = top_word_high_bit;
+   memset(g->tmp.pq_words, 0, num_groups * sizeof(BITSET_WORD));
+   memset(g->tmp.group_dirty, 0xff,
+          BITSET_WORDS(num_groups) * sizeof(BITSET_WORD));
+   for (int i = num_words - 1, high_bit = top_word_high_bit;
         i >= 0; i--, high_bit = BITSET_WORDBITS - 1) {
       g->tmp.in_stack[i] = 0;
       g->tmp.reg_assigned[i] = 0;
@@ -732,65 +876,68 @@ ra_simplify(struct ra_graph *g)
    }
 
    while (progress) {
-      unsigned int min_q_total = UINT_MAX;
-      unsigned int min_q_node = UINT_MAX;
-
       progress = false;
 
-      for (int i = BITSET_WORDS(g->count) - 1, high_bit = top_word_high_bit;
-           i >= 0; i--, high_bit = BITSET_WORDBITS - 1) {
-         BITSET_WORD mask = ~(BITSET_WORD)0 >> (31 - high_bit);
+      /* Only visit the words which may have trivially colorable nodes, from
+       * the top.  Nodes of lower words becoming trivially colorable as we go
+       * get pushed in the same pass, like when walking all the words.
+       */
+      for (int i = ra_prev_set_bit(g->tmp.pq_words, num_words - 1); i >= 0;
+           i = ra_prev_set_bit(g->tmp.pq_words, i - 1)) {
+         const int high_bit = i == num_words - 1 ? top_word_high_bit :
+                                                   BITSET_WORDBITS - 1;
 
          BITSET_WORD skip = g->tmp.in_stack[i] | g->tmp.reg_assigned[i];
-         if (skip == mask)
-            continue;
-
          BITSET_WORD pq = g->tmp.pq_test[i] & ~skip;
-         if (pq) {
-            /* In this case, we have stuff we can immediately take off the
-             * stack.  This also means that we're guaranteed to make progress
-             * and we don't need to bother updating lowest_q_total because we
-             * know we're going to loop again before attempting to do anything
-             * optimistic.
-             */
-            for (int j = high_bit; j >= 0; j--) {
-               if (pq & BITSET_BIT(j)) {
-                  unsigned int n = i * BITSET_WORDBITS + j;
-                  assert(n < g->count);
-                  add_node_to_stack(g, n);
-                  /* add_node_to_stack() may update pq_test for this word so
-                   * we need to update our local copy.
-                   */
-                  pq = g->tmp.pq_test[i] & ~skip;
-                  progress = true;
-               }
-            }
-         } else if (!progress) {
-            if (g->tmp.min_q_total[i] == UINT_MAX) {
-               /* The min_q_total and min_q_node are dirty because we added
-                * one of these nodes to the stack.  It needs to be
-                * recalculated.
+
+         /* In this case, we have stuff we can immediately take off the
+          * stack.  This also means that we're guaranteed to make progress
+          * and we don't need to bother looking for the lowest q_total
+          * because we know we're going to loop again before attempting to
+          * do anything optimistic.
+          */
+         for (int j = high_bit; j >= 0; j--) {
+            if (pq & BITSET_BIT(j)) {
+               unsigned int n = i * BITSET_WORDBITS + j;
+               assert(n < g->count);
+               add_node_to_stack(g, n);
+               /* add_node_to_stack() may update pq_test for this word so
+                * we need to update our local copy.
                 */
-               for (int j = high_bit; j >= 0; j--) {
-                  if (skip & BITSET_BIT(j))
-                     continue;
-
-                  unsigned int n = i * BITSET_WORDBITS + j;
-                  assert(n < g->count);
-                  if (g->nodes[n].tmp.q_total < g->tmp.min_q_total[i]) {
-                     g->tmp.min_q_total[i] = g->nodes[n].tmp.q_total;
-                     g->tmp.min_q_node[i] = n;
-                  }
-               }
-            }
-            if (g->tmp.min_q_total[i] < min_q_total) {
-               min_q_node = g->tmp.min_q_node[i];
-               min_q_total = g->tmp.min_q_total[i];
+               pq = g->tmp.pq_test[i] & ~skip;
+               progress = true;
             }
          }
+
+         /* Nodes above the ones we pushed may have become trivially
+          * colorable, they are left for the next pass.
+          */
+         if (!(g->tmp.pq_test[i] &
+               ~(g->tmp.in_stack[i] | g->tmp.reg_assigned[i])))
+            BITSET_CLEAR(g->tmp.pq_words, i);
+      }
+
+      if (progress)
+         continue;
+
+      /* Nothing is trivially colorable, look for the node with the lowest
+       * q_total.  Only the groups of words where nodes were pushed since the
+       * last time need to be looked at again.
+       */
+      unsigned int min_q_total = UINT_MAX;
+      unsigned int min_q_node = UINT_MAX;
+
+      for (int k = num_groups - 1; k >= 0; k--) {
+         if (BITSET_TEST(g->tmp.group_dirty, k))
+            ra_update_group_min(g, k);
+
+         if (g->tmp.group_min_q_total[k] < min_q_total) {
+            min_q_node = g->tmp.group_min_q_node[k];
+            min_q_total = g->tmp.group_min_q_total[k];
+         }
       }
 
-      if (!progress && min_q_total != UINT_MAX) {
+      if (min_q_total != UINT_MAX) {
          if (stack_optimistic_start == UINT_MAX)
             stack_optimistic_start = g->tmp.stack_count;
 
@@ -802,21 +949,6 @@ ra_simplify(struct ra_graph *g)
    g->tmp.stack_optimistic_start = stack_optimistic_start;
 }
 
-static bool
-ra_any_neighbors_conflict(struct ra_graph *g, unsigned int n, unsigned int r)
-{
-   util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
-      unsigned int n2 = *n2p;
-
-      if (!BITSET_TEST(g->tmp.in_stack, n2) &&
-          BITSET_TEST(g->regs->regs[r].conflicts, g->nodes[n2].reg)) {
-         return true;
-      }
-   }
-
-   return false;
-}
-
 /* Computes a bitfield of what regs are available for a given register
  * selection.
  *
@@ -827,9 +959,10 @@ static bool
 ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
 {
    struct ra_class *c = g->regs->classes[g->nodes[n].class];
+   const unsigned int num_words = BITSET_WORDS(g->regs->count);
 
    /* Populate with the set of regs that are in the node's class. */
-   memcpy(regs, c->regs, BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   memcpy(regs, c->regs, num_words * sizeof(BITSET_WORD));
 
    /* Remove any regs that conflict with nodes that we're adjacent to and have
     * already colored.
@@ -839,12 +972,13 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
       unsigned int r = g->nodes[n2].reg;
 
       if (!BITSET_TEST(g->tmp.in_stack, n2)) {
-         for (int j = 0; j < BITSET_WORDS(g->regs->count); j++)
-            regs[j] &= ~g->regs->regs[r].conflicts[j];
+         const BITSET_WORD *conflicts = g->regs->regs[r].conflicts;
+         for (unsigned int j = 0; j < num_words; j++)
+            regs[j] &= ~conflicts[j];
       }
    }
 
-   for (int i = 0; i < BITSET_WORDS(g->regs->count); i++) {
+   for (unsigned int i = 0; i < num_words; i++) {
       if (regs[i])
          return true;
    }
@@ -852,6 +986,34 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
    return false;
 }
 
+/**
+ * Returns the first register set in regs, starting from start and wrapping
+ * around, or NO_REG if there is none.
+ */
+static unsigned int
+ra_find_available_reg(const BITSET_WORD *regs, unsigned int count,
+                      unsigned int start)
+{
+   const unsigned int num_words = BITSET_WORDS(count);
+   const unsigned int start_word = start / BITSET_WORDBITS;
+
+   for (unsigned int i = start_word; i < num_words; i++) {
+      BITSET_WORD w = regs[i];
+      if (i == start_word)
+         w &= ~(BITSET_WORD)0 << (start % BITSET_WORDBITS);
+      if (w)
+         return i * BITSET_WORDBITS + ffs(w) - 1;
+   }
+
+   /* The bits of start_word above start were checked already. */
+   for (unsigned int i = 0; i <= start_word && i < num_words; i++) {
+      if (regs[i])
+         return i * BITSET_WORDBITS + ffs(regs[i]) - 1;
+   }
+
+   return NO_REG;
+}
+
 /**
  * Pops nodes from the stack back into the graph, coloring them with
  * registers as they go.
@@ -863,45 +1025,35 @@ static bool
 ra_select(struct ra_graph *g)
 {
    int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
-
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   BITSET_WORD *select_regs =
+      malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
 
    while (g->tmp.stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->tmp.stack[g->tmp.stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       BITSET_CLEAR(g->tmp.in_stack, n);
 
-      if (g->select_reg_callback) {
-         if (!ra_compute_available_regs(g, n, select_regs)) {
-            free(select_regs);
-            return false;
-         }
+      /* Gather the regs of the node's class which are not used by a member
+       * of the graph adjacent to us, a word at a time.  This is much cheaper
+       * than walking the neighbors again for each reg we try.
+       */
+      if (!ra_compute_available_regs(g, n, select_regs)) {
+         free(select_regs);
+         return false;
+      }
 
+      if (g->select_reg_callback) {
          r = g->select_reg_callback(n, select_regs, g->select_reg_callback_data);
          assert(r < g->regs->count);
       } else {
-         /* Find the lowest-numbered reg which is not used by a member
-          * of the graph adjacent to us.
-          */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            if (!ra_any_neighbors_conflict(g, n, r))
-               break;
-         }
-
-         if (ri >= g->regs->count)
-            return false;
+         /* Find the lowest-numbered available reg. */
+         r = ra_find_available_reg(select_regs, g->regs->count,
+                                   start_search_reg);
+         assert(r != NO_REG);
       }
 
       g->nodes[n].reg = r;
@@ -926,13 +1078,133 @@ ra_select(struct ra_graph *g)
    return true;
 }
 
+/**
+ * Writes the register set and the graph to a new file in dir, so that the
+ * allocation can be replayed by the register allocator benchmark.
+ */
+static void
+ra_dump_graph(struct ra_graph *g, const char *dir)
+{
+   static uint32_t dump_count = 0;
+   struct blob blob;
+
+#if DETECT_OS_UNIX
+   int pid = getpid();
+#else
+   int pid = 0;
+#endif
+
+   blob_init(&blob);
+   ra_set_serialize(g->regs, &blob);
+   ra_graph_serialize(g, &blob);
+
+   char *name = ralloc_asprintf(NULL, "%s/ra-%d-%u.graph", dir, pid,
+                                p_atomic_inc_return(&dump_count));
+   FILE *f = fopen(name, "wb");
+   if (f) {
+      if (!blob.out_of_memory)
+         fwrite(blob.data, 1, blob.size, f);
+      fclose(f);
+   }
+
+   ralloc_free(name);
+   blob_finish(&blob);
+}
+
 bool
 ra_allocate(struct ra_graph *g)
 {
+   const char *dump_dir = os_get_option("RA_DUMP_DIR");
+   if (unlikely(dump_dir))
+      ra_dump_graph(g, dump_dir);
+
    ra_simplify(g);
    return ra_select(g);
 }
 
+/**
+ * Serializes the nodes of the graph, their classes, forced registers,
+ * spill costs and interferences.  The register set and the select register
+ * callback are not part of it.
+ */
+void
+ra_graph_serialize(const struct ra_graph *g, struct blob *blob)
+{
+   blob_write_uint32(blob, g->count);
+
+   for (unsigned int n = 0; n < g->count; n++) {
+      const struct ra_node *node = &g->nodes[n];
+
+      blob_write_uint32(blob, node->class);
+      blob_write_uint32(blob, node->forced_reg);
+      blob_write_uint32(blob, fui(node->spill_cost));
+
+      /* Each interference is only written once, by its lowest node. */
+      unsigned int num_edges = 0;
+      util_dynarray_foreach(&node->adjacency_list, unsigned int, n2p) {
+         if (*n2p > n)
+            num_edges++;
+      }
+
+      blob_write_uint32(blob, num_edges);
+      util_dynarray_foreach(&node->adjacency_list, unsigned int, n2p) {
+         if (*n2p > n)
+            blob_write_uint32(blob, *n2p);
+      }
+   }
+}
+
+struct ra_graph *
+ra_graph_deserialize(struct ra_regs *regs, struct blob_reader *blob)
+{
+   unsigned int count = blob_read_uint32(blob);
+   if (blob->overrun)
+      return NULL;
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+
+   /* Interferences can only be added once both nodes have their class, so
+    * they are kept aside until all the nodes are read.
+    */
+   struct util_dynarray edges;
+   util_dynarray_init(&edges, NULL);
+
+   bool valid = true;
+   for (unsigned int n = 0; n < count && valid; n++) {
+      unsigned int class = blob_read_uint32(blob);
+      valid = class < regs->class_count;
+      ra_set_node_class(g, n, valid ? class : 0);
+      ra_set_node_reg(g, n, blob_read_uint32(blob));
+      ra_set_node_spill_cost(g, n, uif(blob_read_uint32(blob)));
+
+      unsigned int num_edges = blob_read_uint32(blob);
+      for (unsigned int i = 0; i < num_edges && !blob->overrun; i++) {
+         unsigned int n2 = blob_read_uint32(blob);
+         if (n2 < count) {
+            util_dynarray_append(&edges, unsigned int, n);
+            util_dynarray_append(&edges, unsigned int, n2);
+         }
+      }
+
+      valid = valid && !blob->overrun;
+   }
+
+   if (!valid) {
+      util_dynarray_fini(&edges);
+      ralloc_free(g);
+      return NULL;
+   }
+
+   unsigned int *e = edges.data;
+   unsigned int num_ends = util_dynarray_num_elements(&edges, unsigned int);
+   for (unsigned int i = 0; i < num_ends; i += 2)
+      ra_add_node_interference(g, e[i], e[i + 1]);
+
+   util_dynarray_fini(&edges);
+
+   return g;
+}
+
 unsigned int
 ra_get_node_reg(struct ra_graph *g, unsigned int n)
 {
@@ -41,6 +41,7 @@
 #include "ralloc.h"
 #include "set.h"
 #include "fast_urem_by_const.h"
+#include "hash_group.h"
 
 /*
  * From Knuth -- a good choice for hash/rehash values is p, p-2 where
@@ -139,6 +140,7 @@ _mesa_set_create(void *mem_ctx,
    ht->table = rzalloc_array(ht, struct set_entry, ht->size);
    ht->entries = 0;
    ht->deleted_entries = 0;
+   ht->ctrl = NULL;
 
    if (ht->table == NULL) {
       ralloc_free(ht);
@@ -148,6 +150,66 @@ _mesa_set_create(void *mem_ctx,
    return ht;
 }
 
+/* Sizes the grouped set to HASH_GROUP_SIZE << size_index slots, allocating
+ * the entries and control bytes.  Grouped sets are kept at most 7/8 full.
+ */
+static bool
+set_alloc_grouped(struct set *ht, unsigned size_index)
+{
+   uint32_t size = HASH_GROUP_SIZE << size_index;
+   struct set_entry *table;
+   uint8_t *ctrl;
+
+   table = rzalloc_array(ht, struct set_entry, size);
+   if (table == NULL)
+      return false;
+
+   ctrl = ralloc_array(table, uint8_t, size);
+   if (ctrl == NULL) {
+      ralloc_free(table);
+      return false;
+   }
+   memset(ctrl, HASH_CTRL_EMPTY, size);
+
+   ht->table = table;
+   ht->ctrl = ctrl;
+   ht->size_index = size_index;
+   ht->size = size;
+   ht->max_entries = size - size / 8;
+   ht->rehash = 0;
+   ht->size_magic = 0;
+   ht->rehash_magic = 0;
+   return true;
+}
+
+/**
+ * Creates a set in grouped mode, see _mesa_hash_table_init_grouped().
+ */
+struct set *
+_mesa_set_create_grouped(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b))
+{
+   struct set *ht;
+
+   ht = ralloc(mem_ctx, struct set);
+   if (ht == NULL)
+      return NULL;
+
+   ht->key_hash_function = key_hash_function;
+   ht->key_equals_function = key_equals_function;
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+
+   if (!set_alloc_grouped(ht, 0)) {
+      ralloc_free(ht);
+      return NULL;
+   }
+
+   return ht;
+}
+
 struct set *
 _mesa_set_clone(struct set *set, void *dst_mem_ctx)
 {
@@ -167,6 +229,15 @@ _mesa_set_clone(struct set *set, void *dst_mem_ctx)
 
    memcpy(clone->table, set->table, clone->size * sizeof(struct set_entry));
 
+   if (set->ctrl) {
+      clone->ctrl = ralloc_array(clone->table, uint8_t, clone->size);
+      if (clone->ctrl == NULL) {
+         ralloc_free(clone);
+         return NULL;
+      }
+      memcpy(clone->ctrl, set->ctrl, clone->size);
+   }
+
    return clone;
 }
 
@@ -209,6 +280,11 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
       entry->key = deleted_key;
    }
 
+   if (set->ctrl) {
+      memset(set->table, 0, set->size * sizeof(struct set_entry));
+      memset(set->ctrl, HASH_CTRL_EMPTY, set->size);
+   }
+
    set->entries = set->deleted_entries = 0;
 }
 
@@ -217,11 +293,45 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
  *
  * Returns NULL if no entry is found.
  */
+static struct set_entry *
+set_search_grouped(const struct set *ht, uint32_t hash, const void *key)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+   uint8_t c = hash_group_ctrl(mixed);
+
+   for (uint32_t step = 1; step <= num_groups; step++) {
+      const uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, c);
+
+      while (mask) {
+         struct set_entry *entry =
+            ht->table + group * HASH_GROUP_SIZE + hash_group_mask_first(mask);
+
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key))
+            return entry;
+
+         mask = hash_group_mask_clear_first(mask);
+      }
+
+      if (hash_group_has_empty(ctrl))
+         return NULL;
+
+      group = hash_group_next(group, step, num_groups);
+   }
+
+   return NULL;
+}
+
 static struct set_entry *
 set_search(const struct set *ht, uint32_t hash, const void *key)
 {
    assert(!key_pointer_is_reserved(key));
 
+   if (ht->ctrl)
+      return set_search_grouped(ht, hash, key);
+
    uint32_t size = ht->size;
    uint32_t start_address = util_fast_urem32(hash, size, ht->size_magic);
    uint32_t double_hash = util_fast_urem32(hash, ht->rehash,
@@ -284,12 +394,68 @@ set_add_rehash(struct set *ht, uint32_t hash, const void *key)
    } while (true);
 }
 
+static void
+set_add_rehash_grouped(struct set *ht, uint32_t hash, const void *key)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+
+   for (uint32_t step = 1; ; step++) {
+      uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, HASH_CTRL_EMPTY);
+
+      if (likely(mask)) {
+         unsigned slot = hash_group_mask_first(mask);
+         struct set_entry *entry = ht->table + group * HASH_GROUP_SIZE + slot;
+
+         ctrl[slot] = hash_group_ctrl(mixed);
+         entry->hash = hash;
+         entry->key = key;
+         return;
+      }
+
+      group = hash_group_next(group, step, num_groups);
+   }
+}
+
+static void
+set_rehash_grouped(struct set *ht, unsigned new_size_index)
+{
+   struct set old_ht;
+
+   /* Keep the group count within what hash_group_start() can address. */
+   if (new_size_index >= 28)
+      return;
+
+   old_ht = *ht;
+
+   if (!set_alloc_grouped(ht, new_size_index))
+      return;
+
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+
+   set_foreach(&old_ht, entry) {
+      set_add_rehash_grouped(ht, entry->hash, entry->key);
+   }
+
+   ht->entries = old_ht.entries;
+
+   ralloc_free(old_ht.table);
+}
+
 static void
 set_rehash(struct set *ht, unsigned new_size_index)
 {
    struct set old_ht;
    struct set_entry *table;
 
+   if (ht->ctrl) {
+      set_rehash_grouped(ht, new_size_index);
+      return;
+   }
+
    if (new_size_index >= ARRAY_SIZE(hash_sizes))
       return;
 
@@ -327,8 +493,14 @@ _mesa_set_resize(struct set *set, uint32_t entries)
       entries = set->entries;
 
    unsigned size_index = 0;
-   while (hash_sizes[size_index].max_entries < entries)
-      size_index++;
+   if (set->ctrl) {
+      while ((HASH_GROUP_SIZE << size_index) -
+             (HASH_GROUP_SIZE << size_index) / 8 < entries)
+         size_index++;
+   } else {
+      while (hash_sizes[size_index].max_entries < entries)
+         size_index++;
+   }
 
    set_rehash(set, size_index);
 }
@@ -340,6 +512,66 @@ _mesa_set_resize(struct set *set, uint32_t entries)
  * Note that insertion may rearrange the table on a resize or rehash,
  * so previously found hash_entries are no longer valid after this function.
  */
+static struct set_entry *
+set_search_or_add_grouped(struct set *ht, uint32_t hash, const void *key,
+                          bool *found)
+{
+   uint32_t mixed = hash_group_mix(hash);
+   uint32_t num_groups = ht->size / HASH_GROUP_SIZE;
+   uint32_t group = hash_group_start(mixed, num_groups);
+   uint8_t c = hash_group_ctrl(mixed);
+   uint8_t *available_ctrl = NULL;
+   struct set_entry *available_entry = NULL;
+
+   for (uint32_t step = 1; step <= num_groups; step++) {
+      uint8_t *ctrl = ht->ctrl + group * HASH_GROUP_SIZE;
+      struct set_entry *entries = ht->table + group * HASH_GROUP_SIZE;
+      hash_group_mask mask = hash_group_match(ctrl, c);
+
+      while (mask) {
+         struct set_entry *entry = entries + hash_group_mask_first(mask);
+
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key)) {
+            if (found)
+               *found = true;
+            return entry;
+         }
+
+         mask = hash_group_mask_clear_first(mask);
+      }
+
+      /* Stash the first available slot we find */
+      if (available_entry == NULL) {
+         hash_group_mask avail = hash_group_match_available(ctrl);
+         if (avail) {
+            unsigned slot = hash_group_mask_first(avail);
+            available_ctrl = ctrl + slot;
+            available_entry = entries + slot;
+         }
+      }
+
+      if (hash_group_has_empty(ctrl))
+         break;
+
+      group = hash_group_next(group, step, num_groups);
+   }
+
+   if (available_entry) {
+      /* There is no matching entry, create it. */
+      if (*available_ctrl == HASH_CTRL_DELETED)
+         ht->deleted_entries--;
+      *available_ctrl = c;
+      available_entry->hash = hash;
+      available_entry->key = key;
+      ht->entries++;
+      if (found)
+         *found = false;
+      return available_entry;
+   }
+
+   return NULL;
+}
+
 static struct set_entry *
 set_search_or_add(struct set *ht, uint32_t hash, const void *key, bool *found)
 {
@@ -353,6 +585,9 @@ set_search_or_add(struct set *ht, uint32_t hash, const void *key, bool *found)
       set_rehash(ht, ht->size_index);
    }
 
+   if (ht->ctrl)
+      return set_search_or_add_grouped(ht, hash, key, found);
+
    uint32_t size = ht->size;
    uint32_t start_address = util_fast_urem32(hash, size, ht->size_magic);
    uint32_t double_hash = util_fast_urem32(hash, ht->rehash,
@@ -497,6 +732,24 @@ _mesa_set_remove(struct set *ht, struct set_entry *entry)
    if (!entry)
       return;
 
+   if (ht->ctrl) {
+      uint32_t index = entry - ht->table;
+      uint8_t *group = ht->ctrl + (index & ~(HASH_GROUP_SIZE - 1));
+
+      /* No probe sequence ever went past a group that still has an empty
+       * slot, so the slot can go back to empty instead of leaving a
+       * tombstone.
+       */
+      if (hash_group_has_empty(group)) {
+         ht->ctrl[index] = HASH_CTRL_EMPTY;
+         entry->key = NULL;
+         ht->entries--;
+         return;
+      }
+
+      ht->ctrl[index] = HASH_CTRL_DELETED;
+   }
+
    entry->key = deleted_key;
    ht->entries--;
    ht->deleted_entries++;
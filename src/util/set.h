@@ -53,6 +53,8 @@ struct set {
    uint32_t size_index;
    uint32_t entries;
    uint32_t deleted_entries;
+   /* Control bytes of the groups, NULL unless created in grouped mode. */
+   uint8_t *ctrl;
 };
 
 struct set *
@@ -61,6 +63,11 @@ _mesa_set_create(void *mem_ctx,
                  bool (*key_equals_function)(const void *a,
                                              const void *b));
 struct set *
+_mesa_set_create_grouped(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b));
+struct set *
 _mesa_set_clone(struct set *set, void *dst_mem_ctx);
 
 void
@@ -84,15 +84,79 @@ slab_get_element(struct slab_parent_pool *parent,
  * when no elements are left in it.
  */
 static void
-slab_free_orphaned(struct slab_element_header *elt)
+slab_free_orphaned(struct slab_parent_pool *parent,
+                   struct slab_element_header *elt)
 {
    struct slab_page_header *page;
 
    assert(elt->owner & 1);
 
    page = (struct slab_page_header *)(elt->owner & ~(intptr_t)1);
-   if (!p_atomic_dec_return(&page->u.num_remaining))
+   if (!p_atomic_dec_return(&page->u.num_remaining)) {
       free(page);
+      p_atomic_dec(&parent->stats.num_pages);
+   }
+}
+
+static void
+slab_free_orphaned_list(struct slab_parent_pool *parent,
+                        struct slab_element_header *list)
+{
+   while (list) {
+      struct slab_element_header *elt = list;
+      list = elt->next;
+      slab_free_orphaned(parent, elt);
+   }
+}
+
+/* Hand the elements of the magazine back to their owners. Must be called
+ * with the parent mutex held. Elements of orphaned pages are returned, to be
+ * freed by the caller once the mutex is released.
+ */
+static struct slab_element_header *
+slab_return_magazine_locked(struct slab_child_pool *pool)
+{
+   struct slab_parent_pool *parent = pool->parent;
+   struct slab_element_header *orphans = NULL;
+
+   if (!pool->num_magazine)
+      return NULL;
+
+   while (pool->magazine) {
+      struct slab_element_header *elt = pool->magazine;
+      pool->magazine = elt->next;
+
+      /* Note: we _must_ read elt->owner here because the owning child pool
+       * may have been destroyed by another thread since the element was
+       * put in the magazine.
+       */
+      intptr_t owner_int = p_atomic_read(&elt->owner);
+
+      if (!(owner_int & 1)) {
+         struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
+         elt->next = owner->migrated;
+         owner->migrated = elt;
+      } else {
+         elt->next = orphans;
+         orphans = elt;
+      }
+   }
+
+   parent->stats.num_migrations += pool->num_magazine;
+   parent->stats.num_magazine_flushes++;
+   pool->num_magazine = 0;
+
+   return orphans;
+}
+
+/* Fold the allocation count of the child into the parent statistics. Must be
+ * called with the parent mutex held.
+ */
+static void
+slab_sync_stats_locked(struct slab_child_pool *pool)
+{
+   pool->parent->stats.num_live += pool->live_delta;
+   pool->live_delta = 0;
 }
 
 /**
@@ -110,6 +174,7 @@ slab_create_parent(struct slab_parent_pool *parent,
    parent->element_size = ALIGN_POT(sizeof(struct slab_element_header) + item_size,
                                     sizeof(intptr_t));
    parent->num_elements = num_items;
+   memset(&parent->stats, 0, sizeof(parent->stats));
 }
 
 void
@@ -128,6 +193,9 @@ void slab_create_child(struct slab_child_pool *pool,
    pool->pages = NULL;
    pool->free = NULL;
    pool->migrated = NULL;
+   pool->magazine = NULL;
+   pool->num_magazine = 0;
+   pool->live_delta = 0;
 }
 
 /**
@@ -138,11 +206,16 @@ void slab_create_child(struct slab_child_pool *pool,
  */
 void slab_destroy_child(struct slab_child_pool *pool)
 {
+   struct slab_element_header *orphans;
+
    if (!pool->parent)
       return; /* the slab probably wasn't even created */
 
    mtx_lock(&pool->parent->mutex);
 
+   orphans = slab_return_magazine_locked(pool);
+   slab_sync_stats_locked(pool);
+
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
       pool->pages = page->u.next;
@@ -154,19 +227,14 @@ void slab_destroy_child(struct slab_child_pool *pool)
       }
    }
 
-   while (pool->migrated) {
-      struct slab_element_header *elt = pool->migrated;
-      pool->migrated = elt->next;
-      slab_free_orphaned(elt);
-   }
+   slab_free_orphaned_list(pool->parent, pool->migrated);
+   pool->migrated = NULL;
 
    mtx_unlock(&pool->parent->mutex);
 
-   while (pool->free) {
-      struct slab_element_header *elt = pool->free;
-      pool->free = elt->next;
-      slab_free_orphaned(elt);
-   }
+   slab_free_orphaned_list(pool->parent, pool->free);
+   pool->free = NULL;
+   slab_free_orphaned_list(pool->parent, orphans);
 
    /* Guard against use-after-free. */
    pool->parent = NULL;
@@ -193,6 +261,7 @@ slab_add_new_page(struct slab_child_pool *pool)
 
    page->u.next = pool->pages;
    pool->pages = page;
+   p_atomic_inc(&pool->parent->stats.num_pages);
 
    return true;
 }
@@ -208,14 +277,21 @@ slab_alloc(struct slab_child_pool *pool)
    struct slab_element_header *elt;
 
    if (!pool->free) {
+      struct slab_element_header *orphans;
+
       /* First, collect elements that belong to us but were freed from a
-       * different child pool.
+       * different child pool. Return the elements of other pools we are
+       * holding while we have the lock.
        */
       mtx_lock(&pool->parent->mutex);
       pool->free = pool->migrated;
       pool->migrated = NULL;
+      orphans = slab_return_magazine_locked(pool);
+      slab_sync_stats_locked(pool);
       mtx_unlock(&pool->parent->mutex);
 
+      slab_free_orphaned_list(pool->parent, orphans);
+
       /* Now allocate a new page. */
       if (!pool->free && !slab_add_new_page(pool))
          return NULL;
@@ -227,6 +303,8 @@ slab_alloc(struct slab_child_pool *pool)
    CHECK_MAGIC(elt, SLAB_MAGIC_FREE);
    SET_MAGIC(elt, SLAB_MAGIC_ALLOCATED);
 
+   pool->live_delta++;
+
    return &elt[1];
 }
 
@@ -242,11 +320,12 @@ slab_alloc(struct slab_child_pool *pool)
 void slab_free(struct slab_child_pool *pool, void *ptr)
 {
    struct slab_element_header *elt = ((struct slab_element_header*)ptr - 1);
-   intptr_t owner_int;
 
    CHECK_MAGIC(elt, SLAB_MAGIC_ALLOCATED);
    SET_MAGIC(elt, SLAB_MAGIC_FREE);
 
+   pool->live_delta--;
+
    if (p_atomic_read(&elt->owner) == (intptr_t)pool) {
       /* This is the simple case: The caller guarantees that we can safely
        * access the free list.
@@ -256,24 +335,54 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
+   /* The slow case: migration or an orphaned page. Keep the element in our
+    * magazine, which is private to the caller's thread, and only take the
+    * parent mutex to return a full batch.
+    */
+   elt->next = pool->magazine;
+   pool->magazine = elt;
+   if (++pool->num_magazine >= SLAB_MAGAZINE_SIZE)
+      slab_flush_magazine(pool);
+}
+
+/**
+ * Return the objects of other child pools that were freed in this one to
+ * their owners. Single-threaded, like slab_free.
+ *
+ * This happens automatically when the magazine is full, when the pool runs
+ * out of free objects and when it is destroyed, but can be called at idle
+ * points so that the owners can reuse the objects sooner.
+ */
+void
+slab_flush_magazine(struct slab_child_pool *pool)
+{
+   struct slab_element_header *orphans;
+
    mtx_lock(&pool->parent->mutex);
+   orphans = slab_return_magazine_locked(pool);
+   slab_sync_stats_locked(pool);
+   mtx_unlock(&pool->parent->mutex);
 
-   /* Note: we _must_ re-read elt->owner here because the owning child pool
-    * may have been destroyed by another thread in the meantime.
-    */
-   owner_int = p_atomic_read(&elt->owner);
+   slab_free_orphaned_list(pool->parent, orphans);
+}
 
-   if (!(owner_int & 1)) {
-      struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
-      elt->next = owner->migrated;
-      owner->migrated = elt;
-      mtx_unlock(&pool->parent->mutex);
-   } else {
-      mtx_unlock(&pool->parent->mutex);
+/**
+ * Return statistics about the memory use of the parent pool and its
+ * children, e.g. to measure fragmentation as the ratio of live objects to
+ * page capacity.
+ *
+ * Child pools report their allocations and frees when they take the parent
+ * mutex, so num_live doesn't account for the recent activity of the
+ * children.
+ */
+void
+slab_get_stats(struct slab_parent_pool *parent, struct slab_stats *stats)
+{
+   mtx_lock(&parent->mutex);
+   *stats = parent->stats;
+   mtx_unlock(&parent->mutex);
 
-      slab_free_orphaned(elt);
-   }
+   stats->num_pages = p_atomic_read(&parent->stats.num_pages);
 }
 
 /**
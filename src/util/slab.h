@@ -32,8 +32,10 @@
  *
  * Allocations obtained from one child pool should usually be freed in the
  * same child pool. Freeing an allocation in a different child pool associated
- * to the same parent is allowed (and requires no locking by the caller), but
- * it is discouraged because it implies a performance penalty.
+ * to the same parent is allowed (and requires no locking by the caller). Such
+ * frees are gathered in a per-child magazine and handed back to their owners
+ * in batches, so the parent mutex is only taken once per SLAB_MAGAZINE_SIZE
+ * of them.
  *
  * For convenience and to ease the transition, there is also a set of wrapper
  * functions around a single parent-child pair.
@@ -42,15 +44,38 @@
 #ifndef SLAB_H
 #define SLAB_H
 
+#include <stdint.h>
 #include "c11/threads.h"
 
+#define SLAB_MAGAZINE_SIZE 32
+
 struct slab_element_header;
 struct slab_page_header;
 
+struct slab_stats {
+   /* Pages currently allocated, including orphaned ones. */
+   unsigned num_pages;
+
+   /* Objects allocated and not freed yet. */
+   int64_t num_live;
+
+   /* Objects freed in a different child pool than their own. */
+   uint64_t num_migrations;
+
+   /* Number of batches the migrated objects were returned in. */
+   uint64_t num_magazine_flushes;
+};
+
 struct slab_parent_pool {
    mtx_t mutex;
    unsigned element_size;
    unsigned num_elements;
+
+   /* Protected by the mutex, except num_pages which is atomic. Children
+    * only fold in their allocation counts when they take the mutex, so
+    * num_live lags behind a little.
+    */
+   struct slab_stats stats;
 };
 
 struct slab_child_pool {
@@ -67,6 +92,17 @@ struct slab_child_pool {
     * This list is protected by the parent mutex.
     */
    struct slab_element_header *migrated;
+
+   /* Elements owned by other pools that were freed with this pool as the
+    * argument to slab_free, waiting to be returned to their owners.
+    */
+   struct slab_element_header *magazine;
+   unsigned num_magazine;
+
+   /* Allocations minus frees done through this pool since it last took
+    * the parent mutex.
+    */
+   int live_delta;
 };
 
 void slab_create_parent(struct slab_parent_pool *parent,
@@ -78,6 +114,8 @@ void slab_create_child(struct slab_child_pool *pool,
 void slab_destroy_child(struct slab_child_pool *pool);
 void *slab_alloc(struct slab_child_pool *pool);
 void slab_free(struct slab_child_pool *pool, void *ptr);
+void slab_flush_magazine(struct slab_child_pool *pool);
+void slab_get_stats(struct slab_parent_pool *parent, struct slab_stats *stats);
 
 struct slab_mempool {
    struct slab_parent_pool parent;
@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Reports how well the shader cache compresses a set of entries.
+ *
+ * Each file given on the command line is stored as an entry of a new cache
+ * in a temporary directory, and read back. The compression ratio and the
+ * time spent compressing and decompressing are then printed. The cache is
+ * set up from the usual environment variables, so that for example
+ * MESA_GLSL_CACHE_COMPRESSION_LEVEL and MESA_GLSL_CACHE_DICT can be
+ * compared on the same entries.
+ *
+ * With MESA_GLSL_CACHE_DICT set, the files are stored twice, the first time
+ * to train the dictionary, and only the second time is reported.
+ */
+
+#include <ftw.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "disk_cache.h"
+
+struct entry {
+   void *data;
+   size_t size;
+   cache_key key;
+};
+
+static void *
+read_file(const char *filename, size_t *size)
+{
+   FILE *f = fopen(filename, "rb");
+   if (f == NULL)
+      return NULL;
+
+   fseek(f, 0, SEEK_END);
+   long len = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   void *data = len > 0 ? malloc(len) : NULL;
+   if (data && fread(data, 1, len, f) != len) {
+      free(data);
+      data = NULL;
+   }
+   fclose(f);
+
+   *size = len;
+   return data;
+}
+
+static int
+remove_entry(const char *path, const struct stat *sb, int typeflag,
+             struct FTW *ftwbuf)
+{
+   return remove(path);
+}
+
+static void
+put_entries(struct disk_cache *cache, struct entry *entries,
+            unsigned num_entries)
+{
+   for (unsigned i = 0; i < num_entries; i++) {
+      disk_cache_put(cache, entries[i].key, entries[i].data, entries[i].size,
+                     NULL);
+   }
+   disk_cache_wait_for_idle(cache);
+}
+
+static double
+ms(uint64_t ns)
+{
+   return ns / 1000000.0;
+}
+
+static double
+mb_per_s(uint64_t size, uint64_t ns)
+{
+   return ns ? size * 1000.0 / ns : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct disk_cache_stats before, after;
+   char dir[] = "/tmp/disk_cache_stats.XXXXXX";
+
+   if (argc < 2) {
+      fprintf(stderr, "Usage: %s FILE...\n", argv[0]);
+      return 1;
+   }
+
+   unsigned num_entries = argc - 1;
+   struct entry *entries = calloc(num_entries, sizeof(*entries));
+   if (entries == NULL)
+      return 1;
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      entries[i].data = read_file(argv[i + 1], &entries[i].size);
+      if (entries[i].data == NULL) {
+         fprintf(stderr, "Couldn't read %s\n", argv[i + 1]);
+         return 1;
+      }
+   }
+
+   if (mkdtemp(dir) == NULL) {
+      perror("mkdtemp");
+      return 1;
+   }
+
+   setenv("MESA_GLSL_CACHE_DIR", dir, 1);
+   /* Read the entries back from the disk, not from memory. */
+   setenv("MESA_GLSL_CACHE_MEM_SIZE", "0", 1);
+   unsetenv("MESA_GLSL_CACHE_DISABLE");
+
+   struct disk_cache *cache =
+      disk_cache_create("disk_cache_stats", "disk_cache_stats", 0);
+   if (cache == NULL) {
+      fprintf(stderr, "Couldn't create a cache in %s\n", dir);
+      return 1;
+   }
+
+   bool dict = env_var_as_boolean("MESA_GLSL_CACHE_DICT", false);
+   if (dict) {
+      /* Use other keys for training, so that the entries are stored again
+       * afterwards.
+       */
+      for (unsigned i = 0; i < num_entries; i++) {
+         disk_cache_compute_key(cache, entries[i].data, entries[i].size,
+                                entries[i].key);
+         entries[i].key[0] ^= 1;
+      }
+      put_entries(cache, entries, num_entries);
+   }
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      disk_cache_compute_key(cache, entries[i].data, entries[i].size,
+                             entries[i].key);
+   }
+
+   disk_cache_get_stats(cache, &before);
+
+   put_entries(cache, entries, num_entries);
+
+   unsigned missing = 0;
+   for (unsigned i = 0; i < num_entries; i++) {
+      size_t size;
+      void *data = disk_cache_get(cache, entries[i].key, &size);
+      if (data == NULL || size != entries[i].size ||
+          memcmp(data, entries[i].data, size) != 0)
+         missing++;
+      free(data);
+   }
+
+   disk_cache_get_stats(cache, &after);
+   disk_cache_destroy(cache);
+
+   nftw(dir, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+
+   uint64_t compressed_entries =
+      after.compressed_entries - before.compressed_entries;
+   uint64_t dict_entries = after.dict_entries - before.dict_entries;
+   uint64_t uncompressed_size =
+      after.uncompressed_size - before.uncompressed_size;
+   uint64_t compressed_size = after.compressed_size - before.compressed_size;
+   uint64_t compress_ns = after.compress_ns - before.compress_ns;
+   uint64_t decompressed_entries =
+      after.decompressed_entries - before.decompressed_entries;
+   uint64_t decompress_ns = after.decompress_ns - before.decompress_ns;
+
+   printf("entries:        %" PRIu64 " compressed, %" PRIu64
+          " with the dictionary, %u not read back\n",
+          compressed_entries, dict_entries, missing);
+   printf("size:           %" PRIu64 " -> %" PRIu64 " bytes, ratio %.3f\n",
+          uncompressed_size, compressed_size,
+          compressed_size ? (double) uncompressed_size / compressed_size : 0);
+   printf("compression:    %.3f ms, %.3f ms per entry, %.1f MB/s\n",
+          ms(compress_ns),
+          compressed_entries ? ms(compress_ns) / compressed_entries : 0,
+          mb_per_s(uncompressed_size, compress_ns));
+   printf("decompression:  %.3f ms, %.3f ms per entry, %.1f MB/s\n",
+          ms(decompress_ns),
+          decompressed_entries ? ms(decompress_ns) / decompressed_entries : 0,
+          mb_per_s(uncompressed_size, decompress_ns));
+
+   for (unsigned i = 0; i < num_entries; i++)
+      free(entries[i].data);
+   free(entries);
+
+   return missing ? 1 : 0;
+}
@@ -29,8 +29,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <float.h>
+#include <string.h>
+#include <math.h>
 
 #include "util/u_half.h"
+#include "util/u_memory.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_tests.h"
 #include "util/format/u_format_s3tc.h"
@@ -809,11 +812,151 @@ test_all(void)
 }
 
 
+/*
+ * The vectorized functions util_format_description() may pick must give
+ * exactly the same results as the generated ones, including for the pixels
+ * at the end of rows that don't fill a whole vector.
+ */
+
+#define SIMD_TEST_WIDTH  67
+#define SIMD_TEST_HEIGHT 5
+
+static uint32_t
+simd_test_random(uint32_t *state)
+{
+   *state = *state * 1103515245 + 12345;
+   return *state >> 8;
+}
+
+
+static float
+simd_test_float(uint32_t *state)
+{
+   static const float special[] = {
+      0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, 65504.0f, 65520.0f, 1e-6f, 1e-8f,
+      FLT_MIN, FLT_MIN / 4, FLT_MAX, -FLT_MAX, INFINITY, -INFINITY, NAN,
+      1.0f / 255.0f, 0.5f / 255.0f, 1.0f - FLT_EPSILON, 1.0f + FLT_EPSILON,
+   };
+   uint32_t r = simd_test_random(state);
+
+   if (r % 4 == 0)
+      return special[(r >> 2) % ARRAY_SIZE(special)];
+
+   /* Mostly in the representable range, with some outside of it. */
+   return (float)(r & 0xffff) / 0xc000 - 0.16f;
+}
+
+
+static boolean
+test_simd_format(const struct util_format_description *generic,
+                 const struct util_format_description *desc)
+{
+   const unsigned width = SIMD_TEST_WIDTH;
+   const unsigned height = SIMD_TEST_HEIGHT;
+   /* Extra bytes at the end of the rows must be left untouched. */
+   const unsigned packed_stride = width * UTIL_FORMAT_MAX_PACKED_BYTES + 4;
+   const unsigned unorm8_stride = width * 4 + 4;
+   const unsigned float_stride = (width * 4 + 2) * sizeof(float);
+   const unsigned packed_size = packed_stride * height;
+   const unsigned unorm8_size = unorm8_stride * height;
+   const unsigned float_size = float_stride * height;
+   uint8_t *packed_src = MALLOC(packed_size);
+   uint8_t *unorm8_src = MALLOC(unorm8_size);
+   float *float_src = MALLOC(float_size);
+   uint8_t *dst[2] = { MALLOC(MAX2(packed_size, float_size)),
+                       MALLOC(MAX2(packed_size, float_size)) };
+   const unsigned dst_size = MAX2(packed_size, float_size);
+   uint32_t state = generic->format;
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < packed_size; i++)
+      packed_src[i] = simd_test_random(&state);
+   for (i = 0; i < unorm8_size; i++)
+      unorm8_src[i] = simd_test_random(&state);
+   for (i = 0; i < float_size / sizeof(float); i++)
+      float_src[i] = simd_test_float(&state);
+
+#define TEST_SIMD_FUNC(func, dst_type, src, src_stride, dst_stride) \
+   if (desc->func != generic->func) { \
+      for (i = 0; i < dst_size; i++) \
+         dst[0][i] = dst[1][i] = simd_test_random(&state); \
+      generic->func((dst_type *)dst[0], dst_stride, src, src_stride, \
+                    width, height); \
+      desc->func((dst_type *)dst[1], dst_stride, src, src_stride, \
+                 width, height); \
+      if (memcmp(dst[0], dst[1], dst_size) != 0) { \
+         printf("FAILED: %s %s differs from the generic function\n", \
+                generic->short_name, #func); \
+         success = FALSE; \
+      } \
+   }
+
+   TEST_SIMD_FUNC(unpack_rgba_8unorm, uint8_t, packed_src, packed_stride, unorm8_stride);
+   TEST_SIMD_FUNC(pack_rgba_8unorm, uint8_t, unorm8_src, unorm8_stride, packed_stride);
+   TEST_SIMD_FUNC(unpack_rgba_float, float, packed_src, packed_stride, float_stride);
+   TEST_SIMD_FUNC(pack_rgba_float, uint8_t, float_src, float_stride, packed_stride);
+   TEST_SIMD_FUNC(unpack_z_float, float, packed_src, packed_stride, float_stride);
+
+   /* Depth values outside of [0, 1] have no defined packing. */
+   for (i = 0; i < float_size / sizeof(float); i++) {
+      if (isnan(float_src[i]))
+         float_src[i] = 0.0f;
+      float_src[i] = CLAMP(float_src[i], 0.0f, 1.0f);
+   }
+
+   TEST_SIMD_FUNC(pack_z_float, uint8_t, float_src, float_stride, packed_stride);
+
+#undef TEST_SIMD_FUNC
+
+   FREE(packed_src);
+   FREE(unorm8_src);
+   FREE(float_src);
+   FREE(dst[0]);
+   FREE(dst[1]);
+
+   return success;
+}
+
+
+static boolean
+test_simd(void)
+{
+   enum pipe_format format;
+   boolean success = TRUE;
+
+   for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *desc;
+
+      desc = util_format_description(format);
+      if (!desc || desc == util_format_description_generic(format))
+         continue;
+
+      printf("Testing util_format_%s vectorized functions ...\n",
+             desc->short_name);
+      fflush(stdout);
+
+      if (!test_simd_format(util_format_description_generic(format), desc))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
 int main(int argc, char **argv)
 {
    boolean success;
 
+   if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+      util_format_benchmark();
+      return 0;
+   }
+
    success = test_all();
 
+   if (!test_simd())
+      success = FALSE;
+
    return success ? 0 : 1;
 }
@@ -0,0 +1,278 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Compares the regular and the grouped hash table modes.
+ *
+ * Without arguments, a few synthetic workloads shaped like the hottest NIR
+ * users of hash tables are run at different table sizes:
+ *
+ *  - "cse": search-or-insert of instructions hashed by content, with most
+ *    entries dropped again at the end of each block, like nir_instr_set.
+ *  - "remap": insertion of every pointer of a shader, followed by several
+ *    hitting searches each, like the remap table of nir_clone.
+ *  - "miss": mostly failing pointer searches into a table built up front,
+ *    like the deref and variable lookups of the vars_to_ssa passes.
+ *
+ * A trace can be replayed instead by passing its file name.  Each line is
+ * an operation ('i' for insert, 's' for search, 'r' for remove) followed by
+ * an integer naming the key, e.g. "i 42".
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "os_time.h"
+
+#define REPEAT 20
+
+enum op {
+   OP_INSERT,
+   OP_SEARCH,
+   OP_REMOVE,
+};
+
+struct op_rec {
+   enum op op;
+   unsigned key;
+};
+
+struct workload {
+   const char *name;
+   uint32_t (*hash)(const void *key);
+   bool (*equals)(const void *a, const void *b);
+   struct op_rec *ops;
+   unsigned num_ops;
+   unsigned ops_capacity;
+   unsigned num_keys;
+};
+
+/* Stands in for an instruction hashed by its contents. */
+struct fake_instr {
+   uint32_t opcode;
+   uintptr_t srcs[3];
+};
+
+static uint32_t
+fake_instr_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct fake_instr));
+}
+
+static bool
+fake_instr_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct fake_instr)) == 0;
+}
+
+static void
+add_op(struct workload *w, enum op op, unsigned key)
+{
+   if (w->num_ops == w->ops_capacity) {
+      w->ops_capacity = MAX2(w->ops_capacity * 2, 1024);
+      w->ops = realloc(w->ops, w->ops_capacity * sizeof(*w->ops));
+   }
+   w->ops[w->num_ops].op = op;
+   w->ops[w->num_ops].key = key;
+   w->num_ops++;
+   if (key >= w->num_keys)
+      w->num_keys = key + 1;
+}
+
+static void
+gen_cse(struct workload *w, unsigned size)
+{
+   unsigned block_start = 0;
+
+   w->name = "cse";
+   w->hash = fake_instr_hash;
+   w->equals = fake_instr_equal;
+
+   for (unsigned i = 0; i < size * 4; i++) {
+      /* About a third of the instructions are redundant. */
+      unsigned key = rand() % 3 == 0 && i > 0 ? rand() % i : i;
+
+      add_op(w, OP_SEARCH, key);
+      add_op(w, OP_INSERT, key);
+
+      /* Leaving a block drops the instructions it defined. */
+      if (i - block_start == 32) {
+         for (unsigned j = block_start; j < i; j += 2)
+            add_op(w, OP_REMOVE, j);
+         block_start = i;
+      }
+   }
+}
+
+static void
+gen_remap(struct workload *w, unsigned size)
+{
+   w->name = "remap";
+   w->hash = _mesa_hash_pointer;
+   w->equals = _mesa_key_pointer_equal;
+
+   for (unsigned i = 0; i < size; i++)
+      add_op(w, OP_INSERT, i);
+   for (unsigned i = 0; i < size * 3; i++)
+      add_op(w, OP_SEARCH, rand() % size);
+}
+
+static void
+gen_miss(struct workload *w, unsigned size)
+{
+   w->name = "miss";
+   w->hash = _mesa_hash_pointer;
+   w->equals = _mesa_key_pointer_equal;
+
+   for (unsigned i = 0; i < size; i++)
+      add_op(w, OP_INSERT, i);
+   for (unsigned i = 0; i < size * 4; i++)
+      add_op(w, OP_SEARCH, rand() % 4 ? size + rand() % size : rand() % size);
+}
+
+static bool
+load_trace(struct workload *w, const char *filename)
+{
+   FILE *f = fopen(filename, "r");
+   char op;
+   unsigned key;
+
+   if (!f) {
+      fprintf(stderr, "failed to open %s\n", filename);
+      return false;
+   }
+
+   w->name = filename;
+   w->hash = _mesa_hash_pointer;
+   w->equals = _mesa_key_pointer_equal;
+
+   while (fscanf(f, " %c %u", &op, &key) == 2) {
+      switch (op) {
+      case 'i': add_op(w, OP_INSERT, key); break;
+      case 's': add_op(w, OP_SEARCH, key); break;
+      case 'r': add_op(w, OP_REMOVE, key); break;
+      default:
+         fprintf(stderr, "unknown operation '%c' in %s\n", op, filename);
+         fclose(f);
+         return false;
+      }
+   }
+
+   fclose(f);
+   return true;
+}
+
+static double
+run(const struct workload *w, const void **keys, bool grouped)
+{
+   int64_t start = os_time_get_nano();
+   unsigned found = 0;
+
+   for (unsigned r = 0; r < REPEAT; r++) {
+      struct hash_table *ht = grouped ?
+         _mesa_hash_table_create_grouped(NULL, w->hash, w->equals) :
+         _mesa_hash_table_create(NULL, w->hash, w->equals);
+
+      for (unsigned i = 0; i < w->num_ops; i++) {
+         const void *key = keys[w->ops[i].key];
+
+         switch (w->ops[i].op) {
+         case OP_INSERT:
+            _mesa_hash_table_insert(ht, key, NULL);
+            break;
+         case OP_SEARCH:
+            found += _mesa_hash_table_search(ht, key) != NULL;
+            break;
+         case OP_REMOVE:
+            _mesa_hash_table_remove_key(ht, key);
+            break;
+         }
+      }
+
+      _mesa_hash_table_destroy(ht, NULL);
+   }
+
+   /* Keep the searches from being optimized out. */
+   if (found == UINT32_MAX)
+      printf("\n");
+
+   return (double)(os_time_get_nano() - start) / (REPEAT * w->num_ops);
+}
+
+static void
+bench(struct workload *w)
+{
+   struct fake_instr *instrs = calloc(w->num_keys, sizeof(*instrs));
+   const void **keys = malloc(w->num_keys * sizeof(*keys));
+
+   for (unsigned i = 0; i < w->num_keys; i++) {
+      instrs[i].opcode = i % 61;
+      instrs[i].srcs[0] = i;
+      instrs[i].srcs[1] = i / 7;
+      keys[i] = &instrs[i];
+   }
+
+   double regular = run(w, keys, false);
+   double grouped = run(w, keys, true);
+
+   printf("%-8s %8u ops %8u keys: regular %7.2f ns/op, "
+          "grouped %7.2f ns/op (%.2fx)\n",
+          w->name, w->num_ops, w->num_keys, regular, grouped,
+          regular / grouped);
+
+   free(keys);
+   free(instrs);
+}
+
+int
+main(int argc, char **argv)
+{
+   static void (*const gens[])(struct workload *w, unsigned size) = {
+      gen_cse, gen_remap, gen_miss,
+   };
+   static const unsigned sizes[] = { 32, 512, 16384, 262144 };
+
+   if (argc > 1) {
+      for (int i = 1; i < argc; i++) {
+         struct workload w = { 0 };
+         if (!load_trace(&w, argv[i]))
+            return 1;
+         bench(&w);
+         free(w.ops);
+      }
+      return 0;
+   }
+
+   srand(0);
+   for (unsigned g = 0; g < ARRAY_SIZE(gens); g++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+         struct workload w = { 0 };
+         gens[g](&w, sizes[s]);
+         bench(&w);
+         free(w.ops);
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#undef NDEBUG
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "hash_table.h"
+
+/* Runs the same random sequence of inserts, removals and searches on a
+ * regular and a grouped table, and checks that they always agree.  The key
+ * space is small so that removals leave plenty of tombstones behind and
+ * the tables get rehashed in place as well as grown.
+ */
+
+#define NUM_KEYS 4096
+#define NUM_OPS 200000
+
+static uint32_t
+key_value(const void *key)
+{
+   return *(const uint32_t *)key;
+}
+
+static uint32_t
+key_hash(const void *key)
+{
+   /* Collide a lot on the low bits, like pointer hashes do. */
+   return key_value(key) << 4;
+}
+
+static bool
+uint32_t_key_equals(const void *a, const void *b)
+{
+   return key_value(a) == key_value(b);
+}
+
+static void
+check_same(struct hash_table *ref, struct hash_table *ht)
+{
+   unsigned count = 0;
+
+   assert(ref->entries == ht->entries);
+
+   hash_table_foreach(ht, entry) {
+      struct hash_entry *ref_entry = _mesa_hash_table_search(ref, entry->key);
+      assert(ref_entry);
+      assert(ref_entry->data == entry->data);
+      count++;
+   }
+   assert(count == ht->entries);
+}
+
+int
+main(int argc, char **argv)
+{
+   struct hash_table *ref, *ht, *clone;
+   uint32_t keys[NUM_KEYS];
+   uint32_t i;
+
+   (void) argc;
+   (void) argv;
+
+   ref = _mesa_hash_table_create(NULL, key_hash, uint32_t_key_equals);
+   ht = _mesa_hash_table_create_grouped(NULL, key_hash, uint32_t_key_equals);
+   assert(ht->ctrl);
+
+   for (i = 0; i < NUM_KEYS; i++)
+      keys[i] = i;
+
+   srand(0);
+   for (i = 0; i < NUM_OPS; i++) {
+      /* Grow the working set in phases, then shrink it again. */
+      uint32_t range = 16 + (i % 50000) * (NUM_KEYS - 16) / 50000;
+      uint32_t *key = &keys[rand() % range];
+      struct hash_entry *ref_entry = _mesa_hash_table_search(ref, key);
+      struct hash_entry *entry = _mesa_hash_table_search(ht, key);
+
+      assert((ref_entry == NULL) == (entry == NULL));
+      if (entry)
+         assert(entry->data == ref_entry->data);
+
+      switch (rand() % 3) {
+      case 0:
+      case 1:
+         _mesa_hash_table_insert(ref, key, (void *)(uintptr_t)i);
+         _mesa_hash_table_insert(ht, key, (void *)(uintptr_t)i);
+         break;
+      case 2:
+         _mesa_hash_table_remove(ref, ref_entry);
+         _mesa_hash_table_remove(ht, entry);
+         break;
+      }
+
+      if (i % 10000 == 0)
+         check_same(ref, ht);
+   }
+   check_same(ref, ht);
+
+   clone = _mesa_hash_table_clone(ht, NULL);
+   check_same(ref, clone);
+   _mesa_hash_table_insert(clone, &keys[0], NULL);
+   assert(_mesa_hash_table_search(clone, &keys[0]));
+
+   /* Removing everything while iterating must leave an empty table. */
+   hash_table_foreach(ht, entry)
+      _mesa_hash_table_remove(ht, entry);
+   assert(ht->entries == 0);
+   assert(_mesa_hash_table_next_entry(ht, NULL) == NULL);
+
+   _mesa_hash_table_clear(clone, NULL);
+   assert(clone->entries == 0);
+   for (i = 0; i < NUM_KEYS; i++)
+      assert(_mesa_hash_table_search(clone, &keys[i]) == NULL);
+
+   _mesa_hash_table_destroy(ref, NULL);
+   _mesa_hash_table_destroy(ht, NULL);
+   _mesa_hash_table_destroy(clone, NULL);
+
+   return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Times ra_allocate() on interference graphs.
+ *
+ * Without arguments, synthetic graphs are generated from random live
+ * ranges, for a register file of 128 registers with classes of 1, 2 and 4
+ * aligned registers, roughly like the ones of the Intel backends.
+ *
+ * Otherwise, each argument is a file written by ra_allocate() when the
+ * RA_DUMP_DIR environment variable is set, containing a serialized register
+ * set followed by a serialized graph, and these are replayed instead.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "blob.h"
+#include "os_time.h"
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define REPEAT 10
+#define BASE_REGS 128
+
+static const unsigned class_sizes[] = { 1, 2, 4 };
+#define NUM_CLASSES (sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+static struct ra_regs *
+create_reg_set(void *mem_ctx)
+{
+   unsigned count = 0;
+   for (unsigned c = 0; c < NUM_CLASSES; c++)
+      count += BASE_REGS / class_sizes[c];
+
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, count, true);
+
+   unsigned reg = 0;
+   for (unsigned c = 0; c < NUM_CLASSES; c++) {
+      unsigned class = ra_alloc_reg_class(regs);
+
+      for (unsigned base = 0; base < BASE_REGS; base += class_sizes[c]) {
+         ra_class_add_reg(regs, class, reg);
+         for (unsigned i = 0; c > 0 && i < class_sizes[c]; i++)
+            ra_add_transitive_reg_conflict(regs, base + i, reg);
+         reg++;
+      }
+   }
+
+   ra_set_finalize(regs, NULL);
+
+   return regs;
+}
+
+/* Builds the graph of count values, each live from its definition to a
+ * random later point, so that about max_live of them are live at once.
+ */
+static struct ra_graph *
+create_graph(struct ra_regs *regs, unsigned count, unsigned max_live)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+   unsigned *end = malloc(count * sizeof(*end));
+
+   srand(count);
+   for (unsigned n = 0; n < count; n++) {
+      unsigned r = rand() % 10;
+      ra_set_node_class(g, n, r < 7 ? 0 : r < 9 ? 1 : 2);
+      ra_set_node_spill_cost(g, n, 1.0f + rand() % 100);
+      end[n] = n + 1 + rand() % (2 * max_live);
+   }
+
+   for (unsigned n = 0; n < count; n++) {
+      for (unsigned n2 = n + 1; n2 < count && n2 < end[n]; n2++)
+         ra_add_node_interference(g, n, n2);
+   }
+
+   free(end);
+
+   return g;
+}
+
+static void
+run(const char *name, struct ra_graph *g, unsigned count)
+{
+   bool ok = true;
+   int64_t start = os_time_get_nano();
+
+   for (unsigned i = 0; i < REPEAT; i++)
+      ok = ra_allocate(g);
+
+   double ms = (os_time_get_nano() - start) / 1e6 / REPEAT;
+   int spill = ok ? -1 : ra_get_best_spill_node(g);
+
+   printf("%-40s %8u nodes %10.3f ms %s", name, count, ms,
+          ok ? "colored" : "failed");
+   if (spill >= 0)
+      printf(", spill node %d", spill);
+   printf("\n");
+}
+
+static bool
+replay(const char *filename)
+{
+   FILE *f = fopen(filename, "rb");
+   if (!f) {
+      fprintf(stderr, "Failed to open %s\n", filename);
+      return false;
+   }
+
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   void *mem_ctx = ralloc_context(NULL);
+   void *data = ralloc_size(mem_ctx, size > 0 ? size : 1);
+   bool read = size > 0 && fread(data, 1, size, f) == (size_t)size;
+   fclose(f);
+
+   struct ra_graph *g = NULL;
+   unsigned count = 0;
+   if (read) {
+      struct blob_reader blob;
+      blob_reader_init(&blob, data, size);
+
+      struct ra_regs *regs = ra_set_deserialize(mem_ctx, &blob);
+      if (!blob.overrun) {
+         /* The node count comes first in the graph. */
+         struct blob_reader peek = blob;
+         count = blob_read_uint32(&peek);
+         g = ra_graph_deserialize(regs, &blob);
+      }
+   }
+
+   if (!g) {
+      fprintf(stderr, "Failed to read %s\n", filename);
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   run(filename, g, count);
+
+   ralloc_free(g);
+   ralloc_free(mem_ctx);
+
+   return true;
+}
+
+int
+main(int argc, char **argv)
+{
+   if (argc > 1) {
+      bool ok = true;
+      for (int i = 1; i < argc; i++)
+         ok &= replay(argv[i]);
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+
+   void *mem_ctx = ralloc_context(NULL);
+   struct ra_regs *regs = create_reg_set(mem_ctx);
+
+   static const struct {
+      unsigned count;
+      unsigned max_live;
+   } shapes[] = {
+      { 1000, 40 },
+      { 4000, 60 },
+      { 16000, 80 },
+      { 4000, 120 },
+      { 16000, 120 },
+   };
+
+   for (unsigned i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+      char name[64];
+      snprintf(name, sizeof(name), "synthetic, %u live",
+               shapes[i].max_live);
+
+      struct ra_graph *g = create_graph(regs, shapes[i].count,
+                                        shapes[i].max_live);
+      run(name, g, shapes[i].count);
+      ralloc_free(g);
+   }
+
+   ralloc_free(mem_ctx);
+
+   return EXIT_SUCCESS;
+}
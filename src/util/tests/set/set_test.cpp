@@ -146,3 +146,57 @@ TEST(set, search_or_add)
 
    _mesa_set_destroy(s, NULL);
 }
+
+TEST(set, grouped)
+{
+   struct set *ref = _mesa_set_create(NULL, hash_int, cmp_int);
+   struct set *s = _mesa_set_create_grouped(NULL, hash_int, cmp_int);
+   static int keys[2048];
+
+   EXPECT_TRUE(s->ctrl);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      keys[i] = i;
+
+   /* Mix additions and removals so that both tombstones and rehashes of
+    * both kinds happen, and check that the grouped set tracks a regular one.
+    */
+   srand(0);
+   for (unsigned i = 0; i < 100000; i++) {
+      int *key = &keys[rand() % (16 + i % ARRAY_SIZE(keys)) %
+                       ARRAY_SIZE(keys)];
+      bool found, ref_found;
+
+      if (rand() % 3) {
+         _mesa_set_search_and_add(ref, key, &ref_found);
+         _mesa_set_search_and_add(s, key, &found);
+         EXPECT_EQ(found, ref_found);
+      } else {
+         _mesa_set_remove_key(ref, key);
+         _mesa_set_remove_key(s, key);
+      }
+      EXPECT_EQ(s->entries, ref->entries);
+   }
+
+   set_foreach(ref, entry)
+      EXPECT_TRUE(_mesa_set_search(s, entry->key));
+
+   struct set *clone = _mesa_set_clone(s, NULL);
+   EXPECT_EQ(clone->entries, s->entries);
+   set_foreach(ref, entry)
+      EXPECT_TRUE(_mesa_set_search(clone, entry->key));
+
+   _mesa_set_resize(clone, 10000);
+   EXPECT_EQ(clone->entries, s->entries);
+   set_foreach(ref, entry)
+      EXPECT_TRUE(_mesa_set_search(clone, entry->key));
+
+   _mesa_set_clear(s, NULL);
+   EXPECT_EQ(s->entries, 0);
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_FALSE(_mesa_set_search(s, &keys[i]));
+
+   _mesa_set_destroy(ref, NULL);
+   _mesa_set_destroy(s, NULL);
+   _mesa_set_destroy(clone, NULL);
+}
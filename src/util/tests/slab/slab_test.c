@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#undef NDEBUG
+
+#include "util/macros.h"
+#include "util/slab.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define ITEM_SIZE 24
+#define ITEMS_PER_PAGE 8
+#define NUM_OBJECTS (SLAB_MAGAZINE_SIZE * 3 + 5)
+
+/* Objects freed in another child pool go back to their owner in batches,
+ * and are reused from there.
+ */
+static void
+test_migration(void)
+{
+   struct slab_parent_pool parent;
+   struct slab_child_pool owner, other;
+   struct slab_stats stats;
+   void *objects[NUM_OBJECTS];
+   const unsigned num_pages =
+      (NUM_OBJECTS + ITEMS_PER_PAGE - 1) / ITEMS_PER_PAGE;
+
+   slab_create_parent(&parent, ITEM_SIZE, ITEMS_PER_PAGE);
+   slab_create_child(&owner, &parent);
+   slab_create_child(&other, &parent);
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++) {
+      objects[i] = slab_alloc(&owner);
+      assert(objects[i]);
+      memset(objects[i], i, ITEM_SIZE);
+   }
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_pages == num_pages);
+   assert(stats.num_migrations == 0);
+   assert(stats.num_magazine_flushes == 0);
+
+   /* Only full magazines are returned. */
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      slab_free(&other, objects[i]);
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_migrations ==
+          NUM_OBJECTS / SLAB_MAGAZINE_SIZE * SLAB_MAGAZINE_SIZE);
+   assert(stats.num_magazine_flushes == NUM_OBJECTS / SLAB_MAGAZINE_SIZE);
+
+   slab_flush_magazine(&other);
+   slab_flush_magazine(&owner);
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_migrations == NUM_OBJECTS);
+   assert(stats.num_magazine_flushes == NUM_OBJECTS / SLAB_MAGAZINE_SIZE + 1);
+   assert(stats.num_live == 0);
+   assert(stats.num_pages == num_pages);
+
+   /* The owner gets its objects back instead of allocating pages. */
+   for (unsigned i = 0; i < NUM_OBJECTS; i++) {
+      objects[i] = slab_alloc(&owner);
+      assert(objects[i]);
+   }
+
+   slab_flush_magazine(&owner);
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_pages == num_pages);
+   assert(stats.num_live == NUM_OBJECTS);
+
+   for (unsigned i = 0; i < NUM_OBJECTS; i++)
+      slab_free(&owner, objects[i]);
+
+   slab_destroy_child(&other);
+   slab_destroy_child(&owner);
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_pages == 0);
+   assert(stats.num_live == 0);
+
+   slab_destroy_parent(&parent);
+}
+
+/* The owner may be destroyed while its objects sit in the magazine of
+ * another pool, their pages are freed once the magazine is returned.
+ */
+static void
+test_owner_destroyed(void)
+{
+   struct slab_parent_pool parent;
+   struct slab_child_pool owner, other;
+   struct slab_stats stats;
+   void *objects[SLAB_MAGAZINE_SIZE / 2];
+   void *kept;
+
+   slab_create_parent(&parent, ITEM_SIZE, ITEMS_PER_PAGE);
+   slab_create_child(&owner, &parent);
+   slab_create_child(&other, &parent);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(objects); i++)
+      objects[i] = slab_alloc(&owner);
+   kept = slab_alloc(&owner);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(objects); i++)
+      slab_free(&other, objects[i]);
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_magazine_flushes == 0);
+
+   slab_destroy_child(&owner);
+
+   /* The pages are still used by the magazine and the kept object. */
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_pages ==
+          (ARRAY_SIZE(objects) + 1 + ITEMS_PER_PAGE - 1) / ITEMS_PER_PAGE);
+
+   slab_flush_magazine(&other);
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_migrations == ARRAY_SIZE(objects));
+   assert(stats.num_magazine_flushes == 1);
+   assert(stats.num_pages == 1);
+
+   /* Freeing the last object of an orphaned page frees the page. */
+   slab_free(&other, kept);
+   slab_destroy_child(&other);
+
+   slab_get_stats(&parent, &stats);
+   assert(stats.num_pages == 0);
+   assert(stats.num_live == 0);
+
+   slab_destroy_parent(&parent);
+}
+
+int
+main(int argc, char **argv)
+{
+   test_migration();
+   test_owner_destroyed();
+
+   return 0;
+}
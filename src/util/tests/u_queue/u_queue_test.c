@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#undef NDEBUG
+
+#include "util/u_queue.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define NUM_JOBS 4096
+
+struct test_job {
+   struct util_queue_fence fence;
+   unsigned executed;
+   int cleanup_thread;
+   unsigned *order;
+   unsigned id;
+};
+
+static struct util_queue_fence gate;
+static unsigned order_idx;
+
+static void
+test_execute(void *data, int thread_index)
+{
+   struct test_job *job = data;
+
+   p_atomic_inc(&job->executed);
+   if (job->order)
+      job->order[p_atomic_inc_return(&order_idx) - 1] = job->id;
+}
+
+static void
+test_cleanup(void *data, int thread_index)
+{
+   struct test_job *job = data;
+
+   job->cleanup_thread = thread_index;
+}
+
+static void
+wait_for_gate(void *data, int thread_index)
+{
+   util_queue_fence_wait(&gate);
+}
+
+/* Every job runs exactly once, or is cancelled and never runs. */
+static void
+test_many_jobs(unsigned flags)
+{
+   struct util_queue queue;
+   struct test_job *jobs = calloc(NUM_JOBS, sizeof(*jobs));
+   struct util_queue_stats stats;
+   unsigned num_cancelled = 0;
+
+   assert(jobs);
+   assert(util_queue_init(&queue, "test", 8, 4, flags));
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job_ex(&queue, &jobs[i], &jobs[i].fence, test_execute,
+                            test_cleanup, 1, i % UTIL_QUEUE_NUM_PRIORITIES,
+                            i % 5 == 0 ? UTIL_QUEUE_ANY_THREAD : i % 5 - 1);
+
+      if (i % 3 == 2 && util_queue_cancel_job(&queue, &jobs[i - 1].fence))
+         num_cancelled++;
+
+      if (i == NUM_JOBS / 2)
+         util_queue_adjust_num_threads(&queue, 2);
+      if (i == NUM_JOBS * 3 / 4)
+         util_queue_adjust_num_threads(&queue, 4);
+   }
+
+   util_queue_finish(&queue);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      assert(util_queue_fence_is_signalled(&jobs[i].fence));
+      if (jobs[i].cleanup_thread == -1) {
+         assert(jobs[i].executed == 0);
+         num_cancelled--;
+      } else {
+         assert(jobs[i].executed == 1);
+      }
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+   assert(num_cancelled == 0);
+
+   util_queue_get_stats(&queue, &stats);
+   assert(stats.num_queued == 0);
+   assert(stats.max_queued > 0);
+   assert(stats.num_executed >= NUM_JOBS - stats.num_cancelled);
+   assert(stats.max_wait_time_ns <= stats.total_wait_time_ns);
+
+   util_queue_destroy(&queue);
+   free(jobs);
+}
+
+struct add_thread_input {
+   struct util_queue *queue;
+   struct test_job *jobs;
+};
+
+static int
+add_jobs_thread(void *data)
+{
+   struct add_thread_input *input = data;
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      util_queue_add_job_ex(input->queue, &input->jobs[i],
+                            &input->jobs[i].fence, test_execute, NULL, 0,
+                            UTIL_QUEUE_PRIORITY_NORMAL, i % 4);
+   }
+   return 0;
+}
+
+/* Jobs added for a thread while it is being terminated still run. */
+static void
+test_adjust_while_adding(void)
+{
+   struct util_queue queue;
+   struct test_job *jobs = calloc(NUM_JOBS, sizeof(*jobs));
+   struct add_thread_input input = { &queue, jobs };
+   thrd_t thread;
+
+   assert(jobs);
+   assert(util_queue_init(&queue, "test", 8, 4,
+                          UTIL_QUEUE_INIT_WORK_STEALING |
+                          UTIL_QUEUE_INIT_RESIZE_IF_FULL));
+
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      util_queue_fence_init(&jobs[i].fence);
+
+   assert(thrd_create(&thread, add_jobs_thread, &input) == thrd_success);
+   for (unsigned i = 0; i < 200; i++)
+      util_queue_adjust_num_threads(&queue, i % 2 ? 4 : 1);
+   thrd_join(thread, NULL);
+
+   util_queue_finish(&queue);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      assert(util_queue_fence_is_signalled(&jobs[i].fence));
+      assert(jobs[i].executed == 1);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+
+   util_queue_destroy(&queue);
+   free(jobs);
+}
+
+/* Queued jobs start in priority order, and cancelled ones never run. */
+static void
+test_priorities(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate_fence;
+   struct test_job jobs[UTIL_QUEUE_NUM_PRIORITIES * 2] = {0};
+   unsigned order[ARRAY_SIZE(jobs)];
+
+   assert(util_queue_init(&queue, "test", 8, 1,
+                          UTIL_QUEUE_INIT_WORK_STEALING));
+
+   /* Keep the thread busy while the jobs are queued. */
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+   util_queue_fence_init(&gate_fence);
+   util_queue_add_job(&queue, &gate, &gate_fence, wait_for_gate, NULL, 0);
+
+   order_idx = 0;
+   for (unsigned i = 0; i < ARRAY_SIZE(jobs); i++) {
+      jobs[i].order = order;
+      jobs[i].id = i;
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job_ex(&queue, &jobs[i], &jobs[i].fence, test_execute,
+                            test_cleanup, 0, i % UTIL_QUEUE_NUM_PRIORITIES,
+                            UTIL_QUEUE_ANY_THREAD);
+   }
+
+   /* Job 1 is the first of normal priority. */
+   assert(util_queue_cancel_job(&queue, &jobs[1].fence));
+   assert(jobs[1].cleanup_thread == -1);
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   assert(jobs[1].executed == 0);
+   assert(order_idx == ARRAY_SIZE(jobs) - 1);
+   assert(order[0] == 2 && order[1] == 5);   /* high */
+   assert(order[2] == 4);                    /* normal */
+   assert(order[3] == 0 && order[4] == 3);   /* low */
+
+   assert(!util_queue_cancel_job(&queue, &jobs[0].fence));
+
+   util_queue_destroy(&queue);
+}
+
+int
+main(int argc, char **argv)
+{
+   test_many_jobs(0);
+   test_many_jobs(UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_many_jobs(UTIL_QUEUE_INIT_WORK_STEALING);
+   test_many_jobs(UTIL_QUEUE_INIT_WORK_STEALING |
+                  UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_adjust_while_adding();
+   test_priorities();
+
+   return 0;
+}
@@ -235,49 +235,174 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
 #endif
 
 /****************************************************************************
- * util_queue implementation
+ * Per-thread job lists for UTIL_QUEUE_INIT_WORK_STEALING
  */
 
-struct thread_input {
-   struct util_queue *queue;
-   int thread_index;
-};
+static inline struct util_queue_job_list *
+get_job_list(struct util_queue *queue, unsigned thread_index,
+             enum util_queue_priority priority)
+{
+   return &queue->job_lists[thread_index * UTIL_QUEUE_NUM_PRIORITIES +
+                            priority];
+}
 
-static int
-util_queue_thread_func(void *input)
+static void
+job_list_push(struct util_queue_job_list *list,
+              const struct util_queue_job *job)
 {
-   struct util_queue *queue = ((struct thread_input*)input)->queue;
-   int thread_index = ((struct thread_input*)input)->thread_index;
+   mtx_lock(&list->lock);
 
-   free(input);
+   if (list->num_jobs == list->size) {
+      unsigned new_size = MAX2(list->size * 2, 8);
+      struct util_queue_job *jobs =
+         (struct util_queue_job*)malloc(new_size * sizeof(*jobs));
+      assert(jobs);
 
-#ifdef HAVE_PTHREAD_SETAFFINITY
-   if (queue->flags & UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY) {
-      /* Don't inherit the thread affinity from the parent thread.
-       * Set the full mask.
-       */
-      cpu_set_t cpuset;
-      CPU_ZERO(&cpuset);
-      for (unsigned i = 0; i < CPU_SETSIZE; i++)
-         CPU_SET(i, &cpuset);
+      for (unsigned i = 0; i < list->num_jobs; i++)
+         jobs[i] = list->jobs[(list->head + i) & (list->size - 1)];
 
-      pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+      free(list->jobs);
+      list->jobs = jobs;
+      list->size = new_size;
+      list->head = 0;
    }
-#endif
 
-#if defined(__linux__)
-   if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
-      /* The nice() function can only set a maximum of 19. */
-      setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+   list->jobs[(list->head + list->num_jobs) & (list->size - 1)] = *job;
+   p_atomic_set(&list->num_jobs, list->num_jobs + 1);
+
+   mtx_unlock(&list->lock);
+}
+
+static bool
+job_list_pop(struct util_queue_job_list *list, struct util_queue_job *job)
+{
+   bool found = false;
+
+   /* Don't take the lock of every empty list when looking for work. */
+   if (!p_atomic_read(&list->num_jobs))
+      return false;
+
+   mtx_lock(&list->lock);
+   if (list->num_jobs) {
+      *job = list->jobs[list->head];
+      list->head = (list->head + 1) & (list->size - 1);
+      p_atomic_set(&list->num_jobs, list->num_jobs - 1);
+      found = true;
    }
-#endif
+   mtx_unlock(&list->lock);
 
-   if (strlen(queue->name) > 0) {
-      char name[16];
-      snprintf(name, sizeof(name), "%s%i", queue->name, thread_index);
-      u_thread_setname(name);
+   return found;
+}
+
+static bool
+job_list_remove(struct util_queue_job_list *list,
+                struct util_queue_fence *fence, struct util_queue_job *job)
+{
+   bool found = false;
+
+   if (!p_atomic_read(&list->num_jobs))
+      return false;
+
+   mtx_lock(&list->lock);
+   for (unsigned i = 0; i < list->num_jobs; i++) {
+      unsigned mask = list->size - 1;
+
+      if (list->jobs[(list->head + i) & mask].fence != fence)
+         continue;
+
+      *job = list->jobs[(list->head + i) & mask];
+
+      /* Keep the order of the remaining jobs. */
+      for (unsigned j = i; j + 1 < list->num_jobs; j++) {
+         list->jobs[(list->head + j) & mask] =
+            list->jobs[(list->head + j + 1) & mask];
+      }
+      p_atomic_set(&list->num_jobs, list->num_jobs - 1);
+      found = true;
+      break;
+   }
+   mtx_unlock(&list->lock);
+
+   return found;
+}
+
+/* Take the oldest job of the highest priority, preferring the thread's own
+ * jobs to stealing those of other threads.
+ */
+static bool
+util_queue_get_job(struct util_queue *queue, unsigned thread_index,
+                   struct util_queue_job *job)
+{
+   for (int prio = UTIL_QUEUE_NUM_PRIORITIES - 1; prio >= 0; prio--) {
+      if (job_list_pop(get_job_list(queue, thread_index, prio), job))
+         return true;
+
+      for (unsigned i = 1; i < queue->max_threads; i++) {
+         unsigned victim = (thread_index + i) % queue->max_threads;
+
+         if (job_list_pop(get_job_list(queue, victim, prio), job)) {
+            p_atomic_inc(&queue->stats.num_stolen);
+            return true;
+         }
+      }
    }
 
+   return false;
+}
+
+/****************************************************************************
+ * util_queue statistics
+ */
+
+static void
+util_queue_stats_max_u32(unsigned *max, unsigned value)
+{
+   unsigned old = p_atomic_read(max);
+
+   while (value > old) {
+      unsigned prev = p_atomic_cmpxchg(max, old, value);
+      if (prev == old)
+         break;
+      old = prev;
+   }
+}
+
+static void
+util_queue_stats_max_u64(uint64_t *max, uint64_t value)
+{
+   uint64_t old = p_atomic_read(max);
+
+   while (value > old) {
+      uint64_t prev = p_atomic_cmpxchg(max, old, value);
+      if (prev == old)
+         break;
+      old = prev;
+   }
+}
+
+static void
+util_queue_job_started(struct util_queue *queue,
+                       const struct util_queue_job *job)
+{
+   uint64_t wait_time = os_time_get_nano() - job->add_time;
+
+   p_atomic_inc(&queue->stats.num_executed);
+   p_atomic_add(&queue->stats.total_wait_time_ns, wait_time);
+   util_queue_stats_max_u64(&queue->stats.max_wait_time_ns, wait_time);
+}
+
+/****************************************************************************
+ * util_queue implementation
+ */
+
+struct thread_input {
+   struct util_queue *queue;
+   int thread_index;
+};
+
+static void
+util_queue_ring_buffer_loop(struct util_queue *queue, int thread_index)
+{
    while (1) {
       struct util_queue_job job;
 
@@ -305,16 +430,110 @@ util_queue_thread_func(void *input)
       mtx_unlock(&queue->lock);
 
       if (job.job) {
+         util_queue_job_started(queue, &job);
          job.execute(job.job, thread_index);
          util_queue_fence_signal(job.fence);
          if (job.cleanup)
             job.cleanup(job.job, thread_index);
       }
    }
+}
+
+static void
+util_queue_work_stealing_loop(struct util_queue *queue, int thread_index)
+{
+   while (1) {
+      struct util_queue_job job;
+
+      /* only kill threads that are above "num_threads" */
+      if (thread_index >= p_atomic_read(&queue->num_threads))
+         break;
+
+      if (!util_queue_get_job(queue, thread_index, &job)) {
+         /* Sleep until a job is added. Adding a job increments num_queued
+          * before checking num_sleeping, so the wakeup can't be missed.
+          */
+         mtx_lock(&queue->lock);
+         p_atomic_inc(&queue->num_sleeping);
+         while (thread_index < queue->num_threads &&
+                p_atomic_read(&queue->num_queued) == 0)
+            cnd_wait(&queue->has_queued_cond, &queue->lock);
+         p_atomic_dec(&queue->num_sleeping);
+         mtx_unlock(&queue->lock);
+         continue;
+      }
+
+      p_atomic_dec(&queue->num_queued);
+      p_atomic_add(&queue->total_jobs_size, -job.job_size);
+
+      if (p_atomic_read(&queue->num_waiting_for_space)) {
+         mtx_lock(&queue->lock);
+         cnd_signal(&queue->has_space_cond);
+         mtx_unlock(&queue->lock);
+      }
+
+      util_queue_job_started(queue, &job);
+      job.execute(job.job, thread_index);
+      util_queue_fence_signal(job.fence);
+      if (job.cleanup)
+         job.cleanup(job.job, thread_index);
+   }
+}
+
+static int
+util_queue_thread_func(void *input)
+{
+   struct util_queue *queue = ((struct thread_input*)input)->queue;
+   int thread_index = ((struct thread_input*)input)->thread_index;
+
+   free(input);
+
+#ifdef HAVE_PTHREAD_SETAFFINITY
+   if (queue->flags & UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY) {
+      /* Don't inherit the thread affinity from the parent thread.
+       * Set the full mask.
+       */
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      for (unsigned i = 0; i < CPU_SETSIZE; i++)
+         CPU_SET(i, &cpuset);
+
+      pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+   }
+#endif
+
+#if defined(__linux__)
+   if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
+      /* The nice() function can only set a maximum of 19. */
+      setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+   }
+#endif
+
+   if (strlen(queue->name) > 0) {
+      char name[16];
+      snprintf(name, sizeof(name), "%s%i", queue->name, thread_index);
+      u_thread_setname(name);
+   }
+
+   if (queue->flags & UTIL_QUEUE_INIT_WORK_STEALING)
+      util_queue_work_stealing_loop(queue, thread_index);
+   else
+      util_queue_ring_buffer_loop(queue, thread_index);
 
    /* signal remaining jobs if all threads are being terminated */
    mtx_lock(&queue->lock);
-   if (queue->num_threads == 0) {
+   if (queue->num_threads == 0 &&
+       queue->flags & UTIL_QUEUE_INIT_WORK_STEALING) {
+      for (unsigned i = 0; i < queue->max_threads * UTIL_QUEUE_NUM_PRIORITIES;
+           i++) {
+         struct util_queue_job job;
+
+         while (job_list_pop(&queue->job_lists[i], &job)) {
+            util_queue_fence_signal(job.fence);
+            p_atomic_dec(&queue->num_queued);
+         }
+      }
+   } else if (queue->num_threads == 0) {
       for (unsigned i = queue->read_idx; i != queue->write_idx;
            i = (i + 1) % queue->max_jobs) {
          if (queue->jobs[i].job) {
@@ -448,6 +667,17 @@ util_queue_init(struct util_queue *queue,
    cnd_init(&queue->has_queued_cond);
    cnd_init(&queue->has_space_cond);
 
+   if (flags & UTIL_QUEUE_INIT_WORK_STEALING) {
+      queue->job_lists = (struct util_queue_job_list*)
+         calloc(num_threads * UTIL_QUEUE_NUM_PRIORITIES,
+                sizeof(struct util_queue_job_list));
+      if (!queue->job_lists)
+         goto fail;
+
+      for (i = 0; i < num_threads * UTIL_QUEUE_NUM_PRIORITIES; i++)
+         (void) mtx_init(&queue->job_lists[i].lock, mtx_plain);
+   }
+
    queue->threads = (thrd_t*) calloc(num_threads, sizeof(thrd_t));
    if (!queue->threads)
       goto fail;
@@ -472,6 +702,12 @@ util_queue_init(struct util_queue *queue,
 fail:
    free(queue->threads);
 
+   if (queue->job_lists) {
+      for (i = 0; i < num_threads * UTIL_QUEUE_NUM_PRIORITIES; i++)
+         mtx_destroy(&queue->job_lists[i].lock);
+      free(queue->job_lists);
+   }
+
    if (queue->jobs) {
       cnd_destroy(&queue->has_space_cond);
       cnd_destroy(&queue->has_queued_cond);
@@ -510,6 +746,22 @@ util_queue_kill_threads(struct util_queue *queue, unsigned keep_num_threads,
    for (i = keep_num_threads; i < old_num_threads; i++)
       thrd_join(queue->threads[i], NULL);
 
+   /* Hand the jobs queued on the terminated threads to the remaining ones,
+    * so that util_queue_finish still waits for them.
+    */
+   if (queue->flags & UTIL_QUEUE_INIT_WORK_STEALING && keep_num_threads) {
+      for (i = keep_num_threads; i < old_num_threads; i++) {
+         for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+            struct util_queue_job job;
+
+            while (job_list_pop(get_job_list(queue, i, prio), &job)) {
+               job_list_push(get_job_list(queue, i % keep_num_threads, prio),
+                             &job);
+            }
+         }
+      }
+   }
+
    if (!finish_locked)
       mtx_unlock(&queue->finish_lock);
 }
@@ -524,10 +776,106 @@ util_queue_destroy(struct util_queue *queue)
    cnd_destroy(&queue->has_queued_cond);
    mtx_destroy(&queue->finish_lock);
    mtx_destroy(&queue->lock);
+
+   if (queue->job_lists) {
+      for (unsigned i = 0; i < queue->max_threads * UTIL_QUEUE_NUM_PRIORITIES;
+           i++) {
+         mtx_destroy(&queue->job_lists[i].lock);
+         free(queue->job_lists[i].jobs);
+      }
+      free(queue->job_lists);
+   }
+
    free(queue->jobs);
    free(queue->threads);
 }
 
+static void
+util_queue_add_job_work_stealing(struct util_queue *queue,
+                                 struct util_queue_job *job,
+                                 enum util_queue_priority priority,
+                                 int thread_index)
+{
+   unsigned num_threads = p_atomic_read(&queue->num_threads);
+
+   if (num_threads == 0) {
+      /* well no good option here, but any leaks will be
+       * short-lived as things are shutting down..
+       */
+      return;
+   }
+
+   util_queue_fence_reset(job->fence);
+
+   if (thread_index < 0 || thread_index >= num_threads)
+      thread_index = p_atomic_inc_return(&queue->next_thread) % num_threads;
+
+   /* Reserve a slot, waiting until there is a free one unless the queue is
+    * allowed to grow.  The job is counted before it's visible, so that
+    * num_queued never goes negative and sleeping threads see it.
+    */
+   int num_queued = p_atomic_read(&queue->num_queued);
+   while (1) {
+      if (num_queued >= queue->max_jobs &&
+          !(queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL &&
+            p_atomic_read(&queue->total_jobs_size) + job->job_size <
+            S_256MB)) {
+         mtx_lock(&queue->lock);
+         p_atomic_inc(&queue->num_waiting_for_space);
+         while ((num_queued = p_atomic_read(&queue->num_queued)) >=
+                queue->max_jobs && queue->num_threads)
+            cnd_wait(&queue->has_space_cond, &queue->lock);
+         p_atomic_dec(&queue->num_waiting_for_space);
+         mtx_unlock(&queue->lock);
+
+         /* The threads are being terminated, nothing will free a slot. */
+         if (num_queued >= queue->max_jobs) {
+            num_queued = p_atomic_inc_return(&queue->num_queued);
+            break;
+         }
+      }
+
+      int old = p_atomic_cmpxchg(&queue->num_queued, num_queued,
+                                 num_queued + 1);
+      if (old == num_queued) {
+         num_queued++;
+         break;
+      }
+      num_queued = old;
+   }
+
+   util_queue_stats_max_u32(&queue->stats.max_queued, num_queued);
+   p_atomic_add(&queue->total_jobs_size, job->job_size);
+
+   job_list_push(get_job_list(queue, thread_index, priority), job);
+
+   /* util_queue_adjust_num_threads may have terminated the thread in the
+    * meantime and handed its jobs to the remaining threads before the push.
+    * Reading num_threads after pushing under the list lock sees that, in
+    * which case wait for it to be done and hand the job over the same way.
+    */
+   if (thread_index >= p_atomic_read(&queue->num_threads)) {
+      mtx_lock(&queue->finish_lock);
+      num_threads = queue->num_threads;
+      if (num_threads && thread_index >= num_threads) {
+         struct util_queue_job moved;
+
+         while (job_list_pop(get_job_list(queue, thread_index, priority),
+                             &moved)) {
+            job_list_push(get_job_list(queue, thread_index % num_threads,
+                                       priority), &moved);
+         }
+      }
+      mtx_unlock(&queue->finish_lock);
+   }
+
+   if (p_atomic_read(&queue->num_sleeping)) {
+      mtx_lock(&queue->lock);
+      cnd_signal(&queue->has_queued_cond);
+      mtx_unlock(&queue->lock);
+   }
+}
+
 void
 util_queue_add_job(struct util_queue *queue,
                    void *job,
@@ -535,9 +883,40 @@ util_queue_add_job(struct util_queue *queue,
                    util_queue_execute_func execute,
                    util_queue_execute_func cleanup,
                    const size_t job_size)
+{
+   util_queue_add_job_ex(queue, job, fence, execute, cleanup, job_size,
+                         UTIL_QUEUE_PRIORITY_NORMAL, UTIL_QUEUE_ANY_THREAD);
+}
+
+void
+util_queue_add_job_ex(struct util_queue *queue,
+                      void *job,
+                      struct util_queue_fence *fence,
+                      util_queue_execute_func execute,
+                      util_queue_execute_func cleanup,
+                      const size_t job_size,
+                      enum util_queue_priority priority,
+                      int thread_index)
 {
    struct util_queue_job *ptr;
 
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+
+   if (queue->flags & UTIL_QUEUE_INIT_WORK_STEALING) {
+      struct util_queue_job new_job = {
+         .job = job,
+         .job_size = job_size,
+         .fence = fence,
+         .execute = execute,
+         .cleanup = cleanup,
+         .add_time = os_time_get_nano(),
+      };
+
+      util_queue_add_job_work_stealing(queue, &new_job, priority,
+                                       thread_index);
+      return;
+   }
+
    mtx_lock(&queue->lock);
    if (queue->num_threads == 0) {
       mtx_unlock(&queue->lock);
@@ -593,11 +972,13 @@ util_queue_add_job(struct util_queue *queue,
    ptr->execute = execute;
    ptr->cleanup = cleanup;
    ptr->job_size = job_size;
+   ptr->add_time = os_time_get_nano();
 
    queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
    queue->total_jobs_size += ptr->job_size;
 
    queue->num_queued++;
+   queue->stats.max_queued = MAX2(queue->stats.max_queued, queue->num_queued);
    cnd_signal(&queue->has_queued_cond);
    mtx_unlock(&queue->lock);
 }
@@ -615,30 +996,73 @@ util_queue_add_job(struct util_queue *queue,
 void
 util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 {
+   if (!util_queue_cancel_job(queue, fence))
+      util_queue_fence_wait(fence);
+}
+
+/**
+ * Remove a queued job that hasn't started execution yet, calling its cleanup
+ * callback and signalling the fence.
+ *
+ * \return false if the job has already started or completed, in which case
+ *         the fence is signalled when it completes.
+ */
+bool
+util_queue_cancel_job(struct util_queue *queue, struct util_queue_fence *fence)
+{
+   struct util_queue_job job;
    bool removed = false;
 
    if (util_queue_fence_is_signalled(fence))
-      return;
+      return false;
 
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
+   if (queue->flags & UTIL_QUEUE_INIT_WORK_STEALING) {
+      for (unsigned i = 0; i < queue->max_threads * UTIL_QUEUE_NUM_PRIORITIES;
+           i++) {
+         removed = job_list_remove(&queue->job_lists[i], fence, &job);
+         if (removed)
+            break;
+      }
+
+      if (removed) {
+         p_atomic_dec(&queue->num_queued);
+         p_atomic_add(&queue->total_jobs_size, -job.job_size);
+
+         if (p_atomic_read(&queue->num_waiting_for_space)) {
+            mtx_lock(&queue->lock);
+            cnd_signal(&queue->has_space_cond);
+            mtx_unlock(&queue->lock);
+         }
+      }
+   } else {
+      mtx_lock(&queue->lock);
+      for (unsigned i = queue->read_idx; i != queue->write_idx;
+           i = (i + 1) % queue->max_jobs) {
+         if (queue->jobs[i].fence == fence) {
+            job = queue->jobs[i];
+            queue->total_jobs_size -= job.job_size;
+
+            /* Just clear it. The threads will treat as a no-op job. */
+            memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
+            removed = true;
+            break;
+         }
       }
+      mtx_unlock(&queue->lock);
    }
-   mtx_unlock(&queue->lock);
 
-   if (removed)
+   if (removed) {
+      p_atomic_inc(&queue->stats.num_cancelled);
+
+      /* Signal before the cleanup, like the threads do, so that the cleanup
+       * callback may destroy the fence.
+       */
       util_queue_fence_signal(fence);
-   else
-      util_queue_fence_wait(fence);
+      if (job.cleanup)
+         job.cleanup(job.job, -1);
+   }
+
+   return removed;
 }
 
 static void
@@ -672,10 +1096,15 @@ util_queue_finish(struct util_queue *queue)
    fences = malloc(queue->num_threads * sizeof(*fences));
    util_barrier_init(&barrier, queue->num_threads);
 
+   /* With work stealing, each barrier job is queued behind the jobs of its
+    * thread at the lowest priority, so it can only start once all jobs
+    * added before were taken by a thread.
+    */
    for (unsigned i = 0; i < queue->num_threads; ++i) {
       util_queue_fence_init(&fences[i]);
-      util_queue_add_job(queue, &barrier, &fences[i],
-                         util_queue_finish_execute, NULL, 0);
+      util_queue_add_job_ex(queue, &barrier, &fences[i],
+                            util_queue_finish_execute, NULL, 0,
+                            UTIL_QUEUE_PRIORITY_LOW, i);
    }
 
    for (unsigned i = 0; i < queue->num_threads; ++i) {
@@ -698,3 +1127,14 @@ util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 
    return u_thread_get_time_nano(queue->threads[thread_index]);
 }
+
+/**
+ * Return the queue's counters. They are updated without synchronization
+ * with each other, so they are only approximately consistent.
+ */
+void
+util_queue_get_stats(struct util_queue *queue, struct util_queue_stats *stats)
+{
+   *stats = queue->stats;
+   stats->num_queued = MAX2(p_atomic_read(&queue->num_queued), 0);
+}
@@ -28,6 +28,11 @@
  *
  * Jobs can be added from any thread. After that, the wait call can be used
  * to wait for completion of the job.
+ *
+ * By default all threads take jobs in order from a single ring buffer. With
+ * UTIL_QUEUE_INIT_WORK_STEALING, each thread has its own job lists, one per
+ * priority, and idle threads steal jobs from the others. This avoids all
+ * threads contending on one lock and allows prioritizing jobs.
  */
 
 #ifndef U_QUEUE_H
@@ -49,6 +54,21 @@ extern "C" {
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
 #define UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY  (1 << 2)
+#define UTIL_QUEUE_INIT_WORK_STEALING             (1 << 3)
+
+/* Job priorities, only used with UTIL_QUEUE_INIT_WORK_STEALING. Queued jobs
+ * of a higher priority are always started before those of a lower one, so
+ * they overtake the lower priority jobs added before them.
+ */
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
+/* Let the queue pick the thread a job is queued on. */
+#define UTIL_QUEUE_ANY_THREAD -1
 
 #if defined(__GNUC__) && defined(HAVE_LINUX_FUTEX_H)
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -197,6 +217,31 @@ struct util_queue_job {
    struct util_queue_fence *fence;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   int64_t add_time; /* os_time_get_nano() when the job was added */
+};
+
+/* Jobs of one priority queued on one thread, for
+ * UTIL_QUEUE_INIT_WORK_STEALING. The owning thread and thieves both take
+ * jobs from the head, so that jobs start in the order they were added.
+ */
+struct util_queue_job_list {
+   mtx_t lock;
+   struct util_queue_job *jobs; /* ring buffer, size is a power of two */
+   unsigned size;
+   unsigned head;
+   unsigned num_jobs;
+};
+
+/* Counters for profiling, see util_queue_get_stats. */
+struct util_queue_stats {
+   unsigned num_queued;          /* jobs currently waiting for a thread */
+   unsigned max_queued;          /* the most jobs waiting at once */
+   uint64_t num_executed;
+   uint64_t num_cancelled;
+   uint64_t num_stolen;          /* jobs executed by another thread than the
+                                  * one they were queued on */
+   uint64_t total_wait_time_ns;  /* time between adding and starting jobs */
+   uint64_t max_wait_time_ns;
 };
 
 /* Put this into your context. */
@@ -216,6 +261,17 @@ struct util_queue {
    size_t total_jobs_size;  /* memory use of all jobs in the queue */
    struct util_queue_job *jobs;
 
+   /* UTIL_QUEUE_INIT_WORK_STEALING: "jobs" isn't used, the jobs are in
+    * job_lists[thread * UTIL_QUEUE_NUM_PRIORITIES + priority] instead, and
+    * num_queued is updated atomically. "lock" only protects sleeping.
+    */
+   struct util_queue_job_list *job_lists;
+   unsigned num_sleeping;
+   unsigned num_waiting_for_space;
+   unsigned next_thread;
+
+   struct util_queue_stats stats;
+
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
 };
@@ -234,8 +290,24 @@ void util_queue_add_job(struct util_queue *queue,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup,
                         const size_t job_size);
+
+/* Same as util_queue_add_job, with a priority and the index of the thread
+ * the job should preferably run on, or UTIL_QUEUE_ANY_THREAD. Both are
+ * ignored without UTIL_QUEUE_INIT_WORK_STEALING.
+ */
+void util_queue_add_job_ex(struct util_queue *queue,
+                           void *job,
+                           struct util_queue_fence *fence,
+                           util_queue_execute_func execute,
+                           util_queue_execute_func cleanup,
+                           const size_t job_size,
+                           enum util_queue_priority priority,
+                           int thread_index);
+
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
+bool util_queue_cancel_job(struct util_queue *queue,
+                           struct util_queue_fence *fence);
 
 void util_queue_finish(struct util_queue *queue);
 
@@ -249,6 +321,9 @@ util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads);
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
+void util_queue_get_stats(struct util_queue *queue,
+                          struct util_queue_stats *stats);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)